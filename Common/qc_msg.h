@@ -170,6 +170,71 @@ struct DroneState
 };
 
 
+//  ****************************************************************************
+enum LoopStage
+{
+  k_stage_period    = 0,        // Interval between consecutive IMU samples.
+  k_stage_wake      = 1,        // IMU sample published -> control loop starts.
+  k_stage_stabilize = 2,        // Stabilization (angle) PIDs.
+  k_stage_rate      = 3,        // Rate PIDs.
+  k_stage_plant     = 4,        // Motor mixing and ESC output.
+  k_stage_total     = 5,        // IMU sample published -> control cycle complete.
+
+  k_stage_count
+};
+
+//  ****************************************************************************
+struct LoopStageStats
+{
+  uint8_t   stage;
+  uint32_t  count;
+  uint32_t  overruns;
+  uint32_t  min_ns;
+  uint32_t  p50_ns;
+  uint32_t  p99_ns;
+  uint32_t  p999_ns;
+  uint32_t  max_ns;
+};
+
+//  ****************************************************************************
+struct LoopStats
+{
+  uint8_t         count;
+  LoopStageStats  stage[k_stage_count];
+};
+
+//  ****************************************************************************
+enum DegradeMode
+{
+  k_degrade_none          = 0,  // Normal operation.
+  k_degrade_no_logging    = 1,  // The flight log is not recorded.
+  k_degrade_no_telemetry  = 2,  // The state is not reported.
+  k_degrade_hold          = 3,  // The sticks are ignored, the attitude is held level.
+  k_degrade_descend       = 4,  // The throttle is reduced to descend, until disarmed.
+
+  k_degrade_count
+};
+
+//  ****************************************************************************
+struct DegradeModeStats
+{
+  uint8_t   mode;
+  uint32_t  entered;            // Times the mode was entered.
+  uint32_t  cycles;             // Control cycles completed in the mode.
+};
+
+//  ****************************************************************************
+struct WatchdogStats
+{
+  uint8_t           mode;             // The current DegradeMode.
+  uint32_t          overruns;         // Cycles that did not complete within the time slice.
+  uint32_t          missed_samples;   // IMU samples that did not arrive.
+  uint32_t          max_faults;       // Most consecutive overruns and missed samples.
+  uint8_t           count;
+  DegradeModeStats  modes[k_degrade_count];
+};
+
+
 //  ****************************************************************************
 const uint16_t  k_qc_msg_header           = 0x4EAD;
 const uint16_t  k_qc_msg_beacon           = 0xBEAC;
@@ -184,6 +249,8 @@ const uint16_t  k_qc_msg_adjust_gain      = 0x0404;
 const uint16_t  k_qc_msg_drone_state      = 0x0505;
 const uint16_t  k_qc_req_pid_state        = 0x050A;
 const uint16_t  k_qc_msg_pid_state        = 0x051A;
+const uint16_t  k_qc_msg_loop_stats       = 0x0520;
+const uint16_t  k_qc_msg_watchdog         = 0x0521;
 const uint16_t  k_qc_msg_disarm           = 0x0909;
 const uint16_t  k_qc_msg_halt             = 0x0911;
 
@@ -315,6 +382,22 @@ struct QCPIDStateMsg
 };
 
 
+//  ****************************************************************************
+struct QCLoopStatsMsg
+{
+  QCHeader    header;
+  LoopStats   stats;
+};
+
+
+//  ****************************************************************************
+struct QCWatchdogMsg
+{
+  QCHeader      header;
+  WatchdogStats stats;
+};
+
+
 //  ****************************************************************************
 inline
 uint16_t DecodeMessageType(const uint8_t* p_buffer, size_t len)
@@ -425,6 +508,22 @@ uint16_t MessageType<QCDroneStateMsg>()
 }
 
 
+template <>
+inline 
+uint16_t MessageType<QCLoopStatsMsg>()
+{
+  return k_qc_msg_loop_stats;
+}
+
+
+template <>
+inline 
+uint16_t MessageType<QCWatchdogMsg>()
+{
+  return k_qc_msg_watchdog;
+}
+
+
 template <>
 inline 
 uint16_t MessageType<QCDisarmMsg>()
@@ -893,6 +992,219 @@ size_t Deserialize(Batteries &data, const uint8_t* p_buffer, size_t len)
 }
 
 
+//  ****************************************************************************
+inline
+size_t Serialize(const LoopStageStats &data, uint8_t* p_buffer, size_t len)
+{
+  if ( !p_buffer
+    || len < sizeof(LoopStageStats))
+  {
+    return 0;
+  }
+
+  size_t   offset= 0;
+  uint8_t* p_cur = p_buffer;
+
+  p_cur[0] = data.stage;
+  offset++;
+  p_cur++;
+
+  offset += Serialize_uint32(data.count,    &p_cur);
+  offset += Serialize_uint32(data.overruns, &p_cur);
+  offset += Serialize_uint32(data.min_ns,   &p_cur);
+  offset += Serialize_uint32(data.p50_ns,   &p_cur);
+  offset += Serialize_uint32(data.p99_ns,   &p_cur);
+  offset += Serialize_uint32(data.p999_ns,  &p_cur);
+  offset += Serialize_uint32(data.max_ns,   &p_cur);
+
+  return offset;
+}
+
+//  ****************************************************************************
+inline
+size_t Deserialize(LoopStageStats &data, const uint8_t* p_buffer, size_t len)
+{
+  if ( !p_buffer
+    || len < sizeof(LoopStageStats))
+  {
+    return 0;
+  }
+
+  size_t   offset= 0;
+  const uint8_t* p_cur = p_buffer;
+
+  data.stage = p_cur[0];
+  offset++;
+  p_cur++;
+
+  offset += Deserialize_uint32(data.count,    &p_cur);
+  offset += Deserialize_uint32(data.overruns, &p_cur);
+  offset += Deserialize_uint32(data.min_ns,   &p_cur);
+  offset += Deserialize_uint32(data.p50_ns,   &p_cur);
+  offset += Deserialize_uint32(data.p99_ns,   &p_cur);
+  offset += Deserialize_uint32(data.p999_ns,  &p_cur);
+  offset += Deserialize_uint32(data.max_ns,   &p_cur);
+
+  return offset;
+}
+
+//  ****************************************************************************
+inline
+size_t Serialize(const LoopStats &data, uint8_t* p_buffer, size_t len)
+{
+  if ( !p_buffer
+    || len < sizeof(LoopStats))
+  {
+    return 0;
+  }
+
+  size_t   offset= 0;
+
+  p_buffer[0] = data.count;
+  offset++;
+
+  for (uint8_t i = 0; i < data.count && i < k_stage_count; ++i)
+  {
+    offset += Serialize(data.stage[i], p_buffer + offset, len - offset); 
+  }
+
+  return offset;
+}
+
+//  ****************************************************************************
+inline
+size_t Deserialize(LoopStats &data, const uint8_t* p_buffer, size_t len)
+{
+  if ( !p_buffer
+    || len < sizeof(LoopStats))
+  {
+    return 0;
+  }
+
+  size_t   offset= 0;
+
+  data.count = p_buffer[0];
+  offset++;
+
+  for (uint8_t i = 0; i < data.count && i < k_stage_count; ++i)
+  {
+    offset += Deserialize(data.stage[i], p_buffer + offset, len - offset); 
+  }
+
+  return offset;
+}
+
+//  ****************************************************************************
+inline
+size_t Serialize(const DegradeModeStats &data, uint8_t* p_buffer, size_t len)
+{
+  if ( !p_buffer
+    || len < sizeof(DegradeModeStats))
+  {
+    return 0;
+  }
+
+  size_t   offset= 0;
+  uint8_t* p_cur = p_buffer;
+
+  p_cur[0] = data.mode;
+  offset++;
+  p_cur++;
+
+  offset += Serialize_uint32(data.entered,  &p_cur);
+  offset += Serialize_uint32(data.cycles,   &p_cur);
+
+  return offset;
+}
+
+//  ****************************************************************************
+inline
+size_t Deserialize(DegradeModeStats &data, const uint8_t* p_buffer, size_t len)
+{
+  if ( !p_buffer
+    || len < sizeof(DegradeModeStats))
+  {
+    return 0;
+  }
+
+  size_t   offset= 0;
+  const uint8_t* p_cur = p_buffer;
+
+  data.mode = p_cur[0];
+  offset++;
+  p_cur++;
+
+  offset += Deserialize_uint32(data.entered,  &p_cur);
+  offset += Deserialize_uint32(data.cycles,   &p_cur);
+
+  return offset;
+}
+
+//  ****************************************************************************
+inline
+size_t Serialize(const WatchdogStats &data, uint8_t* p_buffer, size_t len)
+{
+  if ( !p_buffer
+    || len < sizeof(WatchdogStats))
+  {
+    return 0;
+  }
+
+  size_t   offset= 0;
+  uint8_t* p_cur = p_buffer;
+
+  p_cur[0] = data.mode;
+  offset++;
+  p_cur++;
+
+  offset += Serialize_uint32(data.overruns,       &p_cur);
+  offset += Serialize_uint32(data.missed_samples, &p_cur);
+  offset += Serialize_uint32(data.max_faults,     &p_cur);
+
+  p_buffer[offset] = data.count;
+  offset++;
+
+  for (uint8_t i = 0; i < data.count && i < k_degrade_count; ++i)
+  {
+    offset += Serialize(data.modes[i], p_buffer + offset, len - offset); 
+  }
+
+  return offset;
+}
+
+//  ****************************************************************************
+inline
+size_t Deserialize(WatchdogStats &data, const uint8_t* p_buffer, size_t len)
+{
+  if ( !p_buffer
+    || len < sizeof(WatchdogStats))
+  {
+    return 0;
+  }
+
+  size_t   offset= 0;
+  const uint8_t* p_cur = p_buffer;
+
+  data.mode = p_cur[0];
+  offset++;
+  p_cur++;
+
+  offset += Deserialize_uint32(data.overruns,       &p_cur);
+  offset += Deserialize_uint32(data.missed_samples, &p_cur);
+  offset += Deserialize_uint32(data.max_faults,     &p_cur);
+
+  data.count = p_buffer[offset];
+  offset++;
+
+  for (uint8_t i = 0; i < data.count && i < k_degrade_count; ++i)
+  {
+    offset += Deserialize(data.modes[i], p_buffer + offset, len - offset); 
+  }
+
+  return offset;
+}
+
+
 //  ****************************************************************************
 inline
 int write_message(COMPORT comm, 
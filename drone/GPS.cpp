@@ -8,10 +8,13 @@
 ///
 //  ****************************************************************************
 #include "GPS.h"
+#include "utility/timebase.h"
 
 #include <iostream>
 
+#include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 #include <termios.h>
 #include <sys/time.h>
@@ -39,23 +42,43 @@ namespace GPS
 
 //  ****************************************************************************
 UltimateGPS::UltimateGPS()
-  : m_file(0)
+  : m_file(-1)
+  , mp_clock(nullptr)
   , m_fix_data{0}
   , m_cur_pos{0}
   , m_last_pos{0}
   , m_is_exit(false)
+  , m_receive{0}
+  , m_received(0)
+  , m_polls(0)
+  , m_reads(0)
+  , m_sentences(0)
+  , m_fixes(0)
+  , m_overruns(0)
+  , m_fix_ns(0)
 { }
 
 
 //  ****************************************************************************
 //  Communication is fixed at 57600 baud, and updates 5 times / second
 //
-bool UltimateGPS::init()
+//  @param device   The serial device the GPS is connected to,
+//                  nullptr if there is no receiver.
+//  @param clock    The clock of the platform, which stamps the fixes.
+//
+bool UltimateGPS::init(const char* device, const HAL::Clock &clock)
 {
-  m_file = open("/dev/ttyO2", O_RDWR | O_NOCTTY | O_NDELAY);
+  if (!device)
+  {
+    return false;
+  }
+
+  mp_clock = &clock;
+
+  m_file = open(device, O_RDWR | O_NOCTTY | O_NDELAY);
   if (m_file < 0)
   {
-    cout << "UART: Failed (" << m_file << ") to open the GPS Serial Port 2." << endl;
+    cout << "UART: Failed (" << m_file << ") to open the GPS Serial Port " << device << "." << endl;
     return false;
   }
 
@@ -118,11 +141,15 @@ void UltimateGPS::term( )
 
   if (m_read_thread.joinable( ))
   {
+    m_exit_event.notify( );
     m_read_thread.join( );
   }
 
-  ::close(m_file);
-  m_file = 0;
+  if (m_file >= 0)
+  {
+    ::close(m_file);
+    m_file = -1;
+  }
 }
 
 
@@ -143,9 +170,48 @@ void UltimateGPS::thread_proc(UltimateGPS *p_this)
   if (!p_this)
     return;
 
+  pollfd descs[2] =
+  {
+    { p_this->m_file,               POLLIN, 0 },
+    { p_this->m_exit_event.fd(),    POLLIN, 0 }
+  };
+
+  // The thread sleeps until the port has data, and reads all that arrived.
   while (!p_this->m_is_exit)
   {
-    p_this->process( );
+    int result = ::poll(descs, 2, -1);
+    increment(p_this->m_polls);
+
+    if ( result < 0
+      && errno != EINTR)
+    {
+      cout << "The GPS read thread failed: " << strerror(errno) << endl;
+      break;
+    }
+
+    if (descs[1].revents & POLLIN)
+    {
+      p_this->m_exit_event.wait();
+      continue;
+    }
+
+    if (descs[0].revents & POLLIN)
+    {
+      if (!p_this->process())
+      {
+        break;
+      }
+    }
+    else if (descs[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+    {
+      break;
+    }
+  }
+
+  // A port that failed is no longer read, until the GPS is terminated.
+  while (!p_this->m_is_exit)
+  {
+    p_this->m_exit_event.wait();
   }
 }
 
@@ -153,35 +219,55 @@ void UltimateGPS::thread_proc(UltimateGPS *p_this)
 //  ****************************************************************************
 bool UltimateGPS::process()
 {
-  // NMEA sentences have a limit of 82 characters.
-  // Read until a new line is encountered.
-  char  receive[100];
-  int   len       = 0;
-  char  last_byte = 0;
-
-  while ( last_byte != '\n'
-       && len < 100)
+  ssize_t result = ::read(m_file, &m_receive[m_received], k_receive_size - m_received);
+  increment(m_reads);
+
+  if (result < 0)
   {
-    int result = read(m_file, (void*) &receive[len], 1);
-    if (result < 0)
-    {
-//      cout << "Failed (" << result << ") to read from the input.\n" 
-//           << "Discarding " << len << "bytes." << endl;
+    return errno == EAGAIN
+        || errno == EINTR;
+  }
+  else if (result == 0)
+  {
+    return false;
+  }
 
-      return false;
-    }
-    else if (result == 0)
+  // Only the bytes just read can end a sentence, and each sentence
+  // is parsed as soon as its new line arrives.
+  char *p_line  = m_receive;
+  char *p_next  = &m_receive[m_received];
+  char *p_end   = p_next + result;
+
+  while ((p_next = static_cast<char*>(memchr(p_next, '\n', p_end - p_next))))
+  {
+    *p_next = '\0';
+
+    int len = int(p_next - p_line);
+    if (len > 0)
     {
-      usleep(100000);
-      continue;
+      increment(m_sentences);
+
+      if (parse_NMEA(p_line, len))
+      {
+        m_fix_ns.store(mp_clock->now_ns(), std::memory_order_release);
+        increment(m_fixes);
+      }
     }
 
-    last_byte = receive[len];
-    len++;
+    p_line = ++p_next;
   }
 
+  // The partial sentence that remains waits for the rest of its line.
+  m_received = p_end - p_line;
+  if (m_received >= k_max_sentence)
+  {
+    increment(m_overruns);
+    m_received = 0;
+  }
 
-  return parse_NMEA(receive, len);
+  memmove(m_receive, p_line, m_received);
+
+  return true;
 }
 
 
@@ -11,10 +11,15 @@
 #define GPS_H_INCLUDED
 
 #include <time.h>
+#include <atomic>
 #include <cstdint>
 #include <cstddef>
 #include <thread>
 
+#include "hal.h"
+#include "utility/counter.h"
+#include "utility/event_signal.h"
+
 //typedef uint8_t     char;
 
 
@@ -74,7 +79,7 @@ public:
   UltimateGPS ();
 
   //  **************************************************************************
-  bool  init                ();
+  bool  init                (const char* device, const HAL::Clock &clock);
   void  term                ();
   void  getSystemStatus     (uint8_t *system_status,
                              uint8_t *self_test_result,
@@ -130,10 +135,54 @@ public:
     return m_cur_pos;
   }
 
+  //  **************************************************************************
+  /// Replaces the current location, for a receiver that is not initialized,
+  /// such as in the replay of a flight log.
+  ///
+  void location(const location_t &value)
+  {
+    m_cur_pos = value;
+  }
+
+  //  **************************************************************************
+  /// Parses a single NMEA sentence and updates the current location.
+  ///
+  /// @return true if the sentence updated the location or fix data.
+  ///
+  bool parse_NMEA             (const char* p_sentence, int len);
+
+  //  **************************************************************************
+  /// The work of the read thread, to measure the cost of each fix.
+  ///
+  uint64_t  polls( )      const { return m_polls.load(std::memory_order_relaxed);     }
+  uint64_t  reads( )      const { return m_reads.load(std::memory_order_relaxed);     }
+  uint64_t  sentences( )  const { return m_sentences.load(std::memory_order_relaxed); }
+  uint64_t  fixes( )      const { return m_fixes.load(std::memory_order_relaxed);     }
+  uint64_t  overruns( )   const { return m_overruns.load(std::memory_order_relaxed);  }
+
+  //  **************************************************************************
+  /// Returns the monotonic time the most recent fix was parsed,
+  /// zero before the first.
+  ///
+  uint64_t  fix_ns( )     const { return m_fix_ns.load(std::memory_order_acquire);    }
+
 
 private:
+  //  **************************************************************************
+  static const
+    size_t      k_max_sentence  = 100;  ///< NMEA sentences have a limit
+                                        ///  of 82 characters.
+  static const
+    size_t      k_receive_size  = 512;  ///< Holds several sentences, so a
+                                        ///  single read takes all of a fix.
+
+  //  **************************************************************************
+  typedef std::atomic<uint64_t>   counter_t;
+
   //  **************************************************************************
   int           m_file;
+  const HAL::Clock
+               *mp_clock;           ///< Stamps the fixes.
 
   fix_data_t    m_fix_data;
   location_t    m_cur_pos;
@@ -141,11 +190,23 @@ private:
 
   std::thread   m_read_thread;
   bool          m_is_exit;
+  EventSignal   m_exit_event;       ///< Wakes the read thread to exit.
+
+  char          m_receive[k_receive_size];
+  size_t        m_received;         ///< The bytes of a partial sentence,
+                                    ///  at the start of m_receive.
+
+  counter_t     m_polls;
+  counter_t     m_reads;
+  counter_t     m_sentences;
+  counter_t     m_fixes;
+  counter_t     m_overruns;         ///< Partial sentences discarded as
+                                    ///  longer than any sentence.
+  counter_t     m_fix_ns;           ///< Of the most recent fix.
 
 
   bool process();
   bool verify_NMEA_checksum   (const char* p_sentence, int len);
-  bool parse_NMEA             (const char* p_sentence, int len);
   bool parse_fix              (const char* p_sentence, int len);
   bool parse_location         (const char* p_sentence, int len);
 
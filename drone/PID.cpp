@@ -5,23 +5,16 @@
 ///
 //  ****************************************************************************
 #include "PID.h"
+#include "utility/timebase.h"
 
 #include <iostream>
 using std::cout;
 using std::endl;
 
-namespace 
-{
-
-//const float k_dt  = 1.0 / 200.0;
-const float k_dt  = 1.0;
-
-}
-
-
 //  ****************************************************************************
 PID::PID()
   : m_setpoint(0.0)
+  , m_prev_position(0.0f)
   , m_scalar(1.0)
   , m_gain_Kp(1.0)
   , m_gain_Ki(0.0)
@@ -31,16 +24,14 @@ PID::PID()
   , m_windup_limit(0.5)
   , m_cutoff_freq(20.0f)
   , m_last_output(0.0f)
-  , m_average(rc_filter_empty())
 {
-  rc_filter_moving_average(&m_average, 11, k_dt);
-  rc_filter_prefill_inputs(&m_average, 0.0);
   clear();
 }
 
 //  ****************************************************************************
 PID::PID(float K_p, float K_i, float K_d)
   : m_setpoint(0.0)
+  , m_prev_position(0.0f)
   , m_scalar(1.0)
   , m_gain_Kp(K_p)
   , m_gain_Ki(K_i)
@@ -50,10 +41,7 @@ PID::PID(float K_p, float K_i, float K_d)
   , m_windup_limit(0.5)
   , m_cutoff_freq(20.0f)
   , m_last_output(0.0f)
-  , m_average(rc_filter_empty())
 {
-  rc_filter_moving_average(&m_average, 11, k_dt);
-  rc_filter_prefill_inputs(&m_average, 0.0);
   clear();
 }
  
@@ -92,7 +80,7 @@ bool PID::update_delta_time(float    actual,
 
   // The size of the time-slice drives
   // the remaining calculations.
-  m_delta_time = (timestamp - m_prev_time) / 1000.0;
+  m_delta_time = elapsed_seconds(m_prev_time, timestamp);
   m_prev_time  = timestamp;
 
   // If too much time has passed since the last sample, 
@@ -234,9 +222,6 @@ float PID::apply_PID_filter()
               + integral()
               + derivative();
 
-  //float output  = rc_filter_march(&m_average, level);
-  //return output * scalar();
-
   m_last_output = 0.87 * m_last_output + 0.13 * level * scalar();
 //m_last_output *= scalar();
   return m_last_output;
@@ -7,8 +7,8 @@
 #define PID_H_INCLUDED
 
 #include <cstdint>
+#include <math.h>
 #include <iostream>
-#include "utility/robotics.h"
 
 #undef min
 #undef max
@@ -72,6 +72,8 @@ public:
   //  **************************************************************************
   /// Processes the next sample for the specified delta time.
   ///
+  /// @param timestamp  Monotonic time the sample was taken, in nanoseconds.
+  ///
   float update(float value, uint64_t timestamp);
 
   //  **************************************************************************
@@ -244,7 +246,7 @@ private:
   float     m_setpoint;         ///< The commanded value for this PID.
 
   float     m_delta_time;       ///< The length of the last time step in seconds.
-  uint64_t  m_prev_time;        ///< The last timestamp for the error integral.
+  uint64_t  m_prev_time;        ///< The last timestamp for the error integral, in ns.
 
   float     m_prev_position;    ///< The prev actual position.
   float     m_prev_error;       ///< The prev difference between the
@@ -273,7 +275,6 @@ private:
 
   float     m_last_output;      ///< A cached instance of the last calculated
                                 ///  output for use with smoothing filters.
-  rc_filter_t m_average;        ///< An averaging filter to smooth the PID output.
 
 
   //  **************************************************************************
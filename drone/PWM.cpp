@@ -16,7 +16,7 @@
 
 #include "PWM.h"
 #include "utility/util.h"
-#include "utility/robotics.h"
+#include "hal.h"
 #include <cstdlib>
 
 
@@ -43,6 +43,7 @@ unsigned int to_ns(double frequency_hz)
 PWM::PWM(int channel) 
   : m_channel(channel)
   , m_level(0.0)
+  , m_arm(false)
   , m_period(2000000)
   , m_duty_cycle(1000000)
 {
@@ -85,7 +86,7 @@ unsigned int PWM::duty_cycle() const
 int PWM::duty_cycle(unsigned int duty_ns)
 {
   m_duty_cycle = duty_ns;
-  return rc_servo_send_esc_pulse_normalized(m_channel, m_duty_cycle);
+  return HAL::platform().esc().send(m_channel, m_duty_cycle);
 }
 
 //  ****************************************************************************
@@ -118,7 +119,17 @@ int PWM::duty_cycle_percent(double percentage)
     adjusted = 0.2 + (0.8 * m_level);
   }
 
-  return rc_servo_send_esc_pulse_normalized(m_channel, adjusted);
+  int result = HAL::platform().esc().send(m_channel, adjusted);
+
+  // A channel disarmed by another thread after the check above has sent its
+  // zero pulse already, and it must not be overwritten by this level.
+  if ( adjusted > 0.0
+    && !is_armed())
+  {
+    result = HAL::platform().esc().send(m_channel, 0.0);
+  }
+
+  return result;
 }
 
 //  ****************************************************************************
@@ -150,7 +161,7 @@ int PWM::arm()
 int PWM::unarm()
 {
   m_arm = false;
-  return 0;
+  return HAL::platform().esc().send(m_channel, 0.0);
 }
 
 //  ****************************************************************************
@@ -6,6 +6,7 @@
 #ifndef PWM_H_INCLUDED
 #define PWM_H_INCLUDED
 
+#include <atomic>
 
 //  ****************************************************************************
 ///
@@ -44,6 +45,11 @@ public:
 
   //  ****************************************************************************
   int arm();
+
+  //  ****************************************************************************
+  /// Disarms the channel and sends it a zero pulse, so the motor stops even
+  /// if the control loop does not run again. May be called from any thread.
+  ///
   int unarm();
 
   bool is_armed() const;
@@ -55,7 +61,8 @@ private:
   //  ****************************************************************************
   int           m_channel;      ///< PWM Channel
   double        m_level;        ///< The PWM's commanded level.
-  bool          m_arm;          ///< 
+  std::atomic<bool>
+                m_arm;          ///< Cleared by any thread, read by the control loop.
 
   int           m_period;       ///< PWM Period between updates.
   int           m_duty_cycle;   ///< PWM duty-cycle period.
@@ -0,0 +1,295 @@
+/// @file attitude_filter.cpp
+///
+/// Estimates the orientation of the drone from the raw IMU measurements,
+/// in place of the fusion of the DMP.
+///
+//  ****************************************************************************
+#include "attitude_filter.h"
+#include "utility/quat.h"
+
+#include <cmath>
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+const float k_radians_per_degree  = 3.14159265358979323846f / 180.0f;
+
+
+//  ****************************************************************************
+/// The rotation matrix of a unit quaternion, from the IMU axes to earth.
+///
+struct Rotation
+{
+  float r[3][3];
+
+  explicit
+  Rotation(const float *q)
+  {
+    float w = q[0];
+    float x = q[1];
+    float y = q[2];
+    float z = q[3];
+
+    r[0][0] = 1.0f - 2.0f * (y * y + z * z);
+    r[0][1] = 2.0f * (x * y - w * z);
+    r[0][2] = 2.0f * (x * z + w * y);
+
+    r[1][0] = 2.0f * (x * y + w * z);
+    r[1][1] = 1.0f - 2.0f * (x * x + z * z);
+    r[1][2] = 2.0f * (y * z - w * x);
+
+    r[2][0] = 2.0f * (x * z - w * y);
+    r[2][1] = 2.0f * (y * z + w * x);
+    r[2][2] = 1.0f - 2.0f * (x * x + y * y);
+  }
+
+  //  **************************************************************************
+  /// Rotates a vector of the IMU axes into earth.
+  ///
+  void to_earth(const float *v, float *p_out) const
+  {
+    for (int row = 0; row < 3; ++row)
+    {
+      p_out[row] = r[row][0] * v[0] + r[row][1] * v[1] + r[row][2] * v[2];
+    }
+  }
+};
+
+//  ****************************************************************************
+/// Scales a vector to unit length.
+///
+/// @return   false if the vector has no length.
+///
+bool normalize(const float *v, float *p_out)
+{
+  float norm = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+  if (norm <= 0.0f)
+  {
+    return false;
+  }
+
+  float scale = inv_sqrt(norm);
+  p_out[0] = v[0] * scale;
+  p_out[1] = v[1] * scale;
+  p_out[2] = v[2] * scale;
+
+  return true;
+}
+
+//  ****************************************************************************
+void normalize_quaternion(float *q)
+{
+  Quat result = normalize(to_quat(q));
+
+  q[0] = result.w;
+  q[1] = result.x;
+  q[2] = result.y;
+  q[3] = result.z;
+}
+
+}
+
+
+//  ****************************************************************************
+AttitudeFilter::AttitudeFilter(float Kp, float Ki)
+  : m_Kp(Kp)
+  , m_Ki(Ki)
+{
+  reset();
+}
+
+//  ****************************************************************************
+void AttitudeFilter::reset()
+{
+  m_q[0] = 1.0f;
+  m_q[1] = 0.0f;
+  m_q[2] = 0.0f;
+  m_q[3] = 0.0f;
+
+  m_integral[0] = 0.0f;
+  m_integral[1] = 0.0f;
+  m_integral[2] = 0.0f;
+
+  m_is_aligned  = false;
+}
+
+//  ****************************************************************************
+void AttitudeFilter::fuse(HAL::IMUData &sample, float dt)
+{
+  const float *p_mag    = sample.mag;
+  bool         has_mag  = p_mag[0] != 0.0f
+                       || p_mag[1] != 0.0f
+                       || p_mag[2] != 0.0f;
+
+  if (!m_is_aligned)
+  {
+    m_is_aligned = align(sample.accel, has_mag ? p_mag : nullptr);
+  }
+  else
+  {
+    const float *q = m_q;
+    float error[3] = { 0.0f, 0.0f, 0.0f };
+
+    // The error of each reference is the rotation between its measured
+    // direction and the direction the estimate expects, in the IMU axes.
+    float accel[3];
+    if (normalize(sample.accel, accel))
+    {
+      // Earth's z axis in the IMU axes, the last row of the rotation.
+      float vx = 2.0f * (q[1] * q[3] - q[0] * q[2]);
+      float vy = 2.0f * (q[2] * q[3] + q[0] * q[1]);
+      float vz = 1.0f - 2.0f * (q[1] * q[1] + q[2] * q[2]);
+
+      error[0] = accel[1] * vz - accel[2] * vy;
+      error[1] = accel[2] * vx - accel[0] * vz;
+      error[2] = accel[0] * vy - accel[1] * vx;
+    }
+
+    float mag[3];
+    if ( has_mag
+      && normalize(p_mag, mag))
+    {
+      // The field is expected toward north, with the inclination it was
+      // measured with, so the magnetometer only corrects the heading.
+      Rotation rotation(q);
+
+      float field[3];
+      rotation.to_earth(mag, field);
+
+      float north = std::sqrt(field[0] * field[0] + field[1] * field[1]);
+      float up    = field[2];
+
+      float wx = north * rotation.r[1][0] + up   * rotation.r[2][0];
+      float wy = north * rotation.r[1][1] + up   * rotation.r[2][1];
+      float wz = north * rotation.r[1][2] + up   * rotation.r[2][2];
+
+      error[0] += mag[1] * wz - mag[2] * wy;
+      error[1] += mag[2] * wx - mag[0] * wz;
+      error[2] += mag[0] * wy - mag[1] * wx;
+    }
+
+    if (m_Ki > 0.0f)
+    {
+      m_integral[0] += m_Ki * error[0] * dt;
+      m_integral[1] += m_Ki * error[1] * dt;
+      m_integral[2] += m_Ki * error[2] * dt;
+    }
+
+    integrate(sample.gyro[0] * k_radians_per_degree + m_integral[0] + m_Kp * error[0],
+              sample.gyro[1] * k_radians_per_degree + m_integral[1] + m_Kp * error[1],
+              sample.gyro[2] * k_radians_per_degree + m_integral[2] + m_Kp * error[2],
+              dt);
+  }
+
+  const float w = m_q[0];
+  const float x = m_q[1];
+  const float y = m_q[2];
+  const float z = m_q[3];
+
+  sample.fused_quat[0] = w;
+  sample.fused_quat[1] = x;
+  sample.fused_quat[2] = y;
+  sample.fused_quat[3] = z;
+
+  // The same Tait-Bryan sequence the DMP reports.
+  float sin_y = 2.0f * (w * y - x * z);
+  sin_y       = sin_y >  1.0f ?  1.0f
+              : sin_y < -1.0f ? -1.0f
+              : sin_y;
+
+  sample.fused_TaitBryan[HAL::k_tb_pitch_x] = std::atan2(2.0f * (w * x + y * z),
+                                                         1.0f - 2.0f * (x * x + y * y));
+  sample.fused_TaitBryan[HAL::k_tb_roll_y]  = std::asin(sin_y);
+  sample.fused_TaitBryan[HAL::k_tb_yaw_z]   = std::atan2(2.0f * (w * z + x * y),
+                                                         1.0f - 2.0f * (y * y + z * z));
+}
+
+//  ****************************************************************************
+bool AttitudeFilter::align(const float *p_accel, const float *p_mag)
+{
+  float up[3];
+  if (!normalize(p_accel, up))
+  {
+    return false;
+  }
+
+  // The shortest rotation of the measured gravity onto earth's z axis.
+  // Upside down, any axis in the plane will do.
+  if (up[2] > -0.999f)
+  {
+    m_q[0] = 1.0f + up[2];
+    m_q[1] = up[1];
+    m_q[2] = -up[0];
+    m_q[3] = 0.0f;
+  }
+  else
+  {
+    m_q[0] = 0.0f;
+    m_q[1] = 1.0f;
+    m_q[2] = 0.0f;
+    m_q[3] = 0.0f;
+  }
+
+  normalize_quaternion(m_q);
+
+  if (p_mag)
+  {
+    // Turns about earth's z axis until the field points north.
+    float field[3];
+    Rotation(m_q).to_earth(p_mag, field);
+
+    float heading = 0.5f * std::atan2(field[0], field[1]);
+    float c       = std::cos(heading);
+    float s       = std::sin(heading);
+
+    float w = m_q[0];
+    float x = m_q[1];
+    float y = m_q[2];
+    float z = m_q[3];
+
+    m_q[0] = c * w - s * z;
+    m_q[1] = c * x - s * y;
+    m_q[2] = c * y + s * x;
+    m_q[3] = c * z + s * w;
+  }
+
+  m_integral[0] = 0.0f;
+  m_integral[1] = 0.0f;
+  m_integral[2] = 0.0f;
+
+  return true;
+}
+
+//  ****************************************************************************
+void AttitudeFilter::integrate(float gx, float gy, float gz, float dt)
+{
+  // The rate of change of the quaternion, q * (0, g) / 2.
+  float half_dt = 0.5f * dt;
+  Quat  spin    = { 0.0f, gx * half_dt, gy * half_dt, gz * half_dt };
+  Quat  change  = multiply(to_quat(m_q), spin);
+
+  m_q[0] += change.w;
+  m_q[1] += change.x;
+  m_q[2] += change.y;
+  m_q[3] += change.z;
+
+  normalize_quaternion(m_q);
+}
+
+
+//  ****************************************************************************
+void orient_x_back(HAL::IMUData &sample)
+{
+  float *vectors[] = { sample.accel, sample.gyro, sample.mag };
+
+  for (size_t index = 0; index < 3; ++index)
+  {
+    float *p_vector = vectors[index];
+    float  chip_x   = p_vector[0];
+
+    p_vector[0] =  p_vector[1];
+    p_vector[1] = -chip_x;
+  }
+}
@@ -0,0 +1,107 @@
+/// @file attitude_filter.h
+///
+/// Estimates the orientation of the drone from the raw IMU measurements,
+/// in place of the fusion of the DMP.
+///
+/// A Mahony complementary filter integrates the gyro rates into a
+/// quaternion, and corrects the drift of the integration with a feedback
+/// of the error between the measured and the estimated direction of
+/// gravity, and of the magnetic field for the samples that read it.
+/// The proportional gain sets how quickly the estimate follows the
+/// references, and the integral gain removes a constant gyro bias.
+///
+/// The filter only uses float arithmetic and the quaternion kernels, with
+/// a reciprocal square root for each reference and one to normalize the
+/// quaternion, so a sample is fused in a small part of a 1 kHz time slice.
+///
+/// The samples are fused in the IMU axes, into which orient_x_back()
+/// rotates the measurements of the chip.
+///
+/// The quaternion rotates the IMU axes into an earth frame with z up,
+/// and y toward magnetic north once a magnetic field has been read.
+/// The angles are reported about the IMU axes, as the DMP reports them.
+///
+//  ****************************************************************************
+#ifndef ATTITUDE_FILTER_H_INCLUDED
+#define ATTITUDE_FILTER_H_INCLUDED
+
+#include "hal.h"
+
+
+//  ****************************************************************************
+/// Fuses the raw samples of an IMU into an orientation.
+///
+class AttitudeFilter
+{
+public:
+  //  **************************************************************************
+  /// @param Kp   1 / seconds, the proportional gain of the correction.
+  /// @param Ki   1 / seconds^2, the integral gain of the correction.
+  ///
+  explicit
+  AttitudeFilter(float Kp = 0.1f, float Ki = 0.0f);
+
+  //  **************************************************************************
+  void gains(float Kp, float Ki)
+  {
+    m_Kp = Kp;
+    m_Ki = Ki;
+  }
+
+  //  **************************************************************************
+  /// Discards the estimate. The next sample aligns the filter with the
+  /// measured gravity, and the magnetic field if it was read.
+  ///
+  void reset();
+
+  //  **************************************************************************
+  /// Advances the estimate with the raw measurements of the sample, and
+  /// replaces its fused orientation with the estimate.
+  ///
+  /// @param sample   The accel, gyro and mag of the IMU axes, the gyro
+  ///                 in degrees / second. The magnetic field is only
+  ///                 used when it is not zero.
+  /// @param dt       seconds since the previous sample.
+  ///
+  void fuse(HAL::IMUData &sample, float dt);
+
+  //  **************************************************************************
+  /// Reports the estimate as a quaternion (w, x, y, z).
+  ///
+  const float* quaternion() const
+  {
+    return m_q;
+  }
+
+private:
+  //  **************************************************************************
+  //  Sets the quaternion directly from the references of the first sample.
+  //
+  //  @return   false if the acceleration has no direction.
+  //
+  bool align(const float *p_accel, const float *p_mag);
+
+  //  **************************************************************************
+  //  Integrates the corrected rates, in radians / second.
+  //
+  void integrate(float gx, float gy, float gz, float dt);
+
+  //  **************************************************************************
+  float     m_q[4];                 ///< w, x, y, z, from the IMU axes to earth.
+  float     m_integral[3];          ///< radians / second, the integral feedback.
+  float     m_Kp;
+  float     m_Ki;
+  bool      m_is_aligned;
+};
+
+
+//  ****************************************************************************
+/// Rotates the raw measurements of the MPU9250, read in the axes of the chip,
+/// into the IMU axes, as the DMP does with ORIENTATION_X_BACK. The x axis of
+/// the chip points to the back of the drone, so the IMU x axis is the chip's
+/// y axis, and the IMU y axis is the chip's -x axis.
+///
+void orient_x_back(HAL::IMUData &sample);
+
+
+#endif
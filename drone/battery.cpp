@@ -0,0 +1,226 @@
+/// @file battery.cpp
+///
+/// Monitors the battery that powers the motors.
+///
+//  ****************************************************************************
+#include "battery.h"
+
+#include <cmath>
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+/// Returns the share of the difference a filter follows in dt.
+///
+float to_gain(float dt, float time_constant)
+{
+  float gain = dt / time_constant;
+
+  return gain < 1.0f ? gain : 1.0f;
+}
+
+}
+
+
+//  ****************************************************************************
+BatteryMonitor::BatteryMonitor()
+  : mp_adc(nullptr)
+  , m_decimation(1)
+  , mp_clock(nullptr)
+  , m_period_ms(k_min_period_ms)
+  , m_sum(0.0f)
+  , m_converted(0)
+  , m_taken(0)
+  , m_samples(0)
+  , m_errors(0)
+  , m_count(0)
+{ }
+
+//  ****************************************************************************
+BatteryMonitor::~BatteryMonitor()
+{
+  stop();
+}
+
+//  ****************************************************************************
+void BatteryMonitor::attach(HAL::ADC *p_adc, uint32_t decimation)
+{
+  mp_adc        = p_adc;
+  m_decimation  = decimation > 0 ? decimation : 1;
+
+  m_sum         = 0.0f;
+  m_converted   = 0;
+  m_taken       = 0;
+}
+
+//  ****************************************************************************
+bool BatteryMonitor::start(uint32_t period_ms, const HAL::Clock &clock)
+{
+  if ( !mp_adc
+    || !m_stop.is_valid()
+    || m_sampler.joinable())
+  {
+    return false;
+  }
+
+  mp_clock    = &clock;
+  m_period_ms = period_ms < k_min_period_ms ? k_min_period_ms : period_ms;
+  m_sampler   = std::thread(sampler_proc, this);
+
+  return m_sampler.joinable();
+}
+
+//  ****************************************************************************
+void BatteryMonitor::stop()
+{
+  if (m_sampler.joinable())
+  {
+    m_stop.notify();
+    m_sampler.join();
+  }
+}
+
+//  ****************************************************************************
+void BatteryMonitor::poll(uint64_t now_ns)
+{
+  if (!mp_adc)
+  {
+    return;
+  }
+
+  // The ADC reports a failed conversion as a negative voltage.
+  float voltage = mp_adc->battery_voltage();
+  if (voltage < k_min_voltage)
+  {
+    ++m_errors;
+  }
+  else
+  {
+    m_sum += voltage;
+    ++m_converted;
+    ++m_samples;
+  }
+
+  if (++m_taken < m_decimation)
+  {
+    return;
+  }
+
+  // A group without a conversion leaves the previous reading in place.
+  if (m_converted > 0)
+  {
+    BatteryReading &reading = m_readings.write_buffer();
+
+    reading.voltage       = m_sum / m_converted;
+    reading.samples       = m_converted;
+    reading.timestamp_ns  = now_ns;
+
+    m_readings.publish();
+    ++m_count;
+  }
+
+  m_sum       = 0.0f;
+  m_converted = 0;
+  m_taken     = 0;
+}
+
+//  ****************************************************************************
+void BatteryMonitor::sampler_proc(BatteryMonitor *p_this)
+{
+  while (0 == p_this->m_stop.wait_for(int(p_this->m_period_ms)))
+  {
+    p_this->poll(p_this->mp_clock->now_ns());
+  }
+}
+
+
+//  ****************************************************************************
+BatteryEstimator::BatteryEstimator()
+  : m_estimate{0.0f, 0.0f, 0, 0.0f, 1.0f}
+  , m_cells(0)
+  , m_sag(0.0f)
+  , m_reference(0.0f)
+  , m_hover_level(0.0f)
+  , m_load(0.0f)
+{ }
+
+//  ****************************************************************************
+void BatteryEstimator::configure(uint32_t cells, float sag, float reference, float hover_level)
+{
+  // The cells are counted again from the next reading when no longer set.
+  if (cells != m_cells)
+  {
+    m_cells           = cells;
+    m_estimate.cells  = cells;
+  }
+
+  m_sag         = sag;
+  m_reference   = reference;
+  m_hover_level = hover_level;
+
+  compensate();
+}
+
+//  ****************************************************************************
+void BatteryEstimator::update(float voltage, float dt)
+{
+  if (voltage < BatteryMonitor::k_min_voltage)
+  {
+    return;
+  }
+
+  float resting = voltage + m_sag * m_load;
+
+  m_estimate.voltage  = voltage;
+  m_estimate.resting  = m_estimate.resting > 0.0f
+                      ? m_estimate.resting + to_gain(dt, k_resting_time) * (resting - m_estimate.resting)
+                      : resting;
+
+  // Each cell of a charged pack is below the highest voltage of a cell,
+  // and above the voltage of a cell of a pack with one cell less.
+  if (0 == m_estimate.cells)
+  {
+    uint32_t cells    = uint32_t(std::ceil(m_estimate.resting / k_max_cell_voltage));
+    m_estimate.cells  = cells < 1           ? 1
+                      : cells > k_max_cells ? k_max_cells
+                      : cells;
+  }
+
+  m_estimate.cell_voltage = m_estimate.resting / m_estimate.cells;
+
+  compensate();
+}
+
+//  ****************************************************************************
+void BatteryEstimator::compensate()
+{
+  if ( m_reference <= 0.0f
+    || m_estimate.resting <= 0.0f)
+  {
+    m_estimate.compensation = 1.0f;
+    return;
+  }
+
+  // The thrust of the hover level follows the throttle times the voltage
+  // under the load of that throttle. The compensation c holds the thrust
+  // that the hover level had at the reference:
+  //
+  //   c (resting - sag c) = reference - sag,  sag at the hover level,
+  //
+  // of which the smaller root is the one near 1, in a form that also
+  // holds without a sag.
+  float sag       = m_sag * m_hover_level;
+  float resting   = m_estimate.resting;
+  float thrust    = m_reference - sag;
+  float root      = resting * resting - 4.0f * sag * thrust;
+
+  float compensation  = root < 0.0f
+                      ? k_max_compensation
+                      : 2.0f * thrust / (resting + std::sqrt(root));
+
+  m_estimate.compensation = compensation < k_min_compensation ? k_min_compensation
+                          : compensation > k_max_compensation ? k_max_compensation
+                          : compensation;
+}
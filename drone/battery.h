@@ -0,0 +1,251 @@
+/// @file battery.h
+///
+/// Monitors the battery that powers the motors, and compensates the throttle
+/// for its voltage.
+///
+/// The ADC is slow to read, so a thread of the flight software samples the
+/// voltage of the pack at 50 Hz, and publishes the average of each group of
+/// samples to the control loop. Platforms that are not real-time read the
+/// ADC from the control loop instead, one sample for each reading.
+///
+/// The voltage under load sags below the resting voltage of the pack, in
+/// proportion to the current the motors draw. The control loop removes the
+/// sag it expects for the throttle, and follows the resting voltage slowly,
+/// which tells the charge of each cell. The thrust of a propeller follows
+/// the voltage across its motor, so the throttle is scaled by the ratio of
+/// the voltage the hover level was tuned at to the voltage expected at the
+/// hover level now. The resting voltage does not move with each change of
+/// the throttle, so the compensation does not feed back on the sag.
+///
+//  ****************************************************************************
+#ifndef BATTERY_H_INCLUDED
+#define BATTERY_H_INCLUDED
+
+#include <cstdint>
+#include <thread>
+
+#include "hal.h"
+#include "utility/event_signal.h"
+#include "utility/timebase.h"
+#include "utility/triple_buffer.h"
+
+
+//  ****************************************************************************
+/// The voltage of the pack, averaged over a group of samples.
+///
+struct BatteryReading
+{
+  float     voltage;                  ///< volts, under the load of the motors.
+  uint32_t  samples;                  ///< Averaged into the voltage.
+  uint64_t  timestamp_ns;             ///< Monotonic time of the newest sample,
+                                      ///  zero before the first reading.
+};
+
+
+//  ****************************************************************************
+/// Samples the ADC on its own thread, and hands the readings to the control
+/// loop.
+///
+/// Each reading is the mean of a number of samples, which removes the noise
+/// of the ADC and the ripple of the ESCs. Samples the ADC failed to convert
+/// are counted as errors and left out of the mean.
+///
+class BatteryMonitor
+{
+public:
+  //  **************************************************************************
+  static const
+    uint32_t  k_min_period_ms   = 1;  ///< Bounds the rate of the samples.
+
+  static constexpr
+    float     k_min_voltage     = 0.5f;   ///< volts, lower samples are errors.
+
+  //  **************************************************************************
+  BatteryMonitor();
+  ~BatteryMonitor();
+
+  //  **************************************************************************
+  /// Samples the ADC, and publishes a reading once each decimation samples.
+  ///
+  void attach(HAL::ADC *p_adc, uint32_t decimation);
+
+  //  **************************************************************************
+  /// Starts sampling the ADC that was attached.
+  ///
+  /// @param period_ms  milliseconds between the samples.
+  /// @param clock      stamps the readings.
+  ///
+  /// @return false if the sampler could not be started.
+  ///
+  bool start(uint32_t period_ms, const HAL::Clock &clock);
+
+  //  **************************************************************************
+  /// Stops the sampler, and waits for its thread to exit.
+  ///
+  void stop();
+
+  //  **************************************************************************
+  /// Takes a sample of the ADC.
+  /// Called by the sampler thread, or directly when no thread was started.
+  ///
+  void poll(uint64_t now_ns);
+
+  //  **************************************************************************
+  /// Control thread: Reports the most recent reading.
+  ///
+  /// @return false if no reading was published yet.
+  ///
+  bool latest(BatteryReading &reading)
+  {
+    m_readings.acquire();
+    reading = m_readings.read_buffer();
+
+    return 0 != reading.timestamp_ns;
+  }
+
+  //  **************************************************************************
+  uint32_t  samples()  const { return m_samples;  }   ///< Converted.
+  uint32_t  errors()   const { return m_errors;   }   ///< Failed to convert.
+  uint32_t  readings() const { return m_count;    }   ///< Published.
+
+private:
+  //  **************************************************************************
+  //  Samples the ADC every period_ms until stop().
+  //
+  static
+    void sampler_proc(BatteryMonitor *p_this);
+
+  //  **************************************************************************
+  HAL::ADC     *mp_adc;
+  uint32_t      m_decimation;
+  const HAL::Clock
+               *mp_clock;             ///< Of the sampler thread.
+
+  TripleBuffer<BatteryReading>
+                m_readings;           ///< Hands the voltage to the control loop.
+
+  std::thread   m_sampler;
+  EventSignal   m_stop;               ///< Wakes the sampler to exit.
+  uint32_t      m_period_ms;
+
+  float         m_sum;                ///< volts, of the samples converted
+  uint32_t      m_converted;          ///  since the last reading.
+  uint32_t      m_taken;              ///< Samples since the last reading,
+                                      ///  including the errors.
+
+  uint32_t      m_samples;
+  uint32_t      m_errors;
+  uint32_t      m_count;
+};
+
+
+//  ****************************************************************************
+/// The state of the pack, as estimated by the control loop.
+///
+struct BatteryEstimate
+{
+  float     voltage;                  ///< volts, under load, as read.
+  float     resting;                  ///< volts, without the sag of the load.
+  uint32_t  cells;                    ///< In series in the pack.
+  float     cell_voltage;             ///< volts, resting, of each cell.
+  float     compensation;             ///< Scales the throttle.
+};
+
+
+//  ****************************************************************************
+/// Follows the resting voltage of the pack from the readings of the monitor,
+/// and the throttle that loaded the pack while they were taken.
+///
+/// Only the control thread may use the estimator. Without a reference
+/// voltage, or before the first reading, the throttle is not compensated.
+///
+class BatteryEstimator
+{
+public:
+  //  **************************************************************************
+  static const
+    uint32_t  k_max_cells       = 4;  ///< That the telemetry reports.
+
+  static constexpr
+    float     k_max_cell_voltage  = 4.25f;  ///< volts, of a charged LiPo cell.
+
+  static constexpr
+    float     k_load_time       = 0.1f;   ///< seconds, lags the throttle as
+                                          ///  the mean of a reading lags.
+  static constexpr
+    float     k_resting_time    = 5.0f;   ///< seconds, the resting voltage
+                                          ///  follows the charge.
+  static constexpr
+    float     k_min_compensation  = 0.8f;
+  static constexpr
+    float     k_max_compensation  = 1.3f;
+
+  //  **************************************************************************
+  BatteryEstimator();
+
+  //  **************************************************************************
+  /// @param cells        in series in the pack, zero to count them from the
+  ///                     first reading.
+  /// @param sag          volts, the drop of the pack at full throttle.
+  /// @param reference    volts, the resting voltage the hover level was
+  ///                     tuned at, zero to not compensate the throttle.
+  /// @param hover_level  the throttle that holds the drone at altitude.
+  ///
+  void configure(uint32_t cells, float sag, float reference, float hover_level);
+
+  //  **************************************************************************
+  /// Control thread: Follows the throttle of each cycle, which is the load
+  /// of the pack.
+  ///
+  /// @param throttle     normalized, as commanded to the motors.
+  /// @param dt           seconds since the previous cycle.
+  ///
+  void load(float throttle, float dt)
+  {
+    float gain = dt / k_load_time;
+    m_load += (gain < 1.0f ? gain : 1.0f) * (throttle - m_load);
+  }
+
+  //  **************************************************************************
+  /// Control thread: Follows a reading of the pack.
+  ///
+  /// @param voltage      volts, under load, zero before the first reading.
+  /// @param dt           seconds since the previous update.
+  ///
+  void update(float voltage, float dt);
+
+  //  **************************************************************************
+  /// Control thread: Returns the factor of the throttle that keeps the thrust
+  /// of each level as it was at the reference voltage.
+  ///
+  float compensation() const
+  {
+    return m_estimate.compensation;
+  }
+
+  //  **************************************************************************
+  const BatteryEstimate& estimate() const
+  {
+    return m_estimate;
+  }
+
+private:
+  //  **************************************************************************
+  //  Scales the throttle for the resting voltage of the estimate.
+  //
+  void compensate();
+
+  //  **************************************************************************
+  BatteryEstimate
+                m_estimate;
+
+  uint32_t      m_cells;              ///< Configured, zero to count them.
+  float         m_sag;                ///< volts, at full throttle.
+  float         m_reference;          ///< volts, zero for none.
+  float         m_hover_level;
+
+  float         m_load;               ///< normalized, the average throttle.
+};
+
+
+#endif
@@ -0,0 +1,250 @@
+/// @file benchmark.h
+///
+/// Minimal harness to measure the cost of an operation in time,
+/// in retired instructions and in processor cycles.
+///
+//  ****************************************************************************
+#ifndef BENCHMARK_H_INCLUDED
+#define BENCHMARK_H_INCLUDED
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "utility/timebase.h"
+
+
+//  ****************************************************************************
+/// Prevents the compiler from discarding a value that is otherwise unused.
+///
+template <typename T>
+inline
+void do_not_optimize(const T &value)
+{
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+
+//  ****************************************************************************
+/// Counts a user-space hardware event of the calling thread, such as
+/// the instructions retired or the processor cycles.
+///
+/// The counter is not available on all hosts, such as virtual machines
+/// without a virtualized PMU. Check is_valid() before use.
+///
+class PerfCounter
+{
+public:
+  //  **************************************************************************
+  /// @param event  The hardware event, such as PERF_COUNT_HW_INSTRUCTIONS.
+  ///
+  explicit PerfCounter(uint64_t event)
+    : m_fd(-1)
+  {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.size           = sizeof(attr);
+    attr.config         = event;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+
+    m_fd = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+  //  **************************************************************************
+  ~PerfCounter()
+  {
+    if (is_valid())
+    {
+      close(m_fd);
+    }
+  }
+
+  //  **************************************************************************
+  bool is_valid() const
+  {
+    return m_fd >= 0;
+  }
+
+  //  **************************************************************************
+  void start()
+  {
+    if (is_valid())
+    {
+      ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  //  **************************************************************************
+  uint64_t stop()
+  {
+    uint64_t count = 0;
+
+    if (is_valid())
+    {
+      ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(m_fd, &count, sizeof(count)) != sizeof(count))
+      {
+        count = 0;
+      }
+    }
+
+    return count;
+  }
+
+private:
+  int     m_fd;
+};
+
+
+//  ****************************************************************************
+/// The measurements for a single benchmark.
+///
+struct BenchResult
+{
+  std::string   name;
+  uint64_t      iterations;           ///< Operations in each measured sample.
+  double        ns_per_op;            ///< Median over all of the samples.
+  double        instructions_per_op;  ///< From the median sample, 0 if unavailable.
+  double        cycles_per_op;        ///< From the median sample, 0 if unavailable.
+};
+
+
+//  ****************************************************************************
+/// Runs each benchmark and collects the results.
+///
+class BenchRunner
+{
+public:
+  //  **************************************************************************
+  /// @param min_time_ns  Minimum duration of each measured sample.
+  /// @param p_filter     Only run benchmarks with names that contain this text.
+  ///
+  BenchRunner(uint64_t min_time_ns, const char *p_filter)
+    : m_instructions(PERF_COUNT_HW_INSTRUCTIONS)
+    , m_cycles(PERF_COUNT_HW_CPU_CYCLES)
+    , m_min_time_ns(min_time_ns)
+    , m_filter(p_filter ? p_filter : "")
+  { }
+
+  //  **************************************************************************
+  bool has_instructions() const
+  {
+    return m_instructions.is_valid();
+  }
+
+  //  **************************************************************************
+  bool has_cycles() const
+  {
+    return m_cycles.is_valid();
+  }
+
+  //  **************************************************************************
+  const std::vector<BenchResult>& results() const
+  {
+    return m_results;
+  }
+
+  //  **************************************************************************
+  /// Measures the operation, which is called with no arguments.
+  ///
+  /// @param ops_per_call   The number of operations each call performs,
+  ///                       for operations that are cheaper to measure in batches.
+  ///
+  template <typename Op>
+  void run(const char *p_name, Op op, uint64_t ops_per_call = 1)
+  {
+    if ( !m_filter.empty()
+      && std::string(p_name).find(m_filter) == std::string::npos)
+    {
+      return;
+    }
+
+    // Grow the batch until a single sample takes the minimum duration.
+    uint64_t calls = 1;
+    while (measure(op, calls).duration_ns < m_min_time_ns)
+    {
+      calls *= 2;
+    }
+
+    std::vector<Sample> samples;
+    for (int index = 0; index < k_sample_count; ++index)
+    {
+      samples.push_back(measure(op, calls));
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    const Sample &median = samples[k_sample_count / 2];
+    uint64_t      ops    = calls * ops_per_call;
+
+    BenchResult result;
+    result.name                 = p_name;
+    result.iterations           = ops;
+    result.ns_per_op            = double(median.duration_ns)  / ops;
+    result.instructions_per_op  = double(median.instructions) / ops;
+    result.cycles_per_op        = double(median.cycles)       / ops;
+
+    m_results.push_back(result);
+  }
+
+private:
+  //  **************************************************************************
+  static const int k_sample_count = 5;
+
+  //  **************************************************************************
+  struct Sample
+  {
+    uint64_t  duration_ns;
+    uint64_t  instructions;
+    uint64_t  cycles;
+
+    bool operator<(const Sample &rhs) const
+    {
+      return duration_ns < rhs.duration_ns;
+    }
+  };
+
+  //  **************************************************************************
+  PerfCounter               m_instructions;
+  PerfCounter               m_cycles;
+  uint64_t                  m_min_time_ns;
+  std::string               m_filter;
+  std::vector<BenchResult>  m_results;
+
+  //  **************************************************************************
+  template <typename Op>
+  Sample measure(Op &op, uint64_t calls)
+  {
+    Sample sample;
+
+    uint64_t start = timestamp_ns();
+    m_cycles.start();
+    m_instructions.start();
+
+    for (uint64_t index = 0; index < calls; ++index)
+    {
+      op();
+    }
+
+    sample.instructions = m_instructions.stop();
+    sample.cycles       = m_cycles.stop();
+    sample.duration_ns  = timestamp_ns() - start;
+
+    return sample;
+  }
+};
+
+
+#endif
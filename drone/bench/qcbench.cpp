@@ -0,0 +1,946 @@
+/// @file qcbench.cpp
+///
+/// Micro-benchmarks for the work performed in each cycle of the flight software.
+///
+/// The flight code runs on the simulated platform, so the benchmarks build
+/// and run on the host without the robotics cape. Results are written as
+/// JSON so runs may be compared across commits.
+///
+/// Usage: qcbench [-t min_ms] [-f filter] [-o output.json]
+///
+//  ****************************************************************************
+#include "benchmark.h"
+
+#include "attitude_filter.h"
+#include "control_arithmetic.h"
+#include "drone.h"
+#include "flight_config.h"
+#include "gain_schedule.h"
+#include "geofence.h"
+#include "GPS.h"
+#include "gyro_bias.h"
+#include "mixer.h"
+#include "PID.h"
+#include "pid_bank.h"
+#include "qc_msg.h"
+#include "sim_platform.h"
+#include "watchdog.h"
+#include "utility/filters.h"
+#include "utility/imumaths.h"
+#include "utility/linear_algebra.h"
+#include "utility/quat.h"
+#include "utility/util.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::ostream;
+
+
+//  Defined in the flight code *************************************************
+PIDState to_PIDState(const PID& pid);
+int      SendDroneState(int conn, const DroneState& state);
+
+
+//  ****************************************************************************
+/// Access to the private stages of the control loop.
+///
+struct DroneBench
+{
+  //  **************************************************************************
+  static void arm(Drone &drone)
+  {
+    for (size_t index = 0; index < Drone::k_max_motor_count; ++index)
+    {
+      drone.m_motors[index].arm();
+    }
+  }
+
+  //  **************************************************************************
+  static void throttle(Drone &drone, float level)
+  {
+    drone.m_throttle = level;
+  }
+
+  //  **************************************************************************
+  static bool process_plant(Drone &drone, float roll, float pitch, float yaw)
+  {
+    return drone.process_plant(roll, pitch, yaw);
+  }
+
+  //  **************************************************************************
+  static void process_commands(Drone &drone)
+  {
+    drone.process_commands();
+  }
+
+  //  **************************************************************************
+  static void base_location(Drone &drone, const GPS::location_t &location)
+  {
+    drone.m_base_location = location;
+  }
+};
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+const size_t    k_input_count     = 256;            ///< Power of two.
+const size_t    k_message_batch   = 64;
+
+const char      k_rmc_sentence[]  =
+  "$GPRMC,194509.000,A,4737.2300,N,12220.9580,W,0.42,211.54,010118,,,A*7C\r\n";
+
+
+//  ****************************************************************************
+struct Options
+{
+  uint64_t      min_time_ns;
+  const char*   p_filter;
+  const char*   p_output;
+};
+
+
+//  ****************************************************************************
+void usage()
+{
+  cerr  << "Usage: qcbench [-t min_ms] [-f filter] [-o output.json]\n"
+        << "  -t  Minimum duration of each measured sample, in ms. Default: 20\n"
+        << "  -f  Only runs the benchmarks with names that contain the filter.\n"
+        << "  -o  Writes the results to a file rather than stdout.\n";
+}
+
+//  ****************************************************************************
+bool parse_options(int argc, char* argv[], Options &options)
+{
+  options.min_time_ns = 20 * k_ns_per_ms;
+  options.p_filter    = nullptr;
+  options.p_output    = nullptr;
+
+  int option = 0;
+  while (-1 != (option = getopt(argc, argv, "t:f:o:h")))
+  {
+    switch (option)
+    {
+    case 't': options.min_time_ns = uint64_t(atof(optarg) * k_ns_per_ms); break;
+    case 'f': options.p_filter    = optarg; break;
+    case 'o': options.p_output    = optarg; break;
+    default:
+      return false;
+    }
+  }
+
+  return options.min_time_ns > 0;
+}
+
+
+//  ****************************************************************************
+const float   k_period = 0.005f;        ///< seconds, the period of the control loop.
+
+
+//  ****************************************************************************
+/// Inputs that vary from one operation to the next, so the branches
+/// in the flight code are not perfectly predicted.
+///
+struct Inputs
+{
+  float     angle[k_input_count];       ///< radians, +/- 30 degrees
+  QCopter   command[k_input_count];
+  double    latitude[k_input_count];
+  double    longitude[k_input_count];
+  Quat      orientation[k_input_count]; ///< Tilted +/- 30 degrees, at any heading.
+
+  Inputs()
+  {
+    for (size_t index = 0; index < k_input_count; ++index)
+    {
+      double phase = 2.0 * M_PI * index / k_input_count;
+
+      angle[index]  = float(k_pi_6 * std::sin(phase));
+
+      command[index].roll   = to_int16(float(std::sin(phase)));
+      command[index].pitch  = to_int16(float(std::cos(phase)));
+      command[index].yaw    = to_int16(float(std::sin(2.0 * phase)));
+      command[index].thrust = to_int16(float(0.5 + 0.25 * std::sin(phase)));
+
+      latitude[index]  = 47.6205   + 0.0002 * std::sin(phase);
+      longitude[index] = -122.3493 + 0.0002 * std::cos(phase);
+
+      Quat heading = { float(std::cos(phase)), 0.0f, 0.0f, float(std::sin(phase)) };
+      orientation[index] = multiply(heading, from_tilt(angle[index], float(k_pi_6 * std::cos(phase))));
+    }
+  }
+};
+
+
+//  ****************************************************************************
+void bench_PID(BenchRunner &runner, const Inputs &inputs)
+{
+  PID       pid(1.25f, 0.325f, 0.077f);
+  uint64_t  timestamp = k_ns_per_s;
+  size_t    index     = 0;
+
+  runner.run("PID::update", [&]()
+  {
+    timestamp += 5 * k_ns_per_ms;
+    do_not_optimize(pid.update(inputs.angle[index++ & (k_input_count - 1)], timestamp));
+  });
+
+  runner.run("to_PIDState", [&]()
+  {
+    PIDState state = to_PIDState(pid);
+    do_not_optimize(state);
+  });
+}
+
+//  ****************************************************************************
+template <typename Controller>
+void set_gains(Controller &pid, const float (&gains)[3])
+{
+  pid.Kp(gains[0]);
+  pid.Ki(gains[1]);
+  pid.Kd(gains[2]);
+}
+
+//  ****************************************************************************
+/// The gains of the two stabilization and three rate controllers.
+///
+const float k_cycle_gains[5][3] =
+{
+  { 1.25f,    0.325f, 0.077f    },
+  { 1.08f,    0.65f,  0.1625f   },
+  { 0.9678f,  1.526f, 0.02405f  },
+  { 0.375f,   1.545f, 0.0225f   },
+  { 0.825f,   0.5f,   0.0035f   }
+};
+
+//  ****************************************************************************
+/// The PID work of one control cycle with the banks, in the arithmetic.
+///
+template <typename Arithmetic>
+void bench_PID_banks(BenchRunner &runner, const char *p_name, const Inputs &inputs)
+{
+  typedef PIDBank<2, Arithmetic>  StabilizeBank;
+  typedef PIDBank<3, Arithmetic>  RateBank;
+
+  StabilizeBank stabilize(k_period);
+  RateBank      rates(k_period);
+
+  for (size_t index = 0; index < 2; ++index)
+  {
+    typename StabilizeBank::Lane lane = stabilize.lane(index);
+    set_gains(lane, k_cycle_gains[index]);
+  }
+
+  for (size_t index = 0; index < 3; ++index)
+  {
+    typename RateBank::Lane lane = rates.lane(index);
+    set_gains(lane, k_cycle_gains[index + 2]);
+  }
+
+  uint64_t  timestamp = k_ns_per_s;
+  size_t    index     = 0;
+
+  runner.run(p_name, [&]()
+  {
+    timestamp += 5 * k_ns_per_ms;
+    size_t at  = index++ & (k_input_count - 1);
+
+    float actual[5];
+    float output[5];
+    for (size_t pid = 0; pid < 5; ++pid)
+    {
+      actual[pid] = inputs.angle[(at + pid * 32) & (k_input_count - 1)];
+    }
+
+    stabilize.update(&actual[0], timestamp, &output[0]);
+    rates.update    (&actual[2], timestamp, &output[2]);
+    do_not_optimize(output);
+  });
+}
+
+//  ****************************************************************************
+/// A schedule of every gain over four throttle and two voltage breakpoints.
+///
+const char k_schedule_config[] =
+  "schedule.throttle = 0.1, 0.4, 0.7, 1.0\n"
+  "schedule.voltage  = 7.4, 8.4\n";
+
+const char k_schedule_scales[] =
+  "0.8, 0.9, 1.0, 1.1,  0.9, 1.0, 1.1, 1.2\n";
+
+//  ****************************************************************************
+template <typename Lane>
+void schedule_lane(Lane lane, const PIDConfig &config, const SchedulePoint &point)
+{
+  lane.scale_gains(config.Kp_table.lookup(point),
+                   config.Ki_table.lookup(point),
+                   config.Kd_table.lookup(point));
+}
+
+//  ****************************************************************************
+/// The scheduling of the gains in each control cycle, as Drone::schedule_gains.
+///
+void bench_schedule(BenchRunner &runner, const Inputs &inputs)
+{
+  const char* k_pids[] = { "roll", "pitch", "roll_rate", "pitch_rate", "yaw" };
+  const char* k_gains[] = { "Kp", "Ki", "Kd" };
+
+  std::ostringstream text;
+  text << k_schedule_config;
+  for (size_t pid = 0; pid < 5; ++pid)
+  {
+    for (size_t gain = 0; gain < 3; ++gain)
+    {
+      text << k_pids[pid] << "." << k_gains[gain] << "_scale = " << k_schedule_scales;
+    }
+  }
+
+  FlightConfig        config = default_flight_config();
+  std::istringstream  in(text.str());
+  if (!parse_flight_config(in, "bench", config))
+  {
+    return;
+  }
+
+  PIDBank<2>  stabilize(k_period);
+  PIDBank<3>  rates(k_period);
+  size_t      index = 0;
+
+  runner.run("GainSchedule::lookup x15", [&]()
+  {
+    size_t at       = index++ & (k_input_count - 1);
+    float  throttle = 0.5f + inputs.angle[at];
+    float  voltage  = 7.9f + inputs.angle[(at + 64) & (k_input_count - 1)];
+
+    SchedulePoint point = config.schedule.locate(throttle, voltage);
+
+    schedule_lane(stabilize.lane(0), config.roll,       point);
+    schedule_lane(stabilize.lane(1), config.pitch,      point);
+    schedule_lane(rates.lane(0),     config.roll_rate,  point);
+    schedule_lane(rates.lane(1),     config.pitch_rate, point);
+    schedule_lane(rates.lane(2),     config.yaw,        point);
+    do_not_optimize(stabilize);
+    do_not_optimize(rates);
+  });
+}
+
+//  ****************************************************************************
+/// The PID work of one control cycle: two stabilization controllers,
+/// then three rate controllers, with the five PID objects and with the banks
+/// in float and in fixed point.
+///
+void bench_PID_cycle(BenchRunner &runner, const Inputs &inputs)
+{
+  PID pids[5];
+
+  for (size_t index = 0; index < 5; ++index)
+  {
+    pids[index] = PID(k_cycle_gains[index][0], k_cycle_gains[index][1], k_cycle_gains[index][2]);
+  }
+
+  uint64_t  timestamp = k_ns_per_s;
+  size_t    index     = 0;
+
+  runner.run("PID::update x5", [&]()
+  {
+    timestamp += 5 * k_ns_per_ms;
+    size_t at  = index++ & (k_input_count - 1);
+
+    for (size_t pid = 0; pid < 5; ++pid)
+    {
+      do_not_optimize(pids[pid].update(inputs.angle[(at + pid * 32) & (k_input_count - 1)],
+                                       timestamp));
+    }
+  });
+
+  bench_PID_banks<FloatArithmetic>(runner, "PIDBank<2> + PIDBank<3>::update", inputs);
+  bench_PID_banks<FixedArithmetic>(runner,
+                                   "PIDBank<2> + PIDBank<3>::update FixedArithmetic",
+                                   inputs);
+}
+
+//  ****************************************************************************
+/// Each of the derivative filters that may be selected for a PID.
+///
+void bench_filters(BenchRunner &runner, const Inputs &inputs)
+{
+  struct Case
+  {
+    const char*   p_name;
+    FilterConfig  config;
+  };
+
+  const Case k_cases[] =
+  {
+    { "SignalFilter lowpass",    { k_filter_lowpass, 20.0f, 0.7071f, 5 } },
+    { "SignalFilter biquad",     { k_filter_biquad,  20.0f, 0.7071f, 5 } },
+    { "SignalFilter notch",      { k_filter_notch,   40.0f, 2.0f,    5 } },
+    { "SignalFilter average 5",  { k_filter_average, 20.0f, 0.7071f, 5 } },
+    { "SignalFilter median 5",   { k_filter_median,  20.0f, 0.7071f, 5 } },
+    { "SignalFilter median 15",  { k_filter_median,  20.0f, 0.7071f, 15 } }
+  };
+
+  for (size_t test = 0; test < sizeof(k_cases) / sizeof(k_cases[0]); ++test)
+  {
+    SignalFilter  filter;
+    size_t        index = 0;
+
+    filter.configure(k_cases[test].config, k_period);
+
+    runner.run(k_cases[test].p_name, [&]()
+    {
+      do_not_optimize(filter.apply(inputs.angle[index++ & (k_input_count - 1)]));
+    });
+  }
+}
+
+//  ****************************************************************************
+/// The fusion of a raw IMU sample at 1 kHz, with the magnetometer read
+/// for one sample in ten.
+///
+void bench_attitude_filter(BenchRunner &runner, const Inputs &inputs)
+{
+  AttitudeFilter  filter;
+  HAL::IMUData    sample = {};
+  size_t          index  = 0;
+
+  sample.accel[2] = 9.81f;
+  filter.fuse(sample, 0.001f);
+
+  runner.run("AttitudeFilter::fuse", [&]()
+  {
+    size_t at    = index++ & (k_input_count - 1);
+    float  angle = inputs.angle[at];
+
+    sample.accel[0] = 9.81f * angle;
+    sample.accel[1] = 9.81f * inputs.angle[(at + 64) & (k_input_count - 1)];
+    sample.accel[2] = 9.81f;
+    sample.gyro[0]  = 10.0f * angle;
+    sample.gyro[1]  = 10.0f * inputs.angle[(at + 128) & (k_input_count - 1)];
+    sample.gyro[2]  = 5.0f  * angle;
+
+    bool is_mag_read = 0 == (at % 10);
+    sample.mag[1]   = is_mag_read ?  18.6f : 0.0f;
+    sample.mag[2]   = is_mag_read ? -48.5f : 0.0f;
+
+    filter.fuse(sample, 0.001f);
+    do_not_optimize(sample.fused_TaitBryan);
+  });
+}
+
+//  ****************************************************************************
+/// The bias estimate, in flight with the rates of a hover.
+///
+void bench_gyro_bias(BenchRunner &runner, const Inputs &inputs)
+{
+  const FlightConfig &config = default_flight_config();
+
+  GyroBiasEstimator estimator;
+  estimator.configure(config.bias_ground_time, config.bias_flight_time, config.bias_still_rate);
+  estimator.seed(config.roll_bias, config.pitch_bias, config.yaw_bias);
+
+  size_t index = 0;
+
+  runner.run("GyroBiasEstimator::update", [&]()
+  {
+    size_t at    = index++ & (k_input_count - 1);
+    float  angle = inputs.angle[at];
+
+    estimator.update(0.1f * angle,
+                     0.1f * inputs.angle[(at + 64) & (k_input_count - 1)],
+                     0.05f * angle,
+                     0.005f,
+                     true);
+    do_not_optimize(estimator.bias());
+  });
+}
+
+//  ****************************************************************************
+/// The error of the angle loop from the orientation of the IMU. The Euler
+/// error also converts the quaternion, as the DMP driver does.
+///
+void bench_attitude_error(BenchRunner &runner, const Inputs &inputs)
+{
+  size_t index = 0;
+
+  runner.run("attitude error Tait-Bryan", [&]()
+  {
+    size_t      at = index++ & (k_input_count - 1);
+    const Quat &q  = inputs.orientation[at];
+
+    float sin_roll = 2.0f * (q.w * q.y - q.x * q.z);
+    sin_roll       = sin_roll >  1.0f ?  1.0f
+                   : sin_roll < -1.0f ? -1.0f
+                   : sin_roll;
+
+    float pitch = std::atan2(2.0f * (q.w * q.x + q.y * q.z), 1.0f - 2.0f * (q.x * q.x + q.y * q.y));
+    float roll  = std::asin(sin_roll);
+    float yaw   = std::atan2(2.0f * (q.w * q.z + q.x * q.y), 1.0f - 2.0f * (q.y * q.y + q.z * q.z));
+
+    float error[3] = { 0.1f - pitch, -0.1f - roll, yaw };
+    do_not_optimize(error);
+  });
+
+  runner.run("imu::Quaternion::toEuler", [&]()
+  {
+    const Quat &q = inputs.orientation[index++ & (k_input_count - 1)];
+
+    imu::Vector<3> euler = imu::Quaternion(q.w, q.x, q.y, q.z).toEuler();
+    double error[2] = { 0.1 - euler.y(), -0.1 - euler.z() };
+    do_not_optimize(error);
+  });
+
+  Quat target_tilt = from_tilt(-0.1f, 0.1f);
+
+  runner.run("attitude error quaternion", [&]()
+  {
+    const Quat &q = inputs.orientation[index++ & (k_input_count - 1)];
+
+    float error[3];
+    to_rotation_vector(attitude_error(q, multiply(heading(q), target_tilt)), error);
+    do_not_optimize(error);
+  });
+
+  runner.run("Quat normalize", [&]()
+  {
+    do_not_optimize(normalize(inputs.orientation[index++ & (k_input_count - 1)]));
+  });
+}
+
+//  ****************************************************************************
+/// The products and the solves of a Kalman filter with six states, in the
+/// float library and in imumaths.
+///
+void bench_linear_algebra(BenchRunner &runner, const Inputs &inputs)
+{
+  Matrix<6, 6>    F = Matrix<6, 6>::identity();
+  Matrix<6, 6>    P = Matrix<6, 6>::identity();
+  Matrix<6, 6>    Q = Matrix<6, 6>::identity() * 1.0e-4f;
+
+  imu::Matrix<6>  imu_F;
+  imu::Matrix<6>  imu_P;
+  imu::Matrix<6>  imu_Q;
+
+  for (size_t row = 0; row < 6; ++row)
+  {
+    for (size_t col = 0; col < 6; ++col)
+    {
+      F(row, col)     += 0.005f * inputs.angle[(row * 6 + col) * 7 & (k_input_count - 1)];
+      imu_F(row, col)  = F(row, col);
+      imu_P(row, col)  = P(row, col);
+      imu_Q(row, col)  = Q(row, col);
+    }
+  }
+
+  size_t index = 0;
+
+  runner.run("Matrix<3,3> product", [&]()
+  {
+    Matrix<3, 3> a;
+    a(0, 0) = inputs.angle[index++ & (k_input_count - 1)];
+
+    Matrix<3, 3> result = a * a.transpose();
+    do_not_optimize(result);
+  });
+
+  runner.run("imu::Matrix<3> product", [&]()
+  {
+    imu::Matrix<3> a;
+    a(0, 0) = inputs.angle[index++ & (k_input_count - 1)];
+
+    imu::Matrix<3> result = a * a.transpose();
+    do_not_optimize(result);
+  });
+
+  runner.run("Matrix<6,6> F P F' + Q", [&]()
+  {
+    P = F * P * F.transpose() + Q;
+    do_not_optimize(P);
+  });
+
+  runner.run("imu::Matrix<6> F P F' + Q", [&]()
+  {
+    imu_P = imu_F * imu_P * imu_F.transpose() + imu_Q;
+    do_not_optimize(imu_P);
+  });
+
+  // The covariance stays positive definite, as for a filter.
+  Matrix<6, 6> S = F * F.transpose() + Matrix<6, 6>::identity();
+  LDLT<6>      ldlt;
+  Cholesky<6>  cholesky;
+
+  runner.run("LDLT<6> solve", [&]()
+  {
+    Vector<6> x;
+    x[0] = inputs.angle[index++ & (k_input_count - 1)];
+
+    ldlt.compute(S);
+    ldlt.solve(x);
+    do_not_optimize(x);
+  });
+
+  runner.run("Cholesky<6> solve", [&]()
+  {
+    Vector<6> x;
+    x[0] = inputs.angle[index++ & (k_input_count - 1)];
+
+    cholesky.compute(S);
+    cholesky.solve(x);
+    do_not_optimize(x);
+  });
+
+  imu::Matrix<6> imu_S;
+  for (size_t row = 0; row < 6; ++row)
+  {
+    for (size_t col = 0; col < 6; ++col)
+    {
+      imu_S(row, col) = S(row, col);
+    }
+  }
+
+  runner.run("imu::Matrix<6>::invert", [&]()
+  {
+    imu_S(0, 0) += 1.0e-9 * inputs.angle[index++ & (k_input_count - 1)];
+    do_not_optimize(imu_S.invert());
+  });
+}
+
+//  ****************************************************************************
+void bench_drone(BenchRunner &runner, const Inputs &inputs)
+{
+  Drone   drone;
+  size_t  index = 0;
+
+  DroneBench::arm(drone);
+  DroneBench::throttle(drone, 0.5f);
+
+  runner.run("Drone::process_plant", [&]()
+  {
+    size_t at = index++ & (k_input_count - 1);
+    do_not_optimize(DroneBench::process_plant(drone,
+                                              inputs.angle[at],
+                                              inputs.angle[(at + 64) & (k_input_count - 1)],
+                                              inputs.angle[(at + 128) & (k_input_count - 1)]));
+  });
+
+  // Queued by the receiver thread, and applied by the control loop.
+  runner.run("Drone::command", [&]()
+  {
+    drone.command(inputs.command[index++ & (k_input_count - 1)]);
+    DroneBench::process_commands(drone);
+  });
+
+  GPS::location_t base = {0};
+  base.is_valid   = true;
+  base.latitude   = 47.6205;
+  base.longitude  = -122.3493;
+
+  DroneBench::base_location(drone, base);
+
+  GPS::location_t cur = base;
+
+  runner.run("Drone::distance_from_base", [&]()
+  {
+    size_t at     = index++ & (k_input_count - 1);
+    cur.latitude  = inputs.latitude[at];
+    cur.longitude = inputs.longitude[at];
+
+    do_not_optimize(drone.distance_from_base(cur));
+  });
+
+  // The geofence is tested in the tangent plane at the base, for each new fix.
+  LocalFrame frame;
+  frame.origin(base.latitude, base.longitude, base.altitude);
+
+  runner.run("LocalFrame::to_local", [&]()
+  {
+    size_t at = index++ & (k_input_count - 1);
+    do_not_optimize(frame.to_local(inputs.latitude[at], inputs.longitude[at], 0.0));
+  });
+
+  Geofence     cylinder(20.0f);
+  NumberList   octagon  = { 16, { 20, 0,  14, 14,  0, 20,  -14, 14,
+                                  -20, 0,  -14, -14,  0, -20,  14, -14 } };
+  Geofence     polygon;
+  polygon.configure(0.0f, 50.0f, octagon);
+
+  runner.run("Geofence::contains cylinder", [&]()
+  {
+    size_t at = index++ & (k_input_count - 1);
+    do_not_optimize(cylinder.contains(frame.to_local(inputs.latitude[at], inputs.longitude[at], 0.0)));
+  });
+
+  runner.run("Geofence::contains polygon x8", [&]()
+  {
+    size_t at = index++ & (k_input_count - 1);
+    do_not_optimize(polygon.contains(frame.to_local(inputs.latitude[at], inputs.longitude[at], 0.0)));
+  });
+
+  // The watchdog checks every cycle, and a late sample every 64 cycles.
+  Watchdog watchdog(5 * k_ns_per_ms);
+
+  runner.run("Watchdog::cycle", [&]()
+  {
+    uint64_t period = (++index & 63) ? 5 * k_ns_per_ms : 12 * k_ns_per_ms;
+    watchdog.cycle(period, 1 * k_ns_per_ms);
+    do_not_optimize(watchdog.mode());
+  });
+}
+
+//  ****************************************************************************
+template <typename Frame, typename Arithmetic = FloatArithmetic>
+void bench_mixer(BenchRunner &runner, const char *p_name, const Inputs &inputs)
+{
+  float   levels[k_mixer_max_table];
+  size_t  index = 0;
+
+  runner.run(p_name, [&]()
+  {
+    size_t at = index++ & (k_input_count - 1);
+    Mixer<Frame, Arithmetic>::mix(0.5f,
+                                  inputs.angle[at],
+                                  inputs.angle[(at + 64) & (k_input_count - 1)],
+                                  inputs.angle[(at + 128) & (k_input_count - 1)],
+                                  levels);
+    do_not_optimize(levels);
+  });
+}
+
+//  ****************************************************************************
+/// The encoding of the orientation for telemetry, as in each control cycle.
+///
+template <typename Arithmetic>
+void bench_orientation(BenchRunner &runner, const char *p_name, const Inputs &inputs)
+{
+  typedef OrientationEncoder<Arithmetic> Encoder;
+
+  size_t index = 0;
+
+  runner.run(p_name, [&]()
+  {
+    size_t  at  = index++ & (k_input_count - 1);
+    float   yaw = inputs.angle[(at + 128) & (k_input_count - 1)];
+
+    int16_t orientation[5] =
+    {
+      Encoder::roll(inputs.angle[(at + 32) & (k_input_count - 1)]),
+      Encoder::roll(inputs.angle[at]),
+      Encoder::pitch(inputs.angle[(at + 96) & (k_input_count - 1)]),
+      Encoder::pitch(inputs.angle[(at + 64) & (k_input_count - 1)]),
+      Encoder::yaw(yaw < 0.0f ? yaw + float(2.0 * M_PI) : yaw)
+    };
+
+    do_not_optimize(orientation);
+  });
+}
+
+//  ****************************************************************************
+void bench_messages(BenchRunner &runner)
+{
+  DroneState state = {0};
+  state.is_armed                = 1;
+  state.orientation.roll        = 1200;
+  state.orientation.pitch       = -800;
+  state.position.is_valid       = 1;
+  state.position.latitude       = 0x12345678;
+  state.batteries.count         = 1;
+  state.batteries.battery[0].cell_count = 2;
+
+  // Measures serialization and the write, the output is discarded.
+  int null_port = open("/dev/null", O_WRONLY);
+  if (null_port >= 0)
+  {
+    runner.run("SendDroneState", [&]()
+    {
+      do_not_optimize(SendDroneState(null_port, state));
+    });
+
+    close(null_port);
+  }
+
+  // Capture a framed message to replay through read_message.
+  int pipe_ports[2];
+  if (0 != pipe(pipe_ports))
+  {
+    return;
+  }
+
+  uint8_t message[sizeof(QCDroneStateMsg)];
+  SendDroneState(pipe_ports[1], state);
+  if (read(pipe_ports[0], message, sizeof(message)) != sizeof(message))
+  {
+    close(pipe_ports[0]);
+    close(pipe_ports[1]);
+    return;
+  }
+
+  std::vector<uint8_t> batch;
+  for (size_t index = 0; index < k_message_batch; ++index)
+  {
+    batch.insert(batch.end(), message, message + sizeof(message));
+  }
+
+  // Each call writes a batch of messages to the pipe in a single write,
+  // then frames each of them back out one byte at a time.
+  runner.run("read_message", [&]()
+  {
+    if (write(pipe_ports[1], &batch[0], batch.size()) != ssize_t(batch.size()))
+    {
+      return;
+    }
+
+    uint8_t buffer[2048];
+    for (size_t index = 0; index < k_message_batch; ++index)
+    {
+      do_not_optimize(read_message(pipe_ports[0], buffer, sizeof(buffer)));
+    }
+  },
+  k_message_batch);
+
+  close(pipe_ports[0]);
+  close(pipe_ports[1]);
+}
+
+//  ****************************************************************************
+void bench_GPS(BenchRunner &runner)
+{
+  GPS::UltimateGPS  gps;
+  int               len = int(sizeof(k_rmc_sentence) - 1);
+
+  runner.run("GPS::UltimateGPS::parse_NMEA", [&]()
+  {
+    do_not_optimize(gps.parse_NMEA(k_rmc_sentence, len));
+  });
+}
+
+//  ****************************************************************************
+//  Writes a count per operation, or null when the counter is not available.
+//
+void write_count(ostream &out, bool is_available, double count)
+{
+  if (is_available)
+  {
+    char text[32];
+    snprintf(text, sizeof(text), "%.1f", count);
+    out << text;
+  }
+  else
+  {
+    out << "null";
+  }
+}
+
+//  ****************************************************************************
+void write_json(ostream &out, const BenchRunner &runner)
+{
+  const std::vector<BenchResult> &results = runner.results();
+
+  out << "{\n"
+      << "  \"compiler\": \"" << __VERSION__ << "\",\n"
+      << "  \"instructions\": " << (runner.has_instructions() ? "true" : "false") << ",\n"
+      << "  \"cycles\": " << (runner.has_cycles() ? "true" : "false") << ",\n"
+      << "  \"benchmarks\": [\n";
+
+  for (size_t index = 0; index < results.size(); ++index)
+  {
+    const BenchResult &result = results[index];
+
+    char ns[32];
+    snprintf(ns, sizeof(ns), "%.3f", result.ns_per_op);
+
+    out << "    { \"name\": \"" << result.name << "\""
+        << ", \"iterations\": " << result.iterations
+        << ", \"ns_per_op\": " << ns
+        << ", \"instructions_per_op\": ";
+
+    write_count(out, runner.has_instructions(), result.instructions_per_op);
+
+    out << ", \"cycles_per_op\": ";
+    write_count(out, runner.has_cycles(), result.cycles_per_op);
+
+    out << " }" << (index + 1 < results.size() ? "," : "") << "\n";
+  }
+
+  out << "  ]\n"
+      << "}\n";
+}
+
+}
+
+
+//  ****************************************************************************
+int main(int argc, char* argv[])
+{
+  Options options;
+  if (!parse_options(argc, argv, options))
+  {
+    usage();
+    return 1;
+  }
+
+  // The motors are commanded through the simulated ESCs.
+  Sim::SimPlatform platform;
+  HAL::platform(&platform);
+
+  Inputs      inputs;
+  BenchRunner runner(options.min_time_ns, options.p_filter);
+
+  if (!runner.has_instructions())
+  {
+    cerr << "Instruction counts are not available on this host." << endl;
+  }
+
+  if (!runner.has_cycles())
+  {
+    cerr << "Cycle counts are not available on this host." << endl;
+  }
+
+  bench_PID(runner, inputs);
+  bench_PID_cycle(runner, inputs);
+  bench_schedule(runner, inputs);
+  bench_filters(runner, inputs);
+  bench_attitude_filter(runner, inputs);
+  bench_gyro_bias(runner, inputs);
+  bench_attitude_error(runner, inputs);
+  bench_linear_algebra(runner, inputs);
+  bench_drone(runner, inputs);
+  bench_mixer<QuadFrame>(runner, "Mixer<QuadFrame>::mix", inputs);
+  bench_mixer<HexFrame>(runner,  "Mixer<HexFrame>::mix",  inputs);
+  bench_mixer<OctoFrame>(runner, "Mixer<OctoFrame>::mix", inputs);
+  bench_mixer<HexFrame, FixedArithmetic>(runner, "Mixer<HexFrame>::mix FixedArithmetic", inputs);
+  bench_orientation<FloatArithmetic>(runner, "OrientationEncoder::encode", inputs);
+  bench_orientation<FixedArithmetic>(runner, "OrientationEncoder::encode FixedArithmetic", inputs);
+  bench_messages(runner);
+  bench_GPS(runner);
+
+  if (options.p_output)
+  {
+    std::ofstream out(options.p_output);
+    if (!out)
+    {
+      cerr << "Could not open the output file: " << options.p_output << endl;
+      return 1;
+    }
+
+    write_json(out, runner);
+  }
+  else
+  {
+    write_json(cout, runner);
+  }
+
+  return 0;
+}
@@ -0,0 +1,227 @@
+/// @file control_arithmetic.h
+///
+/// The arithmetic of the control path: the PID banks, the mixer and the
+/// encoding of the orientation for telemetry.
+///
+/// Each of these is a template on an arithmetic policy. FloatArithmetic is
+/// the reference, and produces the same results as the original float code.
+/// FixedArithmetic calculates in saturating fixed point, for processors
+/// where float and double arithmetic is slow, such as the VFP-lite unit of
+/// the Cortex-A8. Values enter and leave the control path as float.
+///
+/// The flight software uses ControlArithmetic, which is FixedArithmetic
+/// when QC_FIXED_POINT is defined.
+///
+//  ****************************************************************************
+#ifndef CONTROL_ARITHMETIC_H_INCLUDED
+#define CONTROL_ARITHMETIC_H_INCLUDED
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "PID.h"
+#include "utility/fixed_point.h"
+#include "utility/util.h"
+
+
+//  ****************************************************************************
+/// The reference arithmetic, in float.
+///
+struct FloatArithmetic
+{
+  typedef float           Value;        ///< Signals, gains and limits.
+  typedef float           Coefficient;  ///< Constants between -1.0 and 1.0.
+  typedef float           Period;       ///< A time slice of up to 1 second.
+  typedef float           Rate;         ///< The reciprocal of a time slice.
+  typedef std::true_type  IsFloat;
+
+  //  **************************************************************************
+  static Value        from_float(float value)   { return value; }
+  static float        to_float(Value value)     { return value; }
+  static Coefficient  coefficient(float value)  { return value; }
+  static Period       period(float dt)          { return dt; }
+  static Rate         rate(float dt)            { return 1.0f / dt; }
+
+  //  **************************************************************************
+  /// Marks a derivative that has no previous sample.
+  ///
+  static Value none()                 { return NAN; }
+  static bool  is_none(Value value)   { return std::isnan(value); }
+
+  //  **************************************************************************
+  /// The output smoothing filter of the PID, calculated in double.
+  ///
+  static Value smooth(Value last, Value level, Value scalar)
+  {
+    return 0.87 * last + 0.13 * level * scalar;
+  }
+};
+
+
+//  ****************************************************************************
+/// Saturating fixed-point arithmetic.
+///
+/// Signals are Q11.20, which covers +/-2048 radians, radians / second, or
+/// radians / second^2 with a resolution of 1e-6. The derivative of a rate
+/// easily exceeds the 128 of Q7.24. Coefficients and periods are Q31.
+///
+struct FixedArithmetic
+{
+  typedef Q11_20          Value;
+  typedef Q31             Coefficient;
+  typedef Q31             Period;
+  typedef Q15_16          Rate;
+  typedef std::false_type IsFloat;
+
+  //  **************************************************************************
+  static Value        from_float(float value)   { return Value::from_float(value); }
+  static float        to_float(Value value)     { return value.to_float(); }
+  static Coefficient  coefficient(float value)  { return Coefficient::from_float(value); }
+  static Period       period(float dt)          { return Period::from_float(dt); }
+  static Rate         rate(float dt)            { return Rate::from_float(1.0f / dt); }
+
+  //  **************************************************************************
+  /// Saturation never produces the most negative raw value.
+  ///
+  static Value none()
+  {
+    return Value::from_raw(std::numeric_limits<Value::raw_type>::min());
+  }
+
+  static bool is_none(Value value)
+  {
+    return value.raw() == std::numeric_limits<Value::raw_type>::min();
+  }
+
+  //  **************************************************************************
+  static Value smooth(Value last, Value level, Value scalar)
+  {
+    const Coefficient k_prev = Coefficient::from_float(0.87f);
+    const Coefficient k_next = Coefficient::from_float(0.13f);
+
+    return last * k_prev + (level * scalar) * k_next;
+  }
+};
+
+
+//  ****************************************************************************
+// The arithmetic of the control path that is flown.
+#if defined(QC_FIXED_POINT)
+typedef FixedArithmetic   ControlArithmetic;
+#else
+typedef FloatArithmetic   ControlArithmetic;
+#endif
+
+
+//  ****************************************************************************
+/// Encodes the orientation for telemetry, normalized to 16 bits.
+///
+template <typename Arithmetic>
+struct OrientationEncoder;
+
+//  ****************************************************************************
+/// The reference encoding: the angle is divided by its range,
+/// and converted with to_int16.
+///
+template <>
+struct OrientationEncoder<FloatArithmetic>
+{
+  //  **************************************************************************
+  /// Roll, from -90 to 90 degrees.
+  ///
+  static int16_t roll(float radians)
+  {
+    return to_int16(radians / k_half_pi);
+  }
+
+  //  **************************************************************************
+  /// Pitch, from -180 to 180 degrees.
+  ///
+  static int16_t pitch(float radians)
+  {
+    return to_int16(radians / k_pi);
+  }
+
+  //  **************************************************************************
+  /// Yaw, from -180 to 180 degrees, where headings from 180
+  /// to 360 degrees wrap around to negative values.
+  ///
+  static int16_t yaw(float radians)
+  {
+    float normalized = radians / k_pi;
+
+    return to_int16(normalized > 1.0
+                    ? normalized - 2.0
+                    : normalized);
+  }
+};
+
+//  ****************************************************************************
+/// The fixed-point encoding multiplies by the reciprocal of the range,
+/// and truncates as to_int16 does. Angles are Q7.24.
+///
+template <>
+struct OrientationEncoder<FixedArithmetic>
+{
+  typedef Q7_24                         Value;
+  typedef FixedArithmetic::Coefficient  Coefficient;
+
+  //  **************************************************************************
+  static int16_t roll(float radians)
+  {
+    const Coefficient k_scale = Coefficient::from_float(float(2.0 / M_PI));
+
+    return encode(Value::from_float(radians) * k_scale);
+  }
+
+  //  **************************************************************************
+  static int16_t pitch(float radians)
+  {
+    const Coefficient k_scale = Coefficient::from_float(float(1.0 / M_PI));
+
+    return encode(Value::from_float(radians) * k_scale);
+  }
+
+  //  **************************************************************************
+  static int16_t yaw(float radians)
+  {
+    const Coefficient k_scale = Coefficient::from_float(float(1.0 / M_PI));
+    const Value       k_one   = Value::from_float(1.0f);
+    const Value       k_two   = Value::from_float(2.0f);
+
+    Value normalized = Value::from_float(radians) * k_scale;
+
+    return encode(normalized > k_one
+                  ? normalized - k_two
+                  : normalized);
+  }
+
+private:
+  //  **************************************************************************
+  //  Scales -1.0 to -32768 and 1.0 to 32767, truncated towards zero.
+  //
+  static int16_t encode(Value value)
+  {
+    const int32_t k_one = int32_t(1) << Value::k_fraction;
+
+    int32_t raw = value.raw();
+    if (raw >= k_one)
+    {
+      return std::numeric_limits<int16_t>::max();
+    }
+
+    if (raw <= -k_one)
+    {
+      return std::numeric_limits<int16_t>::min();
+    }
+
+    return raw < 0
+           ? int16_t(-((-raw) >> (Value::k_fraction - 15)))
+           : int16_t((int64_t(raw) * std::numeric_limits<int16_t>::max()) >> Value::k_fraction);
+  }
+};
+
+
+#endif
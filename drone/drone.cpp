@@ -7,14 +7,9 @@
 //  TODO: Add CRCs to the communication protocol.
 //  TODO: Send a MAVLink Heartbeat message to the radio to get the radios reported RSSI with the ground station.
 //        Report this value in the Drone State message.
-//  TODO: Incorporate the vertical range finder to assist with landing
-//  TODO: Incorporate the barometer to help assess the current height
-//        in the absense of GPS.
 //  TODO: Calculate the thrust level for hover. Incorporate the barometer
 //        and GPS altimeter to regulate this value dynamically at flight.
 //  TODO: Enable the anti-windup logic.
-//  TODO: Move the logging logic to a separate source file, 
-//        and hopefully write to the file in a different thread.
 //  TODO: Move the configuration settings into a file that is not compiled into the program.
 //  TODO: Add test-mode settings that allow disabling and enabling specific controllers.
 
@@ -29,7 +24,6 @@
 #include <iosfwd>
 #include <iostream>
 #include <algorithm>
-#include <fstream>
 #include <cerrno>
 
 #include <stdlib.h>
@@ -38,18 +32,10 @@
 #include <sys/types.h>
 #include <sys/time.h>
 #include <sys/stat.h>
+#include <pthread.h>
+#include <sched.h>
 
 
-//  Forward declarations *******************************************************
-// TODO: Clean up the integration of the range sensor information.
-void  start_range_sensor();
-void  shutdown_range_sensor();
-float get_range();
-
-
-
-using std::ifstream;
-using std::ofstream;
 using std::cout;
 using std::cin;
 using std::endl;
@@ -62,58 +48,63 @@ Drone *p_drone_instance = nullptr;
 
 }
 
+// Constants *******************************************************************
+const
+  float k_dT                  = 0.005f;               ///< 200 Hz, size of time slice
+                                                      ///  of the DMP.
 
-// TODO: Incorporate this into a logging class, 
-//       which is composited into the other classes.
-ofstream g_outfile;
+const
+  char  k_config_path[]       = "./flight.conf";      ///< Tuning, reloaded when changed.
 
-// TODO: Need to move these values into configurable settings loaded from a file.
-float g_hover_level             = 0.1f;
+const
+  float k_navigation_rate     = 10.0f;                ///< Hz, the location and geofence.
 
-float g_roll_Kp                 = 1.25; 
-float g_roll_Ki                 = 0.325;
-float g_roll_Kd                 = 0.077; 
-float g_roll_scalar             = 1.0;
-float g_roll_windup_limit       = to_radians(10);
+const
+  float k_battery_rate        = 5.0f;                 ///< Hz, the battery voltage.
 
-float g_pitch_Kp                = 1.08;
-float g_pitch_Ki                = 0.65;
-float g_pitch_Kd                = 0.1625;
-float g_pitch_scalar            = 1.0;
-float g_pitch_windup_limit      = to_radians(10);
+const
+  uint32_t k_battery_period_ms  = 20;                 ///< Between the samples of the
+                                                      ///  battery voltage, 50 Hz.
 
-float g_roll_rate_Kp            = 0.9678; 
-float g_roll_rate_Ki            = 1.526;  
-float g_roll_rate_Kd            = 0.02405;
-float g_roll_rate_windup_limit  = to_radians(20);
-float g_roll_rate_cutoff        = 41.0;
-float g_roll_rate_scalar        = 1.0;
+const
+  uint32_t k_battery_decimation = 10;                 ///< Samples averaged into each
+                                                      ///  reading of the voltage.
 
-float g_pitch_rate_Kp           = 0.375;
-float g_pitch_rate_Ki           = 1.545;
-float g_pitch_rate_Kd           = 0.0225;
-float g_pitch_rate_windup_limit = to_radians(20);
-float g_pitch_rate_cutoff       = 41.0;
-float g_pitch_rate_scalar       = 1.0;
+const
+  float k_group_budget[k_group_count] =               ///< The share of the time slice
+  {                                                   ///  each rate group may use.
+    0.2f,                                             //   rate
+    0.1f,                                             //   angle
+    0.1f,                                             //   navigation
+    0.05f,                                            //   telemetry
+    0.1f                                              //   battery
+  };
 
-float g_yaw_Kp                  = 0.825;
-float g_yaw_Ki                  = 0.5;
-float g_yaw_Kd                  = 0.0035;
-float g_yaw_windup_limit        = to_radians(20);
-float g_yaw_cutoff              = 41.0;
-float g_yaw_scalar              = 1.0;
+const
+  uint32_t k_range_delay_ms   = 2;                    ///< Between the samples of the
+                                                      ///  range finder.
 
+const
+  uint32_t k_range_poll_ms    = 5;                    ///< Between the reads of the
+                                                      ///  range finder.
 
-float g_motor_constraint_min    = 0.0f;
-float g_motor_constraint_max    = 1.0f;
+const
+  uint64_t k_range_max_age_ns = 100 * k_ns_per_ms;    ///< The oldest altitude of the
+                                                      ///  range finder that is used.
 
+const
+  int   k_stall_timeout_ms    = 15;                   ///< The update thread reports a stall
+                                                      ///  after 3 time slices without a sample.
 
-// Constants *******************************************************************
 const
-  int   k_i2c_bus             = 2;
+  float k_descent_level       = 0.8f;                 ///< Share of the hover level the throttle
+                                                      ///  is limited to, for a controlled descent.
 
 const
-  float k_dT                  = 0.005f;               ///< 200 Hz, size of time slice.
+  int   k_control_priority    = HAL::k_imu_priority - 1;
+                                                      ///< SCHED_FIFO priority of the
+                                                      ///  update thread, just below
+                                                      ///  the DMP interrupt thread.
 
 const
   float k_rp_command_limit    = k_pi_6;               // 30 in radians;
@@ -121,9 +112,6 @@ const
 const
   float k_yaw_command_limit   = k_pi_3;               // 60 in radians;
 
-const 
-  float k_yaw_comp_limit      = 1.0f;
-
 const
   float k_critical_limit      = k_pi_3;               // 60 in radians;
 
@@ -142,87 +130,9 @@ const
                                                       ///  deg/sec^2  ->  radians/sec^2
 
 
-const 
-  float k_ratio_limit         = 0.5f;
-
-
-//  ****************************************************************************
-// Calculate the raw levels for each of the output levels.
-// Where the caret is the forward face of the drone,
-// the orientation of the motors are as follows:
-//
-// 4-motor configuration
-//
-//    A ^ B
-//    D   C
-//
-// The rules break-down grouping each motor into
-// one of two sets, positive or negative. For each
-// command, a balanced number of motors should be assigned
-// to each set:
-//
-//          +     -
-// Roll:  (A,D) (B,C)
-// Pitch: (A,B) (C,D)
-// Yaw:   (A,C) (B,D)
-//
-const 
-  Arm_thrust_ratio  k_quad_arms[4] = 
-{ 
-  { cosf(k_pi_4), sinf(k_pi_4),  k_ratio_limit },               // Arm A - 45
-  { cosf(k_pi_4), sinf(k_pi_4), -k_ratio_limit },               // Arm B - 315
-  { cosf(k_pi_4), sinf(k_pi_4),  k_ratio_limit },               // Arm C - 225
-  { cosf(k_pi_4), sinf(k_pi_4), -k_ratio_limit }                // Arm D - 135
-};
-
-//  ****************************************************************************
-// 6-motor configuration
-//
-//           0
-//        F    A
-// 90  E   ^^   B  270
-//        D    C
-//         180
-//
-//          +     -
-// Roll:  (D,E,F) (A,B,C)
-// Pitch: (A,F)   (C,D)
-// Yaw:   (B,D,F) (A,C,E)
-//
-// The roll calculations are rotated by 90 and cos is used,
-// otherwise there is a sign shift that is required with sin calculations
-// for the aft motors of the drone.
-//
-// Additionally, the maximum amount of thrust for all control axes are limited.
-// 
-const 
-  Arm_thrust_ratio  k_hex_arms[6] = 
-{
-  { cosf(to_radians(-30.0f  - 90))  * k_ratio_limit, 
-    cosf(to_radians(-30.0f))        * k_ratio_limit,
-    -k_yaw_comp_limit * k_ratio_limit},                    // Arm A: -30
-  { cosf(to_radians(-90.0f  - 90))  * k_ratio_limit, 
-    cosf(to_radians(-90.0f))        * k_ratio_limit,
-    k_yaw_comp_limit * k_ratio_limit},                     // Arm B: -90
-  { cosf(to_radians(-150.0f - 90))  * k_ratio_limit, 
-    cosf(to_radians(-150.0f))       * k_ratio_limit,
-    -k_yaw_comp_limit * k_ratio_limit},                    // Arm C: -150
-  { cosf(to_radians(150.0f  - 90))  * k_ratio_limit, 
-    cosf(to_radians( 150.0f))       * k_ratio_limit,
-    k_yaw_comp_limit * k_ratio_limit},                     // Arm D: 150
-  { cosf(to_radians(90.0f   - 90))  * k_ratio_limit, 
-    cosf(to_radians( 90.0f))        * k_ratio_limit,
-    -k_yaw_comp_limit * k_ratio_limit},                    // Arm E: 90
-  { cosf(to_radians(30.0f   - 90))  * k_ratio_limit, 
-    cosf(to_radians( 30.0f))        * k_ratio_limit,
-    k_yaw_comp_limit * k_ratio_limit}                      // Arm F: 30
-};
-
-
-
 //  ****************************************************************************
 inline
-float normalize_throttle(int16_t thrust)
+float normalize_throttle(int16_t thrust, float hover_level)
 {
   float throttle = to_normalized(thrust);
 
@@ -235,65 +145,59 @@ float normalize_throttle(int16_t thrust)
     // allowed range.
 
 // TODO: Switch to this code before flight.
-    //float range = k_throttle_limit_max - g_hover_level;
-    //throttle    = g_hover_level + (throttle * k_throttle_limit_max);  
+    //float range = k_throttle_limit_max - hover_level;
+    //throttle    = hover_level + (throttle * k_throttle_limit_max);  
     throttle *= k_throttle_limit_max;  
   }
   else
   {
     // Negative values reduce the thrust from hover down to a minimum level.
-    throttle = (1.0 + throttle) * g_hover_level;
+    throttle = (1.0 + throttle) * hover_level;
   }
 
   return throttle;
 }
 
-//  ****************************************************************************
-inline
-float normalize_roll_angle(float roll)
-{
-  return (roll) / k_half_pi;
-}
-
 //  ****************************************************************************
 inline 
-float normalize_pitch_angle(float pitch)
+float normalize_latitude(float value)
 {
-  return (pitch) / k_pi;
+  return (value) / 90.0f;
 }
 
 //  ****************************************************************************
-//  Normalize to be between -1 (-180) and 1 (180)
-//
-inline
-float normalize_yaw_angle(float yaw)
+inline 
+float normalize_longitude(float value)
 {
-  float normalized = yaw / k_pi;
-
-  return  normalized > 1.0
-          ? normalized - 2.0
-          : normalized;
+  return (value) / 180.0f;
 }
 
 //  ****************************************************************************
 inline 
-float normalize_latitude(float value)
+float normalize_altitude(float value)
 {
-  return (value) / 90.0f;
+  return (value) / 10000.0f;
 }
 
 //  ****************************************************************************
-inline 
-float normalize_longitude(float value)
+/// Reports the monotonic time of the platform, which measures how long the
+/// flight code takes to run.
+///
+inline
+uint64_t monotonic_ns()
 {
-  return (value) / 180.0f;
+  return HAL::platform().clock().monotonic_ns();
 }
 
 //  ****************************************************************************
-inline 
-float normalize_altitude(float value)
+/// Returns the number of time slices between each run of a task at the rate.
+///
+inline
+uint32_t to_divider(float rate, float slice)
 {
-  return (value) / 10000.0f;
+  float divider = 1.0f / (rate * slice) + 0.5f;
+
+  return divider >= 2.0f ? uint32_t(divider) : 1;
 }
 
 
@@ -314,13 +218,29 @@ float YawOrientation(int16_t value)
 
 
 
+//  ****************************************************************************
+/// Indicates the GPS reports the same fix.
+///
+bool is_same_location(const GPS::location_t &lhs, const GPS::location_t &rhs)
+{
+  return lhs.time_stamp   == rhs.time_stamp
+      && lhs.ms           == rhs.ms
+      && lhs.is_valid     == rhs.is_valid
+      && lhs.latitude     == rhs.latitude
+      && lhs.longitude    == rhs.longitude
+      && lhs.altitude     == rhs.altitude
+      && lhs.speed        == rhs.speed
+      && lhs.true_course  == rhs.true_course
+      && lhs.variation    == rhs.variation;
+}
+
 //  ****************************************************************************
 /// Limits the growth of the velocity by a maximum acceleration.
 ///
-float accelerate_angular_vel(float target, float velocity, float accel_max)
+float accelerate_angular_vel(float target, float velocity, float accel_max, float dt)
 {
   // TODO: Revisit
-  float delta_ang_vel = accel_max * k_dT * 10;
+  float delta_ang_vel = accel_max * dt * 10;
   velocity += constrain(target - velocity, -delta_ang_vel, delta_ang_vel);
 
   return velocity;
@@ -328,7 +248,8 @@ float accelerate_angular_vel(float target, float velocity, float accel_max)
 
 
 //  ****************************************************************************
-PIDState to_PIDState(const PID& pid)
+template <typename Controller>
+PIDState to_PIDState(const Controller& pid)
 {
   PIDState state;
 
@@ -349,58 +270,87 @@ PIDState to_PIDState(const PID& pid)
   return state;
 }
 
+//  ****************************************************************************
+PIDState to_PIDState(const PID& pid)
+{
+  return to_PIDState<PID>(pid);
+}
+
 
 //  ****************************************************************************
-void Drone::IMU_interrupt_handler()
+void Drone::IMU_interrupt_handler(const HAL::IMUData &data, uint64_t timestamp)
 {
-  if (!p_drone_instance)
+  Drone *p_drone = p_drone_instance;
+  if (!p_drone)
   {
     return;
   }
 
-//  int index = (p_drone_instance->m_imu_index + 1) % 2;
-
-  // Update the IMU data, and signal the update thread.
-  p_drone_instance->m_imu_update = p_drone_instance->m_imu_data;
-
-  p_drone_instance->update( );
-
-  //// Wait while the update thread is processing logic.
-  //while (true == p_drone_instance->m_IMU_ready);
+  // Publish the sample, and signal the update thread.
+  // The control logic is processed by the update thread so that
+  // the DMP interrupt thread is released as quickly as possible.
+  IMUSample &sample   = p_drone->m_imu_samples.write_buffer();
+  sample.data         = data;
+  sample.timestamp_ns = timestamp;
+  sample.published_ns = monotonic_ns();
 
-  //// Update the 
-  //p_drone_instance->m_imu_index = index;
+  p_drone->m_imu_samples.publish();
 
-  //p_drone_instance->m_IMU_ready = true;
+  p_drone->m_imu_event.notify();
 }
 
 
 //  ****************************************************************************
 Drone::Drone()
-  : m_motors{1,2,3,4,5,6,7,8}
-  , mp_arm_thrust(nullptr)
-  , m_motor_count(4)
-  , m_imu_data{0}
-  , m_imu_index(0)
-  , m_imu_update{0}
+  : m_motors{{1},{2},{3},{4},{5},{6},{7},{8}}
+  , mp_mixer(&mixer_table(QC_FRAME_TYPE))
+  , mp_config(m_config.acquire())
+  , m_dropped_commands(0)
   , m_control_mode(angle_control)
+  , m_use_roll_control(true)
+  , m_use_pitch_control(true)
+  , m_use_yaw_control(true)
+  , m_stabilize(k_dT)
+  , m_roll_stabilize(m_stabilize.lane(k_stabilize_roll))
+  , m_pitch_stabilize(m_stabilize.lane(k_stabilize_pitch))
+  , m_rates(k_dT)
+  , m_roll_rate(m_rates.lane(k_rate_roll))
+  , m_pitch_rate(m_rates.lane(k_rate_pitch))
+  , m_rotation(m_rates.lane(k_rate_yaw))
   , m_critical_angle(false)
+  , m_baro_altitude(0.0f)
+  , m_baro_temperature(0.0f)
+  , m_range_altitude(-1.0f)
   , m_roll(0.0f)
   , m_pitch(0.0f)
   , m_yaw(0.0f)
   , m_throttle(0.0f)
+  , m_battery_voltage(0.0f)
+  , m_thrust(0)
   , m_last_state{0}
   , m_last_PIDS{0}
+  , m_roll_error(0.0f)
+  , m_pitch_error(0.0f)
+  , m_attitude{0.0f, 0.0f}
+  , m_target_roll(0.0f)
+  , m_target_pitch(0.0f)
+  , m_target_tilt{1.0f, 0.0f, 0.0f, 0.0f}
+  , m_is_outside_area(false)
+  , m_watchdog(seconds_to_ns(k_dT))
+  , m_is_holding(false)
+  , m_is_realtime(false)
+  , m_recorded_location{0}
+  , m_last_sample_ns(0)
+  , m_sample_dt(k_dT)
+  , m_cycle_dt(k_dT)
   , m_base_location{0}
-  , m_IMU_ready(false)
   , m_is_exit(false)
 { 
   // Associate this drone object with the interrupt routines.
   p_drone_instance = this;
 
-  // TODO: Add code to dynamically load the motor count and initialize the thrust table.
-  m_motor_count = 6;
-  mp_arm_thrust = k_hex_arms;
+  configure_timing();
+
   //control_mode(rate_control);
 
 }
@@ -410,143 +360,193 @@ Drone::~Drone()
 {
   m_gps.term( );
 
-  rc_mpu_power_off();
-  rc_adc_cleanup();
-  rc_bmp_power_off();
-  rc_servo_cleanup();
+  HAL::Platform &platform = HAL::platform();
+
+  platform.imu().term();
+  stop_update_thread();
+
+  // The barometer is stopped once the IMU no longer reads the bus.
+  if (platform.barometer())
+  {
+    platform.barometer()->term();
+  }
+
+  m_battery_monitor.stop();
+  platform.adc().term();
+  platform.esc().term();
 
-  // TODO: REenable for range calculations
-  //shutdown_range_sensor();
+  m_range.stop();
+  if (platform.range_finder())
+  {
+    platform.range_finder()->term();
+  }
 
   p_drone_instance = nullptr;
 }
 
 
 //  ****************************************************************************
-bool Drone::init()
+bool Drone::init(const char *p_log_path)
 {
-  // TODO: Add code to read coefficients from a configuration file.
   // Set the command limits for each of the PID controllers.
-  adjust_gain_roll        ( g_roll_Kp,       g_roll_Ki,        g_roll_Kd);
   m_roll_stabilize.min    (-k_rp_command_limit);
   m_roll_stabilize.max    ( k_rp_command_limit);
-  m_roll_stabilize.scalar ( g_roll_scalar);
-  m_roll_stabilize.windup_limit(g_roll_windup_limit);
 
-  adjust_gain_pitch       ( g_pitch_Kp,      g_pitch_Ki,       g_pitch_Kd);
   m_pitch_stabilize.min   (-k_rp_command_limit);
   m_pitch_stabilize.max   ( k_rp_command_limit);
-  m_pitch_stabilize.scalar( g_pitch_scalar);
-  m_pitch_stabilize.windup_limit(g_pitch_windup_limit);
 
-  adjust_gain_roll_rate   ( g_roll_rate_Kp,  g_roll_rate_Ki,   g_roll_rate_Kd);
   m_roll_rate.min         (-k_critical_limit);
   m_roll_rate.max         ( k_critical_limit);
-  m_roll_rate.scalar      ( g_roll_rate_scalar);
-  m_roll_rate.lowpass_freq( g_roll_rate_cutoff);
-  m_roll_rate.windup_limit( g_roll_rate_windup_limit);
 
-  adjust_gain_pitch_rate  (g_pitch_rate_Kp, g_pitch_rate_Ki,   g_pitch_rate_Kd);
   m_pitch_rate.min        (-k_critical_limit);
   m_pitch_rate.max        ( k_critical_limit);
-  m_pitch_rate.scalar     ( g_pitch_rate_scalar);
-  m_pitch_rate.lowpass_freq(g_pitch_rate_cutoff);
-  m_pitch_rate.windup_limit(g_pitch_rate_windup_limit);
 
-  adjust_gain_rotation    ( g_yaw_Kp,        g_yaw_Ki,         g_yaw_Kd);
   m_rotation.min          (-k_yaw_command_limit);
   m_rotation.max          ( k_yaw_command_limit);
-  m_rotation.scalar       ( g_yaw_scalar);
-  m_rotation.lowpass_freq ( g_yaw_cutoff);
-  m_rotation.windup_limit ( g_yaw_windup_limit);
 
-  // Initialize the servo motor and power levels.
-  if (0 != rc_servo_init( ))
+  // The tuning is loaded from the configuration file,
+  // and reloaded by the control loop whenever the file changes.
+  if (!m_config.open(k_config_path))
   {
-    cout  << "Call to initialize servo (motors) failed." << endl;
+    cout  << "Error: The flight configuration is not valid.\n";
+    return false;
   }
 
-  //if (0 != rc_servo_set_esc_range(1000, 2000))
-  //{
-  //  cout  << "Call to initialize the ESC range failed." << endl;
-  //}
+  mp_config = m_config.acquire();
+
+  // The control loop runs for each sample, at the rate of the IMU.
+  m_cycle_dt = HAL::k_imu_raw == mp_config->imu.mode
+             ? 1.0f / mp_config->imu.sample_rate
+             : k_dT;
+  configure_timing();
+
+  apply_config(*mp_config);
 
-  // Disable the power rail for the servo signals.
-  rc_servo_power_rail_en(0);
+  HAL::Platform &platform = HAL::platform();
 
+  // Overruns are only measured against the clock of a real-time platform.
+  m_is_realtime = platform.is_realtime();
+
+  // Initialize the servo motor and power levels.
+  platform.esc().init();
 
   clear_motor_levels();
 
-  g_outfile.open("./data.csv", std::ios_base::app);
-  if (!g_outfile.is_open())
+  // Each session is recorded to a separate flight log.
+  // Use qclog to convert the log to CSV.
+  char    log_name[64];
+  time_t  now = time(nullptr);
+  strftime(log_name, sizeof(log_name), "./flight-%Y%m%d-%H%M%S.qcl", localtime(&now));
+
+  // Platforms that step the control loop also write the log between steps.
+  if (!m_recorder.open(p_log_path ? p_log_path : log_name, platform.is_realtime()))
   {
     cout  << "Could not open file to log behavior." << endl;
   }
 
-  // TODO: Need to figure out what needs to be done to enable the PRU range sensor code.
-  // Start the ultrasonic range sensor for high-resolution
-  // distance measurements near the ground.
-  //start_range_sensor();
-  
-
-  // Initialize battery read support.
-  rc_adc_init( );
-
-  // Initialize the IMU to trigger our handler with the interrupt handler.
-  rc_mpu_config_t conf = rc_mpu_default_config();
-
-  // We want the magnetometer data fused with the calculations
-  // to help us determine absolute orientation.
+  // The ultrasonic range finder measures the altitude near the ground.
+  // The drone flies without it if it does not start.
+  HAL::RangeFinder *p_range_finder = platform.range_finder();
+  if (p_range_finder)
+  {
+    volatile RangeShared *p_ring = p_range_finder->init(k_range_delay_ms);
+    if ( !p_ring
+      || !m_range.start(p_ring, k_range_poll_ms, platform.clock()))
+    {
+      cout << "Warning: The range finder did not start." << endl;
+    }
+  }
 
-  conf.i2c_bus                    = k_i2c_bus;
-  conf.gpio_interrupt_pin_chip    = 3;
-  conf.gpio_interrupt_pin         = 21;
-  conf.enable_magnetometer        = 1;
-  conf.dmp_sample_rate            = 200; // Hz
-  conf.dmp_interrupt_priority     = 50;
-  conf.dmp_interrupt_sched_policy = SCHED_FIFO;
-  conf.orient                     = ORIENTATION_X_BACK;
 
-  conf.dmp_fetch_accel_gyro       = 1;
-  conf.show_warnings              = 1;
+  // The battery is sampled on its own thread, as the ADC is slow to read.
+  // Platforms that are not real-time read a sample for each reading.
+  platform.adc().init();
+  if (platform.is_realtime())
+  {
+    m_battery_monitor.attach(&platform.adc(), k_battery_decimation);
+    if (!m_battery_monitor.start(k_battery_period_ms, platform.clock()))
+    {
+      cout << "Warning: The battery monitor did not start." << endl;
+    }
+  }
+  else
+  {
+    m_battery_monitor.attach(&platform.adc(), 1);
+  }
 
-  int status = rc_mpu_initialize_dmp(&m_imu_data, 
-                                     conf);
-  if (0 != status)
+  // The update thread must be ready before the IMU reports its first sample.
+  // Platforms that are not real-time step the control loop themselves.
+  if ( platform.is_realtime()
+    && !start_update_thread())
   {
-    cout  << "Error: " << status << "\n"
-          << "IMU initialization failed in: rc_initialize_imu_dmp()\n";
+    cout  << "Error: The drone update thread failed to start.\n";
     return false;
   }
 
-  rc_mpu_set_dmp_callback(&IMU_interrupt_handler);
+  // The barometer shares the bus of the IMU, and is configured before the
+  // IMU starts to read it. The drone flies without it if it does not start.
+  if ( platform.barometer()
+    && !platform.barometer()->init())
+  {
+    cout << "Warning: The barometer did not start." << endl;
+  }
 
-  // TODO: Have issues if we attempt to enable the barometer at the same time as the IMU.
-  //rc_bmp_init(BMP_OVERSAMPLE_1, 
-  //            BMP_FILTER_16);
+  // Initialize the IMU to trigger our handler with the interrupt handler.
+  if (!platform.imu().init(&IMU_interrupt_handler, mp_config->imu))
+  {
+    return false;
+  }
 
   m_critical_angle = false;
 
-  m_gps.init( );
+  m_gps.init(platform.gps().device(), platform.clock());
 
   // Waiting for an ARM command from the GCS.
   halt( );
 
-  //m_is_exit = false;
-  //m_update_thread = std::thread(thread_proc, this);
-
-  //return m_update_thread.joinable();
   return true;
 }
 
 //  ****************************************************************************
-void Drone::activate()
+bool Drone::activate()
+{
+  DroneCommand request;
+  request.type = DroneCommand::k_arm;
+
+  return queue_command(request);
+}
+
+//  ****************************************************************************
+bool Drone::halt()
+{
+  // Each motor is sent a zero pulse at once, even when the control loop is
+  // not running.
+  stop_motors();
+
+  DroneCommand request;
+  request.type = DroneCommand::k_disarm;
+
+  return queue_command(request);
+}
+
+//  ****************************************************************************
+void Drone::stop_motors()
+{
+  for (size_t index = 0; index < k_max_motor_count; ++index)
+  {
+    m_motors[index].unarm(); 
+  }
+}
+
+//  ****************************************************************************
+void Drone::apply_arm()
 {
   // Reset the commanded levels.
   m_roll      = 0.0f;
   m_pitch     = 0.0f;
   m_yaw       = 0.0f;
   m_throttle  = 0.0f;
+  m_thrust    = 0;
 
 
   m_roll_stabilize.clear();
@@ -555,6 +555,12 @@ void Drone::activate()
   m_pitch_rate.clear();
   m_rotation.clear();
 
+  m_roll_error  = 0.0f;
+  m_pitch_error = 0.0f;
+
+  // A descent continues until the drone is armed again.
+  m_watchdog.reset();
+
   clear_motor_levels();
 
   for (size_t index = 0; index < k_max_motor_count; ++index)
@@ -563,9 +569,15 @@ void Drone::activate()
   }
 
   // Record the starting location before take-off.
-  m_base_location = m_gps.location( );
+  m_base_location   = m_gps.location( );
+  m_is_outside_area = false;
   if (m_base_location.is_valid)
   {
+    // The geofence is tested in the tangent plane at the base.
+    m_local_frame.origin(m_base_location.latitude,
+                         m_base_location.longitude,
+                         m_base_location.altitude);
+
     cout  << "The base location is:\n"
           << "  Latitude:  " << m_base_location.latitude
           << "  Longitude: " << m_base_location.longitude
@@ -573,6 +585,8 @@ void Drone::activate()
   }
   else
   {
+    m_local_frame.clear();
+
     cout  << "Warning!!!\n"
           << "A valid base location has not been recorded for the drone.\n"
           << "Current recorded values are: \n"
@@ -586,12 +600,10 @@ void Drone::activate()
 }
 
 //  ****************************************************************************
-void Drone::halt()
+void Drone::apply_disarm()
 {
-  for (size_t index = 0; index < k_max_motor_count; ++index)
-  {
-    m_motors[index].unarm(); 
-  }
+  // An arm command queued before the halt has armed the motors again.
+  stop_motors();
 
   m_last_state.is_armed = 0;
   cout << "The drone is disarmed..." << endl;
@@ -608,18 +620,116 @@ void Drone::halt()
         << "  Latitude:  " << loc.latitude
         << "  Longitude: " << loc.longitude
         << "  Altitude:  " << loc.altitude << endl;
-  
+}
 
-  m_is_exit = true;
+//  ****************************************************************************
+bool Drone::command(const QCopter &cmd)
+{
+  DroneCommand request;
+  request.type    = DroneCommand::k_control;
+  request.control = cmd;
 
-  if (m_update_thread.joinable())
+  return queue_command(request);
+}
+
+//  ****************************************************************************
+bool Drone::control_mode(ControlMode mode, bool use_roll, bool use_pitch, bool use_yaw)
+{
+  DroneCommand request;
+  request.type            = DroneCommand::k_control_mode;
+  request.mode.mode       = mode;
+  request.mode.use_roll   = use_roll;
+  request.mode.use_pitch  = use_pitch;
+  request.mode.use_yaw    = use_yaw;
+
+  return queue_command(request);
+}
+
+//  ****************************************************************************
+DronePIDs Drone::PID_state() const
+{
+  DronePIDs pids;
+
+  pids.roll_rate  = to_PIDState(m_roll_rate);
+  pids.roll       = to_PIDState(m_roll_stabilize);
+  pids.pitch_rate = to_PIDState(m_pitch_rate);
+  pids.pitch      = to_PIDState(m_pitch_stabilize);
+  pids.rotation   = to_PIDState(m_rotation);
+
+  return pids;
+}
+
+//  ****************************************************************************
+bool Drone::queue_command(const DroneCommand &cmd)
+{
+  // The receiver thread is the only producer. When the control loop
+  // falls behind, the newest command is dropped rather than blocking.
+  if (!m_commands.push(cmd))
   {
-    m_update_thread.join();
+    ++m_dropped_commands;
+    return false;
+  }
+
+  return true;
+}
+
+//  ****************************************************************************
+template <typename Controller>
+void adjust_PID(Controller &pid, const DroneCommand::Gain &gain)
+{
+  // Update the gain parameters and reset to remove
+  // any accumulated integral error.
+  pid.Kp(gain.Kp);
+  pid.Ki(gain.Ki);
+  pid.Kd(gain.Kd);
+}
+
+//  ****************************************************************************
+void Drone::process_commands()
+{
+  DroneCommand cmd;
+  while (m_commands.pop(cmd))
+  {
+    record_command(cmd);
+
+    switch (cmd.type)
+    {
+    case DroneCommand::k_control:
+      apply_control(cmd.control);
+      break;
+
+    case DroneCommand::k_gain:
+      switch (cmd.gain.pid)
+      {
+      case k_roll:        adjust_PID(m_roll_stabilize,  cmd.gain);  break;
+      case k_pitch:       adjust_PID(m_pitch_stabilize, cmd.gain);  break;
+      case k_roll_rate:   adjust_PID(m_roll_rate,       cmd.gain);  break;
+      case k_pitch_rate:  adjust_PID(m_pitch_rate,      cmd.gain);  break;
+      case k_rotate:      adjust_PID(m_rotation,        cmd.gain);  break;
+      default:                                                      break;
+      }
+      break;
+
+    case DroneCommand::k_control_mode:
+      m_control_mode      = cmd.mode.mode;
+      m_use_roll_control  = cmd.mode.use_roll;
+      m_use_pitch_control = cmd.mode.use_pitch;
+      m_use_yaw_control   = cmd.mode.use_yaw;
+      break;
+
+    case DroneCommand::k_arm:
+      apply_arm();
+      break;
+
+    case DroneCommand::k_disarm:
+      apply_disarm();
+      break;
+    }
   }
 }
 
 //  ****************************************************************************
-void Drone::command(const QCopter &cmd)
+void Drone::apply_control(const QCopter &cmd)
 {
   // Normalize each commanded value and configure
   // the setpoint for each PID.
@@ -637,17 +747,25 @@ void Drone::command(const QCopter &cmd)
     m_pitch  *= ratio;  
   }
 
-  m_roll_stabilize.setpoint  (m_roll);
-  m_pitch_stabilize.setpoint (m_pitch);
-
   m_yaw = to_normalized(cmd.yaw) * k_yaw_command_limit;
-  m_rotation.setpoint(m_yaw);
 
+  apply_setpoints();
 
-  m_throttle = normalize_throttle(cmd.thrust);
+  // The throttle is normalized by the control loop,
+  // with the hover level of the current configuration.
+  m_thrust = cmd.thrust;
 }
 
 
+//  ****************************************************************************
+void Drone::apply_setpoints()
+{
+  // The sticks are ignored while the watchdog holds a level attitude.
+  m_roll_stabilize.setpoint  (m_is_holding ? 0.0f : m_roll);
+  m_pitch_stabilize.setpoint (m_is_holding ? 0.0f : m_pitch);
+  m_rotation.setpoint        (m_is_holding ? 0.0f : m_yaw);
+}
+
 //  ****************************************************************************
 void Drone::thread_proc(Drone *p_this)
 {
@@ -656,138 +774,603 @@ void Drone::thread_proc(Drone *p_this)
 
   cout << "Starting Drone Update Thread." << endl;
 
+  // Sleep until the IMU interrupt handler publishes a new sample.
   while (!p_this->m_is_exit)
   {
-    if (p_this->m_IMU_ready)
+    uint64_t signals = p_this->m_imu_event.wait_for(k_stall_timeout_ms);
+    if (p_this->m_is_exit)
+    {
+      break;
+    }
+
+    if (0 == signals)
     {
-      p_this->update();
-      p_this->m_IMU_ready = false;
+      p_this->stall(uint64_t(k_stall_timeout_ms) * k_ns_per_ms);
+    }
+    else if (p_this->m_imu_samples.acquire())
+    {
+      p_this->run_cycle();
     }
   }
 
   cout << "Terminating Drone Update Thread." << endl;
-
 }
 
-
 //  ****************************************************************************
-void Drone::update( )
+bool Drone::step()
 {
-  GPS::location_t cur = current_location( );
+  if (!m_imu_samples.acquire())
+  {
+    return false;
+  }
 
-  m_last_state.position.is_valid  = cur.is_valid;
+  run_cycle();
 
-  m_last_state.position.latitude  = to_int32(normalize_latitude(cur.latitude));
-  m_last_state.position.longitude = to_int32(normalize_longitude(cur.longitude));
-  m_last_state.position.altitude  = to_int32(normalize_altitude(cur.altitude));
-  m_last_state.position.height    = 0;
+  m_recorder.flush();
 
+  return true;
+}
 
-  // TODO: Address when the drone is on the ground, do not let the PID integrals wind-up.
-  //       For now, do not update with zero thrust.
-  if (m_throttle == 0.0f)
+//  ****************************************************************************
+void Drone::run_cycle()
+{
+  const IMUSample &sample = m_imu_samples.read_buffer();
+
+  uint64_t start = monotonic_ns();
+
+  // A reloaded configuration takes effect at the start of a cycle.
+  const FlightConfig *p_config = m_config.acquire();
+  if (p_config != mp_config)
   {
-    clear_motor_levels();
-    return;
+    apply_config(*p_config);
+    mp_config = p_config;
   }
-  else if (m_throttle < g_hover_level)
+
+  // The time slice is measured between the samples themselves.
+  // The nominal slice is used for the first sample, or after a stall.
+  uint64_t period = 0;
+  m_sample_dt     = m_cycle_dt;
+  if (m_last_sample_ns)
   {
-    // This is a make shift adjustment until other components 
-    // are tuned to keep the integral from winding up.
-    m_roll_stabilize.reset_integral();
-    m_pitch_stabilize.reset_integral();
+    period = sample.timestamp_ns - m_last_sample_ns;
+    m_profiler.record(k_stage_period, period);
+
+    if ( period > 0
+      && period < k_ns_per_s)
+    {
+      m_sample_dt = to_seconds(period);
+    }
   }
 
+  m_last_sample_ns = sample.timestamp_ns;
+  m_profiler.record(k_stage_wake, start - sample.published_ns);
 
-  uint64_t timestamp  = timestamp_ms( );
+  record_sample(sample);
 
-  // TODO: Enable the barometer once the issue with simultaneous usage is solved for the IMU.
-  //rc_bmp_data_t bmp_data;
-  //rc_bmp_read(&bmp_data);
-  //
-  //m_baro_altitude     = bmp_data.alt_m;
-  //m_baro_temperature  = bmp_data.temp_c;
+  update();
 
-  // TODO: Enable the range sensor logic once the PRU is solved.
-  //m_range_altitude    = get_range();
+  uint64_t total = monotonic_ns() - sample.published_ns;
+  m_profiler.record(k_stage_total, total);
 
-  //static int cycles = 0;
-  //cycles++;
-  //if (!(cycles % 50))
-  //{
-  //  cout << " Range: " << m_range_altitude << endl;
-  //}
+  // Platforms that step the control loop have no deadline to overrun,
+  // so their cycles are only checked for missed samples.
+  DegradeMode mode = m_watchdog.mode();
+  m_watchdog.cycle(period, m_is_realtime ? total : 0);
+  report_degrade(mode);
+}
 
-  double distance = distance_from_base(cur);
-  if (distance > 20.0)
+//  ****************************************************************************
+void Drone::stall(uint64_t duration_ns)
+{
+  DegradeMode mode = m_watchdog.mode();
+  m_watchdog.stall(duration_ns);
+  report_degrade(mode);
+
+  // Without samples the attitude is not controlled. A drone that descends
+  // keeps its motors evenly at the descent throttle.
+  if ( k_degrade_descend == m_watchdog.mode()
+    && m_last_state.is_armed
+    && m_throttle > 0.0f)
   {
-    // Perform an emergency action to prevent the drone from drifting away.
-    // We force the throttle down to 25%.
-    cout << "ALERT!!! The drone has moved outside of the test area (" << distance << ")" << endl;
-
-    m_throttle = 0.5 * g_hover_level;
+    m_throttle = std::min(m_throttle, k_descent_level * m_battery.compensation()
+                                                      * mp_config->hover_level);
+    process_plant(0.0f, 0.0f, 0.0f);
   }
+}
 
-  // Safety check the stability of the drone
-  m_critical_angle = (roll( )  >  k_critical_limit
-                   || roll( )  < -k_critical_limit
-                   || pitch( ) >  k_critical_limit
-                   || pitch( ) < -k_critical_limit);
-
-    // Update the stabilization PID controllers. *********************
-  float roll_error      = 0.0f;
-  float pitch_error     = 0.0f;
-  if (angle_control == control_mode( ))
+//  ****************************************************************************
+void Drone::report_degrade(DegradeMode previous)
+{
+  DegradeMode mode = m_watchdog.mode();
+  if (mode != previous)
   {
-    roll_error          = m_roll_stabilize.update (roll( ), timestamp);
-    pitch_error         = m_pitch_stabilize.update(pitch( ), timestamp);
+    cout  << (mode > previous
+              ? "ALERT!!! The control loop is behind, the watchdog degrades from "
+              : "The control loop has recovered, the watchdog returns from ")
+          << to_string(previous) << " to " << to_string(mode) << endl;
   }
-  else // expecting rate control
+}
+
+//  ****************************************************************************
+template <typename Controller>
+void apply_PID(Controller &pid, const PIDConfig &config)
+{
+  // Changing a gain resets the accumulated error of the PID.
+  if (pid.Kp() != config.Kp)
   {
-    // Simply use the target setpoint for each axis
-    roll_error          = m_roll_stabilize.target( );
-    pitch_error         = m_pitch_stabilize.target( );
+    pid.Kp(config.Kp);
   }
 
-  // Update the rate PID controllers. ******************************
+  if (pid.Ki() != config.Ki)
+  {
+    pid.Ki(config.Ki);
+  }
 
-  // The outputs from the stabilization control PIDs,
-  // become the new set-points for the rate control PIDs.
-  m_roll_rate.setpoint (accelerate_angular_vel(roll_error, roll_rate( ), k_acceleration_max));
-  m_pitch_rate.setpoint(accelerate_angular_vel(pitch_error, pitch_rate( ), k_acceleration_max));
+  if (pid.Kd() != config.Kd)
+  {
+    pid.Kd(config.Kd);
+  }
 
-  float roll_output       = m_roll_rate.update (roll_rate( ), timestamp);
-  float pitch_output      = m_pitch_rate.update(pitch_rate( ), timestamp);
-  float yaw_output        = m_rotation.update  (yaw_rate( ), timestamp);
+  pid.scalar      (config.scalar);
+  pid.windup_limit(config.windup_limit);
 
-  roll_output   = constrain(roll_output, -k_critical_limit, k_critical_limit);
-  pitch_output  = constrain(pitch_output, -k_critical_limit, k_critical_limit);
+  // Reconfiguring the filter discards its history.
+  if (pid.filter() != config.filter)
+  {
+    pid.filter(config.filter);
+  }
+}
 
-  // Log statistics.
-  g_outfile << m_roll_stabilize.target()  << ","    // 1
-            << roll()                     << ","    // 2
-            << roll_error                 << ","    // 3
-            << m_roll_rate.target()       << ","    // 4
-            << roll_rate()                << ","    // 5
-            << roll_output                << ","    // 6
-            << m_pitch_stabilize.target() << ","    // 7
-            << pitch()                    << ","    // 8
-            << pitch_error                << ","    // 9
-            << m_pitch_rate.target()      << ","    // 10
-            << pitch_rate()               << ","    // 11
-            << pitch_output               << ","    // 12
-            << m_rotation.target( )       << ","    // 13
-            << yaw_rate( )                << ","    // 14
-            << yaw_output                 << ","    // 15
-            << yaw( )                     << "\n";  // 16
-   
-  // Record the orientation.
-  m_last_state.orientation.roll_rate  = to_int16(normalize_roll_angle(roll_rate( )));
-  m_last_state.orientation.roll       = to_int16(normalize_roll_angle(roll( )));
-  m_last_state.orientation.pitch_rate = to_int16(normalize_pitch_angle(pitch_rate( )));
-  m_last_state.orientation.pitch      = to_int16(normalize_pitch_angle(pitch( )));
-  m_last_state.orientation.yaw        = to_int16(normalize_yaw_angle(yaw( )));
+//  ****************************************************************************
+template <typename Controller>
+void schedule_PID(Controller &pid, const PIDConfig &config, const SchedulePoint &point)
+{
+  pid.scale_gains(config.Kp_table.lookup(point),
+                  config.Ki_table.lookup(point),
+                  config.Kd_table.lookup(point));
+}
 
+//  ****************************************************************************
+void Drone::measure_attitude(float *p_attitude)
+{
+  if (k_angle_error_quaternion != mp_config->angle_error)
+  {
+    p_attitude[k_stabilize_roll]  = roll( );
+    p_attitude[k_stabilize_pitch] = pitch( );
+    return;
+  }
+
+  float roll_target   = m_roll_stabilize.target( );
+  float pitch_target  = m_pitch_stabilize.target( );
+
+  // The tilt is only rebuilt when the sticks move.
+  if ( roll_target  != m_target_roll
+    || pitch_target != m_target_pitch)
+  {
+    m_target_roll   = roll_target;
+    m_target_pitch  = pitch_target;
+    m_target_tilt   = from_tilt(roll_target, pitch_target);
+  }
+
+  // The target keeps the current heading, as yaw is controlled by its rate.
+  Quat orientation  = to_quat(imu_sample().fused_quat);
+  Quat target       = multiply(heading(orientation), m_target_tilt);
+
+  float error[3];
+  to_rotation_vector(attitude_error(orientation, target), error);
+
+  p_attitude[k_stabilize_roll]  = roll_target  - error[1];
+  p_attitude[k_stabilize_pitch] = pitch_target - error[0];
+}
+
+//  ****************************************************************************
+void Drone::configure_timing()
+{
+  // A cycle overruns when it does not complete within its time slice,
+  // and a sample is late once it misses half of the next time slice.
+  m_profiler.budget(k_stage_total,  seconds_to_ns(m_cycle_dt));
+  m_profiler.budget(k_stage_period, seconds_to_ns(m_cycle_dt * 1.5));
+
+  m_watchdog.configure(seconds_to_ns(m_cycle_dt));
+}
+
+//  ****************************************************************************
+void Drone::apply_config(const FlightConfig &config)
+{
+  // The derivative filters are designed for the rate each loop runs at.
+  m_stabilize.period(m_cycle_dt * config.angle_divider);
+  m_rates.period(m_cycle_dt);
+
+  apply_PID(m_roll_stabilize,   config.roll);
+  apply_PID(m_pitch_stabilize,  config.pitch);
+  apply_PID(m_roll_rate,        config.roll_rate);
+  apply_PID(m_pitch_rate,       config.pitch_rate);
+  apply_PID(m_rotation,         config.yaw);
+
+  // The estimate of the gyro bias only starts over when the biases change.
+  m_gyro_bias.configure(config.bias_ground_time,
+                        config.bias_flight_time,
+                        config.bias_still_rate);
+  m_gyro_bias.seed(config.roll_bias, config.pitch_bias, config.yaw_bias);
+
+  m_battery.configure(config.battery_cells,
+                      config.battery_sag,
+                      config.battery_reference,
+                      config.hover_level);
+
+  // The gains of a schedule that was removed are no longer scaled.
+  if (!config.is_scheduled)
+  {
+    m_roll_stabilize.scale_gains(1.0f, 1.0f, 1.0f);
+    m_pitch_stabilize.scale_gains(1.0f, 1.0f, 1.0f);
+    m_roll_rate.scale_gains(1.0f, 1.0f, 1.0f);
+    m_pitch_rate.scale_gains(1.0f, 1.0f, 1.0f);
+    m_rotation.scale_gains(1.0f, 1.0f, 1.0f);
+  }
+
+  configure_scheduler(config);
+}
+
+//  ****************************************************************************
+void Drone::configure_scheduler(const FlightConfig &config)
+{
+  uint32_t dividers[k_group_count];
+  dividers[k_group_rate]        = 1;
+  dividers[k_group_angle]       = config.angle_divider;
+  dividers[k_group_navigation]  = to_divider(k_navigation_rate,     m_cycle_dt);
+  dividers[k_group_telemetry]   = to_divider(config.telemetry_rate, m_cycle_dt);
+  dividers[k_group_battery]     = to_divider(k_battery_rate,        m_cycle_dt);
+
+  bool is_changed = false;
+  for (int index = 0; index < k_group_count; ++index)
+  {
+    is_changed |= (dividers[index] != m_scheduler.divider(RateGroup(index)));
+  }
+
+  // Staggering again restarts the periods of every group.
+  if (!is_changed)
+  {
+    return;
+  }
+
+  for (int index = 0; index < k_group_count; ++index)
+  {
+    m_scheduler.configure(RateGroup(index),
+                          dividers[index],
+                          seconds_to_ns(m_cycle_dt * k_group_budget[index]));
+  }
+
+  m_scheduler.stagger();
+}
+
+//  ****************************************************************************
+void Drone::schedule_gains()
+{
+  if (!mp_config->is_scheduled)
+  {
+    return;
+  }
+
+  // The voltage is taken by the battery group, from the battery monitor.
+  SchedulePoint point = mp_config->schedule.locate(m_throttle, m_battery_voltage);
+
+  schedule_PID(m_roll_stabilize,  mp_config->roll,       point);
+  schedule_PID(m_pitch_stabilize, mp_config->pitch,      point);
+  schedule_PID(m_roll_rate,       mp_config->roll_rate,  point);
+  schedule_PID(m_pitch_rate,      mp_config->pitch_rate, point);
+  schedule_PID(m_rotation,        mp_config->yaw,        point);
+}
+
+//  ****************************************************************************
+bool Drone::start_update_thread()
+{
+  if (m_update_thread.joinable())
+  {
+    return true;
+  }
+
+  if (!m_imu_event.is_valid())
+  {
+    cout << "Could not create the IMU event for the update thread." << endl;
+    return false;
+  }
+
+  m_is_exit       = false;
+  m_update_thread = std::thread(thread_proc, this);
+
+  // Run the control loop just below the priority of the DMP interrupt thread,
+  // which only has to publish each sample.
+  sched_param param = {0};
+  param.sched_priority = k_control_priority;
+
+  if (0 != pthread_setschedparam(m_update_thread.native_handle(), 
+                                 SCHED_FIFO, 
+                                 &param))
+  {
+    cout << "Warning: Could not set the real-time priority of the update thread." << endl;
+  }
+
+  return m_update_thread.joinable();
+}
+
+//  ****************************************************************************
+void Drone::stop_update_thread()
+{
+  m_is_exit = true;
+  m_imu_event.notify();
+
+  if (m_update_thread.joinable())
+  {
+    m_update_thread.join();
+  }
+}
+
+
+//  ****************************************************************************
+void Drone::update( )
+{
+  // Commands from the ground station take effect between cycles,
+  // so a cycle never observes a partially applied change.
+  process_commands();
+
+  // The slower groups are staggered across the cycles,
+  // so the control loop keeps most of each time slice.
+  m_scheduler.next_cycle();
+
+  uint64_t start = monotonic_ns();
+
+  if (m_scheduler.is_due(k_group_battery))
+  {
+    monitor_battery();
+
+    uint64_t end = monotonic_ns();
+    m_scheduler.record(k_group_battery, end - start);
+    start = end;
+  }
+
+  if (m_scheduler.is_due(k_group_navigation))
+  {
+    navigate();
+
+    uint64_t end = monotonic_ns();
+    m_scheduler.record(k_group_navigation, end - start);
+  }
+
+  // The rates are read without the bias. The drone is taken to rest
+  // on the ground until it is armed with a thrust.
+  m_gyro_bias.update(to_radians(raw_roll_rate()),
+                     to_radians(raw_pitch_rate()),
+                     to_radians(raw_yaw_rate()),
+                     m_sample_dt,
+                     m_last_state.is_armed && m_thrust > 0);
+
+  control();
+
+  // The throttle of each cycle loads the battery.
+  m_battery.load(m_throttle, m_sample_dt);
+
+  // The watchdog stops the telemetry before it stops controlling the sticks.
+  if ( m_scheduler.is_due(k_group_telemetry)
+    && m_watchdog.mode() < k_degrade_no_telemetry)
+  {
+    start = monotonic_ns();
+
+    report_state();
+
+    m_scheduler.record(k_group_telemetry, monotonic_ns() - start);
+  }
+}
+
+//  ****************************************************************************
+void Drone::navigate()
+{
+  GPS::location_t cur = current_location( );
+
+  // The location only changes with a new fix, from the GPS thread.
+  if (is_same_location(cur, m_recorded_location))
+  {
+    return;
+  }
+
+  // A location is recorded in the cycle that reads it.
+  record_location(cur);
+
+  m_last_state.position.is_valid  = cur.is_valid;
+
+  m_last_state.position.latitude  = to_int32(normalize_latitude(cur.latitude));
+  m_last_state.position.longitude = to_int32(normalize_longitude(cur.longitude));
+  m_last_state.position.altitude  = to_int32(normalize_altitude(cur.altitude));
+  m_last_state.position.height    = 0;
+
+  // Without a fix, or a base location, the drone is assumed to be inside.
+  LocalPosition position    = {0.0f, 0.0f, 0.0f};
+  bool          is_outside  = false;
+  if ( cur.is_valid
+    && m_local_frame.is_valid())
+  {
+    position    = m_local_frame.to_local(cur.latitude, cur.longitude, cur.altitude);
+    is_outside  = !mp_config->geofence.contains(position);
+  }
+
+  if (is_outside != m_is_outside_area)
+  {
+    cout  << (is_outside
+              ? "ALERT!!! The drone has moved outside of the test area"
+              : "The drone has returned to the test area")
+          << " (east " << position.east
+          << ", north " << position.north
+          << ", up " << position.up << ")" << endl;
+  }
+
+  m_is_outside_area = is_outside;
+}
+
+//  ****************************************************************************
+void Drone::monitor_battery()
+{
+  if (!m_is_realtime)
+  {
+    m_battery_monitor.poll(m_imu_samples.read_buffer().timestamp_ns);
+  }
+
+  // The voltage of the previous reading is kept until the next one.
+  BatteryReading reading;
+  if (m_battery_monitor.latest(reading))
+  {
+    m_battery_voltage = reading.voltage;
+  }
+
+  record_battery(m_battery_voltage);
+
+  m_battery.update(m_battery_voltage, 1.0f / k_battery_rate);
+
+  read_battery_levels(m_last_state);
+}
+
+//  ****************************************************************************
+void Drone::control()
+{
+  // The throttle is compensated for the voltage of the battery,
+  // so the thrust of each level holds as the battery drains.
+  float compensation  = m_battery.compensation();
+  float hover_level   = compensation * mp_config->hover_level;
+
+  m_throttle = compensation * normalize_throttle(m_thrust, mp_config->hover_level);
+
+  // TODO: Address when the drone is on the ground, do not let the PID integrals wind-up.
+  //       For now, do not update with zero thrust.
+  if (m_throttle == 0.0f)
+  {
+    clear_motor_levels();
+    return;
+  }
+  else if (m_throttle < hover_level)
+  {
+    // This is a make shift adjustment until other components 
+    // are tuned to keep the integral from winding up.
+    m_roll_stabilize.reset_integral();
+    m_pitch_stabilize.reset_integral();
+  }
+
+
+  // All of the controllers advance with the time the IMU sample was taken.
+  uint64_t timestamp  = m_imu_samples.read_buffer().timestamp_ns;
+
+  // The barometer is read between the samples of the IMU, as the bus allows.
+  HAL::Barometer *p_barometer = HAL::platform().barometer();
+  HAL::BaroData   baro;
+  if ( p_barometer
+    && p_barometer->read(baro))
+  {
+    m_baro_altitude     = baro.altitude;
+    m_baro_temperature  = baro.temperature;
+  }
+
+  // An altitude from the range finder is only used while it is recent.
+  float     range_altitude  = 0.0f;
+  uint64_t  range_age_ns    = 0;
+  m_range_altitude    = m_range.latest(range_altitude, range_age_ns, timestamp)
+                     && range_age_ns <= k_range_max_age_ns
+                      ? range_altitude
+                      : -1.0f;
+
+  if (m_is_outside_area)
+  {
+    // Perform an emergency action to prevent the drone from drifting away.
+    // We force the throttle down to 25%.
+    m_throttle = 0.5 * hover_level;
+  }
+
+  // The watchdog levels the drone when the control loop falls behind,
+  // and brings it down when it cannot catch up.
+  bool is_holding = m_watchdog.mode() >= k_degrade_hold;
+  if (is_holding != m_is_holding)
+  {
+    m_is_holding = is_holding;
+    apply_setpoints();
+  }
+
+  if (k_degrade_descend == m_watchdog.mode())
+  {
+    m_throttle = std::min(m_throttle, k_descent_level * hover_level);
+  }
+
+  // Safety check the stability of the drone
+  m_critical_angle = (roll( )  >  k_critical_limit
+                   || roll( )  < -k_critical_limit
+                   || pitch( ) >  k_critical_limit
+                   || pitch( ) < -k_critical_limit);
+
+  uint64_t stage_start = monotonic_ns();
+
+  // Scale the gains for the throttle and the battery before they are used.
+  schedule_gains();
+
+    // Update the stabilization PID controllers. *********************
+  float roll_error      = 0.0f;
+  float pitch_error     = 0.0f;
+  bool  is_angle_run    = false;
+  if (angle_control == control_mode( ))
+  {
+    // The outputs are held for the cycles the angle loop does not run.
+    if (m_scheduler.is_due(k_group_angle))
+    {
+      measure_attitude(m_attitude);
+
+      float stabilized[k_stabilize_count];
+      m_stabilize.update(m_attitude, timestamp, stabilized);
+
+      m_roll_error      = stabilized[k_stabilize_roll];
+      m_pitch_error     = stabilized[k_stabilize_pitch];
+      is_angle_run      = true;
+    }
+
+    roll_error          = m_roll_error;
+    pitch_error         = m_pitch_error;
+  }
+  else // expecting rate control
+  {
+    // Simply use the target setpoint for each axis
+    roll_error          = m_roll_stabilize.target( );
+    pitch_error         = m_pitch_stabilize.target( );
+  }
+
+  uint64_t stage_end = monotonic_ns();
+  m_profiler.record(k_stage_stabilize, stage_end - stage_start);
+
+  if (is_angle_run)
+  {
+    m_scheduler.record(k_group_angle, stage_end - stage_start);
+  }
+
+  uint64_t rate_start = stage_end;
+  stage_start         = stage_end;
+
+  // Update the rate PID controllers. ******************************
+
+  // The outputs from the stabilization control PIDs,
+  // become the new set-points for the rate control PIDs.
+  m_roll_rate.setpoint (accelerate_angular_vel(roll_error, roll_rate( ), k_acceleration_max, m_sample_dt));
+  m_pitch_rate.setpoint(accelerate_angular_vel(pitch_error, pitch_rate( ), k_acceleration_max, m_sample_dt));
+
+  float rates[k_rate_count];
+  rates[k_rate_roll]      = roll_rate( );
+  rates[k_rate_pitch]     = pitch_rate( );
+  rates[k_rate_yaw]       = yaw_rate( );
+
+  float outputs[k_rate_count];
+  m_rates.update(rates, timestamp, outputs);
+
+  float roll_output       = outputs[k_rate_roll];
+  float pitch_output      = outputs[k_rate_pitch];
+  float yaw_output        = outputs[k_rate_yaw];
+
+  roll_output   = constrain(roll_output, -k_critical_limit, k_critical_limit);
+  pitch_output  = constrain(pitch_output, -k_critical_limit, k_critical_limit);
+
+  stage_end = monotonic_ns();
+  m_profiler.record(k_stage_rate, stage_end - stage_start);
+  stage_start = stage_end;
 
   if (!is_critical( )
       && m_throttle > 0.0f)
@@ -800,7 +1383,7 @@ void Drone::update( )
     process_plant(roll_output,
                   pitch_output,
                   yaw_output);
-    rc_led_set(RC_LED_RED, 0);
+    HAL::platform().leds().set(HAL::LEDs::k_led_red, false);
   }
   else
   {
@@ -810,21 +1393,42 @@ void Drone::update( )
     // Reset the state of the PIDs.
     m_roll_stabilize.clear( );
     m_pitch_stabilize.clear( );
+    m_roll_error  = 0.0f;
+    m_pitch_error = 0.0f;
 
     m_roll_rate.clear( );
     m_pitch_rate.clear( );
     m_rotation.clear( );
 
     // Indicates beyond the critical angle.
-    rc_led_set(RC_LED_RED, 1);
+    HAL::platform().leds().set(HAL::LEDs::k_led_red, true);
   }
 
+  stage_end = monotonic_ns();
+  m_profiler.record(k_stage_plant, stage_end - stage_start);
+  m_scheduler.record(k_group_rate, stage_end - rate_start);
+
+  record_cycle(roll_error, 
+               pitch_error, 
+               roll_output, 
+               pitch_output, 
+               yaw_output);
+}
+
+//  ****************************************************************************
+void Drone::report_state()
+{
+  // Record the orientation.
+  typedef OrientationEncoder<ControlArithmetic> Encoder;
+
+  m_last_state.orientation.roll_rate  = Encoder::roll(roll_rate( ));
+  m_last_state.orientation.roll       = Encoder::roll(roll( ));
+  m_last_state.orientation.pitch_rate = Encoder::pitch(pitch_rate( ));
+  m_last_state.orientation.pitch      = Encoder::pitch(pitch( ));
+  m_last_state.orientation.yaw        = Encoder::yaw(yaw( ));
+
   // Record PID states.
-  m_last_PIDS.roll_rate  = to_PIDState(m_roll_rate);
-  m_last_PIDS.roll       = to_PIDState(m_roll_stabilize);
-  m_last_PIDS.pitch_rate = to_PIDState(m_pitch_rate);
-  m_last_PIDS.pitch      = to_PIDState(m_pitch_stabilize);
-  m_last_PIDS.rotation   = to_PIDState(m_rotation);
+  m_last_PIDS = PID_state();
 
   // Update the drone's recorded state for the motors.
   m_last_state.motor.A = to_uint16(get_motor_level(m_motors[0]));
@@ -836,47 +1440,212 @@ void Drone::update( )
   m_last_state.motor.G = to_uint16(get_motor_level(m_motors[6]));
   m_last_state.motor.H = to_uint16(get_motor_level(m_motors[7]));
 
+  // The ground station takes the state from another thread.
+  m_telemetry.write_buffer() = m_last_state;
+  m_telemetry.publish();
 }
   
 
 //  ****************************************************************************
-bool Drone::process_plant(float roll, float pitch, float yaw)
+template <typename Controller>
+void record_PID(PIDRecord &record, const Controller &pid, float measured, float output)
 {
-  float attitude[k_max_motor_count] = {0.0f};
-  float rate[k_max_motor_count]     = {0.0f};
+  record.setpoint   = pid.target();
+  record.measured   = measured;
+  record.error      = pid.error();
+  record.integral   = pid.integrator();
+  record.derivative = pid.dError();
+  record.output     = output;
+}
 
-  // These coefficients account for the offset angle 
-  // of the motor placement on the body frame.
-  for (size_t index = 0; index < motor_count(); ++index)
+//  ****************************************************************************
+FlightRecord* Drone::claim_record(FlightRecordType type, uint64_t timestamp_ns)
+{
+  // The watchdog stops the flight log first, to keep the time slice.
+  if (m_watchdog.mode() >= k_degrade_no_logging)
+  {
+    return nullptr;
+  }
+
+  return m_recorder.claim(type, timestamp_ns);
+}
+
+//  ****************************************************************************
+void Drone::record_sample(const IMUSample &sample)
+{
+  FlightRecord* p_record = claim_record(k_record_imu, sample.timestamp_ns);
+  if (!p_record)
   {
-    attitude[index] = mp_arm_thrust[index].pitch * pitch 
-                    + mp_arm_thrust[index].roll  * roll
-                    + mp_arm_thrust[index].yaw   * yaw;
+    return;
+  }
+
+  IMURecord &imu = p_record->imu;
+
+  std::copy(sample.data.accel,           sample.data.accel + 3,           imu.accel);
+  std::copy(sample.data.gyro,            sample.data.gyro + 3,            imu.gyro);
+  std::copy(sample.data.mag,             sample.data.mag + 3,             imu.mag);
+  std::copy(sample.data.fused_TaitBryan, sample.data.fused_TaitBryan + 3, imu.fused_TaitBryan);
+  std::copy(sample.data.fused_quat,      sample.data.fused_quat + 4,      imu.fused_quat);
 
-    rate[index]     = m_throttle + attitude[index];
+  m_recorder.commit();
+}
+
+//  ****************************************************************************
+void Drone::record_command(const DroneCommand &cmd)
+{
+  // The armed state is recorded with each cycle.
+  if ( DroneCommand::k_arm    == cmd.type
+    || DroneCommand::k_disarm == cmd.type)
+  {
+    return;
+  }
+
+  FlightRecord* p_record = claim_record(k_record_command, m_imu_samples.read_buffer().timestamp_ns);
+  if (!p_record)
+  {
+    return;
   }
 
+  CommandRecord &command = p_record->command;
+  command = CommandRecord();
 
-  // Normalize the thrust level to between 0 and 1.
-  float lowest_rate  = *std::min_element(&rate[0], &rate[0] + motor_count());
-  float highest_rate = *std::max_element(&rate[0], &rate[0] + motor_count());
+  switch (cmd.type)
+  {
+  case DroneCommand::k_control:
+    command.type          = k_command_control;
+    command.roll          = cmd.control.roll;
+    command.pitch         = cmd.control.pitch;
+    command.yaw           = cmd.control.yaw;
+    command.thrust        = cmd.control.thrust;
+    break;
+
+  case DroneCommand::k_gain:
+    command.type          = k_command_gain;
+    command.pid           = uint8_t(cmd.gain.pid);
+    command.Kp            = cmd.gain.Kp;
+    command.Ki            = cmd.gain.Ki;
+    command.Kd            = cmd.gain.Kd;
+    break;
+
+  case DroneCommand::k_control_mode:
+    command.type          = k_command_mode;
+    command.control_mode  = uint8_t(cmd.mode.mode);
+    command.use_roll      = cmd.mode.use_roll  ? 1 : 0;
+    command.use_pitch     = cmd.mode.use_pitch ? 1 : 0;
+    command.use_yaw       = cmd.mode.use_yaw   ? 1 : 0;
+    break;
+
+  default:
+    break;
+  }
 
-  // Offset by the inverse to raise to zero.
-  float offset  =  lowest_rate < 0.0
-                ? -lowest_rate        
-                : 0.0;
+  m_recorder.commit();
+}
 
-  highest_rate += offset;
-  float ratio   = highest_rate > 1.0
-                ? 1.0 / highest_rate
-                : 1.0;
+//  ****************************************************************************
+void Drone::record_location(const GPS::location_t &location)
+{
+  m_recorded_location = location;
+
+  FlightRecord* p_record = claim_record(k_record_gps, m_imu_samples.read_buffer().timestamp_ns);
+  if (!p_record)
+  {
+    return;
+  }
+
+  GPSRecord &gps = p_record->gps;
+  gps = GPSRecord();
+
+  gps.time_stamp  = int64_t(location.time_stamp);
+  gps.ms          = location.ms;
+  gps.is_valid    = location.is_valid ? 1 : 0;
+  gps.latitude    = location.latitude;
+  gps.longitude   = location.longitude;
+  gps.altitude    = location.altitude;
+  gps.speed       = location.speed;
+  gps.true_course = location.true_course;
+  gps.variation   = location.variation;
+
+  m_recorder.commit();
+}
+
+//  ****************************************************************************
+void Drone::record_battery(float voltage)
+{
+  FlightRecord* p_record = claim_record(k_record_battery, m_imu_samples.read_buffer().timestamp_ns);
+  if (!p_record)
+  {
+    return;
+  }
+
+  p_record->battery.voltage = voltage;
+
+  m_recorder.commit();
+}
+
+//  ****************************************************************************
+void Drone::record_cycle(float roll_error,
+                         float pitch_error,
+                         float roll_output,
+                         float pitch_output,
+                         float yaw_output)
+{
+  FlightRecord* p_record = claim_record(k_record_cycle, m_imu_samples.read_buffer().timestamp_ns);
+  if (!p_record)
+  {
+    return;
+  }
+
+  CycleRecord &cycle = p_record->cycle;
+
+  cycle.throttle      = m_throttle;
+
+  cycle.roll          = roll( );
+  cycle.pitch         = pitch( );
+  cycle.yaw           = yaw( );
+
+  cycle.roll_rate     = roll_rate( );
+  cycle.pitch_rate    = pitch_rate( );
+  cycle.yaw_rate      = yaw_rate( );
+
+  // The angle loop may measure its attitude from the quaternion.
+  bool is_angle = angle_control == m_control_mode;
+
+  record_PID(cycle.roll_stabilize,  m_roll_stabilize,
+             is_angle ? m_attitude[k_stabilize_roll]  : cycle.roll,  roll_error);
+  record_PID(cycle.pitch_stabilize, m_pitch_stabilize,
+             is_angle ? m_attitude[k_stabilize_pitch] : cycle.pitch, pitch_error);
+  record_PID(cycle.roll_rate_pid,   m_roll_rate,       cycle.roll_rate,  roll_output);
+  record_PID(cycle.pitch_rate_pid,  m_pitch_rate,      cycle.pitch_rate, pitch_output);
+  record_PID(cycle.rotation,        m_rotation,        cycle.yaw_rate,   yaw_output);
+
+  for (size_t index = 0; index < k_max_motor_count; ++index)
+  {
+    cycle.motor[index] = get_motor_level(m_motors[index]);
+  }
+
+  cycle.is_armed      = m_last_state.is_armed;
+  cycle.control_mode  = uint8_t(m_control_mode);
+  cycle.is_critical   = m_critical_angle ? 1 : 0;
+  cycle.motor_count   = uint8_t(motor_count());
+
+  cycle.battery_voltage = m_battery_voltage;
+
+  m_recorder.commit();
+}
+
+
+//  ****************************************************************************
+bool Drone::process_plant(float roll, float pitch, float yaw)
+{
+  float levels[k_mixer_max_table];
+
+  mp_mixer->mix(m_throttle, roll, pitch, yaw, levels);
 
   // Assign the normalized rate to each corresponding motor.
   for (size_t index = 0; index < motor_count(); ++index)
   {
-    float motor_rate  = (rate[index] + offset) * ratio;
-
-    set_motor_level(m_motors[index], motor_rate);
+    set_motor_level(m_motors[index], levels[index]);
   }
 
   return false;
@@ -904,8 +1673,8 @@ void Drone::reset_motors()
 void Drone::set_motor_level(PWM &motor, float level)
 {
   float cur_rate = constrain(level, 
-                             g_motor_constraint_min, 
-                             g_motor_constraint_max);
+                             mp_config->motor_min, 
+                             mp_config->motor_max);
 
   motor.duty_cycle_percent(cur_rate);
 }
@@ -927,82 +1696,51 @@ void Drone::clear_motor_levels()
 
 
 //  **************************************************************************
-void Drone::adjust_gain_roll(float Kp, float Ki, float Kd)
+bool Drone::adjust_gain(PIDType type, float Kp, float Ki, float Kd)
 {
-  cout << "Adjust Gain - Roll Stabilize.\n" << endl;
-
-  // Update the gain parameters and reset to remove
-  // any accumulated integral error.
-  m_roll_stabilize.Kp(Kp);
-  m_roll_stabilize.Ki(Ki);
-  m_roll_stabilize.Kd(Kd);
-}
-
-//  **************************************************************************
-void Drone::adjust_gain_pitch(float Kp, float Ki, float Kd)
-{
-  cout << "Adjust Gain - Pitch Stabilize.\n" << endl;
-
-  // Update the gain parameters and reset to remove
-  // any accumulated integral error.
-  m_pitch_stabilize.Kp(Kp);
-  m_pitch_stabilize.Ki(Ki);
-  m_pitch_stabilize.Kd(Kd);
-}
-
-//  **************************************************************************
-void Drone::adjust_gain_roll_rate(float Kp, float Ki, float Kd)
-{
-  cout << "Adjust Gain - Roll Rate.\n" << endl;
-
-  // Update the gain parameters and reset to remove
-  // any accumulated integral error.
-  m_roll_rate.Kp(Kp);
-  m_roll_rate.Ki(Ki);
-  m_roll_rate.Kd(Kd);
-}
-
-//  **************************************************************************
-void Drone::adjust_gain_pitch_rate(float Kp, float Ki, float Kd)
-{
-  cout << "Adjust Gain - Pitch Rate.\n" << endl;
-
-  // Update the gain parameters and reset to remove
-  // any accumulated integral error.
-  m_pitch_rate.Kp(Kp);
-  m_pitch_rate.Ki(Ki);
-  m_pitch_rate.Kd(Kd);
-}
+  switch (type)
+  {
+  case k_roll:
+  case k_pitch:
+  case k_roll_rate:
+  case k_pitch_rate:
+  case k_rotate:
+    break;
+
+  default:
+    cout << "Adjust Gain - Unknown PID: " << int(type) << endl;
+    return false;
+  }
 
-//  **************************************************************************
-void Drone::adjust_gain_rotation(float Kp, float Ki, float Kd)
-{
-  cout << "Adjust Gain - Rotate.\n" << endl;
+  DroneCommand request;
+  request.type      = DroneCommand::k_gain;
+  request.gain.pid  = type;
+  request.gain.Kp   = Kp;
+  request.gain.Ki   = Ki;
+  request.gain.Kd   = Kd;
 
-  // Update the gain parameters and reset to remove
-  // any accumulated integral error.
-  m_rotation.Kp(Kp);
-  m_rotation.Ki(Ki);
-  m_rotation.Kd(Kd);
+  return queue_command(request);
 }
 
 
 //  **************************************************************************
 void Drone::read_battery_levels(DroneState &last_state)
 {
-  last_state.batteries.count = 1;
-
-  Battery &computer   = last_state.batteries.battery[0];
-  computer.cell_count = 2;
+  const BatteryEstimate &estimate = m_battery.estimate();
 
   last_state.batteries.count = 1;
 
-  // Read the computer's battery level.
-  float board = rc_adc_batt();
+  Battery &computer   = last_state.batteries.battery[0];
+  computer.cell_count = uint8_t(estimate.cells);
 
-  
-  computer.cell_level[0] = int(board * 2048) / 2;
-  computer.cell_level[1] = int(board * 2048) / 2;
+  // The cells are not measured on their own, so each reports its share of
+  // the resting voltage, in the units of the 12-bit ADC.
+  for (uint32_t index = 0; index < BatteryEstimator::k_max_cells; ++index)
+  {
+    computer.cell_level[index] = index < estimate.cells
+                               ? uint16_t(estimate.cell_voltage * 2048)
+                               : 0;
+  }
 
   // TODO: Ready the motor's battery level
   //Battery &motors   = last_state.batteries.battery[1];
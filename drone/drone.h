@@ -13,25 +13,28 @@
 #include "GPS.h"
 #include "PWM.h"
 #include "PID.h"
+#include "pid_bank.h"
+#include "control_arithmetic.h"
 #include "qcrecv.h"
-
-#include "utility/robotics.h"
+#include "recorder.h"
+#include "loop_profiler.h"
+#include "rate_scheduler.h"
+#include "watchdog.h"
+#include "hal.h"
+#include "mixer.h"
+#include "flight_config.h"
+#include "gyro_bias.h"
+#include "range.h"
+#include "battery.h"
+
+#include "utility/triple_buffer.h"
+#include "utility/event_signal.h"
+#include "utility/quat.h"
+#include "utility/spsc_ring.h"
 
 const float k_epsilon = 1e-5;
 
 
-extern float g_roll_scalar;
-extern float g_pitch_scalar;
-extern float g_yaw_scalar;
-
-
-// TODO: Move these values to configurable fields.
-
-const float k_roll_bias   = -0.0033;  
-const float k_pitch_bias  = 0.0; 
-const float k_yaw_bias    = -0.0038;    
-
-
 // TODO: Utility Functions that can be moved to more common location.
 
 //  ****************************************************************************
@@ -77,16 +80,56 @@ float is_zero(float value)
 
 
 //  ****************************************************************************
-/// Provides the amount of thrust the specified arm provides for both roll and pitch.
+/// A sample from the IMU, with the monotonic time it was taken by the IMU
+/// and the time it was published by the interrupt handler.
 ///
-struct Arm_thrust_ratio
+struct IMUSample
 {
-  float roll;
-  float pitch;
-  float yaw;
+  HAL::IMUData  data;
+  uint64_t      timestamp_ns;
+  uint64_t      published_ns;
 };
 
 
+//  ****************************************************************************
+/// A request from the ground station, queued for the control loop.
+///
+struct DroneCommand
+{
+  enum Type
+  {
+    k_control,                        ///< Stick command.
+    k_gain,                           ///< Adjusts the gains of a PID.
+    k_control_mode,                   ///< Selects the control mode and axes.
+    k_arm,                            ///< Arms the motors for movement.
+    k_disarm                          ///< Disarms the motors.
+  };
+
+  struct Gain
+  {
+    PIDType       pid;
+    float         Kp;
+    float         Ki;
+    float         Kd;
+  };
+
+  struct Mode
+  {
+    ControlMode   mode;
+    bool          use_roll;
+    bool          use_pitch;
+    bool          use_yaw;
+  };
+
+  Type            type;
+
+  union
+  {
+    QCopter       control;
+    Gain          gain;
+    Mode          mode;
+  };
+};
 
 
 //  ****************************************************************************
@@ -120,14 +163,31 @@ public:
 
   //  **************************************************************************
   /// Interrupt handler for IMU events.
+  /// Only publishes the new sample and wakes the update thread,
+  /// the control work is performed on the update thread.
   ///
   static
-    void IMU_interrupt_handler();
+    void IMU_interrupt_handler(const HAL::IMUData &data, uint64_t timestamp);
 
   //  **************************************************************************
   /// Initializes the components of the drone and resets its state.
+  /// The devices are accessed through HAL::platform().
+  ///
+  /// @param p_log_path   The flight log to record, or nullptr for a log
+  ///                     named for the time in the working directory.
   ///
-  bool init();
+  bool init(const char *p_log_path = nullptr);
+
+  //  **************************************************************************
+  /// Runs the control loop for the most recently published IMU sample
+  /// on the calling thread.
+  ///
+  /// This is used when the platform is not real-time, such as the simulator.
+  /// Otherwise the control loop is run by the update thread.
+  ///
+  /// @return false if a new sample has not been published since the last step.
+  ///
+  bool step();
 
 
   //  **************************************************************************
@@ -139,12 +199,14 @@ public:
   }
 
   //  **************************************************************************
-  /// Sets the desired control mode-type for the drone.
+  /// Sets the desired control mode-type for the drone,
+  /// and the axes that are controlled.
   ///
-  void control_mode(ControlMode mode)
-  {
-    m_control_mode = mode;
-  }
+  /// The change is applied by the control loop before its next cycle.
+  ///
+  /// @return false if the command queue is full and the change was dropped.
+  ///
+  bool control_mode(ControlMode mode, bool use_roll, bool use_pitch, bool use_yaw);
 
 
   //  **************************************************************************
@@ -156,13 +218,22 @@ public:
   }
 
   //  **************************************************************************
-  /// Configures control of the roll axis
+  /// Takes the state most recently reported by the control loop for the
+  /// ground station, which is reported at the configured telemetry rate.
+  /// Only a single thread may take the reported state.
+  ///
+  /// @return   true  if a new state was reported since the last call.
+  ///           false if the state is unchanged.
   ///
-  void use_roll_control(bool enable)
+  bool telemetry(DroneState &state)
   {
-    m_use_roll_control = enable;
+    if (!m_telemetry.acquire())
+    {
+      return false;
+    }
 
-    g_roll_scalar = enable ? 1.0 : 0.0;
+    state = m_telemetry.read_buffer();
+    return true;
   }
 
   //  **************************************************************************
@@ -173,16 +244,6 @@ public:
     return m_use_roll_control;
   }
 
-  //  **************************************************************************
-  /// Configures control of the pitch axis
-  ///
-  void use_pitch_control(bool enable)
-  {
-    m_use_pitch_control = enable;
-
-    g_pitch_scalar = enable ? 1.0 : 0.0;
-  }
-
   //  **************************************************************************
   /// Indicates if control of the pitch axis is enabled.
   ///
@@ -192,21 +253,19 @@ public:
   }
 
   //  **************************************************************************
-  /// Configures control of the yaw axis
+  /// Indicates if control of the yaw axis is enabled.
   ///
-  void use_yaw_control(bool enable)
+  bool use_yaw_control() const
   {
-    m_use_yaw_control = enable;
-
-    g_yaw_scalar = enable ? 1.0 : 0.0;
+    return m_use_yaw_control;
   }
 
   //  **************************************************************************
-  /// Indicates if control of the yaw axis is enabled.
+  /// The IMU sample currently being processed by the update thread.
   ///
-  bool use_yaw_control() const
+  const HAL::IMUData& imu_sample() const
   {
-    return m_use_yaw_control;
+    return m_imu_samples.read_buffer().data;
   }
 
   //  **************************************************************************
@@ -214,7 +273,7 @@ public:
   ///
   float roll() const
   {
-    return m_imu_update.fused_TaitBryan[TB_ROLL_Y];
+    return imu_sample().fused_TaitBryan[HAL::k_tb_roll_y];
   }
 
   //  **************************************************************************
@@ -222,7 +281,7 @@ public:
   ///
   float pitch() const
   {
-    return m_imu_update.fused_TaitBryan[TB_PITCH_X];  
+    return imu_sample().fused_TaitBryan[HAL::k_tb_pitch_x];  
   }
 
   //  **************************************************************************
@@ -230,7 +289,7 @@ public:
   ///
   float yaw() const
   {
-    return m_imu_update.fused_TaitBryan[TB_YAW_Z];
+    return imu_sample().fused_TaitBryan[HAL::k_tb_yaw_z];
   }
 
   //  **************************************************************************
@@ -239,7 +298,7 @@ public:
   ///
   float roll_rate() const
   {
-    return to_radians(raw_roll_rate()) - k_roll_bias;
+    return to_radians(raw_roll_rate()) - m_gyro_bias.bias().roll;
   }
 
   //  **************************************************************************
@@ -248,7 +307,7 @@ public:
   ///
   float pitch_rate() const
   {
-    return to_radians(raw_pitch_rate()) - k_pitch_bias;
+    return to_radians(raw_pitch_rate()) - m_gyro_bias.bias().pitch;
   }
 
   //  **************************************************************************
@@ -257,7 +316,19 @@ public:
   ///
   float yaw_rate() const
   {
-    return to_radians(raw_yaw_rate()) - k_yaw_bias;
+    return to_radians(raw_yaw_rate()) - m_gyro_bias.bias().yaw;
+  }
+
+  //  **************************************************************************
+  /// Takes the gyro bias most recently estimated by the control loop,
+  /// which is removed from the rates. Only a single thread may take the
+  /// estimate.
+  ///
+  /// @return   true  if the estimate changed since the last call.
+  ///
+  bool gyro_bias(GyroBias &bias)
+  {
+    return m_gyro_bias.snapshot(bias);
   }
 
   //  **************************************************************************
@@ -267,7 +338,7 @@ public:
   float raw_roll_rate() const
   {
     // Includes measured bias.
-    return m_imu_update.gyro[1];
+    return imu_sample().gyro[1];
   }
 
   //  **************************************************************************
@@ -277,7 +348,7 @@ public:
   float raw_pitch_rate() const
   {
     // Includes measured bias.
-    return m_imu_update.gyro[0];
+    return imu_sample().gyro[0];
   }
 
   //  **************************************************************************
@@ -287,13 +358,18 @@ public:
   float raw_yaw_rate() const
   {
     // Includes measured bias.
-    return m_imu_update.gyro[2];
+    return imu_sample().gyro[2];
   }
 
   //  **************************************************************************
   /// Updates the commanded settings for the drone.
   ///
-  void command(const QCopter &cmd);
+  /// Commands are queued from a single thread, such as the receiver,
+  /// and applied by the control loop before its next cycle.
+  ///
+  /// @return false if the command queue is full and the command was dropped.
+  ///
+  bool command(const QCopter &cmd);
 
   //  **************************************************************************
   /// For the moment, the update event is externally driven.
@@ -304,13 +380,29 @@ public:
 
   //  **************************************************************************
   /// Arms the motors for movement.
+  /// The control loop resets its state and arms the motors before its
+  /// next cycle.
+  ///
+  /// @return false if the command queue is full and the drone was not armed.
+  ///
+  bool activate();
+
+  //  **************************************************************************
+  /// Sends a zero pulse to each motor and disarms it, then queues the
+  /// disarm of the control loop, which runs before its next cycle.
+  ///
+  /// @return false if the command queue is full. The motors are stopped,
+  ///         but the control loop was not disarmed.
   ///
-  void activate();
+  bool halt();
 
   //  **************************************************************************
-  /// Immediately stops all motor activity.
+  /// Sends a zero pulse to each motor and disarms it, without a command.
+  /// The motors stay stopped while the control loop is stalled, and until
+  /// the drone is armed again. Unlike halt(), this may be called from any
+  /// thread.
   ///
-  void halt();
+  void stop_motors();
 
 
   //  **************************************************************************
@@ -327,36 +419,46 @@ public:
   }
 
   //  **************************************************************************
-  /// Command allows the Roll PID gain to be adjusted
+  /// Adjusts the gains of the specified PID, which resets its accumulated error.
+  /// The change is applied by the control loop before its next cycle.
   ///
-  void adjust_gain_roll(float Kp, float Ki, float Kd);
-
-  //  **************************************************************************
-  /// Command allows the pitch PID gain to be adjusted
+  /// @return false if the PID is not known, or the command queue is full
+  ///         and the change was dropped.
   ///
-  void adjust_gain_pitch(float Kp, float Ki, float Kd);
+  bool adjust_gain(PIDType type, float Kp, float Ki, float Kd);
 
   //  **************************************************************************
-  /// Command allows the Roll rate PID gain to be adjusted
+  /// Reports the number of commands dropped because the queue was full.
   ///
-  void adjust_gain_roll_rate(float Kp, float Ki, float Kd);
+  uint64_t dropped_commands() const
+  {
+    return m_dropped_commands;
+  }
 
   //  **************************************************************************
-  /// Command allows the pitch rate PID gain to be adjusted
+  /// Selects the frame geometry the commands are mixed across.
+  /// The frame should be selected before the motors are activated.
   ///
-  void adjust_gain_pitch_rate(float Kp, float Ki, float Kd);
+  void frame(FrameType type)
+  {
+    mp_mixer = &mixer_table(type);
+  }
 
   //  **************************************************************************
-  /// Command allows the rotation PID gain to be adjusted
+  /// Returns the configured number of motors on the drone.
   ///
-  void adjust_gain_rotation(float Kp, float Ki, float Kd);
+  size_t motor_count() const
+  {
+    return mp_mixer->motor_count;
+  }
 
   //  **************************************************************************
-  /// Returns the configured number of motors on the drone.
+  /// Returns the mixer for the configured frame,
+  /// with the coefficients for each motor.
   ///
-  size_t motor_count() const
+  const MixerTable& mixer() const
   {
-    return m_motor_count;
+    return *mp_mixer;
   }
 
 
@@ -386,29 +488,96 @@ public:
     return m_gps.location( );
   }
 
+  //  **************************************************************************
+  /// Reports the timing measurements for each stage of the control loop.
+  ///
+  const LoopProfiler& loop_profiler() const
+  {
+    return m_profiler;
+  }
+
+  //  **************************************************************************
+  /// Reports the rate and timing of each group of tasks in the control loop.
+  ///
+  const RateScheduler& scheduler() const
+  {
+    return m_scheduler;
+  }
+
+  //  **************************************************************************
+  /// Reports the faults of the control loop, and how the drone degraded.
+  ///
+  const Watchdog& watchdog() const
+  {
+    return m_watchdog;
+  }
+
+  //  **************************************************************************
+  /// Reports the current state of each PID.
+  /// Only consistent when called between cycles of the control loop.
+  ///
+  DronePIDs PID_state() const;
+
 
 
 private:
+  //  **************************************************************************
+  //  Allows the benchmarks to measure the individual stages of the control loop.
+  //
+  friend struct DroneBench;
+
+  //  **************************************************************************
+  //  Allows qcreplay to provide the GPS locations of a flight log.
+  //
+  friend struct DroneReplay;
+
+  //  **************************************************************************
+  //  The lanes of the PID banks.
+  //
+  enum StabilizeLane
+  {
+    k_stabilize_roll,
+    k_stabilize_pitch,
+    k_stabilize_count
+  };
+
+  enum RateLane
+  {
+    k_rate_roll,
+    k_rate_pitch,
+    k_rate_yaw,
+    k_rate_count
+  };
+
+  typedef PIDBank<k_stabilize_count, ControlArithmetic> StabilizeBank;
+  typedef PIDBank<k_rate_count,      ControlArithmetic> RateBank;
+
   //  **************************************************************************
   PWM           m_motors[8];          ///< The motors that provide thrust for the
                                       ///  The multi-rotor copter.
                                       ///  We can support up to 8 motors
                                       ///  in 4,6, or 8 motor configuration.
-  const Arm_thrust_ratio*
-                mp_arm_thrust;        ///< Table with vectors that indicate
-                                      ///  the ratio forces apply in both the
-                                      ///  roll and pitch per arm.
-  size_t        m_motor_count;        ///< The configured number of motors
-                                      ///  on the drone.
+  const MixerTable*
+                mp_mixer;             ///< Distributes the commands across
+                                      ///  the motors of the configured frame.
 
+  FlightConfigStore
+                m_config;             ///< Reloads the tuning when the
+                                      ///  configuration file changes.
+  const FlightConfig*
+                mp_config;            ///< The tuning for the current cycle.
 
-  rc_mpu_data_t m_imu_data;           ///< Contains the latest data updated 
-                                      ///  in the background by the IMU.     
 
-  int           m_imu_index;          ///< The index for the active channel of
-                                      ///  the IMU data's ping-pong buffer.
-  rc_mpu_data_t m_imu_update;         ///< IMU data used by the update thread. 
-                                         
+  TripleBuffer<IMUSample>
+                m_imu_samples;        ///< Hands each IMU sample from the 
+                                      ///  interrupt handler to the update thread.
+  EventSignal   m_imu_event;          ///< Wakes the update thread when a new
+                                      ///  IMU sample has been published.
+
+  SPSCRing<DroneCommand, 64>
+                m_commands;           ///< Commands waiting for the next cycle.
+  std::atomic<uint64_t>
+                m_dropped_commands;   ///< Count of commands that did not fit.
 
 
   ControlMode   m_control_mode;       ///< The control mode-type used to control
@@ -417,12 +586,19 @@ private:
   bool          m_use_pitch_control;  ///< Indicates of control of the pitch axis is enabled.
   bool          m_use_yaw_control;    ///< Indicates of control of the yaw axis is enabled.
 
-  PID           m_roll_stabilize;     ///  These PIDs control the stabilized
-  PID           m_pitch_stabilize;    ///  orientation of the UAV.
-                                                                                                    
-  PID           m_roll_rate;          ///  These PIDs control the rate of change
-  PID           m_pitch_rate;         ///  along each of the three control axis.
-  PID           m_rotation;                                         
+  StabilizeBank m_stabilize;          ///  These PIDs control the stabilized
+  StabilizeBank::Lane                 ///  orientation of the UAV.
+                m_roll_stabilize;
+  StabilizeBank::Lane
+                m_pitch_stabilize;
+
+  RateBank      m_rates;              ///  These PIDs control the rate of change
+  RateBank::Lane                      ///  along each of the three control axis.
+                m_roll_rate;
+  RateBank::Lane
+                m_pitch_rate;
+  RateBank::Lane
+                m_rotation;
 
   bool          m_critical_angle;     ///< Indicates if a critical angle
                                       ///  was reached for the drone's orientation.
@@ -432,13 +608,18 @@ private:
                                       ///  the barometric pressure.
   float         m_baro_temperature;   ///< Most recent temperature reported
                                       ///  by the barometer.
-  float         m_range_altitude;     ///< Ultra-sonic high-resolution altitude 
-                                      ///  measurements near the ground.
+  float         m_range_altitude;     ///< meters, the altitude measured by the
+                                      ///  range finder, negative while it has
+                                      ///  no recent echo.
 
   float         m_roll;               ///< normalized roll value
   float         m_pitch;              ///< normalized pitch value
   float         m_yaw;                ///< normalized yaw value
   float         m_throttle;           ///< normalized throttle value
+  float         m_battery_voltage;    ///< volts, the battery voltage the gains
+                                      ///  are scheduled for.
+  int16_t       m_thrust;             ///< The commanded thrust, normalized
+                                      ///  with the hover level of each cycle.
 
   float         m_neutral_thrust;     ///< The thrust level required to remain
                                       ///  at a constant height.
@@ -448,7 +629,50 @@ private:
                                       ///  update cycle to the drone's controls.
   DronePIDs     m_last_PIDS;          ///< The last set of status values recorded
                                       ///  for each of the drone's PIDs.
-
+  TripleBuffer<DroneState>
+                m_telemetry;          ///< Hands the reported state to the
+                                      ///  ground station.
+
+  RateScheduler m_scheduler;          ///< Runs the tasks of the control loop
+                                      ///  at their configured rates.
+  float         m_roll_error;         ///< The outputs of the angle loop, held
+  float         m_pitch_error;        ///  for the cycles that it does not run.
+  float         m_attitude[k_stabilize_count];
+                                      ///< The attitude the angle loop last ran with.
+  float         m_target_roll;        ///< The set-points of the target tilt,
+  float         m_target_pitch;       ///  as they change.
+  Quat          m_target_tilt;
+  bool          m_is_outside_area;    ///< Indicates the last GPS fix is outside
+                                      ///  of the geofence.
+
+  GyroBiasEstimator
+                m_gyro_bias;          ///< Follows the bias removed from the gyro.
+  RangeSensor   m_range;              ///< Reads the range finder.
+  BatteryMonitor
+                m_battery_monitor;    ///< Reads the voltage of the battery.
+  BatteryEstimator
+                m_battery;            ///< Compensates the throttle for the
+                                      ///  voltage of the battery.
+
+  Watchdog      m_watchdog;           ///< Degrades the work of each cycle when
+                                      ///  the control loop falls behind.
+  bool          m_is_holding;         ///< Indicates the sticks are ignored, to
+                                      ///  hold a level attitude.
+  bool          m_is_realtime;        ///< Indicates the cycles run against the clock.
+
+  FlightRecorder  m_recorder;         ///< Logs the state of each control cycle.
+  GPS::location_t m_recorded_location;///< The last location in the flight log.
+
+  LoopProfiler  m_profiler;           ///< Timing of each stage of the control loop.
+  uint64_t      m_last_sample_ns;     ///< Time the previous IMU sample was taken.
+  float         m_sample_dt;          ///< Seconds between the current and previous
+                                      ///  IMU samples.
+  float         m_cycle_dt;           ///< Seconds, the time slice of each cycle
+                                      ///  at the rate of the IMU.
+
+
+  LocalFrame    m_local_frame;        ///< The tangent plane at the base location,
+                                      ///  in which the geofence is tested.
 
   GPS::location_t m_base_location;    ///< This is the starting location for
                                       ///  the drone. If a problem occurs 
@@ -457,12 +681,9 @@ private:
 
   GPS::Sensor   m_gps;                ///< GPS module instance.
 
-  std::atomic_bool   m_IMU_ready;     ///< Flag indicates when the IMU interrupt has
-                                      ///  been triggered, signaling new data.
+  std::thread        m_update_thread; ///< Runs the control loop for each IMU sample.
 
-  std::thread        m_update_thread;
-
-  bool               m_is_exit;
+  std::atomic_bool   m_is_exit;       ///< Requests the update thread to exit.
 
   //  **************************************************************************
   //  Update processing thread for when the IMU has new data.
@@ -472,6 +693,55 @@ private:
   static
     void thread_proc(Drone *p_this);
 
+  //  **************************************************************************
+  //  Runs the control loop for the most recently acquired IMU sample,
+  //  and measures the latency from when the sample was published.
+  //
+  void run_cycle();
+
+  //  **************************************************************************
+  //  Reports to the watchdog that no sample arrived within the duration.
+  //
+  void stall(uint64_t duration_ns);
+
+  //  **************************************************************************
+  //  Announces when the watchdog has changed modes.
+  //
+  void report_degrade(DegradeMode previous);
+
+  //  **************************************************************************
+  //  Sets the budgets of the profiler and the watchdog for the time slice.
+  //
+  void configure_timing();
+
+  //  **************************************************************************
+  //  Applies the tuning of the configuration to the controllers.
+  //  The state of a PID is only reset when its gains change.
+  //
+  void apply_config(const FlightConfig &config);
+
+  //  **************************************************************************
+  //  Scales the gains of each PID for the throttle and the battery voltage,
+  //  from the gain schedule of the configuration.
+  //
+  void schedule_gains();
+
+  //  **************************************************************************
+  //  Sets the rate of each group of tasks from the configuration.
+  //  The groups are only staggered again when a rate changes.
+  //
+  void configure_scheduler(const FlightConfig &config);
+
+  //  **************************************************************************
+  //  Starts the update thread at real-time priority.
+  //
+  bool start_update_thread();
+
+  //  **************************************************************************
+  //  Signals the update thread to exit and waits for it to complete.
+  //
+  void stop_update_thread();
+
 
   //  **************************************************************************
   //  Processes the current values and properly distributes the commands to 
@@ -486,6 +756,77 @@ private:
   // 
   bool process_plant(float roll, float pitch, float yaw);
 
+  //  **************************************************************************
+  //  The tasks of each rate group, run by update() when they are due.
+  //
+  //  control() runs the angle loop when it is due, and the rate loop
+  //  and the motors every cycle.
+  //
+  void control();
+  void navigate();
+  void report_state();
+  void monitor_battery();
+
+  //  **************************************************************************
+  //  Applies each of the queued commands, in the order they were received.
+  //
+  void process_commands();
+
+  //  **************************************************************************
+  //  Converts the stick command into the set-point of each PID.
+  //
+  void apply_control(const QCopter &cmd);
+
+  //  **************************************************************************
+  //  Resets the state of the control loop, and arms the motors.
+  //
+  void apply_arm();
+
+  //  **************************************************************************
+  //  Disarms the motors, and reports the most recent location.
+  //
+  void apply_disarm();
+
+  //  **************************************************************************
+  //  Sets the set-point of each PID from the commanded values,
+  //  or a level attitude while the watchdog holds it.
+  //
+  void apply_setpoints();
+
+  //  **************************************************************************
+  //  Reports the attitude the angle loop compares to its set-points.
+  //  With the quaternion error, the attitude is the set-point less the
+  //  rotation to the target, so the PIDs correct that rotation.
+  //
+  void measure_attitude(float *p_attitude);
+
+  //  **************************************************************************
+  //  Queues a command for the control loop.
+  //
+  bool queue_command(const DroneCommand &cmd);
+
+  //  **************************************************************************
+  //  Claims a record in the flight log, unless the watchdog stopped the log.
+  //
+  FlightRecord* claim_record(FlightRecordType type, uint64_t timestamp_ns);
+
+  //  **************************************************************************
+  //  Records the inputs of the control loop to the flight log.
+  //
+  void record_sample(const IMUSample &sample);
+  void record_command(const DroneCommand &cmd);
+  void record_location(const GPS::location_t &location);
+  void record_battery(float voltage);
+
+  //  **************************************************************************
+  //  Records the state of the current control cycle to the flight log.
+  //
+  void record_cycle(float roll_error,
+                    float pitch_error,
+                    float roll_output,
+                    float pitch_output,
+                    float yaw_output);
+
   //  **************************************************************************
   //  Resets the motors to the initial activated state.
   //
@@ -0,0 +1,875 @@
+/// @file flight_config.cpp
+///
+/// Tuning parameters for the flight software, loaded from a file.
+///
+//  ****************************************************************************
+#include "flight_config.h"
+#include "PID.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+using std::cout;
+using std::endl;
+
+
+namespace // unnamed
+{
+
+const int   k_watcher_nice    = 10;           ///< Scheduling niceness of the watcher.
+const int   k_reclaim_ms      = 100;          ///< Period to check for retired snapshots.
+
+const uint32_t
+            k_watch_events    = IN_CLOSE_WRITE  ///< Written in place.
+                              | IN_MOVED_TO;    ///< Replaced by a rename.
+
+const uint32_t
+            k_max_angle_divider   = 8;        ///< The angle loop runs at 1/8 of the
+                                              ///  IMU rate or faster.
+const float k_max_telemetry_rate  = 50.0f;    ///< Hz, the most the radio link carries.
+
+const uint32_t
+            k_max_battery_cells   = 4;        ///< The cells the telemetry reports.
+
+const uint32_t
+            k_min_imu_rate        = 200;      ///< Hz, of the raw measurements.
+const uint32_t
+            k_max_imu_rate        = 1000;     ///< Hz, the internal rate of the MPU,
+                                              ///  which must be a multiple of the rate.
+
+const float k_min_bias_time       = 1.0f;     ///< seconds, the time constants of the
+                                              ///  bias estimate span the samples.
+
+//  ****************************************************************************
+float to_radians(float degrees)
+{
+  return degrees * k_pi / 180.0;
+}
+
+//  ****************************************************************************
+FilterConfig default_filter(float cutoff)
+{
+  FilterConfig filter;
+
+  filter.type   = k_filter_lowpass;
+  filter.cutoff = cutoff;
+  filter.q      = 0.7071f;            // Butterworth
+  filter.window = 5;
+
+  return filter;
+}
+
+//  ****************************************************************************
+NumberList empty_list()
+{
+  NumberList list = { 0, { } };
+
+  return list;
+}
+
+//  ****************************************************************************
+//  Unscheduled gains and the default filter.
+//
+PIDConfig make_PID(float Kp, float Ki, float Kd, float windup_limit, float cutoff)
+{
+  PIDConfig config;
+
+  config.Kp           = Kp;
+  config.Ki           = Ki;
+  config.Kd           = Kd;
+  config.scalar       = 1.0;
+  config.windup_limit = windup_limit;
+  config.filter       = default_filter(cutoff);
+  config.Kp_scale     = empty_list();
+  config.Ki_scale     = empty_list();
+  config.Kd_scale     = empty_list();
+
+  return config;
+}
+
+//  ****************************************************************************
+bool prepare_PID(PIDConfig &config, const GainSchedule &schedule)
+{
+  size_t throttle = schedule.throttle_count();
+  size_t voltage  = schedule.voltage_count();
+
+  bool is_valid = config.Kp_table.configure(config.Kp_scale, throttle, voltage);
+  is_valid      = config.Ki_table.configure(config.Ki_scale, throttle, voltage) && is_valid;
+  is_valid      = config.Kd_table.configure(config.Kd_scale, throttle, voltage) && is_valid;
+
+  return is_valid;
+}
+
+//  ****************************************************************************
+bool is_scheduled(const PIDConfig &config)
+{
+  return config.Kp_table.is_scheduled()
+      || config.Ki_table.is_scheduled()
+      || config.Kd_table.is_scheduled();
+}
+
+//  ****************************************************************************
+/// Prepares the gain tables for the control loop.
+///
+/// @return   false if the breakpoints or the scales are not valid.
+///
+bool prepare_schedule(FlightConfig &config)
+{
+  bool is_valid = config.schedule.configure(config.schedule_throttle, config.schedule_voltage);
+
+  is_valid = prepare_PID(config.roll,       config.schedule) && is_valid;
+  is_valid = prepare_PID(config.pitch,      config.schedule) && is_valid;
+  is_valid = prepare_PID(config.roll_rate,  config.schedule) && is_valid;
+  is_valid = prepare_PID(config.pitch_rate, config.schedule) && is_valid;
+  is_valid = prepare_PID(config.yaw,        config.schedule) && is_valid;
+
+  config.is_scheduled = is_scheduled(config.roll)
+                     || is_scheduled(config.pitch)
+                     || is_scheduled(config.roll_rate)
+                     || is_scheduled(config.pitch_rate)
+                     || is_scheduled(config.yaw);
+
+  return is_valid;
+}
+
+//  ****************************************************************************
+/// Prepares the edges of the geofence for the control loop.
+///
+/// @return   false if the limits do not describe an area.
+///
+bool prepare_geofence(FlightConfig &config)
+{
+  return config.geofence.configure(config.geofence_radius,
+                                   config.geofence_ceiling,
+                                   config.geofence_polygon);
+}
+
+//  ****************************************************************************
+FlightConfig make_defaults()
+{
+  FlightConfig config;
+
+  config.hover_level          = 0.1f;
+
+  config.motor_min            = 0.0f;
+  config.motor_max            = 1.0f;
+
+  config.roll_bias            = -0.0033;
+  config.pitch_bias           = 0.0;
+  config.yaw_bias             = -0.0038;
+
+  config.bias_ground_time     = 2.0f;
+  config.bias_flight_time     = 60.0f;
+  config.bias_still_rate      = to_radians(3);
+
+  config.angle_divider        = 1;
+  config.angle_error          = k_angle_error_euler;
+  config.telemetry_rate       = 4.0f;
+
+  config.battery_cells        = 2;
+  config.battery_sag          = 0.0f;
+  config.battery_reference    = 0.0f;
+
+  config.imu.mode             = HAL::k_imu_dmp;
+  config.imu.sample_rate      = 1000;
+  config.imu.filter_Kp        = 0.1f;
+  config.imu.filter_Ki        = 0.0f;
+
+  config.roll                 = make_PID(1.25,   0.325, 0.077,   to_radians(10), 20.0);
+  config.pitch                = make_PID(1.08,   0.65,  0.1625,  to_radians(10), 20.0);
+  config.roll_rate            = make_PID(0.9678, 1.526, 0.02405, to_radians(20), 41.0);
+  config.pitch_rate           = make_PID(0.375,  1.545, 0.0225,  to_radians(20), 41.0);
+  config.yaw                  = make_PID(0.825,  0.5,   0.0035,  to_radians(20), 41.0);
+
+  config.schedule_throttle    = empty_list();
+  config.schedule_voltage     = empty_list();
+
+  prepare_schedule(config);
+
+  config.geofence_radius      = 20.0f;
+  config.geofence_ceiling     = 0.0f;
+  config.geofence_polygon     = empty_list();
+
+  prepare_geofence(config);
+
+  return config;
+}
+
+//  ****************************************************************************
+/// The kinds of value a setting holds.
+///
+enum FieldKind
+{
+  k_field_number,               ///< A float.
+  k_field_angle,                ///< A float, specified in degrees, stored in radians.
+  k_field_count,                ///< A uint32_t.
+  k_field_filter,               ///< A FilterType, specified by name.
+  k_field_imu_mode,             ///< A HAL::IMUMode, specified by name.
+  k_field_angle_error,          ///< An AngleError, specified by name.
+  k_field_list                  ///< A NumberList, of numbers separated by
+                                ///  spaces or commas.
+};
+
+//  ****************************************************************************
+/// A setting that may appear in the configuration file.
+///
+struct ConfigField
+{
+  const char*   p_name;
+  size_t        offset;         ///< Offset of the value within FlightConfig.
+  FieldKind     kind;
+};
+
+#define CONFIG_FIELD(name, member)              { name, offsetof(FlightConfig, member), k_field_number }
+#define CONFIG_ANGLE(name, member)              { name, offsetof(FlightConfig, member), k_field_angle }
+#define CONFIG_COUNT(name, member)              { name, offsetof(FlightConfig, member), k_field_count }
+#define CONFIG_FILTER(name, member)             { name, offsetof(FlightConfig, member), k_field_filter }
+#define CONFIG_IMU_MODE(name, member)           { name, offsetof(FlightConfig, member), k_field_imu_mode }
+#define CONFIG_ANGLE_ERROR(name, member)        { name, offsetof(FlightConfig, member), k_field_angle_error }
+#define CONFIG_LIST(name, member)               { name, offsetof(FlightConfig, member), k_field_list }
+
+#define CONFIG_PID_FIELDS(name, member)                             \
+  CONFIG_FIELD(name ".Kp",            member.Kp),                   \
+  CONFIG_FIELD(name ".Ki",            member.Ki),                   \
+  CONFIG_FIELD(name ".Kd",            member.Kd),                   \
+  CONFIG_FIELD(name ".scalar",        member.scalar),               \
+  CONFIG_ANGLE(name ".windup_limit",  member.windup_limit),         \
+  CONFIG_FILTER(name ".filter",       member.filter.type),          \
+  CONFIG_FIELD(name ".cutoff",        member.filter.cutoff),        \
+  CONFIG_FIELD(name ".q",             member.filter.q),             \
+  CONFIG_COUNT(name ".window",        member.filter.window),        \
+  CONFIG_LIST(name ".Kp_scale",       member.Kp_scale),             \
+  CONFIG_LIST(name ".Ki_scale",       member.Ki_scale),             \
+  CONFIG_LIST(name ".Kd_scale",       member.Kd_scale)
+
+const ConfigField k_fields[] =
+{
+  CONFIG_FIELD("hover_level",   hover_level),
+  CONFIG_FIELD("motor_min",     motor_min),
+  CONFIG_FIELD("motor_max",     motor_max),
+  CONFIG_FIELD("roll_bias",     roll_bias),
+  CONFIG_FIELD("pitch_bias",    pitch_bias),
+  CONFIG_FIELD("yaw_bias",      yaw_bias),
+
+  CONFIG_FIELD("gyro_bias.ground_time", bias_ground_time),
+  CONFIG_FIELD("gyro_bias.flight_time", bias_flight_time),
+  CONFIG_ANGLE("gyro_bias.still_rate",  bias_still_rate),
+
+  CONFIG_COUNT("angle_divider",   angle_divider),
+  CONFIG_ANGLE_ERROR("angle_error", angle_error),
+  CONFIG_FIELD("telemetry_rate",  telemetry_rate),
+
+  CONFIG_COUNT("battery.cells",     battery_cells),
+  CONFIG_FIELD("battery.sag",       battery_sag),
+  CONFIG_FIELD("battery.reference", battery_reference),
+
+  CONFIG_IMU_MODE("imu.mode",     imu.mode),
+  CONFIG_COUNT("imu.rate",        imu.sample_rate),
+  CONFIG_FIELD("imu.filter_Kp",   imu.filter_Kp),
+  CONFIG_FIELD("imu.filter_Ki",   imu.filter_Ki),
+
+  CONFIG_PID_FIELDS("roll",       roll),
+  CONFIG_PID_FIELDS("pitch",      pitch),
+  CONFIG_PID_FIELDS("roll_rate",  roll_rate),
+  CONFIG_PID_FIELDS("pitch_rate", pitch_rate),
+  CONFIG_PID_FIELDS("yaw",        yaw),
+
+  CONFIG_FIELD("geofence.radius",   geofence_radius),
+  CONFIG_FIELD("geofence.ceiling",  geofence_ceiling),
+  CONFIG_LIST("geofence.polygon",   geofence_polygon),
+
+  CONFIG_LIST("schedule.throttle",  schedule_throttle),
+  CONFIG_LIST("schedule.voltage",   schedule_voltage)
+};
+
+#undef CONFIG_PID_FIELDS
+#undef CONFIG_LIST
+#undef CONFIG_ANGLE_ERROR
+#undef CONFIG_IMU_MODE
+#undef CONFIG_FILTER
+#undef CONFIG_COUNT
+#undef CONFIG_ANGLE
+#undef CONFIG_FIELD
+
+//  ****************************************************************************
+/// The names of the filters, in the order of FilterType.
+///
+const char* const k_filter_names[] =
+{
+  "none",
+  "lowpass",
+  "biquad",
+  "notch",
+  "average",
+  "median"
+};
+
+//  ****************************************************************************
+/// The names of the IMU modes, in the order of HAL::IMUMode.
+///
+const char* const k_imu_mode_names[] =
+{
+  "dmp",
+  "raw"
+};
+
+//  ****************************************************************************
+/// The names of the angle errors, in the order of AngleError.
+///
+const char* const k_angle_error_names[] =
+{
+  "euler",
+  "quaternion"
+};
+
+//  ****************************************************************************
+const ConfigField* find_field(const std::string &name)
+{
+  for (size_t index = 0; index < sizeof(k_fields) / sizeof(k_fields[0]); ++index)
+  {
+    if (name == k_fields[index].p_name)
+    {
+      return &k_fields[index];
+    }
+  }
+
+  return nullptr;
+}
+
+//  ****************************************************************************
+bool parse_filter(const std::string &value, FilterType &type)
+{
+  for (size_t index = 0; index < sizeof(k_filter_names) / sizeof(k_filter_names[0]); ++index)
+  {
+    if (value == k_filter_names[index])
+    {
+      type = FilterType(index);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+//  ****************************************************************************
+bool parse_imu_mode(const std::string &value, HAL::IMUMode &mode)
+{
+  for (size_t index = 0; index < sizeof(k_imu_mode_names) / sizeof(k_imu_mode_names[0]); ++index)
+  {
+    if (value == k_imu_mode_names[index])
+    {
+      mode = HAL::IMUMode(index);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+//  ****************************************************************************
+bool parse_angle_error(const std::string &value, AngleError &error)
+{
+  for (size_t index = 0; index < sizeof(k_angle_error_names) / sizeof(k_angle_error_names[0]); ++index)
+  {
+    if (value == k_angle_error_names[index])
+    {
+      error = AngleError(index);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+//  ****************************************************************************
+bool parse_list(const std::string &value, NumberList &list)
+{
+  list.count = 0;
+
+  const char *p_next = value.c_str();
+  while (true)
+  {
+    while (*p_next == ' ' || *p_next == '\t' || *p_next == ',')
+    {
+      ++p_next;
+    }
+
+    if (*p_next == '\0')
+    {
+      return true;
+    }
+
+    char  *p_end  = nullptr;
+    float  number = strtof(p_next, &p_end);
+    if ( p_end == p_next
+      || list.count == k_number_list_max)
+    {
+      return false;
+    }
+
+    list.values[list.count++] = number;
+    p_next = p_end;
+  }
+}
+
+//  ****************************************************************************
+/// Stores the value of a setting.
+///
+/// @return   false if the value is not valid for the kind of setting.
+///
+bool parse_value(const ConfigField &field, const std::string &value, FlightConfig &config)
+{
+  char *p_member = reinterpret_cast<char*>(&config) + field.offset;
+
+  if (k_field_filter == field.kind)
+  {
+    return parse_filter(value, *reinterpret_cast<FilterType*>(p_member));
+  }
+
+  if (k_field_imu_mode == field.kind)
+  {
+    return parse_imu_mode(value, *reinterpret_cast<HAL::IMUMode*>(p_member));
+  }
+
+  if (k_field_angle_error == field.kind)
+  {
+    return parse_angle_error(value, *reinterpret_cast<AngleError*>(p_member));
+  }
+
+  if (k_field_list == field.kind)
+  {
+    return parse_list(value, *reinterpret_cast<NumberList*>(p_member));
+  }
+
+  char  *p_end  = nullptr;
+  float  number = strtof(value.c_str(), &p_end);
+  if ( value.empty()
+    || *p_end != '\0')
+  {
+    return false;
+  }
+
+  switch (field.kind)
+  {
+  case k_field_angle:
+    *reinterpret_cast<float*>(p_member) = to_radians(number);
+    break;
+
+  case k_field_count:
+    if ( number < 0.0f
+      || number != std::floor(number))
+    {
+      return false;
+    }
+
+    *reinterpret_cast<uint32_t*>(p_member) = uint32_t(number);
+    break;
+
+  default:
+    *reinterpret_cast<float*>(p_member) = number;
+    break;
+  }
+
+  return true;
+}
+
+//  ****************************************************************************
+std::string trim(const std::string &text)
+{
+  const char *k_space = " \t\r\n";
+
+  size_t first = text.find_first_not_of(k_space);
+  if (first == std::string::npos)
+  {
+    return std::string();
+  }
+
+  size_t last = text.find_last_not_of(k_space);
+  return text.substr(first, last - first + 1);
+}
+
+//  ****************************************************************************
+bool is_valid_filter(const FilterConfig &config)
+{
+  return config.cutoff > 0.0f
+      && config.q      > 0.0f
+      && config.window >= 1
+      && config.window <= k_filter_max_window;
+}
+
+//  ****************************************************************************
+bool is_valid_PID(const PIDConfig &config)
+{
+  return config.Kp >= 0.0f
+      && config.Ki >= 0.0f
+      && config.windup_limit >= 0.0f
+      && is_valid_filter(config.filter);
+}
+
+//  ****************************************************************************
+bool is_valid_imu(const HAL::IMUConfig &config)
+{
+  return config.sample_rate >= k_min_imu_rate
+      && config.sample_rate <= k_max_imu_rate
+      && k_max_imu_rate % config.sample_rate == 0
+      && config.filter_Kp >= 0.0f
+      && config.filter_Ki >= 0.0f;
+}
+
+//  ****************************************************************************
+/// A time constant of the bias estimate is longer than a stalled sample.
+///
+bool is_valid_bias_time(float time_constant)
+{
+  return time_constant == 0.0f
+      || time_constant >= k_min_bias_time;
+}
+
+//  ****************************************************************************
+bool is_valid(const FlightConfig &config)
+{
+  return config.hover_level >= 0.0f
+      && config.hover_level <= 1.0f
+      && config.motor_min   >= 0.0f
+      && config.motor_min   <  config.motor_max
+      && config.motor_max   <= 1.0f
+      && config.angle_divider >= 1
+      && config.angle_divider <= k_max_angle_divider
+      && config.telemetry_rate > 0.0f
+      && config.telemetry_rate <= k_max_telemetry_rate
+      && config.battery_cells <= k_max_battery_cells
+      && config.battery_sag   >= 0.0f
+      && config.battery_reference >= 0.0f
+      && is_valid_bias_time(config.bias_ground_time)
+      && is_valid_bias_time(config.bias_flight_time)
+      && config.bias_still_rate > 0.0f
+      && is_valid_imu(config.imu)
+      && is_valid_PID(config.roll)
+      && is_valid_PID(config.pitch)
+      && is_valid_PID(config.roll_rate)
+      && is_valid_PID(config.pitch_rate)
+      && is_valid_PID(config.yaw);
+}
+
+}
+
+
+//  ****************************************************************************
+const FlightConfig& default_flight_config()
+{
+  static const FlightConfig k_defaults = make_defaults();
+
+  return k_defaults;
+}
+
+//  ****************************************************************************
+bool parse_flight_config(std::istream &in, const char *p_source, FlightConfig &config)
+{
+  std::string line;
+  int         line_number = 0;
+
+  while (std::getline(in, line))
+  {
+    ++line_number;
+
+    size_t comment = line.find('#');
+    if (comment != std::string::npos)
+    {
+      line.erase(comment);
+    }
+
+    line = trim(line);
+    if (line.empty())
+    {
+      continue;
+    }
+
+    size_t equals = line.find('=');
+    if (equals == std::string::npos)
+    {
+      cout << p_source << ":" << line_number << ": Expected name = value." << endl;
+      return false;
+    }
+
+    std::string name  = trim(line.substr(0, equals));
+    std::string value = trim(line.substr(equals + 1));
+
+    const ConfigField *p_field = find_field(name);
+    if (!p_field)
+    {
+      cout << p_source << ":" << line_number << ": Unknown setting '" << name << "'." << endl;
+      return false;
+    }
+
+    if (!parse_value(*p_field, value, config))
+    {
+      cout << p_source << ":" << line_number << ": Invalid value for '" << name << "'." << endl;
+      return false;
+    }
+  }
+
+  if (!is_valid(config))
+  {
+    cout << p_source << ": The settings are out of range." << endl;
+    return false;
+  }
+
+  if (!prepare_schedule(config))
+  {
+    cout << p_source << ": The gain schedule does not match its breakpoints." << endl;
+    return false;
+  }
+
+  if (!prepare_geofence(config))
+  {
+    cout << p_source << ": The geofence does not describe an area." << endl;
+    return false;
+  }
+
+  return true;
+}
+
+//  ****************************************************************************
+bool load_flight_config(const std::string &path, FlightConfig &config)
+{
+  std::ifstream in(path.c_str());
+  if (!in)
+  {
+    cout << "Could not open the flight configuration: " << path << endl;
+    return false;
+  }
+
+  config = default_flight_config();
+
+  return parse_flight_config(in, path.c_str(), config);
+}
+
+
+//  ****************************************************************************
+FlightConfigStore::FlightConfigStore()
+  : m_current(new FlightConfig(default_flight_config()))
+  , m_reader(nullptr)
+  , m_inotify(-1)
+  , m_is_exit(false)
+  , m_reloads(0)
+{ }
+
+//  ****************************************************************************
+FlightConfigStore::~FlightConfigStore()
+{
+  close();
+
+  // The control loop no longer reads the configuration.
+  for (size_t index = 0; index < m_retired.size(); ++index)
+  {
+    delete m_retired[index];
+  }
+
+  delete m_current.load();
+}
+
+//  ****************************************************************************
+bool FlightConfigStore::open(const std::string &path)
+{
+  if (m_watcher.joinable())
+  {
+    return true;
+  }
+
+  m_path = path;
+
+  // Watch the directory, as editors often replace the file with a rename.
+  std::string directory = ".";
+  size_t      slash     = path.rfind('/');
+  if (slash == std::string::npos)
+  {
+    m_name = path;
+  }
+  else
+  {
+    directory = slash ? path.substr(0, slash) : std::string("/");
+    m_name    = path.substr(slash + 1);
+  }
+
+  bool is_loaded = true;
+  if (0 == ::access(path.c_str(), F_OK))
+  {
+    FlightConfig *p_config = new FlightConfig;
+    is_loaded = load_flight_config(path, *p_config);
+
+    if (is_loaded)
+    {
+      publish(p_config);
+    }
+    else
+    {
+      delete p_config;
+    }
+  }
+  else
+  {
+    cout << "The flight configuration " << path << " does not exist, using the defaults." << endl;
+  }
+
+  // The configuration remains in effect without reloads if it cannot be watched.
+  m_inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if ( m_inotify < 0
+    || ::inotify_add_watch(m_inotify, directory.c_str(), k_watch_events) < 0)
+  {
+    cout << "Warning: Could not watch the flight configuration for changes: " << strerror(errno) << endl;
+    close();
+    return is_loaded;
+  }
+
+  m_is_exit = false;
+  m_watcher = std::thread(thread_proc, this);
+
+  return is_loaded;
+}
+
+//  ****************************************************************************
+void FlightConfigStore::close()
+{
+  m_is_exit = true;
+  m_exit_event.notify();
+
+  if (m_watcher.joinable())
+  {
+    m_watcher.join();
+  }
+
+  if (m_inotify >= 0)
+  {
+    ::close(m_inotify);
+    m_inotify = -1;
+  }
+}
+
+//  ****************************************************************************
+void FlightConfigStore::thread_proc(FlightConfigStore *p_this)
+{
+  if (!p_this)
+    return;
+
+  // Parsing must never compete with the control loop for the CPU.
+  ::setpriority(PRIO_PROCESS, ::syscall(SYS_gettid), k_watcher_nice);
+
+  pollfd descs[2] =
+  {
+    { p_this->m_inotify,            POLLIN, 0 },
+    { p_this->m_exit_event.fd(),    POLLIN, 0 }
+  };
+
+  while (!p_this->m_is_exit)
+  {
+    // Only wake periodically while there are snapshots to release.
+    int timeout = p_this->m_retired.empty() ? -1 : k_reclaim_ms;
+
+    int result = ::poll(descs, 2, timeout);
+    if ( result < 0
+      && errno != EINTR)
+    {
+      cout << "The flight configuration watcher failed: " << strerror(errno) << endl;
+      break;
+    }
+
+    if (descs[1].revents & POLLIN)
+    {
+      p_this->m_exit_event.wait();
+      continue;
+    }
+
+    if (descs[0].revents & POLLIN)
+    {
+      // Several events are usually reported for a single save,
+      // the file is only reloaded once for all of them.
+      alignas(inotify_event) char buffer[4096];
+      bool    is_changed = false;
+      ssize_t len        = 0;
+
+      while ((len = ::read(p_this->m_inotify, buffer, sizeof(buffer))) > 0)
+      {
+        for (char *p_cur = buffer; p_cur < buffer + len; )
+        {
+          const inotify_event *p_event = reinterpret_cast<const inotify_event*>(p_cur);
+
+          if ( p_event->len
+            && p_this->m_name == p_event->name)
+          {
+            is_changed = true;
+          }
+
+          p_cur += sizeof(inotify_event) + p_event->len;
+        }
+      }
+
+      if (is_changed)
+      {
+        p_this->reload();
+      }
+    }
+
+    p_this->reclaim();
+  }
+}
+
+//  ****************************************************************************
+void FlightConfigStore::reload()
+{
+  FlightConfig *p_config = new FlightConfig;
+
+  if (!load_flight_config(m_path, *p_config))
+  {
+    cout << "The flight configuration was not reloaded, the current settings remain in effect." << endl;
+    delete p_config;
+    return;
+  }
+
+  publish(p_config);
+  ++m_reloads;
+
+  cout << "Reloaded the flight configuration: " << m_path << endl;
+}
+
+//  ****************************************************************************
+void FlightConfigStore::publish(const FlightConfig *p_config)
+{
+  const FlightConfig *p_prev = m_current.exchange(p_config, std::memory_order_acq_rel);
+
+  m_retired.push_back(p_prev);
+}
+
+//  ****************************************************************************
+void FlightConfigStore::reclaim()
+{
+  if (m_retired.empty())
+  {
+    return;
+  }
+
+  // The control loop cannot hold a retired snapshot once
+  // it has acquired the snapshot that is current.
+  if ( m_reader.load(std::memory_order_acquire)
+    != m_current.load(std::memory_order_relaxed))
+  {
+    return;
+  }
+
+  for (size_t index = 0; index < m_retired.size(); ++index)
+  {
+    delete m_retired[index];
+  }
+
+  m_retired.clear();
+}
@@ -0,0 +1,244 @@
+/// @file flight_config.h
+///
+/// Tuning parameters for the flight software, loaded from a file.
+///
+/// The file is parsed into an immutable snapshot. A watcher thread reloads
+/// the file whenever it changes and publishes a new snapshot with a single
+/// atomic pointer exchange. The control loop picks up the latest snapshot
+/// at the start of each cycle, without locks or allocations, and the
+/// snapshots it may still be reading are only released after it has moved
+/// on to a newer one.
+///
+/// The file holds one "name = value" setting per line. Text after a '#'
+/// is a comment. Settings that are not present keep their default values.
+/// Values are numbers, except for the filter names of the PID controllers,
+/// and the gain schedules, which are lists of numbers.
+///
+//  ****************************************************************************
+#ifndef FLIGHT_CONFIG_H_INCLUDED
+#define FLIGHT_CONFIG_H_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gain_schedule.h"
+#include "geofence.h"
+#include "hal.h"
+#include "utility/event_signal.h"
+#include "utility/filters.h"
+
+
+//  ****************************************************************************
+/// Tuning for a single PID controller.
+///
+struct PIDConfig
+{
+  float   Kp;
+  float   Ki;
+  float   Kd;
+  float   scalar;
+  float   windup_limit;           ///< radians, degrees in the file.
+  FilterConfig
+          filter;                 ///< Smooths the derivative.
+
+  NumberList
+          Kp_scale;               ///< Scales each gain at the breakpoints
+  NumberList                      ///  of the schedule, empty if the gain
+          Ki_scale;               ///  is not scheduled.
+  NumberList
+          Kd_scale;
+
+  GainTable
+          Kp_table;               ///< Prepared from the scales when loaded.
+  GainTable
+          Ki_table;
+  GainTable
+          Kd_table;
+};
+
+//  ****************************************************************************
+/// How the angle loop measures the error to the target attitude.
+///
+enum AngleError
+{
+  k_angle_error_euler,            ///< From the Tait-Bryan angles, about each axis.
+  k_angle_error_quaternion        ///< From the quaternion, as a single rotation.
+};
+
+//  ****************************************************************************
+/// An immutable snapshot of the flight configuration.
+///
+struct FlightConfig
+{
+  float       hover_level;        ///< Throttle that holds the drone at altitude.
+
+  float       motor_min;          ///< Lowest level commanded to a motor.
+  float       motor_max;          ///< Highest level commanded to a motor.
+
+  float       roll_bias;          ///< radians / second, the gyro bias
+  float       pitch_bias;         ///  the estimate starts from.
+  float       yaw_bias;
+
+  float       bias_ground_time;   ///< seconds, the time constants of the
+  float       bias_flight_time;   ///  bias estimate, zero for none.
+  float       bias_still_rate;    ///< radians / second, degrees in the file.
+
+  uint32_t    angle_divider;      ///< The angle loop runs once every
+                                  ///  angle_divider IMU samples.
+  AngleError  angle_error;
+  float       telemetry_rate;     ///< Hz, the state is reported to the ground station.
+
+  uint32_t    battery_cells;      ///< In series in the pack, zero to count them.
+  float       battery_sag;        ///< volts, the drop of the pack at full throttle.
+  float       battery_reference;  ///< volts, the resting voltage the hover level
+                                  ///  was tuned at, zero to not compensate.
+
+  HAL::IMUConfig
+              imu;                ///< Only read when the drone is initialized.
+
+  PIDConfig   roll;
+  PIDConfig   pitch;
+  PIDConfig   roll_rate;
+  PIDConfig   pitch_rate;
+  PIDConfig   yaw;
+
+  NumberList
+              schedule_throttle;  ///< Breakpoints of the normalized throttle.
+  NumberList
+              schedule_voltage;   ///< volts, breakpoints of the battery voltage.
+
+  GainSchedule
+              schedule;           ///< Prepared from the breakpoints when loaded.
+  bool        is_scheduled;       ///< Indicates a gain of any PID is scheduled.
+
+  float       geofence_radius;    ///< meters, of the cylinder around the base.
+  float       geofence_ceiling;   ///< meters above the base, zero for none.
+  NumberList
+              geofence_polygon;   ///< meters, the east and north of each vertex.
+
+  Geofence    geofence;           ///< Prepared from the limits when loaded.
+};
+
+
+//  ****************************************************************************
+/// Returns the configuration the drone uses when no file is present.
+///
+const FlightConfig& default_flight_config();
+
+//  ****************************************************************************
+/// Parses the settings in the stream over the values already in config.
+///
+/// @param p_source   Name of the source for error messages.
+///
+/// @return   true  if every setting was recognized and the result is valid.
+///           false otherwise, the contents of config are unspecified.
+///
+bool parse_flight_config(std::istream &in, const char *p_source, FlightConfig &config);
+
+//  ****************************************************************************
+/// Loads the settings in the file over the defaults.
+///
+bool load_flight_config(const std::string &path, FlightConfig &config);
+
+
+//  ****************************************************************************
+/// Publishes the flight configuration to the control loop,
+/// and reloads it when the file changes.
+///
+/// A single thread reads the configuration with acquire().
+///
+class FlightConfigStore
+{
+public:
+  //  **************************************************************************
+  FlightConfigStore();
+  ~FlightConfigStore();
+
+  FlightConfigStore(const FlightConfigStore&)             = delete;
+  FlightConfigStore& operator=(const FlightConfigStore&)  = delete;
+
+  //  **************************************************************************
+  /// Loads the file and starts the thread that reloads it as it changes.
+  /// The defaults remain in effect if the file does not exist.
+  ///
+  /// @return   false if the file could not be parsed.
+  ///
+  bool open(const std::string &path);
+
+  //  **************************************************************************
+  /// Stops watching the file. The current configuration remains in effect.
+  ///
+  void close();
+
+  //  **************************************************************************
+  /// Control loop: Returns the most recently published configuration.
+  /// The snapshot remains valid until the next call to acquire().
+  ///
+  const FlightConfig* acquire()
+  {
+    const FlightConfig *p_config = m_current.load(std::memory_order_acquire);
+
+    // Releases any older snapshot to the watcher thread.
+    m_reader.store(p_config, std::memory_order_release);
+
+    return p_config;
+  }
+
+  //  **************************************************************************
+  /// Reports the number of times the configuration has been reloaded.
+  ///
+  uint32_t reloads() const
+  {
+    return m_reloads;
+  }
+
+private:
+  //  **************************************************************************
+  std::atomic<const FlightConfig*>
+                  m_current;          ///< The most recently published snapshot.
+  std::atomic<const FlightConfig*>
+                  m_reader;           ///< The snapshot in use by the control loop.
+  std::vector<const FlightConfig*>
+                  m_retired;          ///< Replaced snapshots that may still
+                                      ///  be in use by the control loop.
+
+  std::string     m_path;             ///< The configuration file.
+  std::string     m_name;             ///< The file name within its directory.
+  int             m_inotify;          ///< Reports changes to the directory.
+  EventSignal     m_exit_event;       ///< Wakes the watcher thread to exit.
+  std::atomic_bool
+                  m_is_exit;          ///< Requests the watcher thread to exit.
+  std::thread     m_watcher;          ///< Reloads the file as it changes.
+
+  std::atomic<uint32_t>
+                  m_reloads;          ///< Count of published reloads.
+
+  //  **************************************************************************
+  //  Low-priority thread that waits for changes to the file.
+  //
+  static
+    void thread_proc(FlightConfigStore *p_this);
+
+  //  **************************************************************************
+  //  Parses the file and publishes the result if it is valid.
+  //
+  void reload();
+
+  //  **************************************************************************
+  //  Publishes a snapshot, and retires the snapshot it replaces.
+  //
+  void publish(const FlightConfig *p_config);
+
+  //  **************************************************************************
+  //  Releases the retired snapshots once the control loop
+  //  has acquired the current snapshot.
+  //
+  void reclaim();
+};
+
+
+#endif
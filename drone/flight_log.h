@@ -0,0 +1,211 @@
+/// @file flight_log.h
+///
+/// Binary format of the flight-data log written by the FlightRecorder.
+///
+/// A log file starts with a FlightLogHeader, followed by a sequence of
+/// fixed-size FlightRecords. All values are stored in the native byte order
+/// of the flight computer, which is described by the header.
+///
+/// Along with the state of each cycle, the inputs of the control loop are
+/// recorded as the loop consumes them: the IMU sample of each cycle, each
+/// command from the ground station, each change of the GPS location and
+/// each reading of the battery voltage.
+/// A cycle's inputs are recorded before its state, so qcreplay can run
+/// the flight software over the log again.
+///
+//  ****************************************************************************
+#ifndef FLIGHT_LOG_H_INCLUDED
+#define FLIGHT_LOG_H_INCLUDED
+
+#include <cstdint>
+#include <cstddef>
+
+
+//  ****************************************************************************
+const uint32_t  k_flight_log_magic      = 0x4C464351;   // "QCFL"
+const uint16_t  k_flight_log_version    = 5;
+const uint16_t  k_flight_log_byte_order = 0x0102;       // Reads as 0x0201 if swapped.
+
+
+//  ****************************************************************************
+enum FlightRecordType
+{
+  k_record_none     = 0,
+  k_record_cycle    = 1,          ///< The state of one control-loop cycle.
+  k_record_imu      = 2,          ///< The IMU sample that starts a cycle.
+  k_record_gps      = 3,          ///< A new GPS location.
+  k_record_command  = 4,          ///< A command applied by the control loop.
+  k_record_battery  = 5           ///< A reading of the battery voltage.
+};
+
+
+//  ****************************************************************************
+enum CommandRecordType
+{
+  k_command_control = 0,          ///< Stick command.
+  k_command_gain    = 1,          ///< Adjusts the gains of a PID.
+  k_command_mode    = 2           ///< Selects the control mode and axes.
+};
+
+
+//  ****************************************************************************
+struct FlightLogHeader
+{
+  uint32_t  magic;                ///< k_flight_log_magic
+  uint16_t  version;              ///< k_flight_log_version
+  uint16_t  byte_order;           ///< k_flight_log_byte_order
+  uint32_t  header_size;          ///< sizeof(FlightLogHeader)
+  uint32_t  record_size;          ///< sizeof(FlightRecord)
+  uint64_t  start_time_ns;        ///< Platform time the log was opened.
+  int64_t   start_time_utc;       ///< Wall-clock time the log was opened.
+  uint8_t   reserved[224];        ///< Pads the header to the size of a record,
+                                  ///  so no record spans two mapped chunks.
+};
+
+
+//  ****************************************************************************
+/// The state of a single PID controller for one cycle.
+///
+struct PIDRecord
+{
+  float     setpoint;
+  float     measured;
+  float     error;
+  float     integral;
+  float     derivative;
+  float     output;
+};
+
+
+//  ****************************************************************************
+/// The state of the control loop for one cycle.
+///
+struct CycleRecord
+{
+  float     throttle;
+
+  float     roll;                 ///< radians
+  float     pitch;                ///< radians
+  float     yaw;                  ///< radians
+
+  float     roll_rate;            ///< radians / second
+  float     pitch_rate;           ///< radians / second
+  float     yaw_rate;             ///< radians / second
+
+  PIDRecord roll_stabilize;
+  PIDRecord pitch_stabilize;
+  PIDRecord roll_rate_pid;
+  PIDRecord pitch_rate_pid;
+  PIDRecord rotation;
+
+  float     motor[8];             ///< Normalized motor levels.
+
+  uint8_t   is_armed;
+  uint8_t   control_mode;
+  uint8_t   is_critical;
+  uint8_t   motor_count;
+
+  float     battery_voltage;      ///< volts, the gains were scheduled for.
+};
+
+
+//  ****************************************************************************
+/// An IMU sample, as reported by the IMU.
+///
+struct IMURecord
+{
+  float     accel[3];             ///< m/s^2
+  float     gyro[3];              ///< degrees / second
+  float     mag[3];               ///< microtesla, zero when not read.
+  float     fused_TaitBryan[3];   ///< radians, see HAL::TaitBryan.
+  float     fused_quat[4];        ///< w, x, y, z
+};
+
+
+//  ****************************************************************************
+/// The GPS location read by the control loop.
+///
+struct GPSRecord
+{
+  int64_t   time_stamp;           ///< UTC seconds of the fix.
+  uint16_t  ms;
+  uint8_t   is_valid;
+  uint8_t   reserved;
+
+  double    latitude;             ///< degrees
+  double    longitude;            ///< degrees
+  double    altitude;             ///< meters
+
+  float     speed;                ///< knots
+  float     true_course;          ///< degrees
+  float     variation;            ///< degrees
+};
+
+
+//  ****************************************************************************
+/// A command from the ground station.
+///
+struct CommandRecord
+{
+  uint8_t   type;                 ///< CommandRecordType
+
+  uint8_t   pid;                  ///< The PIDType of a gain command.
+
+  uint8_t   control_mode;         ///< The ControlMode of a mode command,
+  uint8_t   use_roll;             ///  and the axes that are controlled.
+  uint8_t   use_pitch;
+  uint8_t   use_yaw;
+
+  int16_t   roll;                 ///< The sticks of a control command.
+  int16_t   pitch;
+  int16_t   yaw;
+  int16_t   thrust;
+
+  float     Kp;                   ///< The gains of a gain command.
+  float     Ki;
+  float     Kd;
+};
+
+
+//  ****************************************************************************
+/// The battery voltage read by the control loop.
+///
+struct BatteryRecord
+{
+  float     voltage;              ///< volts
+};
+
+
+//  ****************************************************************************
+const size_t k_flight_record_size = 256;
+
+
+//  ****************************************************************************
+struct FlightRecord
+{
+  uint64_t  timestamp_ns;         ///< Monotonic time of the recorded event.
+  uint32_t  sequence;             ///< Increments for each record produced,
+                                  ///  gaps indicate dropped records.
+  uint16_t  type;                 ///< FlightRecordType
+  uint16_t  reserved;
+
+  union
+  {
+    CycleRecord   cycle;
+    IMURecord     imu;
+    GPSRecord     gps;
+    CommandRecord command;
+    BatteryRecord battery;
+    uint8_t       payload[k_flight_record_size - 16];
+  };
+};
+
+
+static_assert(sizeof(FlightRecord) == k_flight_record_size,
+              "The size of FlightRecord is part of the log file format.");
+
+static_assert(sizeof(FlightLogHeader) == k_flight_record_size,
+              "The log header occupies exactly one record slot.");
+
+
+#endif
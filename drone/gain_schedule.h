@@ -0,0 +1,258 @@
+/// @file gain_schedule.h
+///
+/// Gain scheduling over the throttle and the battery voltage.
+///
+/// Each scheduled gain has a table of scale factors, at breakpoints of the
+/// normalized throttle and, optionally, of the battery voltage. The tables
+/// are prepared when the configuration is loaded: the breakpoints are padded
+/// to a fixed size and the reciprocals of their spans are calculated, so the
+/// control loop interpolates without branches or divisions.
+///
+//  ****************************************************************************
+#ifndef GAIN_SCHEDULE_H_INCLUDED
+#define GAIN_SCHEDULE_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "utility/number_list.h"
+
+
+//  ****************************************************************************
+const size_t  k_schedule_throttle_points  = 8;  ///< Most throttle breakpoints.
+const size_t  k_schedule_voltage_points   = 4;  ///< Most battery voltage breakpoints.
+const size_t  k_schedule_max_values       = k_schedule_throttle_points
+                                          * k_schedule_voltage_points;
+
+
+static_assert(k_schedule_max_values <= k_number_list_max,
+              "A list holds the factors of the largest table.");
+
+
+//  ****************************************************************************
+/// The position of the operating point within the tables.
+///
+struct SchedulePoint
+{
+  uint32_t  throttle;               ///< The breakpoint at or below the throttle.
+  uint32_t  voltage;                ///< The breakpoint at or below the voltage.
+  float     throttle_fraction;      ///< Position between the breakpoint and the next.
+  float     voltage_fraction;
+};
+
+
+//  ****************************************************************************
+/// The breakpoints along one axis of the tables.
+///
+/// An axis without breakpoints has a single breakpoint at zero,
+/// so every value is at that breakpoint.
+///
+template <size_t Capacity>
+class ScheduleAxis
+{
+public:
+  static const size_t k_capacity = Capacity;
+
+  //  **************************************************************************
+  ScheduleAxis()
+  {
+    configure(NumberList());
+  }
+
+  //  **************************************************************************
+  /// @return   false if there are too many breakpoints,
+  ///           or the breakpoints do not increase.
+  ///
+  bool configure(const NumberList &list)
+  {
+    bool is_valid = list.count <= Capacity;
+
+    m_count = (list.count > 0 && is_valid) ? list.count : 1;
+
+    for (size_t index = 0; index < Capacity; ++index)
+    {
+      // The padding is never reached, so the lookup needs no bounds.
+      m_points[index] = index < m_count
+                      ? (list.count > 0 ? list.values[index] : 0.0f)
+                      : std::numeric_limits<float>::infinity();
+      m_spans[index]  = 0.0f;
+    }
+
+    for (size_t index = 0; index + 1 < m_count; ++index)
+    {
+      float span = m_points[index + 1] - m_points[index];
+      if (!(span > 0.0f))
+      {
+        is_valid = false;
+        continue;
+      }
+
+      m_spans[index] = 1.0f / span;
+    }
+
+    return is_valid;
+  }
+
+  //  **************************************************************************
+  size_t count() const
+  {
+    return m_count;
+  }
+
+  //  **************************************************************************
+  /// Finds the breakpoint at or below the value, and the fraction of the
+  /// span to the next breakpoint. Values outside of the axis are clamped,
+  /// and NaN is treated as the first breakpoint.
+  ///
+  void locate(float value, uint32_t &index, float &fraction) const
+  {
+    float x = value > m_points[0]          ? value : m_points[0];
+    x       = x     < m_points[m_count - 1] ? x     : m_points[m_count - 1];
+
+    uint32_t at = 0;
+    for (size_t point = 1; point < Capacity; ++point)
+    {
+      at += uint32_t(x >= m_points[point]);
+    }
+
+    index     = at;
+    fraction  = (x - m_points[at]) * m_spans[at];
+  }
+
+private:
+  size_t    m_count;
+  float     m_points[Capacity];     ///< Ascending, padded with infinity.
+  float     m_spans[Capacity];      ///< The reciprocal of the span to the next point,
+                                    ///  zero for the last point.
+};
+
+
+//  ****************************************************************************
+/// The scale factors of one gain over the operating points.
+///
+class GainTable
+{
+public:
+  //  **************************************************************************
+  /// An unscheduled gain, with a scale of 1.0 everywhere.
+  ///
+  GainTable()
+  {
+    NumberList none = { 0, { } };
+    configure(none, 1, 1);
+  }
+
+  //  **************************************************************************
+  /// @param list   The scale factors, the throttle breakpoints of the first
+  ///               voltage, then those of the next, and so on. An empty list
+  ///               leaves the gain unscheduled.
+  ///
+  /// @return   false if the number of factors does not match the breakpoints,
+  ///           or a factor is negative.
+  ///
+  bool configure(const NumberList &list, size_t throttle_count, size_t voltage_count)
+  {
+    bool is_valid = list.count == 0
+                 || list.count == throttle_count * voltage_count;
+
+    for (size_t voltage = 0; voltage <= k_schedule_voltage_points; ++voltage)
+    {
+      for (size_t throttle = 0; throttle <= k_schedule_throttle_points; ++throttle)
+      {
+        // The padding repeats the last breakpoints, where the fraction is zero.
+        size_t row    = voltage  < voltage_count  ? voltage  : voltage_count  - 1;
+        size_t column = throttle < throttle_count ? throttle : throttle_count - 1;
+        size_t at     = row * throttle_count + column;
+
+        float scale = (is_valid && list.count > 0) ? list.values[at] : 1.0f;
+        is_valid    = is_valid && scale >= 0.0f;
+
+        m_scale[voltage][throttle] = scale;
+      }
+    }
+
+    m_is_scheduled = is_valid && list.count > 0;
+
+    return is_valid;
+  }
+
+  //  **************************************************************************
+  bool is_scheduled() const
+  {
+    return m_is_scheduled;
+  }
+
+  //  **************************************************************************
+  /// Interpolates the scale factor at the operating point.
+  ///
+  float lookup(const SchedulePoint &point) const
+  {
+    const float *p_low  = m_scale[point.voltage];
+    const float *p_high = m_scale[point.voltage + 1];
+
+    float low   = p_low[point.throttle]
+                + (p_low[point.throttle + 1]  - p_low[point.throttle])  * point.throttle_fraction;
+    float high  = p_high[point.throttle]
+                + (p_high[point.throttle + 1] - p_high[point.throttle]) * point.throttle_fraction;
+
+    return low + (high - low) * point.voltage_fraction;
+  }
+
+private:
+  float     m_scale[k_schedule_voltage_points + 1][k_schedule_throttle_points + 1];
+  bool      m_is_scheduled;
+};
+
+
+//  ****************************************************************************
+/// The breakpoints shared by all of the gain tables.
+///
+class GainSchedule
+{
+public:
+  //  **************************************************************************
+  /// @return   false if an axis is not valid.
+  ///
+  bool configure(const NumberList &throttle, const NumberList &voltage)
+  {
+    bool is_valid = m_throttle.configure(throttle);
+
+    return m_voltage.configure(voltage) && is_valid;
+  }
+
+  //  **************************************************************************
+  size_t throttle_count() const
+  {
+    return m_throttle.count();
+  }
+
+  //  **************************************************************************
+  size_t voltage_count() const
+  {
+    return m_voltage.count();
+  }
+
+  //  **************************************************************************
+  /// Locates the operating point, for the lookup of each table.
+  ///
+  /// @param throttle   The normalized throttle, from 0.0 to 1.0.
+  /// @param voltage    volts, the battery voltage.
+  ///
+  SchedulePoint locate(float throttle, float voltage) const
+  {
+    SchedulePoint point;
+
+    m_throttle.locate(throttle, point.throttle, point.throttle_fraction);
+    m_voltage.locate (voltage,  point.voltage,  point.voltage_fraction);
+
+    return point;
+  }
+
+private:
+  ScheduleAxis<k_schedule_throttle_points>  m_throttle;
+  ScheduleAxis<k_schedule_voltage_points>   m_voltage;
+};
+
+
+#endif
@@ -0,0 +1,246 @@
+/// @file geofence.h
+///
+/// The area the drone is allowed to fly in, around its base location.
+///
+/// The base location is projected once, when the drone is armed, as the
+/// origin of a local east-north-up tangent plane. The scale of a degree of
+/// latitude and of longitude is calculated for the origin, so each new GPS
+/// fix is converted to meters with a subtraction and a multiplication per
+/// axis. Over the few hundred meters of a geofence, the error of the flat
+/// plane is a small fraction of the error of the fix itself.
+///
+/// The area is a cylinder around the base, or a polygon of vertices in
+/// meters east and north of the base. Either has one optional ceiling,
+/// in meters above the base.
+/// The edges of the polygon are prepared when the configuration is loaded,
+/// so a position is tested without trigonometry or divisions.
+///
+//  ****************************************************************************
+#ifndef GEOFENCE_H_INCLUDED
+#define GEOFENCE_H_INCLUDED
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "utility/number_list.h"
+
+
+//  ****************************************************************************
+const size_t  k_geofence_max_vertices = k_number_list_max / 2;
+
+
+//  ****************************************************************************
+/// A position relative to the origin of a LocalFrame, in meters.
+///
+struct LocalPosition
+{
+  float     east;
+  float     north;
+  float     up;
+};
+
+
+//  ****************************************************************************
+/// A local east-north-up tangent plane, at an origin on the WGS-84 ellipsoid.
+///
+class LocalFrame
+{
+public:
+  //  **************************************************************************
+  /// A frame without an origin.
+  ///
+  LocalFrame()
+    : m_latitude(0.0)
+    , m_longitude(0.0)
+    , m_altitude(0.0)
+    , m_north_scale(0.0)
+    , m_east_scale(0.0)
+    , m_is_valid(false)
+  { }
+
+  //  **************************************************************************
+  /// Places the origin of the frame, and calculates the length of a degree
+  /// of latitude and of longitude at the origin.
+  ///
+  /// @param latitude   degrees
+  /// @param longitude  degrees
+  /// @param altitude   meters
+  ///
+  void origin(double latitude, double longitude, double altitude)
+  {
+    const double k_a        = 6378137.0;            // Semi-major axis, meters.
+    const double k_e2       = 6.69437999014e-3;     // First eccentricity squared.
+    const double k_radians  = 3.14159265358979323846 / 180.0;
+
+    double sin_lat  = std::sin(latitude * k_radians);
+    double w        = 1.0 - k_e2 * sin_lat * sin_lat;
+
+    // The radii of curvature along the meridian and the prime vertical.
+    double meridian = k_a * (1.0 - k_e2) / (w * std::sqrt(w));
+    double normal   = k_a / std::sqrt(w);
+
+    m_latitude    = latitude;
+    m_longitude   = longitude;
+    m_altitude    = altitude;
+    m_north_scale = meridian * k_radians;
+    m_east_scale  = normal   * k_radians * std::cos(latitude * k_radians);
+    m_is_valid    = true;
+  }
+
+  //  **************************************************************************
+  /// Removes the origin of the frame.
+  ///
+  void clear()
+  {
+    *this = LocalFrame();
+  }
+
+  //  **************************************************************************
+  bool is_valid() const
+  {
+    return m_is_valid;
+  }
+
+  //  **************************************************************************
+  /// Converts a location to meters from the origin.
+  ///
+  LocalPosition to_local(double latitude, double longitude, double altitude) const
+  {
+    LocalPosition position;
+    position.east   = float((longitude - m_longitude) * m_east_scale);
+    position.north  = float((latitude  - m_latitude)  * m_north_scale);
+    position.up     = float(altitude - m_altitude);
+
+    return position;
+  }
+
+private:
+  double    m_latitude;             ///< degrees, of the origin.
+  double    m_longitude;
+  double    m_altitude;             ///< meters
+  double    m_north_scale;          ///< meters / degree of latitude.
+  double    m_east_scale;           ///< meters / degree of longitude.
+  bool      m_is_valid;
+};
+
+
+//  ****************************************************************************
+/// The area around the base location that the drone may fly in.
+///
+class Geofence
+{
+public:
+  //  **************************************************************************
+  /// A cylinder of the radius, without a ceiling.
+  ///
+  explicit
+  Geofence(float radius = 20.0f)
+  {
+    NumberList none = { 0, { } };
+    configure(radius, 0.0f, none);
+  }
+
+  //  **************************************************************************
+  /// @param radius     meters, of the cylinder around the base.
+  /// @param ceiling    meters above the base, or zero for no ceiling.
+  /// @param polygon    The east and north of each vertex, in meters from the
+  ///                   base, in order around the area. A polygon replaces the
+  ///                   cylinder, and an empty list keeps the cylinder.
+  ///
+  /// @return   false if the radius or the ceiling are negative, the cylinder
+  ///           has no radius, or the polygon has fewer than 3 vertices or
+  ///           an odd count of values.
+  ///
+  bool configure(float radius, float ceiling, const NumberList &polygon)
+  {
+    bool is_valid = radius  >= 0.0f
+                 && ceiling >= 0.0f
+                 && (polygon.count > 0 || radius > 0.0f)
+                 && polygon.count % 2 == 0
+                 && polygon.count <= 2 * k_geofence_max_vertices
+                 && (polygon.count == 0 || polygon.count >= 6);
+
+    m_radius_squared  = radius * radius;
+    m_ceiling         = ceiling > 0.0f
+                      ? ceiling
+                      : std::numeric_limits<float>::infinity();
+    m_edge_count      = is_valid ? polygon.count / 2 : 0;
+
+    for (size_t index = 0; index < m_edge_count; ++index)
+    {
+      // Each vertex is joined to the next, and the last to the first.
+      size_t next = (index + 1) % m_edge_count;
+
+      Edge &edge      = m_edges[index];
+      edge.east       = polygon.values[2 * index];
+      edge.north      = polygon.values[2 * index + 1];
+      edge.end_north  = polygon.values[2 * next + 1];
+
+      // An edge along the east axis never crosses the test ray.
+      float rise      = edge.end_north - edge.north;
+      edge.run        = rise != 0.0f
+                      ? (polygon.values[2 * next] - edge.east) / rise
+                      : 0.0f;
+    }
+
+    return is_valid;
+  }
+
+  //  **************************************************************************
+  bool is_polygon() const
+  {
+    return m_edge_count > 0;
+  }
+
+  //  **************************************************************************
+  /// Indicates if the position, relative to the base, is within the area.
+  ///
+  bool contains(const LocalPosition &position) const
+  {
+    if (position.up > m_ceiling)
+    {
+      return false;
+    }
+
+    if (0 == m_edge_count)
+    {
+      return position.east  * position.east
+           + position.north * position.north <= m_radius_squared;
+    }
+
+    // Counts the edges crossed by a ray from the position toward the east.
+    bool is_inside = false;
+    for (size_t index = 0; index < m_edge_count; ++index)
+    {
+      const Edge &edge = m_edges[index];
+
+      if ( (edge.north > position.north) != (edge.end_north > position.north)
+        && position.east < edge.east + (position.north - edge.north) * edge.run)
+      {
+        is_inside = !is_inside;
+      }
+    }
+
+    return is_inside;
+  }
+
+private:
+  //  **************************************************************************
+  struct Edge
+  {
+    float   east;                   ///< The vertex that starts the edge.
+    float   north;
+    float   end_north;              ///< The north of the vertex that ends it.
+    float   run;                    ///< meters east for each meter north.
+  };
+
+  float     m_radius_squared;
+  float     m_ceiling;              ///< Infinity when there is no ceiling.
+  size_t    m_edge_count;           ///< Zero for a cylinder.
+  Edge      m_edges[k_geofence_max_vertices];
+};
+
+
+#endif
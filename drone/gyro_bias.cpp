@@ -0,0 +1,60 @@
+/// @file gyro_bias.cpp
+///
+/// Estimates the bias of each axis of the gyro.
+///
+//  ****************************************************************************
+#include "gyro_bias.h"
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+/// Returns the gain of a time constant, zero for none.
+///
+float to_gain(float time_constant)
+{
+  return time_constant > 0.0f ? 1.0f / time_constant : 0.0f;
+}
+
+}
+
+
+//  ****************************************************************************
+GyroBiasEstimator::GyroBiasEstimator()
+  : m_bias{0.0f, 0.0f, 0.0f, 0}
+  , m_seed{0.0f, 0.0f, 0.0f, 0}
+  , m_is_seeded(false)
+  , m_ground_gain(0.0f)
+  , m_flight_gain(0.0f)
+  , m_still_rate(0.0f)
+{ }
+
+//  ****************************************************************************
+void GyroBiasEstimator::configure(float ground_time, float flight_time, float still_rate)
+{
+  m_ground_gain = to_gain(ground_time);
+  m_flight_gain = to_gain(flight_time);
+  m_still_rate  = still_rate;
+}
+
+//  ****************************************************************************
+void GyroBiasEstimator::seed(float roll, float pitch, float yaw)
+{
+  if ( m_is_seeded
+    && roll  == m_seed.roll
+    && pitch == m_seed.pitch
+    && yaw   == m_seed.yaw)
+  {
+    return;
+  }
+
+  m_seed.roll   = roll;
+  m_seed.pitch  = pitch;
+  m_seed.yaw    = yaw;
+  m_is_seeded   = true;
+
+  m_bias        = m_seed;
+
+  publish();
+}
@@ -0,0 +1,151 @@
+/// @file gyro_bias.h
+///
+/// Estimates the bias of each axis of the gyro, which drifts with the
+/// temperature of the board, so the rate loop does not have to absorb it
+/// with its integrators.
+///
+/// While the drone rests on the ground, each rate it measures is the bias
+/// and noise, and the estimate follows the rates with a short time constant.
+/// In flight the rates also hold the motion of the drone, which averages
+/// out over a hover, so the estimate follows them with a time constant of
+/// a minute or more. In both, a sample is only taken as bias when every
+/// axis is within the still rate of the estimate; anything faster is
+/// motion, and is ignored.
+///
+/// An update costs three subtractions, three comparisons and three
+/// multiply-adds. The estimate starts from the biases of the configuration,
+/// which remain in effect when both time constants are zero.
+///
+//  ****************************************************************************
+#ifndef GYRO_BIAS_H_INCLUDED
+#define GYRO_BIAS_H_INCLUDED
+
+#include <cstdint>
+
+#include "utility/triple_buffer.h"
+
+
+//  ****************************************************************************
+/// The bias of each axis of the gyro.
+///
+struct GyroBias
+{
+  float     roll;                     ///< radians / second
+  float     pitch;                    ///< radians / second
+  float     yaw;                      ///< radians / second
+  uint32_t  samples;                  ///< The samples taken as bias since
+                                      ///  the estimate started.
+};
+
+
+//  ****************************************************************************
+/// Follows the bias of the gyro from the rates the control loop measures.
+///
+/// Only the control thread may update the estimate. A single other thread,
+/// such as the ground station, may take snapshots of it.
+///
+class GyroBiasEstimator
+{
+public:
+  //  **************************************************************************
+  GyroBiasEstimator();
+
+  //  **************************************************************************
+  /// @param ground_time  seconds, the time constant while on the ground,
+  ///                     zero to not update the estimate there.
+  /// @param flight_time  seconds, the time constant in flight,
+  ///                     zero to not update the estimate there.
+  /// @param still_rate   radians / second, the largest difference from the
+  ///                     estimate that is taken as bias.
+  ///
+  void configure(float ground_time, float flight_time, float still_rate);
+
+  //  **************************************************************************
+  /// Starts the estimate from the biases, unless it already started from
+  /// the same biases. A configuration that is reloaded with other biases
+  /// replaces the estimate.
+  ///
+  void seed(float roll, float pitch, float yaw);
+
+  //  **************************************************************************
+  /// Control thread: Follows the rates of a sample.
+  ///
+  /// @param roll_rate    radians / second, including the bias.
+  /// @param pitch_rate   radians / second, including the bias.
+  /// @param yaw_rate     radians / second, including the bias.
+  /// @param dt           seconds since the previous sample.
+  /// @param is_flying    Indicates the motors are turning.
+  ///
+  void update(float roll_rate, float pitch_rate, float yaw_rate, float dt, bool is_flying)
+  {
+    float gain = (is_flying ? m_flight_gain : m_ground_gain) * dt;
+    if (gain <= 0.0f)
+    {
+      return;
+    }
+
+    float roll  = roll_rate  - m_bias.roll;
+    float pitch = pitch_rate - m_bias.pitch;
+    float yaw   = yaw_rate   - m_bias.yaw;
+
+    if ( roll  > m_still_rate || roll  < -m_still_rate
+      || pitch > m_still_rate || pitch < -m_still_rate
+      || yaw   > m_still_rate || yaw   < -m_still_rate)
+    {
+      return;
+    }
+
+    m_bias.roll  += gain * roll;
+    m_bias.pitch += gain * pitch;
+    m_bias.yaw   += gain * yaw;
+    ++m_bias.samples;
+
+    publish();
+  }
+
+  //  **************************************************************************
+  /// Control thread: Returns the current estimate.
+  ///
+  const GyroBias& bias() const
+  {
+    return m_bias;
+  }
+
+  //  **************************************************************************
+  /// Takes the estimate most recently published by the control thread.
+  ///
+  /// @return   true  if the estimate changed since the last snapshot.
+  ///
+  bool snapshot(GyroBias &bias)
+  {
+    bool is_changed = m_published.acquire();
+    bias = m_published.read_buffer();
+
+    return is_changed;
+  }
+
+private:
+  //  **************************************************************************
+  //  Publishes the estimate for snapshots.
+  //
+  void publish()
+  {
+    m_published.write_buffer() = m_bias;
+    m_published.publish();
+  }
+
+  //  **************************************************************************
+  GyroBias      m_bias;               ///< The estimate of the control thread.
+  GyroBias      m_seed;               ///< The biases the estimate started from.
+  bool          m_is_seeded;
+
+  float         m_ground_gain;        ///< 1 / seconds, of the time constants.
+  float         m_flight_gain;
+  float         m_still_rate;         ///< radians / second
+
+  TripleBuffer<GyroBias>
+                m_published;          ///< Hands the estimate to snapshots.
+};
+
+
+#endif
@@ -0,0 +1,33 @@
+/// @file hal.cpp
+///
+/// Hardware abstraction layer for the devices used by the flight software.
+///
+//  ****************************************************************************
+#include "hal.h"
+
+
+namespace HAL
+{
+
+namespace // unnamed
+{
+
+Platform *g_platform = nullptr;
+
+}
+
+
+//  ****************************************************************************
+Platform& platform()
+{
+  return *g_platform;
+}
+
+//  ****************************************************************************
+void platform(Platform *p_platform)
+{
+  g_platform = p_platform;
+}
+
+
+} // namespace HAL
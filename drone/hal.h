@@ -0,0 +1,357 @@
+/// @file hal.h
+///
+/// Hardware abstraction layer for the devices used by the flight software.
+///
+/// The flight code accesses the IMU, ESCs, GPS, ADC, LEDs, clock, range
+/// finder and barometer through these interfaces. The robotics cape binding drives the actual hardware,
+/// and the software-in-the-loop simulator provides a simulated airframe.
+///
+//  ****************************************************************************
+#ifndef HAL_H_INCLUDED
+#define HAL_H_INCLUDED
+
+#include <cstdint>
+
+#include "range_ring.h"
+#include "utility/timebase.h"
+
+
+namespace HAL
+{
+
+//  ****************************************************************************
+/// Indices of the Tait-Bryan angles reported by the IMU.
+/// These match the axes of the MPU as it is mounted on the frame.
+///
+enum TaitBryan
+{
+  k_tb_pitch_x  = 0,
+  k_tb_roll_y   = 1,
+  k_tb_yaw_z    = 2
+};
+
+
+//  ****************************************************************************
+/// A single sample reported by the IMU.
+///
+struct IMUData
+{
+  float     accel[3];           ///< Acceleration in m/s^2.
+  float     gyro[3];            ///< Angular rates in degrees / second.
+  float     mag[3];             ///< Magnetic field in microtesla, zero for
+                                ///  the samples without a new reading.
+  float     fused_TaitBryan[3]; ///< Fused orientation in radians, see TaitBryan.
+  float     fused_quat[4];      ///< Fused orientation as a quaternion (w,x,y,z).
+};
+
+
+//  ****************************************************************************
+/// The source of the fused orientation.
+///
+enum IMUMode
+{
+  k_imu_dmp     = 0,            ///< Fused by the DMP of the MPU, at 200 Hz.
+  k_imu_raw     = 1             ///< The raw measurements, fused by an
+                                ///  AttitudeFilter as each is read.
+};
+
+
+//  ****************************************************************************
+/// Selects how the IMU samples and fuses its measurements.
+///
+struct IMUConfig
+{
+  IMUMode   mode;
+  uint32_t  sample_rate;        ///< Hz, of the raw measurements.
+  float     filter_Kp;          ///< Gains of the correction of the attitude
+  float     filter_Ki;          ///  filter, for the raw measurements.
+};
+
+
+//  ****************************************************************************
+/// Called each time the IMU reports a new sample.
+///
+/// @param data           The sample reported by the IMU.
+/// @param timestamp_ns   Monotonic time the sample was taken, in nanoseconds.
+///
+typedef void (*IMUHandler)(const IMUData &data, uint64_t timestamp_ns);
+
+
+//  ****************************************************************************
+/// SCHED_FIFO priority of the thread that calls the IMUHandler, on a
+/// real-time platform. The threads that consume the samples run below it.
+///
+const int k_imu_priority = 50;
+
+//  ****************************************************************************
+/// SCHED_FIFO priority of the thread that runs the transactions of the other
+/// devices on the bus of the IMU, below the threads that consume the samples.
+///
+const int k_bus_priority = k_imu_priority - 2;
+
+
+//  ****************************************************************************
+/// Source of orientation samples.
+///
+class IMU
+{
+public:
+  virtual ~IMU() { }
+
+  //  **************************************************************************
+  /// Starts the IMU. The handler is called for every sample until term().
+  ///
+  /// The samples of the raw mode are fused before they are reported,
+  /// so the handler receives the same orientation from either mode.
+  ///
+  virtual bool init(IMUHandler handler, const IMUConfig &config) = 0;
+
+  //  **************************************************************************
+  virtual void term() = 0;
+};
+
+
+//  ****************************************************************************
+/// Electronic speed controllers for the motors.
+///
+class ESC
+{
+public:
+  virtual ~ESC() { }
+
+  //  **************************************************************************
+  virtual bool init() = 0;
+  virtual void term() = 0;
+
+  //  **************************************************************************
+  /// Commands the ESC on the specified channel.
+  ///
+  /// @param channel  The 1-based channel the ESC is connected to.
+  /// @param level    Normalized pulse width, 0.0 to 1.0.
+  ///
+  /// @return 0 on success.
+  ///
+  virtual int send(int channel, double level) = 0;
+};
+
+
+//  ****************************************************************************
+/// Serial byte stream from the GPS receiver.
+///
+class GPSPort
+{
+public:
+  virtual ~GPSPort() { }
+
+  //  **************************************************************************
+  /// Path to the serial device that streams NMEA sentences from the GPS,
+  /// nullptr if the platform has no GPS receiver.
+  ///
+  virtual const char* device() const = 0;
+};
+
+
+//  ****************************************************************************
+/// Analog measurements.
+///
+class ADC
+{
+public:
+  virtual ~ADC() { }
+
+  //  **************************************************************************
+  virtual bool init() = 0;
+  virtual void term() = 0;
+
+  //  **************************************************************************
+  /// Reports the voltage of the flight computer's battery.
+  ///
+  virtual float battery_voltage() = 0;
+};
+
+
+//  ****************************************************************************
+/// Status indicators.
+///
+class LEDs
+{
+public:
+  enum LED
+  {
+    k_led_red   = 0,
+    k_led_green = 1
+  };
+
+  virtual ~LEDs() { }
+
+  //  **************************************************************************
+  virtual void set(LED led, bool is_on) = 0;
+};
+
+
+//  ****************************************************************************
+/// The time base that sensor samples are stamped with.
+///
+/// The flight code reads all of its time from the clock of the platform.
+/// The time of the flight is the platform's, which a simulated platform
+/// controls. The time the flight code takes to run is measured with the
+/// monotonic time of the processor, on every platform.
+///
+class Clock
+{
+public:
+  virtual ~Clock() { }
+
+  //  **************************************************************************
+  /// Reports the current time of the flight in nanoseconds, which stamps
+  /// the samples and the other events of the flight.
+  ///
+  virtual uint64_t now_ns() const = 0;
+
+  //  **************************************************************************
+  /// Reports the monotonic time of the processor in nanoseconds, which
+  /// measures how long the flight code takes to run.
+  ///
+  virtual uint64_t monotonic_ns() const
+  {
+    return timestamp_ns();
+  }
+};
+
+
+//  ****************************************************************************
+/// CLOCK_MONOTONIC, the clock of a platform that flies in real time.
+///
+class MonotonicClock
+  : public Clock
+{
+public:
+  uint64_t now_ns() const
+  {
+    return timestamp_ns();
+  }
+};
+
+
+//  ****************************************************************************
+/// The ultrasonic range finder, measured by a PRU program.
+///
+class RangeFinder
+{
+public:
+  virtual ~RangeFinder() { }
+
+  //  **************************************************************************
+  /// Starts the PRU program that measures the range.
+  ///
+  /// @param delay_ms   milliseconds between samples.
+  ///
+  /// @return The ring the samples are written to,
+  ///         nullptr if the program did not start.
+  ///
+  virtual volatile RangeShared* init(uint32_t delay_ms) = 0;
+
+  //  **************************************************************************
+  virtual void term() = 0;
+};
+
+
+//  ****************************************************************************
+/// A sample of the barometer.
+///
+struct BaroData
+{
+  float     altitude;           ///< meters, above sea level.
+  float     temperature;        ///< degrees Celsius.
+  float     pressure;           ///< pascals.
+};
+
+
+//  ****************************************************************************
+/// The barometer, which shares the I2C bus of the IMU.
+///
+class Barometer
+{
+public:
+  virtual ~Barometer() { }
+
+  //  **************************************************************************
+  /// Starts the barometer. It must be started before the IMU, and is then
+  /// read between the samples of the IMU.
+  ///
+  virtual bool init() = 0;
+
+  //  **************************************************************************
+  /// Stops the barometer, after the IMU was stopped.
+  ///
+  virtual void term() = 0;
+
+  //  **************************************************************************
+  /// Takes the most recent sample.
+  ///
+  /// @return true if the barometer was read since the last call.
+  ///
+  virtual bool read(BaroData &data) = 0;
+};
+
+
+//  ****************************************************************************
+/// Provides each of the devices for a single target.
+///
+class Platform
+{
+public:
+  virtual ~Platform() { }
+
+  //  **************************************************************************
+  virtual IMU&      imu()   = 0;
+  virtual ESC&      esc()   = 0;
+  virtual GPSPort&  gps()   = 0;
+  virtual ADC&      adc()   = 0;
+  virtual LEDs&     leds()  = 0;
+  virtual Clock&    clock() = 0;
+
+  //  **************************************************************************
+  /// Returns the range finder, nullptr if the platform has none.
+  ///
+  virtual RangeFinder* range_finder()
+  {
+    return nullptr;
+  }
+
+  //  **************************************************************************
+  /// Returns the barometer, nullptr if the platform has none.
+  ///
+  virtual Barometer* barometer()
+  {
+    return nullptr;
+  }
+
+  //  **************************************************************************
+  /// Indicates the IMU reports samples from its own interrupt thread,
+  /// and the control loop should run on a dedicated real-time thread.
+  ///
+  /// Platforms that return false expect the owner to step the control loop
+  /// after each sample, i.e. Drone::step().
+  ///
+  virtual bool is_realtime() const = 0;
+};
+
+
+//  ****************************************************************************
+/// Returns the platform the flight software is running on.
+/// A platform must be installed before any devices are accessed.
+///
+Platform& platform();
+
+//  ****************************************************************************
+/// Installs the platform the flight software runs on.
+/// The platform must remain valid until the flight software is terminated.
+///
+void platform(Platform *p_platform);
+
+
+} // namespace HAL
+
+
+#endif
@@ -0,0 +1,269 @@
+/// @file i2c_arbiter.cpp
+///
+/// Shares the I2C bus of the IMU with the slower sensors on the same bus.
+///
+//  ****************************************************************************
+#include "i2c_arbiter.h"
+#include "utility/timebase.h"
+
+#include <iomanip>
+#include <iostream>
+
+#include <pthread.h>
+#include <sched.h>
+
+
+using std::cout;
+using std::endl;
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+double to_us(uint64_t value_ns)
+{
+  return value_ns / 1000.0;
+}
+
+}
+
+
+//  ****************************************************************************
+I2CArbiter::I2CArbiter(HAL::Clock &clock)
+  : m_clock(clock)
+  , m_ns_per_bit(0)
+  , m_period_ns(0)
+  , m_guard_ns(0)
+  , m_queue{}
+  , m_count(0)
+  , m_first_ns(0)
+  , m_last_ns(0)
+  , m_periods(0)
+  , m_imu_ns(0)
+  , m_queued_ns(0)
+  , m_granted(0)
+  , m_deferred(0)
+  , m_late(0)
+  , m_rejected(0)
+  , m_max_wait_ns(0)
+  , m_is_exit(false)
+{
+  configure(400000, 5 * k_ns_per_ms, 500 * k_ns_per_us);
+}
+
+//  ****************************************************************************
+I2CArbiter::~I2CArbiter()
+{
+  stop();
+}
+
+//  ****************************************************************************
+void I2CArbiter::configure(uint32_t clock_hz, uint64_t period_ns, uint64_t guard_ns)
+{
+  m_ns_per_bit  = clock_hz > 0 ? k_ns_per_s / clock_hz : 0;
+  m_period_ns   = period_ns;
+  m_guard_ns    = guard_ns;
+}
+
+//  ****************************************************************************
+bool I2CArbiter::submit(uint32_t bytes, uint64_t due_ns, Handler handler, void *p_context)
+{
+  if (m_count == k_queue_capacity)
+  {
+    increment(m_rejected);
+    return false;
+  }
+
+  Transaction &transaction = m_queue[m_count++];
+
+  transaction.bytes     = bytes;
+  transaction.due_ns    = due_ns;
+  transaction.handler   = handler;
+  transaction.p_context = p_context;
+
+  return true;
+}
+
+//  ****************************************************************************
+size_t I2CArbiter::interrupt(uint64_t interrupt_ns)
+{
+  return run(interrupt_ns, m_clock.now_ns());
+}
+
+//  ****************************************************************************
+bool I2CArbiter::start(int priority)
+{
+  if (!m_event.is_valid())
+  {
+    cout << "Error: Could not create the event of the I2C bus thread." << endl;
+    return false;
+  }
+
+  m_is_exit = false;
+  m_thread  = std::thread(thread_proc, this);
+
+  sched_param param = {0};
+  param.sched_priority = priority;
+
+  if (0 != pthread_setschedparam(m_thread.native_handle(),
+                                 SCHED_FIFO,
+                                 &param))
+  {
+    cout << "Warning: Could not set the real-time priority of the I2C bus thread." << endl;
+  }
+
+  return m_thread.joinable();
+}
+
+//  ****************************************************************************
+void I2CArbiter::stop()
+{
+  if (m_thread.joinable())
+  {
+    m_is_exit = true;
+    m_event.notify();
+    m_thread.join();
+  }
+}
+
+//  ****************************************************************************
+void I2CArbiter::notify(uint64_t interrupt_ns)
+{
+  Window &window = m_windows.write_buffer();
+
+  window.interrupt_ns = interrupt_ns;
+  window.read_ns      = m_clock.now_ns();
+
+  m_windows.publish();
+  m_event.notify();
+}
+
+//  ****************************************************************************
+void I2CArbiter::thread_proc(I2CArbiter *p_this)
+{
+  while (!p_this->m_is_exit)
+  {
+    uint64_t signals = p_this->m_event.wait_for(k_wait_timeout_ms);
+    if (p_this->m_is_exit)
+    {
+      break;
+    }
+
+    // Only the most recent interrupt is run, an earlier window has passed.
+    if ( signals > 0
+      && p_this->m_windows.acquire())
+    {
+      const Window &window = p_this->m_windows.read_buffer();
+      p_this->run(window.interrupt_ns, window.read_ns);
+    }
+  }
+}
+
+//  ****************************************************************************
+size_t I2CArbiter::run(uint64_t interrupt_ns, uint64_t read_ns)
+{
+  uint64_t now_ns   = m_clock.now_ns();
+  uint64_t next_ns  = interrupt_ns + m_period_ns;
+
+  if (0 == m_periods.load(std::memory_order_relaxed))
+  {
+    m_first_ns.store(interrupt_ns, std::memory_order_relaxed);
+  }
+
+  m_last_ns.store(interrupt_ns, std::memory_order_relaxed);
+  increment(m_periods);
+  increment(m_imu_ns, read_ns > interrupt_ns ? read_ns - interrupt_ns : 0);
+
+  size_t count = 0;
+  size_t index = 0;
+
+  while (index < m_count)
+  {
+    Transaction transaction = m_queue[index];
+
+    if (transaction.due_ns > now_ns)
+    {
+      ++index;
+      continue;
+    }
+
+    // The oldest due transaction goes first, so a long transaction is not
+    // starved by the short ones that fit around it.
+    if (now_ns + duration_ns(transaction.bytes) + m_guard_ns > next_ns)
+    {
+      increment(m_deferred);
+      break;
+    }
+
+    --m_count;
+    for (size_t move = index; move < m_count; ++move)
+    {
+      m_queue[move] = m_queue[move + 1];
+    }
+
+    if (now_ns - transaction.due_ns > m_max_wait_ns.load(std::memory_order_relaxed))
+    {
+      m_max_wait_ns.store(now_ns - transaction.due_ns, std::memory_order_relaxed);
+    }
+
+    transaction.handler(transaction.p_context);
+
+    uint64_t end_ns = m_clock.now_ns();
+
+    increment(m_queued_ns, end_ns - now_ns);
+    increment(m_granted);
+
+    if (end_ns > next_ns)
+    {
+      increment(m_late);
+    }
+
+    now_ns = end_ns;
+    ++count;
+
+    // The handler may have queued another transaction.
+    index = 0;
+  }
+
+  return count;
+}
+
+//  ****************************************************************************
+float I2CArbiter::utilization() const
+{
+  uint64_t elapsed_ns = m_last_ns.load(std::memory_order_relaxed)
+                      - m_first_ns.load(std::memory_order_relaxed)
+                      + m_period_ns;
+  uint64_t busy_ns    = m_imu_ns.load(std::memory_order_relaxed)
+                      + m_queued_ns.load(std::memory_order_relaxed);
+
+  return 0 == m_periods.load(std::memory_order_relaxed)
+       ? 0.0f
+       : float(double(busy_ns) / double(elapsed_ns));
+}
+
+//  ****************************************************************************
+void I2CArbiter::report(std::ostream &out) const
+{
+  std::ios::fmtflags  flags     = out.flags();
+  std::streamsize     precision = out.precision();
+
+  uint64_t periods  = m_periods.load(std::memory_order_relaxed);
+  double   per      = periods ? 1.0 / periods : 0.0;
+
+  out << std::fixed << std::setprecision(1)
+      << "I2C bus: " << 100.0f * utilization() << "% busy over "
+      << periods << " periods"
+      << ", IMU " << to_us(m_imu_ns.load(std::memory_order_relaxed)) * per << " us"
+      << " and queued " << to_us(m_queued_ns.load(std::memory_order_relaxed)) * per
+      << " us per period.\n"
+      << "  " << granted() << " transactions, "
+      << deferred() << " deferred periods, "
+      << late() << " late, "
+      << rejected() << " rejected, "
+      << "waited at most " << to_us(m_max_wait_ns.load(std::memory_order_relaxed)) << " us.\n";
+
+  out.flags(flags);
+  out.precision(precision);
+}
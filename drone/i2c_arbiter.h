@@ -0,0 +1,216 @@
+/// @file i2c_arbiter.h
+///
+/// Shares the I2C bus of the IMU with the slower sensors on the same bus,
+/// such as the barometer.
+///
+/// The IMU owns the bus right after each of its interrupts, while its
+/// samples are read. The other sensors queue their transactions, and each
+/// transaction runs in the idle time that follows, only if it is expected
+/// to end a guard time before the next interrupt. A transaction that does
+/// not fit waits for the idle time of a later period, so the reads of the
+/// IMU are never delayed by another sensor.
+///
+/// Every transaction runs on a single thread, between the reads of the IMU,
+/// so the devices never address the bus at the same time. An IMU that reads
+/// its samples on its own thread runs the transactions there. An IMU that
+/// reports from an interrupt callback only notifies the arbiter, and the bus
+/// thread runs them in the same window, so the callback never blocks on
+/// the bus.
+///
+//  ****************************************************************************
+#ifndef I2C_ARBITER_H_INCLUDED
+#define I2C_ARBITER_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <thread>
+
+#include "hal.h"
+#include "utility/counter.h"
+#include "utility/event_signal.h"
+#include "utility/triple_buffer.h"
+
+
+//  ****************************************************************************
+/// Schedules the transactions of the slower sensors between the reads of
+/// the IMU.
+///
+/// Once the IMU is started, only the thread that runs the transactions may
+/// submit them: the bus thread while it runs, otherwise the thread that
+/// reads the IMU. Reports may be generated from any thread.
+///
+class I2CArbiter
+{
+public:
+  //  **************************************************************************
+  /// Performs a queued transaction on the bus.
+  ///
+  typedef void (*Handler)(void *p_context);
+
+  //  **************************************************************************
+  static const
+    size_t    k_queue_capacity  = 8;
+
+  static const
+    uint32_t  k_address_bytes   = 3;  ///< The device address, the register,
+                                      ///  and the device address again to read.
+  static const
+    uint32_t  k_bits_per_byte   = 9;  ///< With the acknowledge.
+
+  static const
+    uint64_t  k_setup_ns        = 20000;  ///< Of the driver, per transaction.
+
+  static const
+    int       k_wait_timeout_ms = 100;    ///< Of the bus thread, to check for exit.
+
+  //  **************************************************************************
+  I2CArbiter(HAL::Clock &clock);
+  ~I2CArbiter();
+
+  I2CArbiter(const I2CArbiter&)             = delete;
+  I2CArbiter& operator=(const I2CArbiter&)  = delete;
+
+  //  **************************************************************************
+  /// @param clock_hz   of the bus.
+  /// @param period_ns  between the interrupts of the IMU.
+  /// @param guard_ns   left idle before each expected interrupt.
+  ///
+  void configure(uint32_t clock_hz, uint64_t period_ns, uint64_t guard_ns);
+
+  //  **************************************************************************
+  /// Returns the nanoseconds expected to transfer the bytes of a transaction.
+  ///
+  uint64_t duration_ns(uint32_t bytes) const
+  {
+    return (bytes + k_address_bytes) * k_bits_per_byte * m_ns_per_bit + k_setup_ns;
+  }
+
+  //  **************************************************************************
+  /// Queues a transaction, to run in an idle window no sooner than due_ns.
+  ///
+  /// @param bytes      transferred by the handler, to estimate its duration.
+  ///
+  /// @return false if the queue is full.
+  ///
+  bool submit(uint32_t bytes, uint64_t due_ns, Handler handler, void *p_context);
+
+  //  **************************************************************************
+  /// Called by the thread that reads the IMU, once it was read after an
+  /// interrupt. Records the time the read took, and runs the due
+  /// transactions that fit before the next interrupt, oldest first.
+  ///
+  /// @param interrupt_ns   monotonic time of the interrupt.
+  ///
+  /// @return The number of transactions that ran.
+  ///
+  size_t interrupt(uint64_t interrupt_ns);
+
+  //  **************************************************************************
+  /// Starts the bus thread, which runs the transactions after each notified
+  /// interrupt.
+  ///
+  /// @param priority   SCHED_FIFO priority of the thread.
+  ///
+  /// @return false if the thread could not be started.
+  ///
+  bool start(int priority);
+
+  //  **************************************************************************
+  /// Stops the bus thread, once its transaction ends.
+  ///
+  void stop();
+
+  //  **************************************************************************
+  /// Called from the interrupt callback of the IMU once its sample was read.
+  /// Records the window of the interrupt and wakes the bus thread, which
+  /// runs interrupt() for it. Does not block.
+  ///
+  /// @param interrupt_ns   monotonic time of the interrupt.
+  ///
+  void notify(uint64_t interrupt_ns);
+
+  //  **************************************************************************
+  uint64_t  periods()   const { return m_periods.load(std::memory_order_relaxed);  }
+  uint64_t  granted()   const { return m_granted.load(std::memory_order_relaxed);  }
+  uint64_t  deferred()  const { return m_deferred.load(std::memory_order_relaxed); }
+  uint64_t  late()      const { return m_late.load(std::memory_order_relaxed);     }
+  uint64_t  rejected()  const { return m_rejected.load(std::memory_order_relaxed); }
+
+  //  **************************************************************************
+  /// Returns the share of the time between the first and the most recent
+  /// interrupt that the bus was busy.
+  ///
+  float utilization() const;
+
+  //  **************************************************************************
+  /// Writes a human readable summary of the use of the bus.
+  ///
+  void report(std::ostream &out) const;
+
+private:
+  //  **************************************************************************
+  struct Transaction
+  {
+    uint32_t  bytes;
+    uint64_t  due_ns;
+    Handler   handler;
+    void     *p_context;
+  };
+
+  //  **************************************************************************
+  /// The period of an interrupt, from the interrupt to the end of the read.
+  ///
+  struct Window
+  {
+    uint64_t  interrupt_ns;
+    uint64_t  read_ns;
+  };
+
+  //  **************************************************************************
+  typedef std::atomic<uint64_t>   counter_t;
+
+  //  **************************************************************************
+  //  Runs the due transactions that fit in the window of an interrupt.
+  //
+  size_t run(uint64_t interrupt_ns, uint64_t read_ns);
+
+  //  **************************************************************************
+  //  Runs the transactions after each interrupt that is notified.
+  //
+  static
+    void thread_proc(I2CArbiter *p_this);
+
+  //  **************************************************************************
+  HAL::Clock   &m_clock;
+  uint64_t      m_ns_per_bit;
+  uint64_t      m_period_ns;
+  uint64_t      m_guard_ns;
+
+  Transaction   m_queue[k_queue_capacity];
+  size_t        m_count;              ///< Queued, oldest first.
+
+  counter_t     m_first_ns;           ///< Of the first interrupt.
+  counter_t     m_last_ns;            ///< Of the most recent interrupt.
+
+  counter_t     m_periods;
+  counter_t     m_imu_ns;             ///< Busy reading the IMU.
+  counter_t     m_queued_ns;          ///< Busy with the queued transactions.
+  counter_t     m_granted;
+  counter_t     m_deferred;           ///< Periods a due transaction did not fit.
+  counter_t     m_late;               ///< Transactions that ended after the
+                                      ///  next interrupt was expected.
+  counter_t     m_rejected;           ///< Submitted to a full queue.
+  counter_t     m_max_wait_ns;        ///< From due until run.
+
+  TripleBuffer<Window>
+                m_windows;            ///< Hands the interrupts to the bus thread.
+  EventSignal   m_event;
+  std::thread   m_thread;
+  std::atomic_bool
+                m_is_exit;            ///< Requests the bus thread to exit.
+};
+
+
+#endif
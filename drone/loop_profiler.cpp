@@ -0,0 +1,105 @@
+/// @file loop_profiler.cpp
+///
+/// Latency and jitter measurements for each stage of the control loop.
+///
+//  ****************************************************************************
+#include "loop_profiler.h"
+
+#include <iomanip>
+#include <ostream>
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+uint32_t to_uint32_ns(uint64_t value)
+{
+  return value > UINT32_MAX
+         ? UINT32_MAX
+         : uint32_t(value);
+}
+
+//  ****************************************************************************
+double to_us(uint64_t value_ns)
+{
+  return value_ns / 1000.0;
+}
+
+}
+
+
+//  ****************************************************************************
+const char* to_string(LoopStage stage)
+{
+  switch (stage)
+  {
+  case k_stage_period:    return "period";
+  case k_stage_wake:      return "wake";
+  case k_stage_stabilize: return "stabilize";
+  case k_stage_rate:      return "rate";
+  case k_stage_plant:     return "plant";
+  case k_stage_total:     return "total";
+  default:                return "unknown";
+  }
+}
+
+
+//  ****************************************************************************
+LoopProfiler::LoopProfiler()
+{ }
+
+//  ****************************************************************************
+void LoopProfiler::snapshot(LoopStats &stats) const
+{
+  stats.count = k_stage_count;
+
+  for (int index = 0; index < k_stage_count; ++index)
+  {
+    const LatencyHistogram &hist  = m_stages[index];
+    LoopStageStats         &stage = stats.stage[index];
+
+    stage.stage     = uint8_t(index);
+    stage.count     = hist.count();
+    stage.overruns  = hist.overruns();
+    stage.min_ns    = to_uint32_ns(hist.min());
+    stage.p50_ns    = to_uint32_ns(hist.percentile(0.50));
+    stage.p99_ns    = to_uint32_ns(hist.percentile(0.99));
+    stage.p999_ns   = to_uint32_ns(hist.percentile(0.999));
+    stage.max_ns    = to_uint32_ns(hist.max());
+  }
+}
+
+//  ****************************************************************************
+void LoopProfiler::report(std::ostream &out) const
+{
+  std::ios::fmtflags flags = out.flags();
+
+  out << "Control loop timing (us):\n"
+      << std::setw(10) << "stage"
+      << std::setw(10) << "count"
+      << std::setw(10) << "overruns"
+      << std::setw(10) << "min"
+      << std::setw(10) << "p50"
+      << std::setw(10) << "p99"
+      << std::setw(10) << "p99.9"
+      << std::setw(10) << "max" << "\n";
+
+  out << std::fixed << std::setprecision(1);
+
+  for (int index = 0; index < k_stage_count; ++index)
+  {
+    const LatencyHistogram &hist = m_stages[index];
+
+    out << std::setw(10) << to_string(LoopStage(index))
+        << std::setw(10) << hist.count()
+        << std::setw(10) << hist.overruns()
+        << std::setw(10) << to_us(hist.min())
+        << std::setw(10) << to_us(hist.percentile(0.50))
+        << std::setw(10) << to_us(hist.percentile(0.99))
+        << std::setw(10) << to_us(hist.percentile(0.999))
+        << std::setw(10) << to_us(hist.max()) << "\n";
+  }
+
+  out.flags(flags);
+}
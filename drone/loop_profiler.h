@@ -0,0 +1,74 @@
+/// @file loop_profiler.h
+///
+/// Latency and jitter measurements for each stage of the control loop.
+///
+//  ****************************************************************************
+#ifndef LOOP_PROFILER_H_INCLUDED
+#define LOOP_PROFILER_H_INCLUDED
+
+#include <cstdint>
+#include <iosfwd>
+
+#include "qc_msg.h"
+#include "utility/histogram.h"
+
+
+//  ****************************************************************************
+/// Collects a latency histogram for each LoopStage of the control loop.
+///
+/// Measurements are recorded by the control thread only. Snapshots and
+/// reports may be generated from any thread while the loop is running.
+///
+class LoopProfiler
+{
+public:
+  //  **************************************************************************
+  LoopProfiler();
+
+  //  **************************************************************************
+  /// Records the duration of a stage, in nanoseconds.
+  ///
+  void record(LoopStage stage, uint64_t duration_ns)
+  {
+    m_stages[stage].record(duration_ns);
+  }
+
+  //  **************************************************************************
+  /// Sets the time allowed for a stage before it is counted as an overrun.
+  ///
+  void budget(LoopStage stage, uint64_t budget_ns)
+  {
+    m_stages[stage].budget(budget_ns);
+  }
+
+  //  **************************************************************************
+  /// Returns the histogram that records the specified stage.
+  ///
+  const LatencyHistogram& histogram(LoopStage stage) const
+  {
+    return m_stages[stage];
+  }
+
+  //  **************************************************************************
+  /// Summarizes each stage for the loop statistics telemetry message.
+  ///
+  void snapshot(LoopStats &stats) const;
+
+  //  **************************************************************************
+  /// Writes a human readable summary of each stage.
+  ///
+  void report(std::ostream &out) const;
+
+private:
+  //  **************************************************************************
+  LatencyHistogram  m_stages[k_stage_count];
+};
+
+
+//  ****************************************************************************
+/// Returns a short display name for the stage.
+///
+const char* to_string(LoopStage stage);
+
+
+#endif
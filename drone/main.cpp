@@ -7,6 +7,7 @@
 #include "drone.h"
 #include "qcrecv.h"
 #include "beacon.h"
+#include "rc_platform.h"
 
 #include "utility/robotics.h"
 #include <stdlib.h>
@@ -16,7 +17,14 @@ using std::endl;
 
 
 //  ****************************************************************************
-const unsigned int k_sample_rate_ms = 250;
+const unsigned int k_poll_rate_ms = 10;       ///< The state is reported at the
+                                              ///  telemetry rate of the control
+                                              ///  loop, checked every 10ms.
+const unsigned int k_loop_stats_rate = 4;     ///< Loop statistics are reported
+                                              ///  once every 4 state reports.
+const unsigned int k_watchdog_polls  = 100;   ///< The watchdog is reported once
+                                              ///  a second, even after the
+                                              ///  telemetry has been stopped.
 
 //  ****************************************************************************
 void set_system_state(rc_state_t state)
@@ -66,6 +74,10 @@ void clear_error()
 //  ****************************************************************************
 int main()
 {
+  // The flight software runs on the robotics cape.
+  HAL::RCPlatform platform;
+  HAL::platform(&platform);
+
   Drone drone;
 
   cout << "Drone Control Entry Point:\n\n"; 
@@ -121,16 +133,36 @@ int main()
   rc_make_pid_file();
 
   StartListening(&drone);
+
+  unsigned int report_count = 0;
+  unsigned int poll_count   = 0;
+  DroneState   state;
   while ( EXITING != rc_get_state()
        && IsListening())
   {
-    // Report state to the controller.
-    DroneState state = drone.state();
-    ReportDroneState(state);
-
-    // Wait the specified delay before requesting next data 
+    // Report each state published by the control loop to the controller.
+    if (drone.telemetry(state))
+    {
+      ReportDroneState(state);
+
+      if (0 == (++report_count % k_loop_stats_rate))
+      {
+        LoopStats stats;
+        drone.loop_profiler().snapshot(stats);
+        ReportLoopStats(stats);
+      }
+    }
+
+    if (0 == (++poll_count % k_watchdog_polls))
+    {
+      WatchdogStats stats;
+      drone.watchdog().snapshot(stats);
+      ReportWatchdogStats(stats);
+    }
+
+    // Wait the specified delay before checking for the next state.
     // Convert the units to microseconds.
-    usleep(k_sample_rate_ms * 1000); 
+    usleep(k_poll_rate_ms * 1000); 
   }
 
   set_system_state(EXITING);
@@ -139,6 +171,11 @@ int main()
 
   HaltListening();
 
+  drone.loop_profiler().report(cout);
+  drone.scheduler().report(cout);
+  drone.watchdog().report(cout);
+  platform.bus().report(cout);
+
   cout << "Terminating Drone Control Application.\n\n"; 
   cout.flush();
 
@@ -0,0 +1,83 @@
+/// @file mixer.cpp
+///
+/// Distributes the roll, pitch and yaw commands across the motors of the frame.
+///
+//  ****************************************************************************
+#include "mixer.h"
+
+
+//  Mixer tables ***************************************************************
+constexpr float QuadFrame::k_roll[QuadFrame::k_table_size];
+constexpr float QuadFrame::k_pitch[QuadFrame::k_table_size];
+constexpr float QuadFrame::k_yaw[QuadFrame::k_table_size];
+
+constexpr float HexFrame::k_roll[HexFrame::k_table_size];
+constexpr float HexFrame::k_pitch[HexFrame::k_table_size];
+constexpr float HexFrame::k_yaw[HexFrame::k_table_size];
+
+constexpr float OctoFrame::k_roll[OctoFrame::k_table_size];
+constexpr float OctoFrame::k_pitch[OctoFrame::k_table_size];
+constexpr float OctoFrame::k_yaw[OctoFrame::k_table_size];
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+template <typename Frame, typename Arithmetic>
+MixerTable make_table(FrameType type)
+{
+  MixerTable table =
+  {
+    type,
+    Frame::k_motor_count,
+    Frame::k_roll,
+    Frame::k_pitch,
+    Frame::k_yaw,
+    &Mixer<Frame, Arithmetic>::mix
+  };
+
+  return table;
+}
+
+//  ****************************************************************************
+template <typename Arithmetic>
+struct Mixers
+{
+  static const MixerTable k_tables[];
+};
+
+template <typename Arithmetic>
+const MixerTable Mixers<Arithmetic>::k_tables[] =
+{
+  make_table<QuadFrame, Arithmetic>(k_frame_quad),
+  make_table<HexFrame,  Arithmetic>(k_frame_hex),
+  make_table<OctoFrame, Arithmetic>(k_frame_octo)
+};
+
+}
+
+
+//  ****************************************************************************
+template <typename Arithmetic>
+const MixerTable& mixer_table(FrameType type)
+{
+  const MixerTable *p_tables = Mixers<Arithmetic>::k_tables;
+
+  switch (type)
+  {
+  case k_frame_quad:  return p_tables[0];
+  case k_frame_octo:  return p_tables[2];
+  case k_frame_hex:
+  default:            return p_tables[1];
+  }
+}
+
+template const MixerTable& mixer_table<FloatArithmetic>(FrameType type);
+template const MixerTable& mixer_table<FixedArithmetic>(FrameType type);
+
+//  ****************************************************************************
+const MixerTable& mixer_table(FrameType type)
+{
+  return mixer_table<ControlArithmetic>(type);
+}
@@ -0,0 +1,635 @@
+/// @file mixer.h
+///
+/// Distributes the roll, pitch and yaw commands across the motors of the frame.
+///
+/// Each frame geometry is a set of compile-time coefficient tables, one per
+/// control axis. The mixer is generated for a geometry with every motor
+/// unrolled, and the geometry in use is selected with a single indirect call.
+///
+/// Where SSE2 or NEON is available, four motors are mixed at a time.
+/// The SSE2 and AArch64 paths produce results that are bit-identical to the
+/// scalar mixer. The NEON unit of ARMv7 flushes denormals to zero, so its
+/// levels are identical unless a value falls below FLT_MIN, and then differ
+/// by less than k_mixer_tolerance. Define MIXER_NO_SIMD to build the scalar
+/// mixer only.
+///
+/// A mixer with FixedArithmetic calculates in fixed point, and does not
+/// divide.
+///
+//  ****************************************************************************
+#ifndef MIXER_H_INCLUDED
+#define MIXER_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "control_arithmetic.h"
+#include "utility/unroll.h"
+
+#if !defined(MIXER_NO_SIMD)
+# if defined(__SSE2__)
+#   include <xmmintrin.h>
+#   define MIXER_USE_SSE
+# elif defined(__aarch64__) || defined(__ARM_NEON__)
+#   include <arm_neon.h>
+#   define MIXER_USE_NEON
+# endif
+#endif
+
+// The frame geometry that is flown unless the drone selects another.
+#ifndef QC_FRAME_TYPE
+# define QC_FRAME_TYPE    k_frame_hex
+#endif
+
+
+//  ****************************************************************************
+/// The supported frame configurations.
+///
+enum FrameType
+{
+  k_frame_quad,
+  k_frame_hex,
+  k_frame_octo
+};
+
+//  ****************************************************************************
+const size_t  k_mixer_lanes     = 4;    ///< Motors mixed in each vector.
+const size_t  k_mixer_max_table = 8;    ///< Largest table over all frames.
+
+#if defined(MIXER_USE_NEON) && !defined(__aarch64__)
+const float   k_mixer_tolerance = 1e-30f; ///< Largest difference from the scalar
+                                          ///  mixer, from the flushed denormals.
+#else
+const float   k_mixer_tolerance = 0.0f;
+#endif
+
+
+//  ****************************************************************************
+// Each table holds the share of the command that each motor provides
+// for the control axis. The tables are padded to a multiple of the
+// vector width by repeating the first motor, which leaves the lowest
+// and highest levels of the frame unchanged.
+//
+// Where the caret is the forward face of the drone,
+// the orientation of the motors are as follows:
+//
+// 4-motor configuration
+//
+//    A ^ B
+//    D   C
+//
+// The rules break-down grouping each motor into
+// one of two sets, positive or negative. For each
+// command, a balanced number of motors should be assigned
+// to each set:
+//
+//          +     -
+// Roll:  (A,D) (B,C)
+// Pitch: (A,B) (C,D)
+// Yaw:   (A,C) (B,D)
+//
+struct QuadFrame
+{
+  static const size_t k_motor_count = 4;
+  static const size_t k_table_size  = 4;
+
+  // cosf(k_pi_4), sinf(k_pi_4) and k_ratio_limit for each arm.
+  // Arms A: 45, B: 315, C: 225, D: 135 degrees.
+  //
+  // The roll and pitch tables reproduce the coefficients of the original
+  // quad table, which are positive on every arm. The signs of the rules
+  // above are not applied to them, only to the yaw table. Changing them
+  // changes how the quad flies, and its tuning.
+  static constexpr float k_roll[k_table_size] =
+    { 0.707106769f, 0.707106769f, 0.707106769f, 0.707106769f };
+
+  static constexpr float k_pitch[k_table_size] =
+    { 0.707106769f, 0.707106769f, 0.707106769f, 0.707106769f };
+
+  static constexpr float k_yaw[k_table_size] =
+    { 0.5f, -0.5f, 0.5f, -0.5f };
+};
+
+//  ****************************************************************************
+// 6-motor configuration
+//
+//           0 deg
+//        F    A
+// 90   E   ^^   B  270
+//        D    C
+//          180
+//
+//          +     -
+// Roll:  (D,E,F) (A,B,C)
+// Pitch: (A,F)   (C,D)
+// Yaw:   (B,D,F) (A,C,E)
+//
+// The roll calculations are rotated by 90 degrees and cos is used,
+// otherwise there is a sign shift that is required with sin calculations
+// for the aft motors of the drone.
+//
+// Additionally, the maximum amount of thrust for all control axes are limited.
+//
+struct HexFrame
+{
+  static const size_t k_motor_count = 6;
+  static const size_t k_table_size  = 8;
+
+  // cosf(to_radians(angle - 90)), cosf(to_radians(angle)) and the yaw
+  // compensation limit, each scaled by k_ratio_limit.
+  // Arms A: -30, B: -90, C: -150, D: 150, E: 90, F: 30 degrees.
+  static constexpr float k_roll[k_table_size] =
+    { -0.25000003f, -0.5f, -0.249999955f, 0.249999985f, 0.5f, 0.249999985f,
+      -0.25000003f, -0.25000003f };
+
+  static constexpr float k_pitch[k_table_size] =
+    { 0.433012694f, -2.18556941e-08f, -0.433012754f, -0.433012754f,
+      -2.18556941e-08f, 0.433012694f,
+      0.433012694f, 0.433012694f };
+
+  static constexpr float k_yaw[k_table_size] =
+    { -0.5f, 0.5f, -0.5f, 0.5f, -0.5f, 0.5f,
+      -0.5f, -0.5f };
+};
+
+//  ****************************************************************************
+// 8-motor configuration
+//
+//            0 deg
+//         H     A
+//      G     ^^    B
+// 90                   270
+//      F           C
+//         E     D
+//           180
+//
+//          +         -
+// Roll:  (E,F,G,H) (A,B,C,D)
+// Pitch: (A,B,G,H) (C,D,E,F)
+// Yaw:   (B,D,F,H) (A,C,E,G)
+//
+// The coefficients are calculated in the same manner as the 6-motor frame.
+//
+struct OctoFrame
+{
+  static const size_t k_motor_count = 8;
+  static const size_t k_table_size  = 8;
+
+  // Arms A: -22.5, B: -67.5, C: -112.5, D: -157.5,
+  //      E: 157.5, F: 112.5, G: 67.5,   H: 22.5 degrees.
+  static constexpr float k_roll[k_table_size] =
+    { -0.191341698f, -0.461939752f, -0.461939722f, -0.191341788f,
+       0.191341713f,  0.461939752f,  0.461939752f,  0.191341713f };
+
+  static constexpr float k_pitch[k_table_size] =
+    {  0.461939752f,  0.191341713f, -0.191341698f, -0.461939752f,
+      -0.461939752f, -0.191341698f,  0.191341713f,  0.461939752f };
+
+  static constexpr float k_yaw[k_table_size] =
+    { -0.5f, 0.5f, -0.5f, 0.5f, -0.5f, 0.5f, -0.5f, 0.5f };
+};
+
+
+//  ****************************************************************************
+/// Calculates the normalized level of each motor from the throttle
+/// and the attitude commands.
+///
+/// @param p_levels   Receives the level of each motor, from 0.0 to 1.0.
+///                   Must hold k_mixer_max_table values.
+///
+typedef void (*MixFunction)(float  throttle,
+                            float  roll,
+                            float  pitch,
+                            float  yaw,
+                            float *p_levels);
+
+//  ****************************************************************************
+/// Run-time description of the mixer for a frame.
+///
+struct MixerTable
+{
+  FrameType     type;
+  size_t        motor_count;
+  const float*  p_roll;
+  const float*  p_pitch;
+  const float*  p_yaw;
+  MixFunction   mix;
+};
+
+//  ****************************************************************************
+/// Returns the mixer for the specified frame geometry, in the arithmetic
+/// of the control path.
+///
+const MixerTable& mixer_table(FrameType type);
+
+//  ****************************************************************************
+/// Returns the mixer for the specified frame geometry and arithmetic.
+///
+template <typename Arithmetic>
+const MixerTable& mixer_table(FrameType type);
+
+
+//  ****************************************************************************
+/// Mixer specialized for the geometry of a frame.
+///
+/// The levels are calculated as:
+///
+///   rate  = throttle + pitch * k_pitch + roll * k_roll + yaw * k_yaw
+///   level = (rate + offset) * ratio
+///
+/// where the offset raises the lowest rate to zero, and the ratio
+/// scales the highest rate down to 1.0.
+///
+template <typename Frame, typename Arithmetic = FloatArithmetic>
+struct Mixer
+{
+  static const size_t k_motor_count = Frame::k_motor_count;
+  static const size_t k_table_size  = Frame::k_table_size;
+
+  static_assert(k_table_size % k_mixer_lanes == 0,
+                "Mixer tables must be padded to the vector width.");
+  static_assert(k_table_size <= k_mixer_max_table,
+                "Mixer table exceeds the maximum table size.");
+  static_assert(k_motor_count <= k_table_size,
+                "Mixer table is too small for the motor count.");
+
+  //  **************************************************************************
+  static void mix(float  throttle,
+                  float  roll,
+                  float  pitch,
+                  float  yaw,
+                  float *p_levels)
+  {
+    mix(throttle, roll, pitch, yaw, p_levels, typename Arithmetic::IsFloat());
+  }
+
+  //  **************************************************************************
+  /// The reference mixer, also used where vectors are not available.
+  ///
+  static void mix_scalar(float  throttle,
+                         float  roll,
+                         float  pitch,
+                         float  yaw,
+                         float *p_levels)
+  {
+    float rate[k_motor_count];
+
+    auto mix_rate = [&](size_t index)
+    {
+      float attitude  = Frame::k_pitch[index] * pitch
+                      + Frame::k_roll[index]  * roll
+                      + Frame::k_yaw[index]   * yaw;
+
+      rate[index]     = throttle + attitude;
+    };
+
+    Unroll<k_motor_count>::apply(mix_rate);
+
+    // The first of the lowest and highest rates, as with std::min_element.
+    float lowest_rate   = rate[0];
+    float highest_rate  = rate[0];
+
+    auto find_range = [&](size_t index)
+    {
+      if (rate[index] < lowest_rate)
+      {
+        lowest_rate = rate[index];
+      }
+
+      if (highest_rate < rate[index])
+      {
+        highest_rate = rate[index];
+      }
+    };
+
+    Unroll<k_motor_count>::apply(find_range);
+
+    float offset  = 0.0f;
+    float ratio   = normalize(lowest_rate, highest_rate, offset);
+
+    auto scale = [&](size_t index)
+    {
+      p_levels[index] = (rate[index] + offset) * ratio;
+    };
+
+    Unroll<k_motor_count>::apply(scale);
+  }
+
+  //  **************************************************************************
+  /// The fixed-point mixer.
+  ///
+  static void mix_fixed(float  throttle,
+                        float  roll,
+                        float  pitch,
+                        float  yaw,
+                        float *p_levels)
+  {
+    typedef FixedArithmetic::Value        Value;
+    typedef FixedArithmetic::Coefficient  Coefficient;
+
+    const Value v_throttle  = Value::from_float(throttle);
+    const Value v_roll      = Value::from_float(roll);
+    const Value v_pitch     = Value::from_float(pitch);
+    const Value v_yaw       = Value::from_float(yaw);
+
+    const FixedTable &table = FixedTable::k_table;
+
+    Value rate[k_motor_count];
+
+    auto mix_rate = [&](size_t index)
+    {
+      Value attitude  = v_pitch * table.pitch[index]
+                      + v_roll  * table.roll[index]
+                      + v_yaw   * table.yaw[index];
+
+      rate[index]     = v_throttle + attitude;
+    };
+
+    Unroll<k_motor_count>::apply(mix_rate);
+
+    Value lowest_rate   = rate[0];
+    Value highest_rate  = rate[0];
+
+    auto find_range = [&](size_t index)
+    {
+      if (rate[index] < lowest_rate)
+      {
+        lowest_rate = rate[index];
+      }
+
+      if (highest_rate < rate[index])
+      {
+        highest_rate = rate[index];
+      }
+    };
+
+    Unroll<k_motor_count>::apply(find_range);
+
+    const Value k_one   = Value::from_float(1.0f);
+
+    Value offset        = lowest_rate < Value()
+                        ? -lowest_rate
+                        : Value();
+
+    highest_rate        = highest_rate + offset;
+    Coefficient ratio   = highest_rate > k_one
+                        ? reciprocal(highest_rate)
+                        : Coefficient::max();
+
+    auto scale = [&](size_t index)
+    {
+      p_levels[index] = ((rate[index] + offset) * ratio).to_float();
+    };
+
+    Unroll<k_motor_count>::apply(scale);
+  }
+
+private:
+  static const size_t k_vector_count = k_table_size / k_mixer_lanes;
+
+  //  **************************************************************************
+  //  The coefficient tables of the frame, converted once to fixed point.
+  //
+  struct FixedTable
+  {
+    FixedArithmetic::Coefficient  roll[k_table_size];
+    FixedArithmetic::Coefficient  pitch[k_table_size];
+    FixedArithmetic::Coefficient  yaw[k_table_size];
+
+    static const FixedTable       k_table;
+
+    FixedTable()
+    {
+      for (size_t index = 0; index < k_table_size; ++index)
+      {
+        roll[index]   = FixedArithmetic::coefficient(Frame::k_roll[index]);
+        pitch[index]  = FixedArithmetic::coefficient(Frame::k_pitch[index]);
+        yaw[index]    = FixedArithmetic::coefficient(Frame::k_yaw[index]);
+      }
+    }
+  };
+
+  //  **************************************************************************
+  static void mix(float  throttle,
+                  float  roll,
+                  float  pitch,
+                  float  yaw,
+                  float *p_levels,
+                  std::true_type)
+  {
+#if defined(MIXER_USE_SSE)
+    mix_sse(throttle, roll, pitch, yaw, p_levels);
+#elif defined(MIXER_USE_NEON)
+    mix_neon(throttle, roll, pitch, yaw, p_levels);
+#else
+    mix_scalar(throttle, roll, pitch, yaw, p_levels);
+#endif
+  }
+
+  //  **************************************************************************
+  static void mix(float  throttle,
+                  float  roll,
+                  float  pitch,
+                  float  yaw,
+                  float *p_levels,
+                  std::false_type)
+  {
+    mix_fixed(throttle, roll, pitch, yaw, p_levels);
+  }
+
+  //  **************************************************************************
+  //  Returns 1 / value for a value above 1.0, with Newton-Raphson iterations.
+  //
+  //  The value is normalized to m * 2^e, with m from 0.5 to 1.0, where the
+  //  estimate 48/17 - 32/17 * m is within 1/17 of 1 / m. Each iteration
+  //  squares the error, so three iterations are exact to the Q31 result.
+  //
+  static FixedArithmetic::Coefficient reciprocal(FixedArithmetic::Value value)
+  {
+    typedef FixedArithmetic::Value        Value;
+    typedef FixedArithmetic::Coefficient  Coefficient;
+
+    const int64_t k_one         = int64_t(1) << 29;
+    const int64_t k_48_over_17  = 1515870810;     // Q29
+    const int64_t k_32_over_17  = 1010580540;     // Q29
+
+    // The mantissa is Q31, the estimate is Q29.
+    int     shift     = __builtin_clz(uint32_t(value.raw()));
+    int64_t mantissa  = int64_t(uint32_t(value.raw()) << shift) >> 1;
+    int64_t estimate  = k_48_over_17 - ((k_32_over_17 * mantissa) >> 31);
+
+    for (int iteration = 0; iteration < 3; ++iteration)
+    {
+      int64_t error = k_one - ((mantissa * estimate) >> 31);
+      estimate     += (estimate * error) >> 29;
+    }
+
+    // value = m * 2^(32 - shift - F), so 1 / value in Q31
+    // is the Q29 estimate shifted by shift + F - 30.
+    int right = 30 - shift - Value::k_fraction;
+    int64_t half = right > 0 ? int64_t(1) << (right - 1) : 0;
+
+    return Coefficient::from_wide(right >= 0
+                                  ? (estimate + half) >> right
+                                  : estimate << -right);
+  }
+
+  //  **************************************************************************
+  //  Calculates the offset and ratio that normalize the rates to 0.0 to 1.0.
+  //  The arithmetic matches the original mixer, including the promotions
+  //  to double, so that the levels are identical.
+  //
+  static float normalize(float lowest_rate, float highest_rate, float &offset)
+  {
+    // Offset by the inverse to raise to zero.
+    offset  =  lowest_rate < 0.0
+            ? -lowest_rate
+            : 0.0;
+
+    highest_rate += offset;
+    float ratio   = highest_rate > 1.0
+                  ? 1.0 / highest_rate
+                  : 1.0;
+
+    return ratio;
+  }
+
+#if defined(MIXER_USE_SSE)
+  //  **************************************************************************
+  //  The lowest and highest rates are only different from std::min_element
+  //  and std::max_element for NaN rates, which are not valid commands.
+  //
+  static void mix_sse(float  throttle,
+                      float  roll,
+                      float  pitch,
+                      float  yaw,
+                      float *p_levels)
+  {
+    const __m128 v_throttle = _mm_set1_ps(throttle);
+    const __m128 v_roll     = _mm_set1_ps(roll);
+    const __m128 v_pitch    = _mm_set1_ps(pitch);
+    const __m128 v_yaw      = _mm_set1_ps(yaw);
+
+    __m128 rate[k_vector_count];
+
+    auto mix_rate = [&](size_t index)
+    {
+      const size_t at = index * k_mixer_lanes;
+
+      __m128 attitude = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&Frame::k_pitch[at]), v_pitch),
+                                   _mm_mul_ps(_mm_loadu_ps(&Frame::k_roll[at]),  v_roll));
+      attitude        = _mm_add_ps(attitude,
+                                   _mm_mul_ps(_mm_loadu_ps(&Frame::k_yaw[at]),   v_yaw));
+
+      rate[index]     = _mm_add_ps(v_throttle, attitude);
+    };
+
+    Unroll<k_vector_count>::apply(mix_rate);
+
+    __m128 lowest   = rate[0];
+    __m128 highest  = rate[0];
+
+    auto find_range = [&](size_t index)
+    {
+      lowest  = _mm_min_ps(lowest,  rate[index]);
+      highest = _mm_max_ps(highest, rate[index]);
+    };
+
+    Unroll<k_vector_count>::apply(find_range);
+
+    lowest  = _mm_min_ps(lowest,  _mm_movehl_ps(lowest,  lowest));
+    lowest  = _mm_min_ss(lowest,  _mm_shuffle_ps(lowest,  lowest,  1));
+    highest = _mm_max_ps(highest, _mm_movehl_ps(highest, highest));
+    highest = _mm_max_ss(highest, _mm_shuffle_ps(highest, highest, 1));
+
+    float offset  = 0.0f;
+    float ratio   = normalize(_mm_cvtss_f32(lowest), _mm_cvtss_f32(highest), offset);
+
+    const __m128 v_offset = _mm_set1_ps(offset);
+    const __m128 v_ratio  = _mm_set1_ps(ratio);
+
+    auto scale = [&](size_t index)
+    {
+      _mm_storeu_ps(&p_levels[index * k_mixer_lanes],
+                    _mm_mul_ps(_mm_add_ps(rate[index], v_offset), v_ratio));
+    };
+
+    Unroll<k_vector_count>::apply(scale);
+  }
+#endif
+
+#if defined(MIXER_USE_NEON)
+  //  **************************************************************************
+  //  The lowest and highest rates are only different from std::min_element
+  //  and std::max_element for NaN rates, which are not valid commands.
+  //
+  static void mix_neon(float  throttle,
+                       float  roll,
+                       float  pitch,
+                       float  yaw,
+                       float *p_levels)
+  {
+    const float32x4_t v_throttle = vdupq_n_f32(throttle);
+
+    float32x4_t rate[k_vector_count];
+
+    auto mix_rate = [&](size_t index)
+    {
+      const size_t at = index * k_mixer_lanes;
+
+      float32x4_t attitude = vaddq_f32(vmulq_n_f32(vld1q_f32(&Frame::k_pitch[at]), pitch),
+                                       vmulq_n_f32(vld1q_f32(&Frame::k_roll[at]),  roll));
+      attitude             = vaddq_f32(attitude,
+                                       vmulq_n_f32(vld1q_f32(&Frame::k_yaw[at]),   yaw));
+
+      rate[index]          = vaddq_f32(v_throttle, attitude);
+    };
+
+    Unroll<k_vector_count>::apply(mix_rate);
+
+    float32x4_t lowest  = rate[0];
+    float32x4_t highest = rate[0];
+
+    auto find_range = [&](size_t index)
+    {
+      lowest  = vminq_f32(lowest,  rate[index]);
+      highest = vmaxq_f32(highest, rate[index]);
+    };
+
+    Unroll<k_vector_count>::apply(find_range);
+
+#if defined(__aarch64__)
+    float low     = vminvq_f32(lowest);
+    float high    = vmaxvq_f32(highest);
+#else
+    float32x2_t low_pair  = vpmin_f32(vget_low_f32(lowest),  vget_high_f32(lowest));
+    float32x2_t high_pair = vpmax_f32(vget_low_f32(highest), vget_high_f32(highest));
+
+    float low     = vget_lane_f32(vpmin_f32(low_pair,  low_pair),  0);
+    float high    = vget_lane_f32(vpmax_f32(high_pair, high_pair), 0);
+#endif
+
+    float offset  = 0.0f;
+    float ratio   = normalize(low, high, offset);
+
+    const float32x4_t v_offset = vdupq_n_f32(offset);
+
+    auto scale = [&](size_t index)
+    {
+      vst1q_f32(&p_levels[index * k_mixer_lanes],
+                vmulq_n_f32(vaddq_f32(rate[index], v_offset), ratio));
+    };
+
+    Unroll<k_vector_count>::apply(scale);
+  }
+#endif
+};
+
+//  ****************************************************************************
+template <typename Frame, typename Arithmetic>
+const typename Mixer<Frame, Arithmetic>::FixedTable
+Mixer<Frame, Arithmetic>::FixedTable::k_table;
+
+
+#endif
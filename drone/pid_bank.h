@@ -0,0 +1,995 @@
+/// @file pid_bank.h
+///
+/// A group of PID controllers that are sampled at the same time.
+///
+/// The state of the controllers is held as a structure of arrays, one lane
+/// per controller, and every controller is advanced with a single call.
+/// The time slice is measured once for the group.
+///
+/// The derivative of each controller is smoothed by the filter selected
+/// in its configuration, with coefficients calculated for the nominal
+/// sample period of the bank when the filter is configured. The default
+/// first-order low-pass is applied within the vectors, the other filters
+/// are applied to each controller in turn.
+///
+/// The arithmetic is selected by a template parameter, see
+/// control_arithmetic.h. With FloatArithmetic, where SSE2 or NEON is
+/// available, four controllers are updated at a time. The SSE2 and AArch64
+/// paths produce results that are bit-identical to the scalar path, which
+/// follows the steps of the PID class, including the promotions to double
+/// in its output filter. The NEON unit of ARMv7 flushes denormals to zero,
+/// so its results are identical unless a value falls below FLT_MIN, and
+/// then differ by less than k_pid_bank_tolerance. ARMv7 has no vectors of
+/// double, and its output filter is applied to each controller in turn.
+/// Define PID_BANK_NO_SIMD to build the scalar bank only. With
+/// FixedArithmetic the scalar path is calculated in fixed point, except for
+/// the derivative filters other than the low-pass.
+///
+//  ****************************************************************************
+#ifndef PID_BANK_H_INCLUDED
+#define PID_BANK_H_INCLUDED
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "control_arithmetic.h"
+#include "utility/filters.h"
+#include "utility/timebase.h"
+
+#if !defined(PID_BANK_NO_SIMD)
+# if defined(__SSE2__)
+#   include <emmintrin.h>
+#   define PID_BANK_USE_SSE
+# elif defined(__aarch64__) || defined(__ARM_NEON__)
+#   include <arm_neon.h>
+#   define PID_BANK_USE_NEON
+# endif
+#endif
+
+
+//  ****************************************************************************
+const size_t  k_pid_lanes = 4;          ///< Controllers updated in each vector.
+
+#if defined(PID_BANK_USE_NEON) && !defined(__aarch64__)
+const float   k_pid_bank_tolerance = 1e-30f;  ///< Largest difference from the
+                                              ///  scalar path, from the flushed
+                                              ///  denormals.
+#else
+const float   k_pid_bank_tolerance = 0.0f;
+#endif
+
+
+//  ****************************************************************************
+/// Updates Count PID controllers together.
+///
+/// The controllers are configured through a Lane, which has the same
+/// interface as the PID class. All of the controllers in the bank must
+/// be updated with each sample.
+///
+template <size_t Count, typename Arithmetic = FloatArithmetic>
+class PIDBank
+{
+public:
+  static const size_t k_count = Count;
+  static const size_t k_size  = (Count + k_pid_lanes - 1) / k_pid_lanes * k_pid_lanes;
+
+  typedef typename Arithmetic::Value        Value;
+  typedef typename Arithmetic::Coefficient  Coefficient;
+
+  //  **************************************************************************
+  /// A single controller within the bank.
+  ///
+  class Lane
+  {
+  public:
+    //  ************************************************************************
+    Lane(PIDBank &bank, size_t index)
+      : mp_bank(&bank)
+      , m_index(index)
+    { }
+
+    //  ************************************************************************
+    float target() const
+    {
+      return Arithmetic::to_float(mp_bank->m_setpoint[m_index]);
+    }
+
+    //  ************************************************************************
+    void setpoint(float value)
+    {
+      if (value < min())
+      {
+        value = min();
+      }
+      else if (value > max())
+      {
+        value = max();
+      }
+
+      mp_bank->m_setpoint[m_index] = Arithmetic::from_float(value);
+    }
+
+    //  ************************************************************************
+    float dt() const
+    {
+      return Arithmetic::to_float(mp_bank->m_delta_time[m_index]);
+    }
+
+    //  ************************************************************************
+    float proportional() const
+    {
+      return Kp() * error();
+    }
+
+    //  ************************************************************************
+    float integral() const
+    {
+      return Ki() * integrator();
+    }
+
+    //  ************************************************************************
+    float integrator() const
+    {
+      return Arithmetic::to_float(mp_bank->m_integral[m_index]);
+    }
+
+    //  ************************************************************************
+    float derivative() const
+    {
+      return Kd() * dError();
+    }
+
+    //  ************************************************************************
+    void reset_integral()
+    {
+      mp_bank->m_integral[m_index]   = Value();
+      mp_bank->m_derivative[m_index] = Value();
+      mp_bank->m_filters[m_index].reset();
+    }
+
+    //  ************************************************************************
+    float error() const
+    {
+      return Arithmetic::to_float(mp_bank->m_error[m_index]);
+    }
+
+    //  ************************************************************************
+    float dError() const
+    {
+      return Arithmetic::to_float(mp_bank->m_derivative[m_index]);
+    }
+
+    //  ************************************************************************
+    float windup_limit() const
+    {
+      return Arithmetic::to_float(mp_bank->m_windup_limit[m_index]);
+    }
+
+    //  ************************************************************************
+    void windup_limit(float limit)
+    {
+      mp_bank->m_windup_limit[m_index] = Arithmetic::from_float(limit);
+    }
+
+    //  ************************************************************************
+    float lowpass_freq() const
+    {
+      return filter().cutoff;
+    }
+
+    //  ************************************************************************
+    void lowpass_freq(float freq)
+    {
+      FilterConfig config = filter();
+      config.cutoff       = freq;
+
+      filter(config);
+    }
+
+    //  ************************************************************************
+    const FilterConfig& filter() const
+    {
+      return mp_bank->m_filter[m_index];
+    }
+
+    //  ************************************************************************
+    /// Selects the derivative filter, which starts again from its reset state.
+    ///
+    void filter(const FilterConfig &config)
+    {
+      mp_bank->filter(m_index, config);
+    }
+
+    //  ************************************************************************
+    float Kp() const
+    {
+      return mp_bank->m_gains[m_index].Kp;
+    }
+
+    //  ************************************************************************
+    void Kp(float gain)
+    {
+      if (gain < 0.0)
+        return;
+
+      mp_bank->m_gains[m_index].Kp    = gain;
+      mp_bank->m_gain_Kp[m_index] = Arithmetic::from_float(gain * mp_bank->m_scales[m_index].Kp);
+
+      // Reset the error of the PID.
+      clear();
+    }
+
+    //  ************************************************************************
+    float Ki() const
+    {
+      return mp_bank->m_gains[m_index].Ki;
+    }
+
+    //  ************************************************************************
+    void Ki(float gain)
+    {
+      if (gain < 0.0)
+        return;
+
+      mp_bank->m_gains[m_index].Ki    = gain;
+      mp_bank->m_gain_Ki[m_index] = Arithmetic::from_float(gain * mp_bank->m_scales[m_index].Ki);
+
+      // Reset the error of the PID.
+      clear();
+    }
+
+    //  ************************************************************************
+    float Kd() const
+    {
+      return mp_bank->m_gains[m_index].Kd;
+    }
+
+    //  ************************************************************************
+    void Kd(float gain)
+    {
+      mp_bank->m_gains[m_index].Kd    = gain;
+      mp_bank->m_gain_Kd[m_index] = Arithmetic::from_float(gain * mp_bank->m_scales[m_index].Kd);
+
+      // Reset the error of the PID.
+      clear();
+    }
+
+    //  ************************************************************************
+    /// Scales the gains for the operating point, such as from a gain schedule.
+    /// The gains are reported without the scale, and unlike a change of the
+    /// gains, the state of the controller is kept.
+    ///
+    void scale_gains(float Kp_scale, float Ki_scale, float Kd_scale)
+    {
+      Gains         &scales = mp_bank->m_scales[m_index];
+      const Gains   &gains  = mp_bank->m_gains[m_index];
+
+      scales.Kp = Kp_scale;
+      scales.Ki = Ki_scale;
+      scales.Kd = Kd_scale;
+
+      mp_bank->m_gain_Kp[m_index] = Arithmetic::from_float(gains.Kp * Kp_scale);
+      mp_bank->m_gain_Ki[m_index] = Arithmetic::from_float(gains.Ki * Ki_scale);
+      mp_bank->m_gain_Kd[m_index] = Arithmetic::from_float(gains.Kd * Kd_scale);
+    }
+
+    //  ************************************************************************
+    float scalar() const
+    {
+      return Arithmetic::to_float(mp_bank->m_scalar[m_index]);
+    }
+
+    //  ************************************************************************
+    void scalar(float value)
+    {
+      mp_bank->m_scalar[m_index] = Arithmetic::from_float(value);
+    }
+
+    //  ************************************************************************
+    float min() const
+    {
+      return Arithmetic::to_float(mp_bank->m_range_min[m_index]);
+    }
+
+    //  ************************************************************************
+    void min(float range)
+    {
+      if (range >= max())
+        return;
+
+      mp_bank->m_range_min[m_index] = Arithmetic::from_float(range);
+
+      // Make sure the set-point is within range.
+      if (target() < min())
+      {
+        setpoint(range);
+      }
+
+      // Reset the error of the PID.
+      clear();
+    }
+
+    //  ************************************************************************
+    float max() const
+    {
+      return Arithmetic::to_float(mp_bank->m_range_max[m_index]);
+    }
+
+    //  ************************************************************************
+    void max(float range)
+    {
+      if (range <= min())
+        return;
+
+      mp_bank->m_range_max[m_index] = Arithmetic::from_float(range);
+
+      // Make sure the set-point is within range.
+      if (target() > max())
+      {
+        setpoint(range);
+      }
+
+      // Reset the error of the PID.
+      clear();
+    }
+
+    //  ************************************************************************
+    /// Resets the state of this controller.
+    /// All accumulated errors and state are reset to zero.
+    ///
+    void clear()
+    {
+      mp_bank->clear(m_index);
+    }
+
+  private:
+    PIDBank  *mp_bank;
+    size_t    m_index;
+  };
+
+
+  //  **************************************************************************
+  /// Each controller starts with the defaults of the PID class.
+  ///
+  /// @param period   The nominal sample period, in seconds.
+  ///
+  explicit PIDBank(float period)
+    : m_prev_time(0)
+    , m_next_primed(0)
+    , m_period(period)
+    , m_filtered(0)
+  {
+    static_assert(Count <= 32, "The filtered lanes are recorded in a 32-bit mask.");
+
+    for (size_t index = 0; index < k_size; ++index)
+    {
+      m_setpoint[index]     = Value();
+      m_position[index]     = Value();
+      m_scalar[index]       = Arithmetic::from_float(1.0f);
+      m_gain_Kp[index]      = Arithmetic::from_float(1.0f);
+      m_gain_Ki[index]      = Value();
+      m_gain_Kd[index]      = Value();
+      m_range_min[index]    = Arithmetic::from_float(-1.0f);
+      m_range_max[index]    = Arithmetic::from_float(1.0f);
+      m_windup_limit[index] = Arithmetic::from_float(0.5f);
+      m_last_output[index]  = Value();
+      m_alpha[index]        = Arithmetic::coefficient(1.0f);
+      m_filter_mask[index]  = 0u;
+      m_filter_output[index] = Value();
+      m_delta_time[index]   = Value();
+      m_primed[index]       = 0u;
+      m_error[index]        = Value();
+      m_derivative[index]   = Arithmetic::none();
+      m_integral[index]     = Value();
+    }
+
+    for (size_t index = 0; index < Count; ++index)
+    {
+      Gains         gains   = { 1.0f, 0.0f, 0.0f };
+      Gains         scales  = { 1.0f, 1.0f, 1.0f };
+      FilterConfig  config  = { k_filter_lowpass, 20.0f, 0.7071f, 5 };
+
+      m_gains[index]  = gains;
+      m_scales[index] = scales;
+      filter(index, config);
+      clear(index);
+    }
+  }
+
+  //  **************************************************************************
+  /// Sets the nominal sample period, and designs each derivative filter
+  /// for it again. A filter that is designed again discards its history.
+  ///
+  /// @param period   seconds
+  ///
+  void period(float period)
+  {
+    if (period == m_period)
+    {
+      return;
+    }
+
+    m_period = period;
+
+    for (size_t index = 0; index < Count; ++index)
+    {
+      filter(index, m_filter[index]);
+    }
+  }
+
+  //  **************************************************************************
+  float period() const
+  {
+    return m_period;
+  }
+
+  //  **************************************************************************
+  /// Returns the controller for a lane.
+  ///
+  Lane lane(size_t index)
+  {
+    return Lane(*this, index);
+  }
+
+  //  **************************************************************************
+  /// Processes the next sample for every controller.
+  ///
+  /// @param p_actual   The measured value for each controller.
+  /// @param timestamp  Monotonic time the samples were taken, in nanoseconds.
+  /// @param p_output   Receives the output of each controller.
+  ///
+  void update(const float *p_actual, uint64_t timestamp, float *p_output)
+  {
+    float dt    = elapsed_seconds(m_prev_time, timestamp);
+    m_prev_time = timestamp;
+
+    // The first sample after a controller is cleared only records the error.
+    // A controller is not primed by a sample at time zero, as with the PID.
+    m_next_primed = (0 != timestamp) ? ~0u : 0u;
+
+    // A stall or a repeated sample takes the reference path.
+    if ( dt > 0.0f
+      && dt <= 1.0f
+      && update_vectors(p_actual, dt, p_output, typename Arithmetic::IsFloat()))
+    {
+      return;
+    }
+
+    update_scalar(p_actual, dt, p_output);
+  }
+
+  //  **************************************************************************
+  /// The reference update, also used where vectors are not available.
+  /// Each lane follows the steps of PID::update.
+  ///
+  void update_scalar(const float *p_actual, float dt, float *p_output)
+  {
+    const Period  period  = Arithmetic::period(dt);
+    const Rate    rate    = Arithmetic::rate(dt);
+
+    for (size_t index = 0; index < Count; ++index)
+    {
+      p_output[index] = update_lane(index, p_actual[index], dt, period, rate);
+    }
+  }
+
+private:
+  static const size_t k_vector_count = k_size / k_pid_lanes;
+
+  typedef typename Arithmetic::Period       Period;
+  typedef typename Arithmetic::Rate         Rate;
+
+  //  PID Tracking Data ********************************************************
+  alignas(16) Value     m_setpoint[k_size];       ///< The commanded value.
+  alignas(16) Value     m_delta_time[k_size];     ///< Length of the last time step in seconds.
+  alignas(16) Value     m_position[k_size];       ///< The prev actual position.
+  alignas(16) Value     m_error[k_size];          ///< The prev difference between the commanded
+                                                  ///  setpoint and the measured setpoint.
+  alignas(16) Value     m_derivative[k_size];     ///< The filtered change in position.
+  alignas(16) Value     m_integral[k_size];       ///< The total error accumulated over time.
+  alignas(16) Value     m_last_output[k_size];    ///< The last output, for the smoothing filter.
+  alignas(16) uint32_t  m_primed[k_size];         ///< All bits set once the controller has a
+                                                  ///  previous sample to measure against.
+
+  uint64_t              m_prev_time;              ///< The timestamp of the last sample, in ns.
+  uint32_t              m_next_primed;            ///< The primed state after this sample.
+  float                 m_period;                 ///< The nominal sample period in seconds.
+
+  //  PID Tuning Data **********************************************************
+  alignas(16) Value     m_scalar[k_size];         ///< Scalar factor for the entire PID.
+  alignas(16) Value     m_gain_Kp[k_size];        ///< The gain of the proportional factor.
+  alignas(16) Value     m_gain_Ki[k_size];        ///< The gain of the integral factor.
+  alignas(16) Value     m_gain_Kd[k_size];        ///< The gain of the derivative factor.
+  alignas(16) Value     m_range_min[k_size];      ///< The minimum allowed set-point.
+  alignas(16) Value     m_range_max[k_size];      ///< The maximum allowed set-point.
+  alignas(16) Value     m_windup_limit[k_size];   ///< Bounds the integral error.
+  alignas(16) Coefficient
+                        m_alpha[k_size];          ///< Coefficient of the derivative low-pass filter.
+
+  //  **************************************************************************
+  struct Gains
+  {
+    float   Kp;
+    float   Ki;
+    float   Kd;
+  };
+
+  Gains                 m_gains[Count];           ///< The gains as configured, reported by the
+                                                  ///  lanes, as fixed-point gains are rounded.
+  Gains                 m_scales[Count];          ///< The scale of each gain in use.
+  FilterConfig          m_filter[Count];          ///< The derivative filter of each controller.
+  SignalFilter          m_filters[Count];         ///< The derivative filters that are not
+                                                  ///  the low-pass, applied to each lane.
+  uint32_t              m_filtered;               ///< A bit is set for each lane with a
+                                                  ///  filter in m_filters.
+  alignas(16) uint32_t  m_filter_mask[k_size];    ///< All bits set for the lanes with a
+                                                  ///  filter in m_filters.
+  alignas(16) Value     m_filter_output[k_size];  ///< The derivative from m_filters.
+
+  //  **************************************************************************
+  void filter(size_t index, const FilterConfig &config)
+  {
+    m_filter[index] = config;
+    m_alpha[index]  = Arithmetic::coefficient(LowPassFilter::coefficient(config.cutoff, m_period));
+
+    m_filters[index].configure(config, m_period);
+    if (k_filter_lowpass == config.type)
+    {
+      m_filtered            &= ~(1u << index);
+      m_filter_mask[index]  = 0u;
+    }
+    else
+    {
+      m_filtered            |= 1u << index;
+      m_filter_mask[index]  = ~0u;
+    }
+  }
+
+  //  **************************************************************************
+  void clear(size_t index)
+  {
+    m_delta_time[index] = Value();
+    m_primed[index]     = 0u;
+    m_error[index]      = Value();
+    m_derivative[index] = Arithmetic::none();
+    m_integral[index]   = Value();
+
+    m_filters[index].reset();
+  }
+
+  //  **************************************************************************
+  //  Smooths the change in position of a single controller.
+  //
+  Value filter_derivative(size_t index, Value derivative, Value previous)
+  {
+    if (m_filtered & (1u << index))
+    {
+      return Arithmetic::from_float(m_filters[index].apply(Arithmetic::to_float(derivative)));
+    }
+
+    return previous + (derivative - previous) * m_alpha[index];
+  }
+
+  //  **************************************************************************
+  //  Before the vectors are updated, applies the filters that are not
+  //  the low-pass to the controllers that have a previous derivative.
+  //  The vectors select the results with m_filter_mask.
+  //
+  void filter_lanes(const float *p_actual, float rate)
+  {
+    for (size_t index = 0; index < Count; ++index)
+    {
+      if ( (m_filtered & (1u << index))
+        && m_primed[index]
+        && !std::isnan(m_derivative[index]))
+      {
+        float change = (m_position[index] - p_actual[index]) * rate;
+
+        m_filter_output[index] = m_filters[index].apply(change);
+      }
+    }
+  }
+
+  //  **************************************************************************
+  //  The vectors are only used with float arithmetic.
+  //
+  bool update_vectors(const float *p_actual, float dt, float *p_output, std::true_type)
+  {
+#if defined(PID_BANK_USE_SSE)
+    update_sse(p_actual, dt, p_output);
+    return true;
+#elif defined(PID_BANK_USE_NEON)
+    update_neon(p_actual, dt, p_output);
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  //  **************************************************************************
+  bool update_vectors(const float *, float, float *, std::false_type)
+  {
+    return false;
+  }
+
+  //  **************************************************************************
+  //  Updates a single controller, as PID::update.
+  //
+  float update_lane(size_t index, float measured, float dt, Period period, Rate rate)
+  {
+    Value actual    = Arithmetic::from_float(measured);
+    m_error[index]  = m_setpoint[index] - actual;
+
+    // Do not report if this is the first sample.
+    if (!m_primed[index])
+    {
+      m_primed[index]     = m_next_primed;
+      m_derivative[index] = Value();
+      m_integral[index]   = Value();
+
+      return 0.0f;
+    }
+
+    m_delta_time[index] = Arithmetic::from_float(dt);
+
+    // If too much time has passed since the last sample,
+    // reset the filter state.
+    if (dt > 1.0f)
+    {
+      clear(index);
+    }
+    else if (dt == 0.0f)
+    {
+      return 0.0f;
+    }
+    else
+    {
+      m_primed[index] = m_next_primed;
+    }
+
+    // The derivative is calculated from the process variable,
+    // and requires a first step with change.
+    Value cur_derivative = Value();
+    Value previous       = m_derivative[index];
+    if (!Arithmetic::is_none(previous))
+    {
+      cur_derivative  = (m_position[index] - actual) * rate;
+      cur_derivative  = filter_derivative(index, cur_derivative, previous);
+    }
+
+    m_position[index]   = actual;
+    m_derivative[index] = cur_derivative;
+
+    // Only update the integral if the system is not already saturated.
+    Value level = m_gain_Kp[index] * m_error[index]
+                + m_gain_Ki[index] * m_integral[index]
+                + m_gain_Kd[index] * m_derivative[index];
+    if ( level > m_range_min[index]
+      && level < m_range_max[index])
+    {
+      m_integral[index] += m_error[index] * period;
+    }
+
+    // Prevent the integral, steady-state, error from growing too large.
+    if (m_integral[index] > m_windup_limit[index])
+    {
+      m_integral[index] = m_windup_limit[index];
+    }
+    else if (m_integral[index] < -m_windup_limit[index])
+    {
+      m_integral[index] = -m_windup_limit[index];
+    }
+
+    level = m_gain_Kp[index] * m_error[index]
+          + m_gain_Ki[index] * m_integral[index]
+          + m_gain_Kd[index] * m_derivative[index];
+
+    m_last_output[index] = Arithmetic::smooth(m_last_output[index], level, m_scalar[index]);
+    return Arithmetic::to_float(m_last_output[index]);
+  }
+
+#if defined(PID_BANK_USE_SSE)
+  //  **************************************************************************
+  //  Loads the lanes that are in use, the remaining lanes are zero.
+  //  The caller's values are read individually, so a value that was just
+  //  stored is forwarded rather than waiting for the store to complete.
+  //
+  static __m128 load(const float *p_values, size_t count)
+  {
+    switch (count)
+    {
+    case 1:   return _mm_load_ss(p_values);
+    case 2:   return _mm_unpacklo_ps(_mm_load_ss(p_values), _mm_load_ss(p_values + 1));
+    case 3:   return _mm_movelh_ps(_mm_unpacklo_ps(_mm_load_ss(p_values), _mm_load_ss(p_values + 1)),
+                                   _mm_load_ss(p_values + 2));
+    default:  return _mm_loadu_ps(p_values);
+    }
+  }
+
+  //  **************************************************************************
+  //  Stores the lanes that are in use.
+  //
+  static void store(float *p_values, __m128 values, size_t count)
+  {
+    switch (count)
+    {
+    case 3:   _mm_store_ss(p_values + 2, _mm_movehl_ps(values, values));
+              // fall through
+    case 2:   _mm_store_ss(p_values + 1, _mm_shuffle_ps(values, values, 1));
+              // fall through
+    case 1:   _mm_store_ss(p_values, values);
+              break;
+    default:  _mm_storeu_ps(p_values, values);
+              break;
+    }
+  }
+
+  //  **************************************************************************
+  //  Selects a where the mask is set, otherwise b.
+  //
+  static __m128 select(__m128 mask, __m128 a, __m128 b)
+  {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+  }
+
+  //  **************************************************************************
+  //  The smoothing filter, in double as the PID calculates it.
+  //
+  static __m128 smooth(__m128 last, __m128 level, __m128 scalar)
+  {
+    const __m128d k_prev  = _mm_set1_pd(0.87);
+    const __m128d k_next  = _mm_set1_pd(0.13);
+
+    __m128d low   = _mm_add_pd(_mm_mul_pd(k_prev, _mm_cvtps_pd(last)),
+                               _mm_mul_pd(_mm_mul_pd(k_next, _mm_cvtps_pd(level)),
+                                          _mm_cvtps_pd(scalar)));
+    __m128d high  = _mm_add_pd(_mm_mul_pd(k_prev, _mm_cvtps_pd(_mm_movehl_ps(last, last))),
+                               _mm_mul_pd(_mm_mul_pd(k_next, _mm_cvtps_pd(_mm_movehl_ps(level, level))),
+                                          _mm_cvtps_pd(_mm_movehl_ps(scalar, scalar))));
+
+    return _mm_movelh_ps(_mm_cvtpd_ps(low), _mm_cvtpd_ps(high));
+  }
+
+  //  **************************************************************************
+  //  Updates four controllers at a time, for a time slice in (0, 1].
+  //
+  void update_sse(const float *p_actual, float dt, float *p_output)
+  {
+    const __m128 v_dt          = _mm_set1_ps(dt);
+    const __m128 v_rate        = _mm_set1_ps(1.0f / dt);
+
+    if (m_filtered)
+    {
+      filter_lanes(p_actual, 1.0f / dt);
+    }
+    const __m128 v_sign        = _mm_set1_ps(-0.0f);
+    const __m128 v_primed_next = _mm_castsi128_ps(_mm_set1_epi32(int32_t(m_next_primed)));
+
+    for (size_t vector = 0; vector < k_vector_count; ++vector)
+    {
+      const size_t at     = vector * k_pid_lanes;
+      const size_t count  = Count - at;
+
+      __m128 actual     = load(&p_actual[at], count);
+      __m128 primed     = _mm_loadu_ps(reinterpret_cast<const float*>(&m_primed[at]));
+      __m128 error      = _mm_sub_ps(_mm_loadu_ps(&m_setpoint[at]), actual);
+      __m128 previous   = _mm_loadu_ps(&m_derivative[at]);
+      __m128 position   = _mm_loadu_ps(&m_position[at]);
+      __m128 integral   = _mm_loadu_ps(&m_integral[at]);
+      __m128 last       = _mm_loadu_ps(&m_last_output[at]);
+      __m128 Kp         = _mm_loadu_ps(&m_gain_Kp[at]);
+      __m128 Ki         = _mm_loadu_ps(&m_gain_Ki[at]);
+      __m128 Kd         = _mm_loadu_ps(&m_gain_Kd[at]);
+      __m128 windup     = _mm_loadu_ps(&m_windup_limit[at]);
+
+      // The derivative low-pass filter, zero until it has a previous value.
+      __m128 change     = _mm_mul_ps(_mm_sub_ps(position, actual), v_rate);
+      __m128 derivative = _mm_add_ps(previous,
+                                     _mm_mul_ps(_mm_sub_ps(change, previous),
+                                                _mm_loadu_ps(&m_alpha[at])));
+      derivative        = select(_mm_loadu_ps(reinterpret_cast<const float*>(&m_filter_mask[at])),
+                                 _mm_loadu_ps(&m_filter_output[at]),
+                                 derivative);
+      derivative        = _mm_and_ps(_mm_cmpord_ps(previous, previous), derivative);
+
+      // The integral only accumulates while the output is not saturated.
+      __m128 level      = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Kp, error),
+                                                _mm_mul_ps(Ki, integral)),
+                                     _mm_mul_ps(Kd, derivative));
+      __m128 in_range   = _mm_and_ps(_mm_cmpgt_ps(level, _mm_loadu_ps(&m_range_min[at])),
+                                     _mm_cmplt_ps(level, _mm_loadu_ps(&m_range_max[at])));
+      integral          = select(in_range,
+                                 _mm_add_ps(integral, _mm_mul_ps(error, v_dt)),
+                                 integral);
+
+      __m128 lower      = _mm_xor_ps(windup, v_sign);
+      __m128 clamped    = select(_mm_cmplt_ps(integral, lower), lower, integral);
+      integral          = select(_mm_cmpgt_ps(integral, windup), windup, clamped);
+
+      level             = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Kp, error),
+                                                _mm_mul_ps(Ki, integral)),
+                                     _mm_mul_ps(Kd, derivative));
+      __m128 output     = smooth(last, level, _mm_loadu_ps(&m_scalar[at]));
+
+      // Controllers without a previous sample only record the error.
+      _mm_storeu_ps(&m_error[at],       error);
+      _mm_storeu_ps(&m_delta_time[at],  select(primed, v_dt,       _mm_loadu_ps(&m_delta_time[at])));
+      _mm_storeu_ps(&m_position[at],    select(primed, actual,     position));
+      _mm_storeu_ps(&m_derivative[at],  _mm_and_ps(primed, derivative));
+      _mm_storeu_ps(&m_integral[at],    _mm_and_ps(primed, integral));
+      _mm_storeu_ps(&m_last_output[at], select(primed, output,     last));
+      store(&p_output[at], _mm_and_ps(primed, output), count);
+      _mm_storeu_ps(reinterpret_cast<float*>(&m_primed[at]), v_primed_next);
+    }
+  }
+#endif
+
+#if defined(PID_BANK_USE_NEON)
+  //  **************************************************************************
+  //  Loads the lanes that are in use, the remaining lanes are zero.
+  //  The caller's values are read individually, so a value that was just
+  //  stored is forwarded rather than waiting for the store to complete.
+  //
+  static float32x4_t load(const float *p_values, size_t count)
+  {
+    if (count >= k_pid_lanes)
+    {
+      return vld1q_f32(p_values);
+    }
+
+    float32x4_t values = vdupq_n_f32(0.0f);
+    switch (count)
+    {
+    case 3:   values = vld1q_lane_f32(p_values + 2, values, 2);
+              // fall through
+    case 2:   values = vld1q_lane_f32(p_values + 1, values, 1);
+              // fall through
+    default:  values = vld1q_lane_f32(p_values,     values, 0);
+              break;
+    }
+
+    return values;
+  }
+
+  //  **************************************************************************
+  //  Stores the lanes that are in use.
+  //
+  static void store(float *p_values, float32x4_t values, size_t count)
+  {
+    if (count >= k_pid_lanes)
+    {
+      vst1q_f32(p_values, values);
+      return;
+    }
+
+    switch (count)
+    {
+    case 3:   vst1q_lane_f32(p_values + 2, values, 2);
+              // fall through
+    case 2:   vst1q_lane_f32(p_values + 1, values, 1);
+              // fall through
+    default:  vst1q_lane_f32(p_values,     values, 0);
+              break;
+    }
+  }
+
+  //  **************************************************************************
+  //  The smoothing filter, in double as the PID calculates it.
+  //
+  static float32x4_t smooth(float32x4_t last, float32x4_t level, float32x4_t scalar)
+  {
+#if defined(__aarch64__)
+    const float64x2_t k_prev  = vdupq_n_f64(0.87);
+    const float64x2_t k_next  = vdupq_n_f64(0.13);
+
+    float64x2_t low   = vaddq_f64(vmulq_f64(k_prev, vcvt_f64_f32(vget_low_f32(last))),
+                                  vmulq_f64(vmulq_f64(k_next, vcvt_f64_f32(vget_low_f32(level))),
+                                            vcvt_f64_f32(vget_low_f32(scalar))));
+    float64x2_t high  = vaddq_f64(vmulq_f64(k_prev, vcvt_high_f64_f32(last)),
+                                  vmulq_f64(vmulq_f64(k_next, vcvt_high_f64_f32(level)),
+                                            vcvt_high_f64_f32(scalar)));
+
+    return vcvt_high_f32_f64(vcvt_f32_f64(low), high);
+#else
+    // The VFP calculates in double, one controller at a time.
+    alignas(16) float values[3][k_pid_lanes];
+
+    vst1q_f32(values[0], last);
+    vst1q_f32(values[1], level);
+    vst1q_f32(values[2], scalar);
+
+    for (size_t lane = 0; lane < k_pid_lanes; ++lane)
+    {
+      values[0][lane] = Arithmetic::smooth(values[0][lane], values[1][lane], values[2][lane]);
+    }
+
+    return vld1q_f32(values[0]);
+#endif
+  }
+
+  //  **************************************************************************
+  //  Clears the lanes where the mask is not set.
+  //
+  static float32x4_t mask(uint32x4_t mask, float32x4_t value)
+  {
+    return vreinterpretq_f32_u32(vandq_u32(mask, vreinterpretq_u32_f32(value)));
+  }
+
+  //  **************************************************************************
+  //  Updates four controllers at a time, for a time slice in (0, 1].
+  //
+  void update_neon(const float *p_actual, float dt, float *p_output)
+  {
+    const float32x4_t v_dt          = vdupq_n_f32(dt);
+    const float32x4_t v_rate        = vdupq_n_f32(1.0f / dt);
+
+    if (m_filtered)
+    {
+      filter_lanes(p_actual, 1.0f / dt);
+    }
+    const uint32x4_t  v_next_primed = vdupq_n_u32(m_next_primed);
+
+    for (size_t vector = 0; vector < k_vector_count; ++vector)
+    {
+      const size_t at     = vector * k_pid_lanes;
+      const size_t count  = Count - at;
+
+      float32x4_t actual      = load(&p_actual[at], count);
+      uint32x4_t  primed      = vld1q_u32(&m_primed[at]);
+      float32x4_t error       = vsubq_f32(vld1q_f32(&m_setpoint[at]), actual);
+      float32x4_t previous    = vld1q_f32(&m_derivative[at]);
+      float32x4_t position    = vld1q_f32(&m_position[at]);
+      float32x4_t integral    = vld1q_f32(&m_integral[at]);
+      float32x4_t last        = vld1q_f32(&m_last_output[at]);
+      float32x4_t Kp          = vld1q_f32(&m_gain_Kp[at]);
+      float32x4_t Ki          = vld1q_f32(&m_gain_Ki[at]);
+      float32x4_t Kd          = vld1q_f32(&m_gain_Kd[at]);
+      float32x4_t windup      = vld1q_f32(&m_windup_limit[at]);
+
+      // The derivative low-pass filter, zero until it has a previous value.
+      float32x4_t change      = vmulq_f32(vsubq_f32(position, actual), v_rate);
+      float32x4_t derivative  = vaddq_f32(previous,
+                                          vmulq_f32(vsubq_f32(change, previous),
+                                                    vld1q_f32(&m_alpha[at])));
+      derivative              = vbslq_f32(vld1q_u32(&m_filter_mask[at]),
+                                          vld1q_f32(&m_filter_output[at]),
+                                          derivative);
+      derivative              = mask(vceqq_f32(previous, previous), derivative);
+
+      // The integral only accumulates while the output is not saturated.
+      float32x4_t level       = vaddq_f32(vaddq_f32(vmulq_f32(Kp, error),
+                                                    vmulq_f32(Ki, integral)),
+                                          vmulq_f32(Kd, derivative));
+      uint32x4_t  in_range    = vandq_u32(vcgtq_f32(level, vld1q_f32(&m_range_min[at])),
+                                          vcltq_f32(level, vld1q_f32(&m_range_max[at])));
+      integral                = vbslq_f32(in_range,
+                                          vaddq_f32(integral, vmulq_f32(error, v_dt)),
+                                          integral);
+
+      float32x4_t lower       = vnegq_f32(windup);
+      float32x4_t clamped     = vbslq_f32(vcltq_f32(integral, lower), lower, integral);
+      integral                = vbslq_f32(vcgtq_f32(integral, windup), windup, clamped);
+
+      level                   = vaddq_f32(vaddq_f32(vmulq_f32(Kp, error),
+                                                    vmulq_f32(Ki, integral)),
+                                          vmulq_f32(Kd, derivative));
+      float32x4_t output      = smooth(last, level, vld1q_f32(&m_scalar[at]));
+
+      // Controllers without a previous sample only record the error.
+      vst1q_f32(&m_error[at],       error);
+      vst1q_f32(&m_delta_time[at],  vbslq_f32(primed, v_dt,   vld1q_f32(&m_delta_time[at])));
+      vst1q_f32(&m_position[at],    vbslq_f32(primed, actual, position));
+      vst1q_f32(&m_derivative[at],  mask(primed, derivative));
+      vst1q_f32(&m_integral[at],    mask(primed, integral));
+      vst1q_f32(&m_last_output[at], vbslq_f32(primed, output, last));
+      store(&p_output[at], mask(primed, output), count);
+      vst1q_u32(&m_primed[at],      v_next_primed);
+    }
+  }
+#endif
+};
+
+
+#endif
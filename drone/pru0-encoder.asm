@@ -1,6 +1,7 @@
 ;
 ; PRUSS program to drive a HY-SRF05 sensor.
-; The results are stored in memory that is accessible from Linux userspace.
+; Each sample is written to the ring of range_ring.h, in the shared memory
+; that is accessible from Linux userspace, and stamped with the IEP timer.
 ; An interrupt is triggered each time a new sample is ready.
 ;
 ; This program is adapted from "ultrasonic", originally writen by Derek Molloy 
@@ -14,6 +15,7 @@
 
 ; Definitions to setup PRU shared memory
 	.asg    C4,         CONST_SYSCFG
+	.asg    C26,        CONST_IEP
 	.asg    C28,		CONST_PRUSHAREDRAM
 	.asg	0x22000,	PRU0_CTRL
 	.asg    0x28,       CTPPR0           ; page 75
@@ -22,10 +24,21 @@
 	.asg	0x020,		OTHER_RAM
 	.asg    0x100,		SHARED_RAM       ; This is so prudebug can find it.
 
-	.asg    64,			CNT_OFFSET
-	.asg    68,			DELAY_OFFSET
-	.asg    72,			RAW_DIST_OFFSET
-	.asg    76,			SAMPLE_OFFSET
+; The ring of range_ring.h, at RANGE_RING_OFFSET.
+; Its assertions name these offsets, which must change with them.
+	.asg    64,			CNT_OFFSET       ; status
+	.asg    68,			DELAY_OFFSET     ; delay_ms
+	.asg    72,			RAW_DIST_OFFSET  ; echo
+	.asg    76,			SAMPLE_OFFSET    ; head
+	.asg    80,			SLOTS_OFFSET     ; slots
+	.asg    15,			SLOT_MASK        ; RANGE_RING_SLOTS - 1
+	.asg    4,			SLOT_SHIFT       ; 16 bytes per slot: sequence,
+	                                     ;   timestamp, echo, reserved
+
+; The IEP timer counts at 200 MHz
+	.asg    0x00,		IEP_GLOBAL_CFG
+	.asg    0x0C,		IEP_COUNT
+	.asg    0x11,		IEP_ENABLE       ; CNT_EN, DEFAULT_INC = 1
 
 
 ; Definitions for the Trigger Pulse / Echo calculations
@@ -52,6 +65,9 @@
 ;    r1 - Delay, number of milliseconds to wait between samples
 ;    r2 - Echo Pulse Width counter, records the width of the return pulse.
 ;    r3 - Sample Counter
+;    r7 - IEP timestamp of the sample
+;    r8 - Offset of the slot of the sample
+;    r9 - Offset within the slot
 ; 
 ; Define the entry-point and export it for the linker.
 	.clink
@@ -70,6 +86,9 @@ start:
    LDI32  r1, PRU0_CTRL + CTPPR0            ; Note we use beginning of shared ram unlike example which
    SBBO   &r0, r1, 0, 4                     ;  page 25
 
+   LDI    r0, IEP_ENABLE                    ; Start the IEP timer that stamps the samples
+   SBCO   &r0, CONST_IEP, IEP_GLOBAL_CFG, 4
+
 ;stall:
 ;   ADD    r3, r3, 1
 ;   SBCO   &r3, CONST_PRUSHAREDRAM, RAW_DIST_OFFSET, 4
@@ -99,7 +118,7 @@ triggering:	                                ; The trigger is a 10us high-signal
 wait_for_echo:
    ADD    r5, r5, 1
    
-   QBGT   mainloop, r6, r5
+   QBGT   record, r6, r5                    ; no echo, record a width of zero
    QBBC   wait_for_echo, r31, 15
 
 ; start counting (measuring echo pulse width)  until the echo goes low
@@ -108,10 +127,24 @@ counting:
    QBBS   counting, r31, 15                 ; jump if the echo bit is still high
 
 record:
-; at this point the echo is now low - write the value to shared memory
-   SBCO   &r2, CONST_PRUSHAREDRAM, RAW_DIST_OFFSET, 4
+; at this point the echo is now low - write the sample to the next slot
+   LBCO   &r7, CONST_IEP, IEP_COUNT, 4
+   AND    r8, r3, SLOT_MASK
+   LSL    r8, r8, SLOT_SHIFT
+   ADD    r8, r8, SLOTS_OFFSET
    ADD    r3, r3, 1
+
+   ZERO   &r0, 4                            ; the slot is incomplete while written
+   SBCO   &r0, CONST_PRUSHAREDRAM, r8, 4
+   ADD    r9, r8, 4
+   SBCO   &r7, CONST_PRUSHAREDRAM, r9, 4
+   ADD    r9, r8, 8
+   SBCO   &r2, CONST_PRUSHAREDRAM, r9, 4
+   SBCO   &r3, CONST_PRUSHAREDRAM, r8, 4    ; the sequence completes the slot
+
+   SBCO   &r2, CONST_PRUSHAREDRAM, RAW_DIST_OFFSET, 4
    SBCO   &r3, CONST_PRUSHAREDRAM, SAMPLE_OFFSET, 4
+   LBCO   &r1, CONST_PRUSHAREDRAM, DELAY_OFFSET, 4
    
 update_loop:
 ; generate an interrupt to update the display on the host computer
@@ -160,9 +160,10 @@ void ArmDrone(const uint8_t* p_buffer, size_t len)
 
   cout << "Connect acknowledgement sent\n";
 
-  if (p_drone)
+  if ( p_drone
+    && !p_drone->activate())
   {
-    p_drone->activate();
+    cout << "Arm command dropped." << endl;
   }
 }
 
@@ -201,7 +202,10 @@ void ProcessCommand(const uint8_t* p_buffer, size_t len)
   Drone  *p_drone = gp_drone;
   if (p_drone)
   {
-    p_drone->command(data.control);
+    if (!p_drone->command(data.control))
+    {
+      cout << "Control command dropped, the command queue is full." << endl;
+    }
   }
 }
 
@@ -272,10 +276,13 @@ void ProcessSetControlMode(const uint8_t* p_buffer, size_t len)
   Drone  *p_drone = gp_drone;
   if (p_drone)
   {
-    p_drone->control_mode(data.control_mode == rate_control ? rate_control : angle_control);
-    p_drone->use_roll_control (1 == data.disable_roll);
-    p_drone->use_pitch_control(1 == data.disable_pitch);
-    p_drone->use_yaw_control  (1 == data.disable_yaw);
+    if (!p_drone->control_mode(data.control_mode == rate_control ? rate_control : angle_control,
+                               1 == data.disable_roll,
+                               1 == data.disable_pitch,
+                               1 == data.disable_yaw))
+    {
+      cout << "Control mode dropped, the command queue is full." << endl;
+    }
   }
 }
 
@@ -334,25 +341,9 @@ void AdjustGain(const uint8_t* p_buffer, size_t len)
 
     cout << "Kp: " << Kp << ", Ki: " << Ki << ", Kd: " << Kd << endl;
 
-    if (data.type == k_roll)
-    {
-      p_drone->adjust_gain_roll(Kp, Ki, Kd);
-    }
-    else if (data.type == k_roll_rate)
+    if (!p_drone->adjust_gain(data.type, Kp, Ki, Kd))
     {
-      p_drone->adjust_gain_roll_rate(Kp, Ki, Kd);
-    }
-    else if (data.type == k_pitch)
-    {
-      p_drone->adjust_gain_pitch(Kp, Ki, Kd);
-    }
-    else if (data.type == k_pitch_rate)
-    {
-      p_drone->adjust_gain_pitch_rate(Kp, Ki, Kd);
-    }
-    else if (data.type == k_rotate)
-    {
-      p_drone->adjust_gain_rotation(Kp, Ki, Kd);
+      cout << "Gain adjustment dropped." << endl;
     }
   }
 }
@@ -386,6 +377,14 @@ void Halt(const uint8_t *p_buffer, size_t len)
          buffer,
          disconnect_len);
 
+  // This thread queues the commands of the drone, so it also disarms the
+  // control loop. HaltListening() only stops the motors.
+  Drone  *p_drone = gp_drone;
+  if (p_drone)
+  {
+    p_drone->halt();
+  }
+
   HaltListening();
 }
 
@@ -519,10 +518,12 @@ void HaltListening()
 {
   g_is_listening = false;
 
+  // The main thread also stops listening, while the receiver thread may
+  // still queue commands. Only the receiver thread may queue the halt.
   Drone  *p_drone = gp_drone;
   if (p_drone)
   {
-    p_drone->halt();
+    p_drone->stop_motors();
   }
 
   gp_drone       = nullptr;
@@ -590,6 +591,48 @@ int SendDroneState(int conn, const DroneState& state)
 }
 
 
+//  ****************************************************************************
+int SendLoopStats(int conn, const LoopStats& stats)
+{
+  QCLoopStatsMsg data_out;
+
+  PopulateQCHeader(data_out);
+
+  // Serialize the structure:
+  const size_t k_data_len = sizeof(QCLoopStatsMsg);
+  uint8_t  buffer[k_data_len] = {0};
+
+  size_t offset = 0;
+
+  offset  = Serialize(data_out.header, buffer, k_data_len);
+  offset += Serialize(stats, buffer + offset, k_data_len - offset);
+
+  // Send the datagram to the ground control station for monitoring.
+  return write_message(conn, buffer, k_data_len);
+}
+
+
+//  ****************************************************************************
+int SendWatchdogStats(int conn, const WatchdogStats& stats)
+{
+  QCWatchdogMsg data_out;
+
+  PopulateQCHeader(data_out);
+
+  // Serialize the structure:
+  const size_t k_data_len = sizeof(QCWatchdogMsg);
+  uint8_t  buffer[k_data_len] = {0};
+
+  size_t offset = 0;
+
+  offset  = Serialize(data_out.header, buffer, k_data_len);
+  offset += Serialize(stats, buffer + offset, k_data_len - offset);
+
+  // Send the datagram to the ground control station for monitoring.
+  return write_message(conn, buffer, k_data_len);
+}
+
+
 //  ****************************************************************************
 int SendPIDState(
   int              conn, 
@@ -700,3 +743,14 @@ int  ReportDroneState(const DroneState& state)
   return SendDroneState(g_conn, state);
 }
 
+//  ****************************************************************************
+int  ReportLoopStats(const LoopStats& stats)
+{
+  return SendLoopStats(g_conn, stats);
+}
+
+//  ****************************************************************************
+int  ReportWatchdogStats(const WatchdogStats& stats)
+{
+  return SendWatchdogStats(g_conn, stats);
+}
@@ -24,6 +24,8 @@ bool UpdateLatestSeqId(uint16_t seq);
 
 
 int  ReportDroneState(const DroneState& state);
+int  ReportLoopStats(const LoopStats& stats);
+int  ReportWatchdogStats(const WatchdogStats& stats);
 
 
 #endif
@@ -1,185 +1,215 @@
 /// @file range.cpp
 ///
-/// PRUSS driver program to read data from the ultrasonic range sensor HY-SRF05.
-/// This program loads the PRU binary and maps the memory addresses used to 
-/// interpret the results in user-space.
-///
-/// Adapted from "Exploring BeagleBone" by Derek Molloy
+/// Reads the altitude near the ground from the ultrasonic range finder.
 ///
 //  ****************************************************************************
-#include <stdio.h>
-#include <stdlib.h>
-#include <prussdrv.h>
-#include <pruss_intc_mapping.h>
-#include <pthread.h>
-#include <unistd.h>
-#include <stdint.h>
-
-#include <iostream>
-#include <iomanip>
+#include "range.h"
 
-using std::cout;
-using std::endl;
+#include <atomic>
+#include <cmath>
 
-#include <rc/pru.h>
-#include <rc/time.h>
 
-namespace 
+namespace // unnamed
 {
 
-// pru shared memory pointer
-static volatile
-uint32_t  *pru0_data = nullptr;
+const uint32_t k_slot_mask    = RANGE_RING_SLOTS - 1;
 
-const uint32_t k_mem_offset     = 16;
-const uint32_t k_sample_delay   = k_mem_offset + 1;
-const uint32_t k_raw_distance   = k_mem_offset + 2;
-const uint32_t k_sample_count   = k_mem_offset + 3;
+//  ****************************************************************************
+/// Returns the nanoseconds of an interval of the IEP timer of the PRU.
+///
+uint64_t ticks_to_ns(uint32_t ticks)
+{
+  return uint64_t(ticks) * k_ns_per_us / RANGE_TICKS_PER_US;
+}
 
-const uint32_t k_PRU_num        = 0;
-const char*    k_PRU_firmware   = "am335x-pru0-qc-range-fw";
+}
 
-static 
-bool g_is_init                  = false;
 
+//  ****************************************************************************
+RangeRing::RangeRing()
+  : mp_shared(nullptr)
+  , m_next(0)
+  , m_samples(0)
+  , m_dropped(0)
+  , m_torn(0)
+{ }
+
+//  ****************************************************************************
+void RangeRing::attach(volatile RangeShared *p_shared)
+{
+  mp_shared = p_shared;
+  m_next    = p_shared ? p_shared->head : 0;
 }
 
 //  ****************************************************************************
-bool initialize_PRU( )
+size_t RangeRing::read(RangeSample *p_samples, size_t capacity, uint64_t now_ns)
 {
-	// map memory
-	pru0_data = rc_pru_shared_mem_ptr();
-	if (nullptr == pru0_data)
-  {
-    cout << "ERROR in initialize_PRU, failed to map shared memory pointer" << endl;
-		g_is_init = false;
-		return false;
-	}
-
-	// set first channel to be nonzero, PRU binary will zero this out later
-	pru0_data[k_mem_offset] = 42;
-
-  //prussdrv_init( );
-  // Open access to the PRU interrupt.
-  //int retVal = prussdrv_open(PRU_EVTOUT_0);
-  //if (retVal < 0)
-  //{
-  //  cout << "call to prussdrv_open failed (" << retVal << ")" <<  endl;
-  //}
-
-	// start pru
-	if (rc_pru_start(k_PRU_num, k_PRU_firmware))
+  if (!mp_shared)
   {
-    cout << "ERROR in initialize_PRU, failed to start PRU0" << endl;
-		return false;
-	}
+    return 0;
+  }
 
+  // The samples up to the head are complete once the head is read.
+  uint32_t head = mp_shared->head;
+  std::atomic_thread_fence(std::memory_order_acquire);
 
-	// make sure memory actually got zero'd out
-	for (int i=0; i < 40; i++)
+  uint32_t pending = head - m_next;
+  if (pending > UINT32_MAX / 2)
   {
-		if (0 == pru0_data[k_mem_offset])
-    {
-			g_is_init = true;
+    // The head went backwards, so the PRU program restarted.
+    m_next = head;
+    return 0;
+  }
 
-      // Initialize control values. 
-      pru0_data[k_sample_delay]   = 2;   // 2 milli seconds between samples
-      pru0_data[k_raw_distance]   = 0;
-      pru0_data[k_sample_count]   = 0;
+  // The PRU overwrote the samples more than a ring behind the head.
+  if (pending > RANGE_RING_SLOTS)
+  {
+    m_dropped += pending - RANGE_RING_SLOTS;
+    m_next     = head - RANGE_RING_SLOTS;
+  }
 
-			return true;
-		}
+  uint32_t  ticks[RANGE_RING_SLOTS];
+  size_t    count = 0;
 
-		rc_usleep(100000);
-	}
+  for (; m_next != head && count < capacity; ++m_next)
+  {
+    volatile RangeSlot &slot     = mp_shared->slots[m_next & k_slot_mask];
+    uint32_t            sequence = m_next + 1;
 
-  cout << "ERROR in rc_encoder_pru_init, " << k_PRU_firmware << " failed to load" << endl; 
-  cout << "Attempting to stop PRU0" << endl;
+    // The PRU clears the sequence of a slot while it writes the slot,
+    // so a copy is only complete if the sequence is unchanged around it.
+    uint32_t before = slot.sequence;
+    std::atomic_thread_fence(std::memory_order_acquire);
 
-  rc_pru_stop(k_PRU_num);
-	
-  g_is_init = false;
-	
-  return false;}
+    uint32_t timestamp  = slot.timestamp;
+    uint32_t echo       = slot.echo;
 
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t after = slot.sequence;
 
-//  ****************************************************************************
-bool terminate_PRU( )
-{
-	// zero out shared memory
-	if (nullptr == pru0_data)
-  {
-		pru0_data[k_mem_offset] = 0;
-	}
+    if ( before != sequence
+      || after  != sequence)
+    {
+      ++m_torn;
+      continue;
+    }
+
+    p_samples[count].sequence = sequence;
+    p_samples[count].distance = echo / float(RANGE_ECHO_PER_M);
+    ticks[count]              = timestamp;
+    ++count;
+  }
 
-	rc_pru_stop(k_PRU_num);
+  // The PRU has no clock in common with the flight software,
+  // so only the intervals between its samples are used.
+  for (size_t index = 0; index < count; ++index)
+  {
+    p_samples[index].timestamp_ns = now_ns - ticks_to_ns(ticks[count - 1] - ticks[index]);
+  }
 
-	pru0_data = nullptr;
-	g_is_init = false;
+  m_samples += count;
 
-  return true;
+  return count;
 }
 
+
 //  ****************************************************************************
-void *updateRangeCalculations(void *value)
+RangeSensor::RangeSensor()
+  : m_poll_ms(k_min_poll_ms)
+  , mp_clock(nullptr)
+  , m_altitude(0.0f)
+  , m_echoes(0)
+  , m_misses(0)
+  , m_outliers(0)
+{ }
+
+//  ****************************************************************************
+RangeSensor::~RangeSensor()
 {
-  cout << "Distance reported by ultrasonic sensor:\n\n";
+  stop();
+}
 
-  do
+//  ****************************************************************************
+bool RangeSensor::start(volatile RangeShared *p_shared, uint32_t poll_ms, const HAL::Clock &clock)
+{
+  if ( !p_shared
+    || !m_stop.is_valid()
+    || m_reader.joinable())
   {
-    //prussdrv_pru_wait_event (PRU_EVTOUT_0);
-     
-    uint32_t raw   = pru0_data[k_raw_distance];
-
-    float inches   = (raw / float(100 * 148));
-    float cm       = (raw / float(100 * 58));
+    return false;
+  }
 
-    cout  << "\r" << std::setw(8) << inches   << " in"
-          << "\t" << std::setw(8) << cm       << " cm";
+  m_ring.attach(p_shared);
+  m_median.reset();
 
-    //prussdrv_pru_clear_event (PRU_EVTOUT_0, PRU0_ARM_INTERRUPT);
+  mp_clock  = &clock;
+  m_poll_ms = poll_ms < k_min_poll_ms ? k_min_poll_ms : poll_ms;
+  m_reader  = std::thread(reader_proc, this);
 
-  }
-  while (1);
+  return m_reader.joinable();
 }
 
-
 //  ****************************************************************************
-void start_range_sensor()
+void RangeSensor::stop()
 {
-  initialize_PRU();
-
-  pthread_t thread;
-  if (pthread_create(&thread, NULL, &updateRangeCalculations, NULL))
+  if (m_reader.joinable())
   {
-    cout << "Failed to create range calculation thread.\n";
+    m_stop.notify();
+    m_reader.join();
   }
-
 }
 
 //  ****************************************************************************
-void shutdown_range_sensor()
+void RangeSensor::poll(uint64_t now_ns)
 {
-  terminate_PRU();
-}
+  RangeSample samples[RANGE_RING_SLOTS];
+  size_t      count   = m_ring.read(samples, RANGE_RING_SLOTS, now_ns);
 
+  const RangeSample *p_newest = nullptr;
 
-//  ****************************************************************************
-/// Reports the measured range in meters.
-///
-float get_range()
-{
-  if ( nullptr == pru0_data
-    || !g_is_init)
-  { 
-    cout << "ERROR in get_range(), call start_range_sensor() first" << endl;
-    return -1.0;
+  for (size_t index = 0; index < count; ++index)
+  {
+    const RangeSample &sample = samples[index];
+
+    if ( sample.distance < k_min_distance
+      || sample.distance > k_max_distance)
+    {
+      ++m_misses;
+      continue;
+    }
+
+    // Until the window fills, there is no median to compare with.
+    if ( m_echoes >= k_median_window
+      && std::fabs(sample.distance - m_altitude) > k_outlier_distance)
+    {
+      ++m_outliers;
+    }
+
+    m_altitude = m_median.apply(sample.distance);
+    ++m_echoes;
+
+    p_newest = &sample;
   }
 
-  uint32_t raw   = pru0_data[k_raw_distance];
-  float cm       = (raw / float(100 * 58));
+  if (p_newest)
+  {
+    RangeReading &reading = m_readings.write_buffer();
 
-  return cm / 1000.0f;
-}
+    reading.altitude      = m_altitude;
+    reading.timestamp_ns  = p_newest->timestamp_ns;
+    reading.sequence      = p_newest->sequence;
 
+    m_readings.publish();
+  }
+}
 
+//  ****************************************************************************
+void RangeSensor::reader_proc(RangeSensor *p_this)
+{
+  // The PRU cannot raise an event this thread is able to wait on,
+  // so the ring is read at the poll rate, sleeping in between.
+  while (0 == p_this->m_stop.wait_for(int(p_this->m_poll_ms)))
+  {
+    p_this->poll(p_this->mp_clock->now_ns());
+  }
+}
@@ -0,0 +1,213 @@
+/// @file range.h
+///
+/// Reads the altitude near the ground from the ultrasonic range finder.
+///
+/// The PRU measures the echo of the HY-SRF05 and writes each sample to the
+/// ring described in range_ring.h. A thread of the flight software reads the
+/// new samples at a bounded rate, filters them, and publishes the altitude
+/// for the control loop. Nothing spins while it waits for the next sample.
+///
+/// The ring may be the PRU shared memory, or ordinary memory written by a
+/// simulated PRU, which is how qcrange tests the reader.
+///
+//  ****************************************************************************
+#ifndef RANGE_H_INCLUDED
+#define RANGE_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include "hal.h"
+#include "range_ring.h"
+#include "utility/event_signal.h"
+#include "utility/filters.h"
+#include "utility/timebase.h"
+#include "utility/triple_buffer.h"
+
+
+//  ****************************************************************************
+/// A sample read from the ring.
+///
+struct RangeSample
+{
+  uint32_t  sequence;                 ///< The number of samples written,
+                                      ///  with this one.
+  uint64_t  timestamp_ns;             ///< Monotonic time of the echo.
+  float     distance;                 ///< meters, zero when no echo returned.
+};
+
+
+//  ****************************************************************************
+/// Copies the new samples out of the ring.
+///
+/// A single thread reads the ring. The samples it misses, because the PRU
+/// overwrote them before they were read, are counted rather than reported.
+///
+class RangeRing
+{
+public:
+  //  **************************************************************************
+  RangeRing();
+
+  //  **************************************************************************
+  /// Reads the ring from its current head onward.
+  ///
+  void attach(volatile RangeShared *p_shared);
+
+  //  **************************************************************************
+  /// Copies the samples written since the last read, oldest first.
+  ///
+  /// The newest of the samples is stamped with the time of the read, and
+  /// the others with the intervals the PRU measured between them. A sample
+  /// is therefore late by up to the interval between reads.
+  ///
+  /// @param p_samples  receives the samples.
+  /// @param capacity   of p_samples, at least RANGE_RING_SLOTS.
+  /// @param now_ns     monotonic time of the read.
+  ///
+  /// @return The number of samples copied.
+  ///
+  size_t read(RangeSample *p_samples, size_t capacity, uint64_t now_ns);
+
+  //  **************************************************************************
+  uint32_t  samples() const { return m_samples; }   ///< Copied.
+  uint32_t  dropped() const { return m_dropped; }   ///< Overwritten before read.
+  uint32_t  torn()    const { return m_torn;    }   ///< Overwritten while read.
+
+private:
+  //  **************************************************************************
+  volatile RangeShared
+           *mp_shared;
+  uint32_t  m_next;                   ///< The sequence of the next sample.
+  uint32_t  m_samples;
+  uint32_t  m_dropped;
+  uint32_t  m_torn;
+};
+
+
+//  ****************************************************************************
+/// The altitude measured by the range finder.
+///
+struct RangeReading
+{
+  float     altitude;                 ///< meters, the median of the recent echoes.
+  uint64_t  timestamp_ns;             ///< Monotonic time of the newest echo,
+                                      ///  zero before the first.
+  uint32_t  sequence;                 ///< Of the newest echo.
+};
+
+
+//  ****************************************************************************
+/// Reads the range finder on its own thread, and hands the filtered altitude
+/// to the control loop.
+///
+/// Samples without an echo, or beyond the range of the sensor, are ignored.
+/// The altitude is the median of the last k_median_window echoes, so a
+/// single spurious echo does not move it; echoes that differ from the median
+/// by more than k_outlier_distance are counted as outliers.
+///
+class RangeSensor
+{
+public:
+  //  **************************************************************************
+  static const
+    size_t    k_median_window     = 5;
+
+  static const
+    uint32_t  k_min_poll_ms       = 1;  ///< Bounds the rate of the reads.
+
+  static constexpr
+    float     k_min_distance      = 0.02f;  ///< meters, the range of the HY-SRF05.
+  static constexpr
+    float     k_max_distance      = 4.5f;
+  static constexpr
+    float     k_outlier_distance  = 0.25f;  ///< meters, from the median.
+
+  //  **************************************************************************
+  RangeSensor();
+  ~RangeSensor();
+
+  //  **************************************************************************
+  /// Starts reading the ring.
+  ///
+  /// @param p_shared   the ring the PRU writes.
+  /// @param poll_ms    milliseconds between reads of the ring.
+  /// @param clock      the time the ring is read at.
+  ///
+  /// @return false if the reader could not be started.
+  ///
+  bool start(volatile RangeShared *p_shared, uint32_t poll_ms, const HAL::Clock &clock);
+
+  //  **************************************************************************
+  /// Stops the reader, and waits for its thread to exit.
+  ///
+  void stop();
+
+  //  **************************************************************************
+  /// Reads and filters the new samples in the ring.
+  /// Called by the reader thread, or directly when no thread was started.
+  ///
+  void poll(uint64_t now_ns);
+
+  //  **************************************************************************
+  /// Control thread: Reports the most recent altitude.
+  ///
+  /// @param altitude   meters.
+  /// @param age_ns     nanoseconds since the newest echo in the altitude.
+  /// @param now_ns     monotonic time to measure the age at.
+  ///
+  /// @return false if no echo was received yet.
+  ///
+  bool latest(float &altitude, uint64_t &age_ns, uint64_t now_ns)
+  {
+    m_readings.acquire();
+    const RangeReading &reading = m_readings.read_buffer();
+
+    if (0 == reading.timestamp_ns)
+    {
+      return false;
+    }
+
+    altitude  = reading.altitude;
+    age_ns    = now_ns > reading.timestamp_ns ? now_ns - reading.timestamp_ns : 0;
+
+    return true;
+  }
+
+  //  **************************************************************************
+  const RangeRing&  ring() const { return m_ring; }
+
+  uint32_t  echoes()   const { return m_echoes;   }   ///< Filtered.
+  uint32_t  misses()   const { return m_misses;   }   ///< Without an echo.
+  uint32_t  outliers() const { return m_outliers; }   ///< Far from the median.
+
+private:
+  //  **************************************************************************
+  //  Reads the ring every poll_ms until stop().
+  //
+  static
+    void reader_proc(RangeSensor *p_this);
+
+  //  **************************************************************************
+  RangeRing     m_ring;
+  MedianFilter<k_median_window>
+                m_median;
+
+  TripleBuffer<RangeReading>
+                m_readings;           ///< Hands the altitude to the control loop.
+
+  std::thread   m_reader;
+  EventSignal   m_stop;               ///< Wakes the reader to exit.
+  uint32_t      m_poll_ms;
+  const HAL::Clock
+               *mp_clock;             ///< Of the reader thread.
+
+  float         m_altitude;           ///< meters, the current median.
+  uint32_t      m_echoes;
+  uint32_t      m_misses;
+  uint32_t      m_outliers;
+};
+
+
+#endif
@@ -1,6 +1,7 @@
 //
 // PRUSS program to drive a HY-SRF05 sensor.
-// The results are stored in memory that is accessible from Linux userspace.
+// Each sample is written to the ring of range_ring.h, in the shared memory
+// that is accessible from Linux userspace, and stamped with the IEP timer.
 // An interrupt is triggered each time a new sample is ready.
 //
 // This program is adapted from "ultrasonic", originally writen by Derek Molloy 
@@ -20,18 +21,46 @@
 #define PRU_EVTOUT_0	    3
 #define PRU_EVTOUT_1	    4
 
+// The ring of range_ring.h, at RANGE_RING_OFFSET of the shared memory.
+// Its assertions name these offsets, which must change with them.
+#define RING_ADDRESS        0x00010040
+#define STATUS_OFFSET       0
+#define DELAY_OFFSET        4
+#define ECHO_OFFSET         8
+#define HEAD_OFFSET         12
+#define SLOT_SEQUENCE       16            // of the first slot, 16 bytes each
+#define SLOT_TIMESTAMP      20
+#define SLOT_ECHO           24
+#define SLOT_MASK           15
+#define SLOT_SHIFT          4
+
+// The IEP timer counts at 200 MHz
+#define IEP_GLOBAL_CFG      0x00
+#define IEP_COUNT           0x0C
+#define IEP_ENABLE          0x11          // CNT_EN, DEFAULT_INC = 1
+
 // Using register 0 for all temporary storage (reused multiple times)
 //  Register Usage Key:
 //    r0 - Temporary storage
 //    r1 - Delay, number of milliseconds to wait between samples
 //    r2 - Echo Pulse Width counter, records the width of the return pulse.
 //    r3 - Sample Counter
+//    r7 - IEP timestamp of the sample
+//    r8 - Address of the slot of the sample
+//    r10 - Address of the ring
 // 
 START:
+   // Notify the host process that we have loaded successfully
+   MOV    r10, RING_ADDRESS
+   MOV    r0, 0
+   SBBO   r0, r10, STATUS_OFFSET, 4
+
+   MOV    r0, IEP_ENABLE                  // Start the IEP timer that
+   SBCO   r0, C26, IEP_GLOBAL_CFG, 4      //   stamps the samples
+
    // Read number of samples to read and inter-sample delay
    MOV    r3, 0
-   MOV    r0, 0x00000000                  // Read the delay length
-   LBBO   r1, r0, 0, 4                    //   between samples
+   LBBO   r1, r10, DELAY_OFFSET, 4        // Read the delay length between samples
 
 MAINLOOP:
    MOV    r0, TRIGGER_COUNT               // store length of the trigger pulse delay
@@ -48,7 +77,7 @@ TRIGGERING:                               // The trigger is a 10us high-signal
    MOV    r6, ECHO_DELAY
 WAIT_FOR_ECHO:
    ADD    r5, r5, 1
-   QBGT   MAINLOOP, r6, r5
+   QBGT   RECORD, r6, r5                  // no echo, record a width of zero
    QBBC   WAIT_FOR_ECHO, r31.t3
 
    // start counting (measuring echo pulse width)  until the echo goes low
@@ -57,13 +86,22 @@ COUNTING:
    QBBS   COUNTING, r31.t3                // jump if the echo bit is still high
 
 RECORD:
-   // at this point the echo is now low - write the value to shared memory
-   MOV    r0, 0x00000004                  // going to write the result to this address
-   SBBO   r2, r0, 0, 4                    // store the count at this address
-
+   // at this point the echo is now low - write the sample to the next slot
+   LBCO   r7, C26, IEP_COUNT, 4
+   AND    r8, r3, SLOT_MASK
+   LSL    r8, r8, SLOT_SHIFT
+   ADD    r8, r8, r10
    ADD    r3, r3, 1
-   MOV    r0, 0x00000008                  
-   SBBO   r3, r0, 0, 4                    
+
+   MOV    r0, 0                           // the slot is incomplete while written
+   SBBO   r0, r8, SLOT_SEQUENCE, 4
+   SBBO   r7, r8, SLOT_TIMESTAMP, 4
+   SBBO   r2, r8, SLOT_ECHO, 4
+   SBBO   r3, r8, SLOT_SEQUENCE, 4         // the sequence completes the slot
+
+   SBBO   r2, r10, ECHO_OFFSET, 4
+   SBBO   r3, r10, HEAD_OFFSET, 4
+   LBBO   r1, r10, DELAY_OFFSET, 4
    
 UPDATE_LOOP:
    // generate an interrupt to update the display on the host computer
@@ -0,0 +1,93 @@
+/// @file range_ring.h
+///
+/// The samples of the ultrasonic range finder, shared by the PRU program
+/// that measures them and the flight software that reads them.
+///
+/// The PRU writes each sample to the next slot of a ring in the PRU shared
+/// memory. It clears the sequence of the slot, writes the sample, and then
+/// sets the sequence of the slot and the head of the ring to the number of
+/// samples written. A reader copies the slots between the head it last read
+/// and the current head, and only keeps a copy when the sequence of the slot
+/// is the expected one both before and after the copy. A slot the PRU wrote
+/// again during the copy is discarded, and a reader that falls a full ring
+/// behind skips the samples that were overwritten.
+///
+/// The PRU programs are written in assembly, and repeat the offsets of this
+/// header in range.p and pru0-encoder.asm. The assertions at the end hold
+/// the layout to those offsets, so a change here that the assembly does not
+/// follow fails the build of the flight software.
+///
+//  ****************************************************************************
+#ifndef RANGE_RING_H_INCLUDED
+#define RANGE_RING_H_INCLUDED
+
+#include <stdint.h>
+
+
+#define RANGE_RING_OFFSET     64        ///< bytes, into the PRU shared memory.
+#define RANGE_RING_SLOTS      16        ///< A power of two.
+
+#define RANGE_TICKS_PER_US    200       ///< The IEP timer of the PRU, 200 MHz.
+#define RANGE_ECHO_PER_US     100       ///< The echo is counted with a loop
+                                        ///  of two instructions, at 200 MHz.
+#define RANGE_ECHO_PER_M      (RANGE_ECHO_PER_US * 5800)
+                                        ///< Sound travels to the ground and
+                                        ///  back in 58 us per cm.
+
+
+//  ****************************************************************************
+/// A sample of the range finder.
+///
+typedef struct
+{
+  uint32_t  sequence;                   ///< The number of samples written,
+                                        ///  with this one. Zero while written.
+  uint32_t  timestamp;                  ///< IEP ticks when the echo ended.
+  uint32_t  echo;                       ///< Counts of the echo pulse,
+                                        ///  zero when no echo returned.
+  uint32_t  reserved;
+} RangeSlot;
+
+
+//  ****************************************************************************
+/// The ring at RANGE_RING_OFFSET of the PRU shared memory.
+///
+typedef struct
+{
+  uint32_t  status;                     ///< Set by the loader, and cleared
+                                        ///  by the PRU program when it runs.
+  uint32_t  delay_ms;                   ///< Between samples, set by the loader.
+  uint32_t  echo;                       ///< The echo of the newest sample.
+  uint32_t  head;                       ///< The number of samples written.
+
+  RangeSlot slots[RANGE_RING_SLOTS];    ///< Sample n is in slot n % RANGE_RING_SLOTS.
+} RangeShared;
+
+
+#ifdef __cplusplus
+
+#include <cstddef>
+
+//  ****************************************************************************
+//  The offsets and the sizes that range.p and pru0-encoder.asm depend on.
+//
+static_assert(RANGE_RING_OFFSET == 64,
+              "RING_ADDRESS in range.p, CNT_OFFSET in pru0-encoder.asm");
+static_assert(RANGE_RING_SLOTS == 16,
+              "SLOT_MASK is 15 in range.p and pru0-encoder.asm");
+
+static_assert(offsetof(RangeShared, status)   == 0,  "STATUS_OFFSET, CNT_OFFSET");
+static_assert(offsetof(RangeShared, delay_ms) == 4,  "DELAY_OFFSET");
+static_assert(offsetof(RangeShared, echo)     == 8,  "ECHO_OFFSET, RAW_DIST_OFFSET");
+static_assert(offsetof(RangeShared, head)     == 12, "HEAD_OFFSET, SAMPLE_OFFSET");
+static_assert(offsetof(RangeShared, slots)    == 16, "SLOT_SEQUENCE, SLOTS_OFFSET");
+
+static_assert(sizeof(RangeSlot) == 16,                  "SLOT_SHIFT is 4");
+static_assert(offsetof(RangeSlot, sequence)  == 0,      "SLOT_SEQUENCE");
+static_assert(offsetof(RangeSlot, timestamp) == 4,      "SLOT_TIMESTAMP");
+static_assert(offsetof(RangeSlot, echo)      == 8,      "SLOT_ECHO");
+
+#endif
+
+
+#endif
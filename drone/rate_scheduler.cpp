@@ -0,0 +1,154 @@
+/// @file rate_scheduler.cpp
+///
+/// Runs the tasks of the control loop at rates below the IMU sample rate.
+///
+//  ****************************************************************************
+#include "rate_scheduler.h"
+
+#include <iomanip>
+#include <ostream>
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+uint32_t gcd(uint32_t lhs, uint32_t rhs)
+{
+  while (rhs)
+  {
+    uint32_t remainder = lhs % rhs;
+    lhs = rhs;
+    rhs = remainder;
+  }
+
+  return lhs;
+}
+
+//  ****************************************************************************
+double to_us(uint64_t value_ns)
+{
+  return value_ns / 1000.0;
+}
+
+}
+
+
+//  ****************************************************************************
+const char* to_string(RateGroup group)
+{
+  switch (group)
+  {
+  case k_group_rate:        return "rate";
+  case k_group_angle:       return "angle";
+  case k_group_navigation:  return "navigation";
+  case k_group_telemetry:   return "telemetry";
+  case k_group_battery:     return "battery";
+  default:                  return "unknown";
+  }
+}
+
+
+//  ****************************************************************************
+RateScheduler::RateScheduler()
+{
+  for (int index = 0; index < k_group_count; ++index)
+  {
+    Group &group = m_groups[index];
+
+    group.divider   = 1;
+    group.slot      = 0;
+    group.countdown = 0;
+    group.is_due    = false;
+  }
+}
+
+//  ****************************************************************************
+void RateScheduler::configure(RateGroup group, uint32_t divider, uint64_t budget_ns)
+{
+  m_groups[group].divider = divider ? divider : 1;
+  m_groups[group].timing.budget(budget_ns);
+}
+
+//  ****************************************************************************
+void RateScheduler::stagger()
+{
+  // Two groups share a cycle whenever their slots are equal modulo
+  // the greatest common divisor of their dividers. Each group takes
+  // the first slot that shares cycles with the fewest of the groups
+  // placed before it. The groups that run every cycle share all of them.
+  for (int index = 0; index < k_group_count; ++index)
+  {
+    Group &group = m_groups[index];
+
+    group.slot = 0;
+
+    uint32_t fewest = k_group_count;
+    for (uint32_t slot = 0; slot < group.divider && group.divider > 1; ++slot)
+    {
+      uint32_t shared = 0;
+      for (int placed = 0; placed < index; ++placed)
+      {
+        const Group &other = m_groups[placed];
+        uint32_t     cycle = gcd(group.divider, other.divider);
+
+        if ( other.divider > 1
+          && slot % cycle == other.slot % cycle)
+        {
+          ++shared;
+        }
+      }
+
+      if (shared < fewest)
+      {
+        fewest      = shared;
+        group.slot  = slot;
+      }
+
+      if (0 == fewest)
+      {
+        break;
+      }
+    }
+
+    group.countdown = group.slot;
+    group.is_due    = false;
+  }
+}
+
+//  ****************************************************************************
+void RateScheduler::report(std::ostream &out) const
+{
+  std::ios::fmtflags flags = out.flags();
+
+  out << "Rate group timing (us):\n"
+      << std::setw(12) << "group"
+      << std::setw(10) << "divider"
+      << std::setw(10) << "slot"
+      << std::setw(10) << "count"
+      << std::setw(10) << "overruns"
+      << std::setw(10) << "budget"
+      << std::setw(10) << "p50"
+      << std::setw(10) << "p99"
+      << std::setw(10) << "max" << "\n";
+
+  out << std::fixed << std::setprecision(1);
+
+  for (int index = 0; index < k_group_count; ++index)
+  {
+    const Group            &group = m_groups[index];
+    const LatencyHistogram &hist  = group.timing;
+
+    out << std::setw(12) << to_string(RateGroup(index))
+        << std::setw(10) << group.divider
+        << std::setw(10) << group.slot
+        << std::setw(10) << hist.count()
+        << std::setw(10) << hist.overruns()
+        << std::setw(10) << to_us(hist.budget())
+        << std::setw(10) << to_us(hist.percentile(0.50))
+        << std::setw(10) << to_us(hist.percentile(0.99))
+        << std::setw(10) << to_us(hist.max()) << "\n";
+  }
+
+  out.flags(flags);
+}
@@ -0,0 +1,141 @@
+/// @file rate_scheduler.h
+///
+/// Runs the tasks of the control loop at rates below the IMU sample rate.
+///
+/// Each group of tasks runs once every divider cycles of the control loop.
+/// The groups that do not run every cycle are staggered across the cycles,
+/// so the expensive tasks share a cycle as rarely as their rates allow.
+///
+//  ****************************************************************************
+#ifndef RATE_SCHEDULER_H_INCLUDED
+#define RATE_SCHEDULER_H_INCLUDED
+
+#include <cstdint>
+#include <iosfwd>
+
+#include "utility/histogram.h"
+
+
+//  ****************************************************************************
+/// The groups of tasks performed by the control loop.
+///
+enum RateGroup
+{
+  k_group_rate,                 ///< Rate PIDs and the motors, every sample.
+  k_group_angle,                ///< Angle stabilization PIDs.
+  k_group_navigation,           ///< GPS location and the geofence.
+  k_group_telemetry,            ///< State reported to the ground station.
+  k_group_battery,              ///< Battery voltage.
+
+  k_group_count
+};
+
+
+//  ****************************************************************************
+/// Decides which groups are due in each cycle of the control loop,
+/// and measures the time each group takes against its budget.
+///
+/// Only the control thread may advance the scheduler or record timings.
+/// Reports may be generated from any thread while the loop is running.
+///
+class RateScheduler
+{
+public:
+  //  **************************************************************************
+  RateScheduler();
+
+  //  **************************************************************************
+  /// Sets the rate of a group, and the time allowed each time it runs
+  /// before it is counted as an overrun.
+  /// The new rate takes effect once the groups are staggered.
+  ///
+  /// @param divider    The group runs once every divider cycles, at least 1.
+  ///
+  void configure(RateGroup group, uint32_t divider, uint64_t budget_ns);
+
+  //  **************************************************************************
+  /// Assigns each group to a slot within its period, and restarts the cycles.
+  ///
+  void stagger();
+
+  //  **************************************************************************
+  /// Advances to the next cycle, and determines the groups that are due.
+  ///
+  void next_cycle()
+  {
+    for (int index = 0; index < k_group_count; ++index)
+    {
+      Group &group = m_groups[index];
+
+      group.is_due = (0 == group.countdown);
+      group.countdown = group.is_due
+                      ? group.divider - 1
+                      : group.countdown - 1;
+    }
+  }
+
+  //  **************************************************************************
+  /// Indicates if the group runs in the current cycle.
+  ///
+  bool is_due(RateGroup group) const
+  {
+    return m_groups[group].is_due;
+  }
+
+  //  **************************************************************************
+  /// Records the time the group took in the current cycle, in nanoseconds.
+  ///
+  void record(RateGroup group, uint64_t duration_ns)
+  {
+    m_groups[group].timing.record(duration_ns);
+  }
+
+  //  **************************************************************************
+  uint32_t divider(RateGroup group) const
+  {
+    return m_groups[group].divider;
+  }
+
+  //  **************************************************************************
+  /// Returns the cycle within the period of the group that it runs.
+  ///
+  uint32_t slot(RateGroup group) const
+  {
+    return m_groups[group].slot;
+  }
+
+  //  **************************************************************************
+  /// Returns the histogram that records the time taken by the group.
+  ///
+  const LatencyHistogram& histogram(RateGroup group) const
+  {
+    return m_groups[group].timing;
+  }
+
+  //  **************************************************************************
+  /// Writes a human readable summary of each group.
+  ///
+  void report(std::ostream &out) const;
+
+private:
+  //  **************************************************************************
+  struct Group
+  {
+    uint32_t          divider;
+    uint32_t          slot;
+    uint32_t          countdown;    ///< Cycles until the group is due.
+    bool              is_due;
+    LatencyHistogram  timing;
+  };
+
+  Group   m_groups[k_group_count];
+};
+
+
+//  ****************************************************************************
+/// Returns a short display name for the group.
+///
+const char* to_string(RateGroup group);
+
+
+#endif
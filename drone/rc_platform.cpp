@@ -0,0 +1,519 @@
+/// @file rc_platform.cpp
+///
+/// Binding of the hardware abstraction layer to the robotics cape library.
+///
+//  ****************************************************************************
+#include "rc_platform.h"
+#include "utility/timebase.h"
+
+#include <cstring>
+#include <iostream>
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <rc/pru.h>
+
+
+using std::cout;
+using std::endl;
+
+
+namespace HAL
+{
+
+namespace // unnamed
+{
+
+const
+  int   k_i2c_bus             = 2;
+
+const
+  uint32_t k_i2c_clock_hz     = 400000;               ///< Of the bus of the MPU.
+
+const
+  uint32_t k_i2c_guard        = 10;                   ///< The share of each period of the
+                                                      ///  IMU, in %, left idle before
+                                                      ///  the next sample.
+
+const
+  int   k_imu_sample_rate     = 200;                  ///< Hz, of the DMP.
+
+const
+  uint32_t k_mag_rate         = 100;                  ///< Hz, the most the AK8963
+                                                      ///  magnetometer measures.
+
+const
+  uint64_t k_baro_period_ns   = 40 * k_ns_per_ms;     ///< 25 Hz, between the reads
+                                                      ///  of the BMP280.
+const
+  uint32_t k_baro_bytes       = 6;                    ///< The pressure and temperature.
+
+const
+  int   k_range_pru           = 0;
+const
+  char *k_range_firmware      = "am335x-pru0-qc-range-fw";
+const
+  uint32_t k_range_loaded     = 42;                   ///< Cleared by the PRU program
+                                                      ///  once it runs.
+const
+  int   k_range_load_checks   = 40;                   ///< 100ms apart.
+
+RCIMU *p_imu_instance = nullptr;
+
+}
+
+
+//  ****************************************************************************
+RCIMU::RCIMU(Clock &clock, I2CArbiter &bus)
+  : m_clock(clock)
+  , m_bus(bus)
+  , m_handler(nullptr)
+  , m_config{k_imu_dmp, k_imu_sample_rate, 0.1f, 0.0f}
+  , m_data{0}
+  , m_sample{0}
+  , m_is_exit(false)
+{ }
+
+//  ****************************************************************************
+bool RCIMU::init(IMUHandler handler, const IMUConfig &config)
+{
+  m_handler       = handler;
+  m_config        = config;
+  p_imu_instance  = this;
+
+  // The other devices on the bus are read between the samples.
+  uint64_t period = k_ns_per_s / (k_imu_raw == config.mode ? config.sample_rate
+                                                           : k_imu_sample_rate);
+  m_bus.configure(k_i2c_clock_hz, period, period * k_i2c_guard / 100);
+
+  return k_imu_raw == config.mode
+         ? init_raw()
+         : init_dmp();
+}
+
+//  ****************************************************************************
+bool RCIMU::init_dmp()
+{
+  // Initialize the IMU to trigger our handler with the interrupt handler.
+  rc_mpu_config_t conf = rc_mpu_default_config();
+
+  // We want the magnetometer data fused with the calculations
+  // to help us determine absolute orientation.
+
+  conf.i2c_bus                    = k_i2c_bus;
+  conf.gpio_interrupt_pin_chip    = 3;
+  conf.gpio_interrupt_pin         = 21;
+  conf.enable_magnetometer        = 1;
+  conf.dmp_sample_rate            = k_imu_sample_rate;
+  conf.dmp_interrupt_priority     = k_imu_priority;
+  conf.dmp_interrupt_sched_policy = SCHED_FIFO;
+  // The raw mode rotates its samples into the same axes, with orient_x_back().
+  conf.orient                     = ORIENTATION_X_BACK;
+
+  conf.dmp_fetch_accel_gyro       = 1;
+  conf.show_warnings              = 1;
+
+  int status = rc_mpu_initialize_dmp(&m_data,
+                                     conf);
+  if (0 != status)
+  {
+    cout  << "Error: " << status << "\n"
+          << "IMU initialization failed in: rc_initialize_imu_dmp()\n";
+    return false;
+  }
+
+  // The other devices on the bus are read by the bus thread, below the
+  // threads that consume the samples.
+  if (!m_bus.start(k_bus_priority))
+  {
+    cout << "Error: Could not start the I2C bus thread." << endl;
+    rc_mpu_power_off();
+    return false;
+  }
+
+  rc_mpu_set_dmp_callback(&interrupt_handler);
+
+  return true;
+}
+
+//  ****************************************************************************
+bool RCIMU::init_raw()
+{
+  rc_mpu_config_t conf = rc_mpu_default_config();
+
+  // The filters of the MPU pass the rates the control loop responds to,
+  // and remove the vibration of the motors above them.
+  conf.i2c_bus                    = k_i2c_bus;
+  conf.enable_magnetometer        = 1;
+  conf.accel_fsr                  = ACCEL_FSR_4G;
+  conf.gyro_fsr                   = GYRO_FSR_1000DPS;
+  conf.accel_dlpf                 = ACCEL_DLPF_184;
+  conf.gyro_dlpf                  = GYRO_DLPF_184;
+  conf.show_warnings              = 1;
+
+  int status = rc_mpu_initialize(&m_data,
+                                 conf);
+  if (0 != status)
+  {
+    cout  << "Error: " << status << "\n"
+          << "IMU initialization failed in: rc_mpu_initialize()\n";
+    return false;
+  }
+
+  m_filter.gains(m_config.filter_Kp, m_config.filter_Ki);
+  m_filter.reset();
+
+  m_is_exit = false;
+  m_reader  = std::thread(reader_proc, this);
+
+  sched_param param = {0};
+  param.sched_priority = k_imu_priority;
+
+  if (0 != pthread_setschedparam(m_reader.native_handle(),
+                                 SCHED_FIFO,
+                                 &param))
+  {
+    cout << "Warning: Could not set the real-time priority of the IMU reader thread." << endl;
+  }
+
+  return m_reader.joinable();
+}
+
+//  ****************************************************************************
+void RCIMU::term()
+{
+  m_bus.stop();
+
+  m_is_exit = true;
+
+  if (m_reader.joinable())
+  {
+    m_reader.join();
+  }
+
+  rc_mpu_power_off();
+
+  p_imu_instance = nullptr;
+}
+
+//  ****************************************************************************
+void RCIMU::interrupt_handler()
+{
+  RCIMU *p_this = p_imu_instance;
+  if ( !p_this
+    || !p_this->m_handler)
+  {
+    return;
+  }
+
+  // The sample is stamped with the time of the DMP interrupt rather than
+  // the time this callback runs, which trails it by a variable I2C read.
+  uint64_t timestamp = p_this->m_clock.now_ns();
+
+  int64_t since_interrupt = rc_mpu_nanos_since_last_dmp_interrupt();
+  if ( since_interrupt > 0
+    && uint64_t(since_interrupt) < timestamp)
+  {
+    timestamp -= uint64_t(since_interrupt);
+  }
+
+  const rc_mpu_data_t &data   = p_this->m_data;
+  IMUData             &sample = p_this->m_sample;
+
+  for (int index = 0; index < 3; ++index)
+  {
+    sample.accel[index]           = float(data.accel[index]);
+    sample.gyro[index]            = float(data.gyro[index]);
+    sample.mag[index]             = float(data.mag[index]);
+    sample.fused_TaitBryan[index] = float(data.fused_TaitBryan[index]);
+  }
+
+  for (int index = 0; index < 4; ++index)
+  {
+    sample.fused_quat[index]      = float(data.fused_quat[index]);
+  }
+
+  p_this->m_handler(sample, timestamp);
+
+  p_this->m_bus.notify(timestamp);
+}
+
+//  ****************************************************************************
+void RCIMU::reader_proc(RCIMU *p_this)
+{
+  const uint64_t period       = k_ns_per_s / p_this->m_config.sample_rate;
+  const uint32_t mag_divider  = p_this->m_config.sample_rate > k_mag_rate
+                              ? p_this->m_config.sample_rate / k_mag_rate
+                              : 1;
+
+  rc_mpu_data_t &data   = p_this->m_data;
+  IMUData       &sample = p_this->m_sample;
+
+  uint64_t next = p_this->m_clock.now_ns();
+  uint64_t last = 0;
+
+  for (uint32_t count = 0; !p_this->m_is_exit; ++count)
+  {
+    next += period;
+
+    timespec wake = { time_t(next / k_ns_per_s), long(next % k_ns_per_s) };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr);
+
+    uint64_t timestamp = p_this->m_clock.now_ns();
+
+    // A sample that cannot be read is missed, the drone's watchdog counts it.
+    if ( 0 != rc_mpu_read_accel(&data)
+      || 0 != rc_mpu_read_gyro(&data))
+    {
+      continue;
+    }
+
+    bool has_mag = 0 == count % mag_divider
+                && 0 == rc_mpu_read_mag(&data);
+
+    for (int index = 0; index < 3; ++index)
+    {
+      sample.accel[index] = float(data.accel[index]);
+      sample.gyro[index]  = float(data.gyro[index]);
+      sample.mag[index]   = has_mag ? float(data.mag[index]) : 0.0f;
+    }
+
+    // rc_mpu_initialize() has no orientation, it only applies to the DMP.
+    orient_x_back(sample);
+
+    p_this->m_filter.fuse(sample, to_seconds(last ? timestamp - last : period));
+    last = timestamp;
+
+    if (p_this->m_handler)
+    {
+      p_this->m_handler(sample, timestamp);
+    }
+
+    p_this->m_bus.interrupt(timestamp);
+
+    // A late sample starts the next period, rather than reading to catch up.
+    if (next < timestamp)
+    {
+      next = timestamp;
+    }
+  }
+}
+
+
+//  ****************************************************************************
+bool RCESC::init()
+{
+  // Initialize the servo motor and power levels.
+  if (0 != rc_servo_init( ))
+  {
+    cout  << "Call to initialize servo (motors) failed." << endl;
+    return false;
+  }
+
+  //if (0 != rc_servo_set_esc_range(1000, 2000))
+  //{
+  //  cout  << "Call to initialize the ESC range failed." << endl;
+  //}
+
+  // Disable the power rail for the servo signals.
+  rc_servo_power_rail_en(0);
+
+  return true;
+}
+
+//  ****************************************************************************
+void RCESC::term()
+{
+  rc_servo_cleanup();
+}
+
+//  ****************************************************************************
+int RCESC::send(int channel, double level)
+{
+  return rc_servo_send_esc_pulse_normalized(channel, level);
+}
+
+
+//  ****************************************************************************
+bool RCADC::init()
+{
+  return 0 == rc_adc_init( );
+}
+
+//  ****************************************************************************
+void RCADC::term()
+{
+  rc_adc_cleanup();
+}
+
+//  ****************************************************************************
+float RCADC::battery_voltage()
+{
+  return float(rc_adc_batt());
+}
+
+
+//  ****************************************************************************
+RCBarometer::RCBarometer(Clock &clock, I2CArbiter &bus)
+  : m_clock(clock)
+  , m_bus(bus)
+  , m_is_running(false)
+  , m_due_ns(0)
+{ }
+
+//  ****************************************************************************
+bool RCBarometer::init()
+{
+  // The IMU does not use the bus yet, so the BMP280 is configured directly.
+  if (0 != rc_bmp_init(BMP_OVERSAMPLE_1, BMP_FILTER_16))
+  {
+    cout << "Error: Could not initialize the barometer." << endl;
+    return false;
+  }
+
+  m_is_running  = true;
+  m_due_ns      = m_clock.now_ns();
+
+  return m_bus.submit(k_baro_bytes, m_due_ns, read_proc, this);
+}
+
+//  ****************************************************************************
+void RCBarometer::term()
+{
+  if (m_is_running)
+  {
+    rc_bmp_power_off();
+    m_is_running = false;
+  }
+}
+
+//  ****************************************************************************
+bool RCBarometer::read(BaroData &data)
+{
+  if (!m_samples.acquire())
+  {
+    return false;
+  }
+
+  data = m_samples.read_buffer();
+  return true;
+}
+
+//  ****************************************************************************
+void RCBarometer::read_proc(void *p_context)
+{
+  RCBarometer *p_this = static_cast<RCBarometer*>(p_context);
+
+  rc_bmp_data_t data;
+  if (0 == rc_bmp_read(&data))
+  {
+    BaroData &sample = p_this->m_samples.write_buffer();
+
+    sample.altitude     = float(data.alt_m);
+    sample.temperature  = float(data.temp_c);
+    sample.pressure     = float(data.pressure_pa);
+
+    p_this->m_samples.publish();
+  }
+
+  // The reads keep to their rate, unless a read is a whole period late.
+  uint64_t now = p_this->m_clock.now_ns();
+
+  p_this->m_due_ns += k_baro_period_ns;
+  if (p_this->m_due_ns < now)
+  {
+    p_this->m_due_ns = now + k_baro_period_ns;
+  }
+
+  p_this->m_bus.submit(k_baro_bytes, p_this->m_due_ns, read_proc, p_this);
+}
+
+
+//  ****************************************************************************
+void RCLEDs::set(LED led, bool is_on)
+{
+  rc_led_set(k_led_red == led ? RC_LED_RED : RC_LED_GREEN,
+             is_on ? 1 : 0);
+}
+
+
+//  ****************************************************************************
+RCRangeFinder::RCRangeFinder()
+  : mp_shared(nullptr)
+{ }
+
+//  ****************************************************************************
+volatile RangeShared* RCRangeFinder::init(uint32_t delay_ms)
+{
+  volatile uint32_t *p_memory = rc_pru_shared_mem_ptr();
+  if (nullptr == p_memory)
+  {
+    cout << "Error: Could not map the PRU shared memory." << endl;
+    return nullptr;
+  }
+
+  volatile RangeShared *p_shared =
+    reinterpret_cast<volatile RangeShared*>(
+      reinterpret_cast<volatile uint8_t*>(p_memory) + RANGE_RING_OFFSET);
+
+  // The PRU program clears the status once it runs.
+  p_shared->status    = k_range_loaded;
+  p_shared->delay_ms  = delay_ms;
+  p_shared->echo      = 0;
+  p_shared->head      = 0;
+
+  for (uint32_t index = 0; index < RANGE_RING_SLOTS; ++index)
+  {
+    p_shared->slots[index].sequence = 0;
+  }
+
+  if (rc_pru_start(k_range_pru, k_range_firmware))
+  {
+    cout << "Error: Could not start PRU " << k_range_pru << "." << endl;
+    return nullptr;
+  }
+
+  for (int check = 0; check < k_range_load_checks; ++check)
+  {
+    if (0 == p_shared->status)
+    {
+      mp_shared = p_shared;
+      return mp_shared;
+    }
+
+    usleep(100000);
+  }
+
+  cout << "Error: " << k_range_firmware << " did not start." << endl;
+  rc_pru_stop(k_range_pru);
+
+  return nullptr;
+}
+
+//  ****************************************************************************
+void RCRangeFinder::term()
+{
+  if (nullptr == mp_shared)
+  {
+    return;
+  }
+
+  rc_pru_stop(k_range_pru);
+
+  mp_shared->status = 0;
+  mp_shared         = nullptr;
+}
+
+
+//  ****************************************************************************
+RCPlatform::RCPlatform()
+  : m_bus(m_clock)
+  , m_imu(m_clock, m_bus)
+  , m_baro(m_clock, m_bus)
+{ }
+
+
+} // namespace HAL
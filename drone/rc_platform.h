@@ -0,0 +1,238 @@
+/// @file rc_platform.h
+///
+/// Binding of the hardware abstraction layer to the robotics cape library.
+///
+//  ****************************************************************************
+#ifndef RC_PLATFORM_H_INCLUDED
+#define RC_PLATFORM_H_INCLUDED
+
+#include <atomic>
+#include <thread>
+
+#include "attitude_filter.h"
+#include "hal.h"
+#include "i2c_arbiter.h"
+#include "utility/robotics.h"
+#include "utility/triple_buffer.h"
+
+
+namespace HAL
+{
+
+//  ****************************************************************************
+/// The MPU9250 on the robotics cape.
+///
+/// The DMP reports its fused samples from its interrupt thread. In the raw
+/// mode, a thread reads the accelerometer and the gyro at the sample rate,
+/// and the magnetometer at up to 100 Hz, and fuses each sample itself.
+///
+/// After each sample is read, the other devices on the bus are read in
+/// the time that remains before the next sample. The reader thread reads
+/// them itself. The DMP callback only notifies the bus, whose thread reads
+/// them, so the callback does not wait on the bus.
+///
+class RCIMU
+  : public IMU
+{
+public:
+  //  **************************************************************************
+  RCIMU(Clock &clock, I2CArbiter &bus);
+
+  //  **************************************************************************
+  bool init(IMUHandler handler, const IMUConfig &config);
+  void term();
+
+private:
+  //  **************************************************************************
+  Clock        &m_clock;
+  I2CArbiter   &m_bus;            ///< Shared with the barometer.
+  IMUHandler    m_handler;
+  IMUConfig     m_config;
+  rc_mpu_data_t m_data;           ///< Updated in the background by the DMP,
+                                  ///  or by the reader thread.
+  IMUData       m_sample;
+
+  AttitudeFilter    m_filter;     ///< Fuses the raw samples.
+  std::thread       m_reader;     ///< Reads the raw samples.
+  std::atomic_bool  m_is_exit;    ///< Requests the reader thread to exit.
+
+  //  **************************************************************************
+  bool init_dmp();
+  bool init_raw();
+
+  //  **************************************************************************
+  //  Converts each DMP sample, reports it to the handler, and notifies the
+  //  bus.
+  //
+  static
+    void interrupt_handler();
+
+  //  **************************************************************************
+  //  Reads, fuses and reports a raw sample at each period of the sample rate.
+  //
+  static
+    void reader_proc(RCIMU *p_this);
+};
+
+
+//  ****************************************************************************
+/// ESCs driven by the servo outputs of the robotics cape.
+///
+class RCESC
+  : public ESC
+{
+public:
+  bool init();
+  void term();
+  int  send(int channel, double level);
+};
+
+
+//  ****************************************************************************
+/// The Ultimate GPS, connected to UART 2.
+///
+class RCGPSPort
+  : public GPSPort
+{
+public:
+  const char* device() const
+  {
+    return "/dev/ttyO2";
+  }
+};
+
+
+//  ****************************************************************************
+class RCADC
+  : public ADC
+{
+public:
+  bool  init();
+  void  term();
+  float battery_voltage();
+};
+
+
+//  ****************************************************************************
+/// The BMP280 on the robotics cape, which shares the bus of the MPU9250.
+///
+/// The BMP280 converts continuously, and the most recent conversion is read
+/// as a transaction of the bus, in the time between two samples of the IMU.
+///
+class RCBarometer
+  : public Barometer
+{
+public:
+  //  **************************************************************************
+  RCBarometer(Clock &clock, I2CArbiter &bus);
+
+  //  **************************************************************************
+  bool init();
+  void term();
+  bool read(BaroData &data);
+
+private:
+  //  **************************************************************************
+  Clock        &m_clock;
+  I2CArbiter   &m_bus;
+  bool          m_is_running;
+  uint64_t      m_due_ns;         ///< Of the next read.
+
+  TripleBuffer<BaroData>
+                m_samples;        ///< Hands the samples to the control loop.
+
+  //  **************************************************************************
+  //  Reads a sample, and queues the next read.
+  //
+  static
+    void read_proc(void *p_context);
+};
+
+
+//  ****************************************************************************
+class RCLEDs
+  : public LEDs
+{
+public:
+  void set(LED led, bool is_on);
+};
+
+
+//  ****************************************************************************
+/// The HY-SRF05, measured by PRU 0.
+///
+class RCRangeFinder
+  : public RangeFinder
+{
+public:
+  //  **************************************************************************
+  RCRangeFinder();
+
+  //  **************************************************************************
+  volatile RangeShared* init(uint32_t delay_ms);
+  void term();
+
+private:
+  //  **************************************************************************
+  volatile RangeShared
+               *mp_shared;        ///< In the PRU shared memory, while running.
+};
+
+
+//  ****************************************************************************
+/// The BeagleBone Blue, or a BeagleBone Black with the robotics cape.
+///
+class RCPlatform
+  : public Platform
+{
+public:
+  //  **************************************************************************
+  RCPlatform();
+
+  //  **************************************************************************
+  IMU&      imu()   { return m_imu;   }
+  ESC&      esc()   { return m_esc;   }
+  GPSPort&  gps()   { return m_gps;   }
+  ADC&      adc()   { return m_adc;   }
+  LEDs&     leds()  { return m_leds;  }
+  Clock&    clock() { return m_clock; }
+
+  RangeFinder*  range_finder() { return &m_range; }
+  Barometer*    barometer()    { return &m_baro;  }
+
+  //  **************************************************************************
+  /// Reports the use of the I2C bus the IMU shares with the barometer.
+  ///
+  const I2CArbiter& bus() const
+  {
+    return m_bus;
+  }
+
+  //  **************************************************************************
+  bool is_realtime() const
+  {
+    return true;
+  }
+
+private:
+  //  **************************************************************************
+  MonotonicClock
+            m_clock;
+  I2CArbiter
+            m_bus;
+  RCIMU     m_imu;
+  RCESC     m_esc;
+  RCGPSPort m_gps;
+  RCADC     m_adc;
+  RCLEDs    m_leds;
+  RCRangeFinder
+            m_range;
+  RCBarometer
+            m_baro;
+};
+
+
+} // namespace HAL
+
+
+#endif
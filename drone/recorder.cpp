@@ -0,0 +1,269 @@
+/// @file recorder.cpp
+///
+/// Asynchronous flight-data recorder.
+///
+//  ****************************************************************************
+#include "recorder.h"
+#include "hal.h"
+#include "utility/util.h"
+
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+using std::cout;
+using std::endl;
+
+
+namespace // unnamed
+{
+
+const long  k_drain_period_ns = 20000000;     ///< 20ms between drains.
+const int   k_writer_nice     = 10;           ///< Scheduling niceness of the writer.
+
+}
+
+
+//  ****************************************************************************
+FlightRecorder::FlightRecorder()
+  : m_is_open(false)
+  , m_is_exit(false)
+  , m_sequence(0)
+  , m_dropped(0)
+  , m_written(0)
+  , m_file(-1)
+  , mp_chunk(nullptr)
+  , m_chunk_base(0)
+  , m_offset(0)
+{ }
+
+//  ****************************************************************************
+FlightRecorder::~FlightRecorder()
+{
+  close();
+}
+
+//  ****************************************************************************
+bool FlightRecorder::open(const std::string &path, bool use_writer)
+{
+  if (is_open())
+  {
+    return true;
+  }
+
+  m_file = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (m_file < 0)
+  {
+    cout << "Could not create the flight log: " << path << endl;
+    return false;
+  }
+
+  if (!map_chunk(0))
+  {
+    ::close(m_file);
+    m_file = -1;
+    return false;
+  }
+
+  FlightLogHeader header;
+  ::memset(&header, 0, sizeof(header));
+
+  header.magic          = k_flight_log_magic;
+  header.version        = k_flight_log_version;
+  header.byte_order     = k_flight_log_byte_order;
+  header.header_size    = sizeof(FlightLogHeader);
+  header.record_size    = sizeof(FlightRecord);
+  header.start_time_ns  = HAL::platform().clock().now_ns();
+  header.start_time_utc = ::time(nullptr);
+
+  ::memcpy(mp_chunk, &header, sizeof(header));
+  m_offset    = sizeof(header);
+
+  m_sequence  = 0;
+  m_dropped   = 0;
+  m_written   = 0;
+
+  m_is_exit   = false;
+  if (use_writer)
+  {
+    m_writer  = std::thread(thread_proc, this);
+  }
+
+  m_is_open   = !use_writer || m_writer.joinable();
+
+  return is_open();
+}
+
+//  ****************************************************************************
+void FlightRecorder::close()
+{
+  m_is_open = false;
+  m_is_exit = true;
+
+  if (m_writer.joinable())
+  {
+    m_writer.join();
+  }
+
+  if (m_file < 0)
+  {
+    return;
+  }
+
+  // Without the writer, the records since the last flush remain.
+  drain();
+
+  unmap_chunk();
+
+  // Release the unused portion of the preallocated file.
+  if (0 != ::ftruncate(m_file, m_offset))
+  {
+    cout << "Could not trim the flight log to its recorded length." << endl;
+  }
+
+  ::fsync(m_file);
+  ::close(m_file);
+  m_file = -1;
+}
+
+//  ****************************************************************************
+FlightRecord* FlightRecorder::claim(FlightRecordType type, uint64_t timestamp_ns)
+{
+  if (!is_open())
+  {
+    return nullptr;
+  }
+
+  uint32_t      sequence  = m_sequence++;
+  FlightRecord* p_record  = m_ring.claim();
+  if (!p_record)
+  {
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  p_record->timestamp_ns  = timestamp_ns;
+  p_record->sequence      = sequence;
+  p_record->type          = uint16_t(type);
+  p_record->reserved      = 0;
+
+  return p_record;
+}
+
+//  ****************************************************************************
+void FlightRecorder::flush()
+{
+  if ( is_open()
+    && !m_writer.joinable())
+  {
+    drain();
+  }
+}
+
+//  ****************************************************************************
+void FlightRecorder::thread_proc(FlightRecorder *p_this)
+{
+  if (!p_this)
+    return;
+
+  // Logging must never compete with the control loop for the CPU.
+  ::setpriority(PRIO_PROCESS, ::syscall(SYS_gettid), k_writer_nice);
+
+  timespec period = { 0, k_drain_period_ns };
+
+  while (!p_this->m_is_exit)
+  {
+    ::nanosleep(&period, nullptr);
+    p_this->drain();
+  }
+
+  // Collect the records committed before the recorder was closed.
+  p_this->drain();
+}
+
+//  ****************************************************************************
+void FlightRecorder::drain()
+{
+  bool has_written = false;
+
+  FlightRecord* p_record = m_ring.front();
+  while (p_record)
+  {
+    // Preallocate and move to the next region of the file when full.
+    if (m_offset - m_chunk_base >= k_chunk_size)
+    {
+      if (!map_chunk(m_chunk_base + k_chunk_size))
+      {
+        // Without space in the file, the records can only be dropped.
+        m_dropped.fetch_add(m_ring.size(), std::memory_order_relaxed);
+        while (m_ring.front())
+        {
+          m_ring.pop();
+        }
+
+        return;
+      }
+    }
+
+    ::memcpy(mp_chunk + (m_offset - m_chunk_base), p_record, sizeof(FlightRecord));
+    m_offset += sizeof(FlightRecord);
+
+    m_ring.pop();
+    m_written.fetch_add(1, std::memory_order_relaxed);
+    has_written = true;
+
+    p_record = m_ring.front();
+  }
+
+  // Start the write-back of the new records without waiting on it.
+  if (has_written)
+  {
+    ::msync(mp_chunk, k_chunk_size, MS_ASYNC);
+  }
+}
+
+//  ****************************************************************************
+bool FlightRecorder::map_chunk(size_t base)
+{
+  unmap_chunk();
+
+  int status = ::posix_fallocate(m_file, base, k_chunk_size);
+  if (0 != status)
+  {
+    cout << "Could not preallocate space for the flight log (" << status << ")." << endl;
+    return false;
+  }
+
+  void* p_map = ::mmap(nullptr,
+                       k_chunk_size,
+                       PROT_READ | PROT_WRITE,
+                       MAP_SHARED,
+                       m_file,
+                       base);
+  if (MAP_FAILED == p_map)
+  {
+    cout << "Could not map the flight log into memory." << endl;
+    return false;
+  }
+
+  mp_chunk      = static_cast<uint8_t*>(p_map);
+  m_chunk_base  = base;
+
+  return true;
+}
+
+//  ****************************************************************************
+void FlightRecorder::unmap_chunk()
+{
+  if (mp_chunk)
+  {
+    ::munmap(mp_chunk, k_chunk_size);
+    mp_chunk = nullptr;
+  }
+}
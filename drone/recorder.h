@@ -0,0 +1,153 @@
+/// @file recorder.h
+///
+/// Asynchronous flight-data recorder.
+///
+/// The control loop populates fixed-size binary records in place within a
+/// lock-free ring. A low-priority writer thread drains the ring into a
+/// preallocated, memory-mapped log file. Use the qclog tool to convert the
+/// log into CSV or other formats.
+///
+/// Platforms that step the control loop themselves, such as the simulator,
+/// open the recorder without the writer thread and flush it between cycles,
+/// so no record is dropped however fast the loop runs.
+///
+//  ****************************************************************************
+#ifndef RECORDER_H_INCLUDED
+#define RECORDER_H_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "flight_log.h"
+#include "utility/spsc_ring.h"
+
+
+//  ****************************************************************************
+/// Records flight data without blocking the control loop.
+///
+class FlightRecorder
+{
+public:
+  //  **************************************************************************
+  static const
+    size_t k_ring_size    = 512;                  ///< 2.5s of cycles at 200 Hz.
+
+  static const
+    size_t k_chunk_size   = 8 * 1024 * 1024;      ///< Size of each preallocated
+                                                  ///  region of the log file.
+
+  //  **************************************************************************
+  FlightRecorder();
+  ~FlightRecorder();
+
+  FlightRecorder(const FlightRecorder&)             = delete;
+  FlightRecorder& operator=(const FlightRecorder&)  = delete;
+
+  //  **************************************************************************
+  /// Creates the log file and starts the writer thread.
+  ///
+  /// @param use_writer   false to write the records with flush() instead,
+  ///                     from the thread that runs the control loop.
+  ///
+  bool open(const std::string &path, bool use_writer = true);
+
+  //  **************************************************************************
+  /// Writes any remaining records, trims the log file to the recorded
+  /// length and stops the writer thread.
+  ///
+  void close();
+
+  //  **************************************************************************
+  bool is_open() const
+  {
+    return m_is_open;
+  }
+
+  //  **************************************************************************
+  /// Reserves the next record to be populated by the control loop.
+  /// The timestamp, sequence and type are assigned by the recorder.
+  ///
+  /// @return   The record to populate, followed by a call to commit().
+  ///           nullptr if the recorder is not open, or the ring is full;
+  ///           the record is counted as dropped.
+  ///
+  FlightRecord* claim(FlightRecordType type, uint64_t timestamp_ns);
+
+  //  **************************************************************************
+  /// Hands the claimed record to the writer thread.
+  ///
+  void commit()
+  {
+    m_ring.commit();
+  }
+
+  //  **************************************************************************
+  /// Writes the committed records to the log file, for a recorder opened
+  /// without the writer thread. Call between cycles of the control loop.
+  ///
+  void flush();
+
+  //  **************************************************************************
+  /// Reports the number of records that could not be recorded.
+  ///
+  uint64_t dropped() const
+  {
+    return m_dropped;
+  }
+
+  //  **************************************************************************
+  /// Reports the number of records written to the log file.
+  ///
+  uint64_t written() const
+  {
+    return m_written;
+  }
+
+private:
+  //  **************************************************************************
+  SPSCRing<FlightRecord, k_ring_size>
+                  m_ring;             ///< Records waiting to be written.
+
+  std::atomic_bool
+                  m_is_open;          ///< Indicates records are accepted.
+  std::atomic_bool
+                  m_is_exit;          ///< Requests the writer thread to exit.
+  std::thread     m_writer;           ///< Drains the ring into the log file.
+
+  uint32_t        m_sequence;         ///< The sequence of the next record.
+  std::atomic<uint64_t>
+                  m_dropped;          ///< Count of records that did not fit.
+  std::atomic<uint64_t>
+                  m_written;          ///< Count of records that were written.
+
+  int             m_file;             ///< The log file descriptor.
+  uint8_t*        mp_chunk;           ///< The mapped region of the log file.
+  size_t          m_chunk_base;       ///< File offset of the mapped region.
+  size_t          m_offset;           ///< File offset of the next record.
+
+  //  **************************************************************************
+  //  Low-priority thread that periodically drains the ring.
+  //
+  static
+    void thread_proc(FlightRecorder *p_this);
+
+  //  **************************************************************************
+  //  Writes every record currently in the ring to the log file.
+  //
+  void drain();
+
+  //  **************************************************************************
+  //  Preallocates and maps the chunk of the file that starts at the offset.
+  //
+  bool map_chunk(size_t base);
+
+  //  **************************************************************************
+  //  Releases the mapped region of the log file.
+  //
+  void unmap_chunk();
+};
+
+
+#endif
@@ -0,0 +1,764 @@
+/// @file qcreplay.cpp
+///
+/// Replays a flight log through the flight software.
+///
+/// The IMU samples, GPS locations, battery voltages and ground station
+/// commands recorded in the log drive Drone::command() and Drone::step()
+/// on the replay platform, as fast as the host allows. The replay is
+/// recorded to its own flight log, which qclog converts like any other,
+/// and its cycles are compared to the cycles of a reference log: the
+/// original flight, or an earlier replay.
+/// The timing of the control loop is reported for the replayed cycles.
+///
+/// A replay reproduces the flight exactly when the log has no dropped
+/// records, and the flight.conf in the working directory is the one the
+/// flight was recorded with. Reloads of the configuration during the flight
+/// are not recorded. The drone is armed and disarmed with the first cycle
+/// that records the change.
+///
+/// The integral each PID holds is reported for the replay and for the
+/// reference, which compares the load on the integrators of two flights.
+/// The recorded samples do not respond to the replay, so the flights are
+/// flown with each tuning, and one is the reference of the other. For
+/// example, the gyro bias the integrators absorb without its estimate:
+///
+///   qcsim -s 5 -b 0.5       with gyro_bias.ground_time = 0 and
+///                           gyro_bias.flight_time = 0, renamed fixed.qcl
+///   qcsim -s 5 -b 0.5       with the default flight.conf
+///   qcreplay -r fixed.qcl -e 1 flight-*.qcl
+///
+/// Usage: qcreplay [-o replay.qcl] [-r reference.qcl] [-e tolerance] [-v]
+///                 <log.qcl>
+///
+//  ****************************************************************************
+#include "drone.h"
+#include "flight_log.h"
+#include "replay_platform.h"
+#include "utility/histogram.h"
+#include "utility/util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <unistd.h>
+
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+
+//  ****************************************************************************
+/// Provides the recorded GPS locations to the drone, which reads them
+/// from a receiver the replay platform does not have.
+///
+struct DroneReplay
+{
+  //  **************************************************************************
+  static void location(Drone &drone, const GPS::location_t &location)
+  {
+    drone.m_gps.location(location);
+  }
+};
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+const size_t  k_pid_count = 5;
+
+const char* k_pid_names[k_pid_count] =
+{
+  "roll_stab",
+  "pitch_stab",
+  "roll_rate_pid",
+  "pitch_rate_pid",
+  "rotation"
+};
+
+
+//  ****************************************************************************
+struct Options
+{
+  const char*   p_log;
+  const char*   p_output;
+  const char*   p_reference;      ///< The input log when not specified.
+  double        tolerance;
+  bool          is_verbose;
+};
+
+
+//  ****************************************************************************
+void usage()
+{
+  cerr  << "Usage: qcreplay [-o replay.qcl] [-r reference.qcl] [-e tolerance] [-v]\n"
+        << "                <log.qcl>\n"
+        << "  -o  The flight log of the replay. Default: replay.qcl\n"
+        << "  -r  The log the replay is compared to. Default: the replayed log.\n"
+        << "  -e  Largest difference from the reference. Default: 0, exact.\n"
+        << "  -v  Reports each cycle that differs from the reference.\n";
+}
+
+//  ****************************************************************************
+bool parse_options(int argc, char* argv[], Options &options)
+{
+  options.p_log       = nullptr;
+  options.p_output    = "replay.qcl";
+  options.p_reference = nullptr;
+  options.tolerance   = 0.0;
+  options.is_verbose  = false;
+
+  int option = 0;
+  while (-1 != (option = getopt(argc, argv, "o:r:e:vh")))
+  {
+    switch (option)
+    {
+    case 'o': options.p_output    = optarg;       break;
+    case 'r': options.p_reference = optarg;       break;
+    case 'e': options.tolerance   = atof(optarg); break;
+    case 'v': options.is_verbose  = true;         break;
+    default:
+      return false;
+    }
+  }
+
+  if (optind + 1 != argc)
+  {
+    return false;
+  }
+
+  options.p_log = argv[optind];
+  if (!options.p_reference)
+  {
+    options.p_reference = options.p_log;
+  }
+
+  return options.tolerance >= 0.0;
+}
+
+//  ****************************************************************************
+const PIDRecord& pid_at(const CycleRecord &cycle, size_t index)
+{
+  const PIDRecord* pids[] =
+  {
+    &cycle.roll_stabilize,
+    &cycle.pitch_stabilize,
+    &cycle.roll_rate_pid,
+    &cycle.pitch_rate_pid,
+    &cycle.rotation
+  };
+
+  return *pids[index];
+}
+
+//  ****************************************************************************
+FrameType frame_for(size_t motor_count)
+{
+  switch (motor_count)
+  {
+  case 4:   return k_frame_quad;
+  case 8:   return k_frame_octo;
+  case 6:
+  default:  return k_frame_hex;
+  }
+}
+
+//  ****************************************************************************
+bool same_bits(float lhs, float rhs)
+{
+  return 0 == memcmp(&lhs, &rhs, sizeof(lhs));
+}
+
+
+//  ****************************************************************************
+/// Reads the records of a flight log in order.
+///
+class LogReader
+{
+public:
+  //  **************************************************************************
+  LogReader()
+    : mp_file(nullptr)
+    , m_count(0)
+    , m_expected(0)
+  { }
+
+  //  **************************************************************************
+  ~LogReader()
+  {
+    if (mp_file)
+    {
+      fclose(mp_file);
+    }
+  }
+
+  //  **************************************************************************
+  bool open(const char *p_path)
+  {
+    mp_file = fopen(p_path, "rb");
+    if (!mp_file)
+    {
+      cerr << "Could not open: " << p_path << "\n";
+      return false;
+    }
+
+    m_path = p_path;
+
+    FlightLogHeader header;
+    if (1 != fread(&header, sizeof(header), 1, mp_file))
+    {
+      cerr << p_path << ": The file is too short to be a flight log.\n";
+      return false;
+    }
+
+    if (header.magic != k_flight_log_magic)
+    {
+      cerr << p_path << ": The file is not a flight log.\n";
+      return false;
+    }
+
+    if (header.byte_order != k_flight_log_byte_order)
+    {
+      cerr << p_path << ": The flight log was recorded with a different byte order.\n";
+      return false;
+    }
+
+    if ( header.version     != k_flight_log_version
+      || header.record_size != sizeof(FlightRecord)
+      || header.header_size != sizeof(FlightLogHeader))
+    {
+      cerr << p_path << ": Unsupported flight log version: " << header.version << "\n";
+      return false;
+    }
+
+    return true;
+  }
+
+  //  **************************************************************************
+  /// Reads the next record.
+  ///
+  /// @return   false at the end of the log, or at a record that follows
+  ///           dropped records, after which the flight cannot be replayed.
+  ///
+  bool next(FlightRecord &record)
+  {
+    if (1 != fread(&record, sizeof(record), 1, mp_file))
+    {
+      return false;
+    }
+
+    if (m_count > 0 && record.sequence != m_expected)
+    {
+      cerr << m_path << ": " << uint32_t(record.sequence - m_expected)
+           << " records were dropped at sequence " << m_expected
+           << ", the log ends there.\n";
+      return false;
+    }
+
+    m_expected = record.sequence + 1;
+    ++m_count;
+
+    return true;
+  }
+
+  //  **************************************************************************
+  /// Reads the next cycle record.
+  ///
+  bool next_cycle(FlightRecord &record)
+  {
+    while (next(record))
+    {
+      if (record.type == k_record_cycle)
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+private:
+  FILE*         mp_file;
+  std::string   m_path;
+  uint64_t      m_count;
+  uint32_t      m_expected;
+};
+
+
+//  ****************************************************************************
+/// The records the control loop consumed in one cycle, and the state of
+/// the cycle, if it was recorded.
+///
+struct CycleInputs
+{
+  FlightRecord                sample;
+  std::vector<CommandRecord>  commands;
+  bool                        has_location;
+  GPS::location_t             location;
+  bool                        has_battery;
+  float                       battery_voltage;
+  bool                        has_cycle;
+  CycleRecord                 cycle;
+};
+
+//  ****************************************************************************
+/// Reads the records up to the IMU sample of the next cycle.
+///
+/// @param record   The IMU sample that starts the cycle, on return the
+///                 record that starts the next cycle.
+/// @return         false when no record follows.
+///
+bool read_cycle(LogReader &reader, FlightRecord &record, CycleInputs &inputs)
+{
+  inputs.sample       = record;
+  inputs.has_location = false;
+  inputs.has_battery  = false;
+  inputs.has_cycle    = false;
+  inputs.commands.clear();
+
+  while (reader.next(record))
+  {
+    switch (record.type)
+    {
+    case k_record_imu:
+      return true;
+
+    case k_record_command:
+      inputs.commands.push_back(record.command);
+      break;
+
+    case k_record_gps:
+    {
+      const GPSRecord &gps = record.gps;
+      GPS::location_t &location = inputs.location;
+
+      location.time_stamp   = time_t(gps.time_stamp);
+      location.ms           = gps.ms;
+      location.is_valid     = gps.is_valid != 0;
+      location.latitude     = gps.latitude;
+      location.longitude    = gps.longitude;
+      location.altitude     = gps.altitude;
+      location.speed        = gps.speed;
+      location.true_course  = gps.true_course;
+      location.variation    = gps.variation;
+
+      inputs.has_location   = true;
+      break;
+    }
+
+    case k_record_battery:
+      inputs.battery_voltage  = record.battery.voltage;
+      inputs.has_battery      = true;
+      break;
+
+    case k_record_cycle:
+      inputs.cycle          = record.cycle;
+      inputs.has_cycle      = true;
+      break;
+
+    default:
+      break;
+    }
+  }
+
+  return false;
+}
+
+//  ****************************************************************************
+/// Queues a recorded command, as the receiver thread did.
+///
+bool send(Drone &drone, const CommandRecord &command)
+{
+  switch (command.type)
+  {
+  case k_command_control:
+  {
+    QCopter cmd;
+    cmd.roll    = command.roll;
+    cmd.pitch   = command.pitch;
+    cmd.yaw     = command.yaw;
+    cmd.thrust  = command.thrust;
+
+    return drone.command(cmd);
+  }
+
+  case k_command_gain:
+    return drone.adjust_gain(PIDType(command.pid), command.Kp, command.Ki, command.Kd);
+
+  case k_command_mode:
+    return drone.control_mode(ControlMode(command.control_mode),
+                              command.use_roll  != 0,
+                              command.use_pitch != 0,
+                              command.use_yaw   != 0);
+
+  default:
+    return true;
+  }
+}
+
+
+//  ****************************************************************************
+/// The replayed flight, and the time it took.
+///
+struct ReplayReport
+{
+  uint64_t          cycles;
+  uint64_t          flight_ns;        ///< The time between the first and last samples.
+  uint64_t          wall_ns;
+  uint64_t          unsent_commands;  ///< Commands the drone's queue did not accept.
+  LatencyHistogram  step;             ///< The inputs and step of each cycle.
+
+  ReplayReport()
+    : cycles(0)
+    , flight_ns(0)
+    , wall_ns(0)
+    , unsent_commands(0)
+  { }
+};
+
+//  ****************************************************************************
+bool replay(Replay::ReplayPlatform &platform, const Options &options, ReplayReport &report)
+{
+  LogReader reader;
+  if (!reader.open(options.p_log))
+  {
+    return false;
+  }
+
+  Drone drone;
+  if (!drone.init(options.p_output))
+  {
+    cerr << "An error occurred during Drone::init()" << endl;
+    return false;
+  }
+
+  // The cycles begin with an IMU sample.
+  FlightRecord record;
+  bool         has_record = reader.next(record);
+  while ( has_record
+       && record.type != k_record_imu)
+  {
+    has_record = reader.next(record);
+  }
+
+  CycleInputs inputs;
+  uint64_t    first_ns  = has_record ? record.timestamp_ns : 0;
+  bool        has_frame = false;
+  uint64_t    start     = timestamp_ns();
+
+  while (has_record)
+  {
+    has_record = read_cycle(reader, record, inputs);
+
+    uint64_t step_start = timestamp_ns();
+
+    // The frame and armed state are only known from the cycle's own record.
+    if (inputs.has_cycle)
+    {
+      const CycleRecord &cycle = inputs.cycle;
+
+      if (!has_frame)
+      {
+        drone.frame(frame_for(cycle.motor_count));
+        has_frame = true;
+      }
+
+      if (cycle.is_armed != drone.state().is_armed)
+      {
+        if (cycle.is_armed)
+        {
+          drone.activate();
+        }
+        else
+        {
+          drone.halt();
+        }
+      }
+    }
+
+    if (inputs.has_battery)
+    {
+      platform.replay_adc().voltage(inputs.battery_voltage);
+    }
+
+    for (size_t index = 0; index < inputs.commands.size(); ++index)
+    {
+      if (!send(drone, inputs.commands[index]))
+      {
+        ++report.unsent_commands;
+      }
+    }
+
+    if (inputs.has_location)
+    {
+      DroneReplay::location(drone, inputs.location);
+    }
+
+    const IMURecord &imu    = inputs.sample.imu;
+    HAL::IMUData     sample;
+
+    std::copy(imu.accel,           imu.accel + 3,           sample.accel);
+    std::copy(imu.gyro,            imu.gyro + 3,            sample.gyro);
+    std::copy(imu.mag,             imu.mag + 3,             sample.mag);
+    std::copy(imu.fused_TaitBryan, imu.fused_TaitBryan + 3, sample.fused_TaitBryan);
+    std::copy(imu.fused_quat,      imu.fused_quat + 4,      sample.fused_quat);
+
+    platform.replay_clock().set(inputs.sample.timestamp_ns);
+    platform.replay_imu().publish(sample, inputs.sample.timestamp_ns);
+
+    drone.step();
+
+    report.step.record(timestamp_ns() - step_start);
+    report.flight_ns = inputs.sample.timestamp_ns - first_ns;
+    ++report.cycles;
+  }
+
+  report.wall_ns = timestamp_ns() - start;
+
+  cout << "\n";
+  drone.loop_profiler().report(cout);
+  cout << "\n";
+  drone.scheduler().report(cout);
+  cout << "\n";
+  drone.watchdog().report(cout);
+
+  return true;
+}
+
+
+//  ****************************************************************************
+/// The comparison of the replayed cycles to the reference.
+///
+struct CompareReport
+{
+  uint64_t  cycles;
+  uint64_t  exact;                    ///< Cycles where every output is the same.
+  uint64_t  replay_cycles;            ///< Cycles recorded by the replay.
+  uint64_t  reference_cycles;         ///< Cycles recorded by the reference.
+  uint32_t  first_sequence;           ///< The first cycle that differs.
+  uint64_t  first_time_ns;
+
+  double    pid_error[k_pid_count];
+  double    integral_sqr[k_pid_count];            ///< Of the replay.
+  double    reference_integral_sqr[k_pid_count];
+  double    motor_error;
+  double    throttle_error;
+
+  CompareReport()
+  {
+    memset(this, 0, sizeof(*this));
+  }
+
+  //  **************************************************************************
+  double largest_error() const
+  {
+    double error = std::max(motor_error, throttle_error);
+    for (size_t index = 0; index < k_pid_count; ++index)
+    {
+      error = std::max(error, pid_error[index]);
+    }
+
+    return error;
+  }
+};
+
+//  ****************************************************************************
+/// Compares one output, and updates the largest error.
+///
+bool compare(float replayed, float reference, double &largest)
+{
+  double error = std::fabs(double(replayed) - reference);
+  largest      = std::max(largest, error);
+
+  return same_bits(replayed, reference);
+}
+
+//  ****************************************************************************
+bool compare_logs(const Options &options, CompareReport &report)
+{
+  LogReader replayed;
+  LogReader reference;
+  if ( !replayed.open(options.p_output)
+    || !reference.open(options.p_reference))
+  {
+    return false;
+  }
+
+  FlightRecord lhs;
+  FlightRecord rhs;
+
+  bool has_lhs = replayed.next_cycle(lhs);
+  bool has_rhs = reference.next_cycle(rhs);
+
+  while (has_lhs && has_rhs)
+  {
+    const CycleRecord &cycle = lhs.cycle;
+    const CycleRecord &other = rhs.cycle;
+
+    bool is_exact = compare(cycle.throttle, other.throttle, report.throttle_error)
+                 && cycle.is_critical == other.is_critical;
+
+    for (size_t index = 0; index < k_pid_count; ++index)
+    {
+      float output  = pid_at(cycle, index).output;
+      float logged  = pid_at(other, index).output;
+
+      double integral           = pid_at(cycle, index).integral;
+      double reference_integral = pid_at(other, index).integral;
+
+      report.integral_sqr[index]            += integral * integral;
+      report.reference_integral_sqr[index]  += reference_integral * reference_integral;
+
+      if (!compare(output, logged, report.pid_error[index]))
+      {
+        is_exact = false;
+
+        if (options.is_verbose)
+        {
+          cout << "Sequence " << rhs.sequence << ": "
+               << k_pid_names[index] << " is " << output
+               << ", the reference " << logged << "\n";
+        }
+      }
+    }
+
+    for (size_t index = 0; index < 8; ++index)
+    {
+      is_exact = compare(cycle.motor[index], other.motor[index], report.motor_error)
+              && is_exact;
+    }
+
+    if (!is_exact && report.exact == report.cycles)
+    {
+      report.first_sequence = rhs.sequence;
+      report.first_time_ns  = rhs.timestamp_ns;
+    }
+
+    report.exact += is_exact ? 1 : 0;
+    ++report.cycles;
+
+    has_lhs = replayed.next_cycle(lhs);
+    has_rhs = reference.next_cycle(rhs);
+  }
+
+  report.replay_cycles    = report.cycles;
+  report.reference_cycles = report.cycles;
+
+  while (has_lhs)
+  {
+    ++report.replay_cycles;
+    has_lhs = replayed.next_cycle(lhs);
+  }
+
+  while (has_rhs)
+  {
+    ++report.reference_cycles;
+    has_rhs = reference.next_cycle(rhs);
+  }
+
+  return true;
+}
+
+}
+
+
+//  ****************************************************************************
+int main(int argc, char* argv[])
+{
+  Options options;
+  if (!parse_options(argc, argv, options))
+  {
+    usage();
+    return 1;
+  }
+
+  Replay::ReplayPlatform platform;
+  HAL::platform(&platform);
+
+  // The drone is destroyed at the end of the replay, which closes its log.
+  ReplayReport replayed;
+  if (!replay(platform, options, replayed))
+  {
+    return 1;
+  }
+
+  CompareReport compared;
+  if (!compare_logs(options, compared))
+  {
+    return 1;
+  }
+
+  double flight_time  = to_seconds(replayed.flight_ns);
+  double wall_time    = to_seconds(replayed.wall_ns);
+
+  cout  << std::fixed << std::setprecision(3)
+        << "\nReplayed " << flight_time << "s of flight in " << wall_time << "s, "
+        << std::setprecision(1) << (wall_time > 0.0 ? flight_time / wall_time : 0.0)
+        << "x real-time, " << replayed.cycles << " IMU samples.\n"
+        << std::setprecision(3)
+        << "Step (us): min " << replayed.step.min() / 1000.0
+        << ", p50 " << replayed.step.percentile(0.50) / 1000.0
+        << ", p99 " << replayed.step.percentile(0.99) / 1000.0
+        << ", max " << replayed.step.max() / 1000.0 << "\n";
+
+  if (replayed.unsent_commands)
+  {
+    cout << "Commands the drone did not accept: " << replayed.unsent_commands << "\n";
+  }
+
+  cout.unsetf(std::ios::floatfield);
+  cout  << "\nCompared " << compared.cycles << " cycles to " << options.p_reference
+        << ", " << compared.exact << " exact.\n"
+        << "Largest difference of each PID output:";
+
+  for (size_t index = 0; index < k_pid_count; ++index)
+  {
+    cout << " " << k_pid_names[index] << " " << compared.pid_error[index];
+  }
+
+  cout  << "\n"
+        << "Integral of each PID, rms:";
+
+  for (size_t index = 0; index < k_pid_count; ++index)
+  {
+    double cycles = compared.cycles ? double(compared.cycles) : 1.0;
+
+    cout  << " " << k_pid_names[index]
+          << " " << std::sqrt(compared.integral_sqr[index] / cycles)
+          << " (reference " << std::sqrt(compared.reference_integral_sqr[index] / cycles) << ")";
+  }
+
+  cout  << "\n"
+        << "Largest difference of the throttle: " << compared.throttle_error
+        << ", of the motor levels: " << compared.motor_error << "\n";
+
+  if (compared.exact < compared.cycles)
+  {
+    cout  << "First difference at sequence " << compared.first_sequence
+          << ", " << to_seconds(compared.first_time_ns) << "s.\n";
+  }
+
+  bool is_complete = compared.replay_cycles == compared.reference_cycles;
+  if (!is_complete)
+  {
+    cout  << "The replay recorded " << compared.replay_cycles
+          << " cycles, the reference " << compared.reference_cycles << ".\n";
+  }
+
+  // Without a tolerance, the replay must be exact.
+  bool is_passed = is_complete
+                && (options.tolerance > 0.0
+                    ? compared.largest_error() <= options.tolerance
+                    : compared.exact == compared.cycles);
+
+  cout << (is_passed ? "PASSED" : "FAILED") << "\n";
+
+  return is_passed ? 0 : 1;
+}
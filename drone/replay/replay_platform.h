@@ -0,0 +1,189 @@
+/// @file replay_platform.h
+///
+/// Devices that replay a flight log to the flight software.
+///
+/// Time is the timestamp of the IMU sample being replayed, and the battery
+/// voltage is the one the cycle recorded reading. The platform has no GPS
+/// receiver, the recorded locations are provided to the drone directly.
+///
+//  ****************************************************************************
+#ifndef REPLAY_PLATFORM_H_INCLUDED
+#define REPLAY_PLATFORM_H_INCLUDED
+
+#include "hal.h"
+
+
+namespace Replay
+{
+
+//  ****************************************************************************
+/// The time of the replayed sample, in nanoseconds.
+///
+class ReplayClock
+  : public HAL::Clock
+{
+public:
+  //  **************************************************************************
+  ReplayClock()
+    : m_now_ns(0)
+  { }
+
+  //  **************************************************************************
+  uint64_t now_ns() const
+  {
+    return m_now_ns;
+  }
+
+  //  **************************************************************************
+  void set(uint64_t now_ns)
+  {
+    m_now_ns = now_ns;
+  }
+
+private:
+  uint64_t  m_now_ns;
+};
+
+
+//  ****************************************************************************
+/// Reports the recorded samples to the drone.
+///
+class ReplayIMU
+  : public HAL::IMU
+{
+public:
+  //  **************************************************************************
+  ReplayIMU()
+    : m_handler(nullptr)
+  { }
+
+  //  **************************************************************************
+  bool init(HAL::IMUHandler handler, const HAL::IMUConfig&)
+  {
+    m_handler = handler;
+    return true;
+  }
+
+  //  **************************************************************************
+  void term()
+  {
+    m_handler = nullptr;
+  }
+
+  //  **************************************************************************
+  /// Reports a sample to the drone, with the time it was recorded.
+  ///
+  void publish(const HAL::IMUData &data, uint64_t timestamp_ns)
+  {
+    if (m_handler)
+    {
+      m_handler(data, timestamp_ns);
+    }
+  }
+
+private:
+  HAL::IMUHandler   m_handler;
+};
+
+
+//  ****************************************************************************
+/// The motor levels are recorded in the replayed log.
+///
+class ReplayESC
+  : public HAL::ESC
+{
+public:
+  bool init()                     { return true; }
+  void term()                     { }
+  int  send(int, double)          { return 0; }
+};
+
+
+//  ****************************************************************************
+class ReplayGPSPort
+  : public HAL::GPSPort
+{
+public:
+  const char* device() const      { return nullptr; }
+};
+
+
+//  ****************************************************************************
+/// Reports the battery voltage read in the replayed cycle.
+///
+class ReplayADC
+  : public HAL::ADC
+{
+public:
+  //  **************************************************************************
+  ReplayADC()
+    : m_voltage(0.0f)
+  { }
+
+  //  **************************************************************************
+  bool  init()                    { return true; }
+  void  term()                    { }
+  float battery_voltage()         { return m_voltage; }
+
+  //  **************************************************************************
+  void voltage(float value)
+  {
+    m_voltage = value;
+  }
+
+private:
+  float     m_voltage;
+};
+
+
+//  ****************************************************************************
+class ReplayLEDs
+  : public HAL::LEDs
+{
+public:
+  void set(LED, bool)             { }
+};
+
+
+//  ****************************************************************************
+/// Devices for the replay.
+/// The control loop is stepped by the replay after each IMU sample.
+///
+class ReplayPlatform
+  : public HAL::Platform
+{
+public:
+  //  **************************************************************************
+  HAL::IMU&     imu()   { return m_imu;   }
+  HAL::ESC&     esc()   { return m_esc;   }
+  HAL::GPSPort& gps()   { return m_gps;   }
+  HAL::ADC&     adc()   { return m_adc;   }
+  HAL::LEDs&    leds()  { return m_leds;  }
+  HAL::Clock&   clock() { return m_clock; }
+
+  //  **************************************************************************
+  bool is_realtime() const
+  {
+    return false;
+  }
+
+  //  **************************************************************************
+  ReplayClock&  replay_clock()  { return m_clock; }
+  ReplayIMU&    replay_imu()    { return m_imu;   }
+  ReplayADC&    replay_adc()    { return m_adc;   }
+
+private:
+  //  **************************************************************************
+  ReplayClock   m_clock;
+  ReplayIMU     m_imu;
+  ReplayESC     m_esc;
+  ReplayGPSPort m_gps;
+  ReplayADC     m_adc;
+  ReplayLEDs    m_leds;
+};
+
+
+} // namespace Replay
+
+
+#endif
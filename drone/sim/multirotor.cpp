@@ -0,0 +1,270 @@
+/// @file multirotor.cpp
+///
+/// Six degree of freedom rigid-body model of a multi-rotor airframe.
+///
+//  ****************************************************************************
+#include "multirotor.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace Sim
+{
+
+namespace // unnamed
+{
+
+const double k_gravity  = 9.80665;        ///< m/s^2
+const double k_rad_deg  = 180.0 / M_PI;
+
+const imu::Vector<3> k_magnetic_field(0.0, 18.6, -48.5);  ///< microtesla, east, north
+                                                          ///  and up, near the base.
+
+const imu::Quaternion k_imu_mount(M_SQRT1_2, 0.0, 0.0, -M_SQRT1_2);  ///< From the IMU axes to
+                                                                     ///  the body, -90 degrees
+                                                                     ///  about z.
+
+}
+
+
+//  ****************************************************************************
+Airframe default_airframe()
+{
+  Airframe frame;
+
+  frame.mass          = 2.5;
+  frame.arm_length    = 0.225;
+  frame.inertia[0]    = 0.030;
+  frame.inertia[1]    = 0.030;
+  frame.inertia[2]    = 0.055;
+  frame.max_thrust    = 11.5;
+  frame.yaw_moment    = 0.016;
+  frame.motor_lag     = 0.030;
+  frame.linear_drag   = 0.25;
+  frame.angular_drag  = 0.02;
+  frame.gyro_noise    = 0.05;
+  frame.gyro_bias[0]  = 0.0;
+  frame.gyro_bias[1]  = 0.0;
+  frame.gyro_bias[2]  = 0.0;
+
+  return frame;
+}
+
+
+//  ****************************************************************************
+Multirotor::Multirotor( const MixerTable &mixer,
+                        const Airframe   &frame)
+  : m_frame(frame)
+  , m_motor_count(std::min(mixer.motor_count, size_t(Drone::k_max_motor_count)))
+  , m_position(0.0, 0.0, 0.0)
+  , m_velocity(0.0, 0.0, 0.0)
+  , m_accel(0.0, 0.0, 0.0)
+  , m_rates(0.0, 0.0, 0.0)
+  , m_is_landed(true)
+  , m_noise_source(5489u)
+  , m_gyro_noise(0.0, 1.0)
+{
+  for (size_t index = 0; index < Drone::k_max_motor_count; ++index)
+  {
+    m_arm_x[index]  = 0.0;
+    m_arm_y[index]  = 0.0;
+    m_spin[index]   = 0.0;
+    m_thrust[index] = 0.0;
+  }
+
+  // The mixer commands positive roll with the motors on the left,
+  // and positive pitch with the motors at the front of the frame.
+  // The direction of each arm is recovered from those ratios.
+  for (size_t index = 0; index < m_motor_count; ++index)
+  {
+    double roll   = mixer.p_roll[index];
+    double pitch  = mixer.p_pitch[index];
+
+    double length = std::sqrt(roll * roll + pitch * pitch);
+    if (length > 0.0)
+    {
+      m_arm_x[index] = frame.arm_length * pitch / length;
+      m_arm_y[index] = frame.arm_length * roll  / length;
+    }
+
+    m_spin[index] = mixer.p_yaw[index] < 0.0 ? -1.0 : 1.0;
+  }
+}
+
+//  ****************************************************************************
+void Multirotor::step(const double *p_commands, double dt)
+{
+  // Motors approach the commanded thrust with a first-order lag.
+  double alpha = dt / (m_frame.motor_lag + dt);
+
+  double total  = 0.0;
+  double torque_x = 0.0;
+  double torque_y = 0.0;
+  double torque_z = 0.0;
+
+  for (size_t index = 0; index < m_motor_count; ++index)
+  {
+    double command = p_commands[index];
+    if (command < 0.0)
+    {
+      command = 0.0;
+    }
+    else if (command > 1.0)
+    {
+      command = 1.0;
+    }
+
+    double target = m_frame.max_thrust * command * command;
+    m_thrust[index] += (target - m_thrust[index]) * alpha;
+
+    double thrust = m_thrust[index];
+
+    total     += thrust;
+    torque_x  += m_arm_y[index] * thrust;
+    torque_y  -= m_arm_x[index] * thrust;
+    torque_z  += m_spin[index]  * m_frame.yaw_moment * thrust;
+  }
+
+  // Rotational dynamics, Euler's equations in the body frame.
+  const double *I = m_frame.inertia;
+
+  imu::Vector<3> torque(torque_x, torque_y, torque_z);
+  imu::Vector<3> momentum(I[0] * m_rates.x(), I[1] * m_rates.y(), I[2] * m_rates.z());
+
+  torque = torque - m_rates * m_frame.angular_drag - m_rates.cross(momentum);
+
+  // Translational dynamics in the world frame.
+  imu::Vector<3> thrust = m_attitude.rotateVector(imu::Vector<3>(0.0, 0.0, total));
+
+  m_accel = (thrust - m_velocity * m_frame.linear_drag) / m_frame.mass;
+  m_accel.z() -= k_gravity;
+
+  // The frame rests on the ground until there is enough thrust to lift it.
+  if ( m_is_landed
+    && m_accel.z() <= 0.0)
+  {
+    m_accel     = imu::Vector<3>(0.0, 0.0, 0.0);
+    m_velocity  = imu::Vector<3>(0.0, 0.0, 0.0);
+    m_rates     = imu::Vector<3>(0.0, 0.0, 0.0);
+
+    // Settle level on the ground, with the current heading.
+    double heading = yaw();
+    m_attitude = imu::Quaternion(std::cos(heading / 2), 0.0, 0.0, std::sin(heading / 2));
+    return;
+  }
+
+  m_is_landed = false;
+
+  // Semi-implicit Euler integration.
+  m_rates.x() += torque.x() / I[0] * dt;
+  m_rates.y() += torque.y() / I[1] * dt;
+  m_rates.z() += torque.z() / I[2] * dt;
+
+  imu::Quaternion spin(0.0, m_rates);
+  m_attitude = m_attitude + (m_attitude * spin) * (0.5 * dt);
+  m_attitude.normalize();
+
+  m_velocity = m_velocity + m_accel * dt;
+  m_position = m_position + m_velocity * dt;
+
+  if (m_position.z() <= 0.0)
+  {
+    m_position.z() = 0.0;
+    m_is_landed    = true;
+  }
+}
+
+//  ****************************************************************************
+void Multirotor::sample(HAL::IMUData &data)
+{
+  // The accelerometer measures the specific force in the body frame.
+  imu::Vector<3> specific(m_accel.x(), m_accel.y(), m_accel.z() + k_gravity);
+  imu::Vector<3> accel = m_attitude.conjugate().rotateVector(specific);
+  imu::Vector<3> field = m_attitude.conjugate().rotateVector(k_magnetic_field);
+
+  // The IMU's x axis points to the right of the body, and its y axis forward,
+  // so the drone reports pitch with the nose up, a negative rotation about
+  // the body y axis.
+  data.accel[0] = float(-accel.y());
+  data.accel[1] = float( accel.x());
+  data.accel[2] = float( accel.z());
+
+  data.gyro[0]  = float(-m_rates.y() * k_rad_deg + m_frame.gyro_bias[0] + gyro_noise());
+  data.gyro[1]  = float( m_rates.x() * k_rad_deg + m_frame.gyro_bias[1] + gyro_noise());
+  data.gyro[2]  = float( m_rates.z() * k_rad_deg + m_frame.gyro_bias[2] + gyro_noise());
+
+  data.mag[0]   = float(-field.y());
+  data.mag[1]   = float( field.x());
+  data.mag[2]   = float( field.z());
+
+  data.fused_TaitBryan[HAL::k_tb_pitch_x] = float(pitch());
+  data.fused_TaitBryan[HAL::k_tb_roll_y]  = float(roll());
+  data.fused_TaitBryan[HAL::k_tb_yaw_z]   = float(yaw());
+
+  // The quaternion rotates the IMU axes to earth, as the DMP reports it.
+  imu::Quaternion orientation = m_attitude * k_imu_mount;
+
+  data.fused_quat[0] = float(orientation.w());
+  data.fused_quat[1] = float(orientation.x());
+  data.fused_quat[2] = float(orientation.y());
+  data.fused_quat[3] = float(orientation.z());
+}
+
+//  ****************************************************************************
+double Multirotor::gyro_noise()
+{
+  if (m_frame.gyro_noise <= 0.0)
+  {
+    return 0.0;
+  }
+
+  return m_gyro_noise(m_noise_source) * m_frame.gyro_noise;
+}
+
+//  ****************************************************************************
+double Multirotor::hover_command() const
+{
+  double weight = m_frame.mass * k_gravity;
+
+  return std::sqrt(weight / (m_frame.max_thrust * m_motor_count));
+}
+
+//  ****************************************************************************
+double Multirotor::roll() const
+{
+  const imu::Quaternion &q = m_attitude;
+
+  return std::atan2(2.0 * (q.w() * q.x() + q.y() * q.z()),
+                    1.0 - 2.0 * (q.x() * q.x() + q.y() * q.y()));
+}
+
+//  ****************************************************************************
+double Multirotor::pitch() const
+{
+  const imu::Quaternion &q = m_attitude;
+
+  double sin_pitch = 2.0 * (q.w() * q.y() - q.z() * q.x());
+  if (sin_pitch > 1.0)
+  {
+    sin_pitch = 1.0;
+  }
+  else if (sin_pitch < -1.0)
+  {
+    sin_pitch = -1.0;
+  }
+
+  return -std::asin(sin_pitch);
+}
+
+//  ****************************************************************************
+double Multirotor::yaw() const
+{
+  const imu::Quaternion &q = m_attitude;
+
+  return std::atan2(2.0 * (q.w() * q.z() + q.x() * q.y()),
+                    1.0 - 2.0 * (q.y() * q.y() + q.z() * q.z()));
+}
+
+
+} // namespace Sim
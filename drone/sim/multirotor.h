@@ -0,0 +1,127 @@
+/// @file multirotor.h
+///
+/// Six degree of freedom rigid-body model of a multi-rotor airframe.
+///
+/// The body frame is x forward, y left and z up. The world frame is
+/// east, north and up, with the origin at the takeoff location.
+///
+//  ****************************************************************************
+#ifndef MULTIROTOR_H_INCLUDED
+#define MULTIROTOR_H_INCLUDED
+
+#include <cstddef>
+#include <random>
+
+#include "drone.h"
+#include "hal.h"
+#include "utility/imumaths.h"
+
+
+namespace Sim
+{
+
+//  ****************************************************************************
+/// Physical properties of the airframe.
+///
+struct Airframe
+{
+  double    mass;               ///< kg
+  double    arm_length;         ///< m, from the center of mass to each motor.
+  double    inertia[3];         ///< kg m^2, about the body x, y and z axes.
+  double    max_thrust;         ///< N, of a single motor at full command.
+  double    yaw_moment;         ///< Nm of reaction torque per N of thrust.
+  double    motor_lag;          ///< s, time constant of the motor response.
+  double    linear_drag;        ///< N per m/s.
+  double    angular_drag;       ///< Nm per rad/s.
+  double    gyro_noise;         ///< Standard deviation of the gyro, degrees / second.
+  double    gyro_bias[3];       ///< degrees / second, of each IMU axis of the gyro.
+};
+
+//  ****************************************************************************
+/// A 2.5 kg hexacopter with a 450 mm frame.
+///
+Airframe default_airframe();
+
+
+//  ****************************************************************************
+/// Rigid-body multi-rotor driven by normalized ESC commands.
+///
+/// The position of each motor and the direction it spins are taken from
+/// the mixer table the flight software uses, so the model responds to the
+/// same arm geometry that the drone's controllers command.
+///
+class Multirotor
+{
+public:
+  //  **************************************************************************
+  Multirotor( const MixerTable &mixer,
+              const Airframe   &frame);
+
+  //  **************************************************************************
+  /// Advances the model by a single time step.
+  ///
+  /// @param p_commands   Normalized ESC command for each motor, 0.0 to 1.0.
+  /// @param dt           Length of the time step in seconds.
+  ///
+  void step(const double *p_commands, double dt);
+
+  //  **************************************************************************
+  /// Reports the current state as it would be measured by the drone's IMU.
+  ///
+  void sample(HAL::IMUData &data);
+
+  //  **************************************************************************
+  /// Reports the ESC command that produces enough thrust to hover.
+  ///
+  double hover_command() const;
+
+  //  **************************************************************************
+  const imu::Vector<3>&   position() const    { return m_position; }
+  const imu::Vector<3>&   velocity() const    { return m_velocity; }
+  const imu::Quaternion&  attitude() const    { return m_attitude; }
+  const imu::Vector<3>&   body_rates() const  { return m_rates; }
+
+  //  **************************************************************************
+  /// Reports the roll, nose-up pitch and yaw in radians,
+  /// with the same conventions as the drone's IMU.
+  ///
+  double roll() const;
+  double pitch() const;
+  double yaw() const;
+
+  //  **************************************************************************
+  bool is_landed() const
+  {
+    return m_is_landed;
+  }
+
+private:
+  //  **************************************************************************
+  Airframe          m_frame;
+  size_t            m_motor_count;
+
+  double            m_arm_x[Drone::k_max_motor_count];    ///< m, forward
+  double            m_arm_y[Drone::k_max_motor_count];    ///< m, left
+  double            m_spin[Drone::k_max_motor_count];     ///< +1 or -1
+  double            m_thrust[Drone::k_max_motor_count];   ///< N
+
+  imu::Vector<3>    m_position;       ///< m, world
+  imu::Vector<3>    m_velocity;       ///< m/s, world
+  imu::Vector<3>    m_accel;          ///< m/s^2, world
+  imu::Quaternion   m_attitude;       ///< body to world
+  imu::Vector<3>    m_rates;          ///< rad/s, body
+  bool              m_is_landed;
+
+  std::mt19937      m_noise_source;   ///< Fixed seed, runs are repeatable.
+  std::normal_distribution<double>
+                    m_gyro_noise;     ///< Unit deviation.
+
+  //  **************************************************************************
+  double gyro_noise();
+};
+
+
+} // namespace Sim
+
+
+#endif
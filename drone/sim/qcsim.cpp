@@ -0,0 +1,782 @@
+/// @file qcsim.cpp
+///
+/// Software-in-the-loop simulator for the flight software.
+///
+/// Runs the flight software's control loop against a rigid-body model of
+/// the airframe, as fast as the host allows. A simulated pilot climbs to
+/// the requested altitude, holds a step in attitude during the middle third
+/// of the flight, and then levels off. Unless -n leaves out the GPS, the
+/// drone is armed once it has a fix, so the geofence is tested in flight.
+///
+/// With -g, a ground station thread forwards the pilot's commands and
+/// adjusts the gains of every PID as fast as the command queue accepts
+/// them, and disarms and arms the drone again each second. Each control
+/// cycle verifies that it observed a complete set of gains, and the final
+/// gains and armed state must match the last that were sent.
+///
+/// With -d, the IMU stops reporting samples for a while in the middle of
+/// the flight, and the watchdog degrades the drone until it recovers.
+///
+/// With -b, the gyro reports a bias on each axis, and with -s the drone
+/// rests on the ground, disarmed, before the flight, which is when the
+/// control loop learns most of the bias.
+///
+/// Usage: qcsim [-t seconds] [-a altitude] [-r roll] [-p pitch] [-y yaw_rate]
+///              [-n] [-g] [-d ms] [-b bias] [-s seconds] [-o trace.csv]
+///
+//  ****************************************************************************
+#include "drone.h"
+#include "flight_config.h"
+#include "multirotor.h"
+#include "sim_platform.h"
+#include "utility/timebase.h"
+#include "utility/triple_buffer.h"
+#include "utility/util.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include <unistd.h>
+
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+const uint64_t  k_physics_ns      = k_ns_per_ms;    ///< 1 kHz physics update.
+const unsigned  k_command_divider = 50;             ///< 20 Hz pilot commands.
+const unsigned  k_gps_divider     = 200;            ///< 5 Hz GPS fixes.
+
+const double    k_base_latitude   = 47.6205;        ///< degrees
+const double    k_base_longitude  = -122.3493;      ///< degrees
+const double    k_earth_radius    = 6378137.0;      ///< m
+const double    k_knots_per_ms    = 1.943844;
+
+const uint64_t  k_fix_timeout_ns  = 5 * k_ns_per_s; ///< Wall time to wait for
+                                                    ///  the first GPS fix.
+const unsigned  k_fix_poll_us     = 10000;          ///< Wall time between the
+                                                    ///  fixes while waiting.
+
+//  ****************************************************************************
+struct Options
+{
+  double        duration;         ///< s
+  double        altitude;         ///< m
+  double        roll;             ///< degrees
+  double        pitch;            ///< degrees
+  double        yaw_rate;         ///< normalized command
+  bool          use_gps;
+  bool          stress_gains;     ///< Adjusts the gains throughout the flight.
+  double        dropout;          ///< s, without IMU samples mid-flight.
+  double        gyro_bias;        ///< degrees / second, of each gyro axis.
+  double        rest;             ///< s, disarmed on the ground before the flight.
+  const char*   p_trace;
+};
+
+
+//  ****************************************************************************
+void usage()
+{
+  cerr  << "Usage: qcsim [-t seconds] [-a altitude] [-r roll] [-p pitch] [-y yaw_rate]\n"
+        << "             [-n] [-g] [-d ms] [-b bias] [-s seconds] [-o trace.csv]\n"
+        << "  -t  Length of the simulated flight, in seconds. Default: 10\n"
+        << "  -a  Altitude the pilot holds, in meters. Default: 2\n"
+        << "  -r  Roll step commanded mid-flight, in degrees. Default: 10\n"
+        << "  -p  Pitch step commanded mid-flight, in degrees. Default: 0\n"
+        << "  -y  Yaw command held mid-flight, -1.0 to 1.0. Default: 0\n"
+        << "  -n  Do not simulate the GPS.\n"
+        << "  -g  Adjusts the gains and toggles the arming from a ground station thread\n"
+        << "      throughout the flight.\n"
+        << "  -d  Drops the IMU samples for this long at mid-flight, in ms. Default: 0\n"
+        << "  -b  Bias of each axis of the gyro, in degrees / second. Default: 0\n"
+        << "  -s  Rests on the ground, disarmed, before the flight, in seconds. Default: 0\n"
+        << "  -o  Writes the state of the airframe for each IMU sample to a CSV file.\n";
+}
+
+//  ****************************************************************************
+bool parse_options(int argc, char* argv[], Options &options)
+{
+  options.duration  = 10.0;
+  options.altitude  = 2.0;
+  options.roll      = 10.0;
+  options.pitch     = 0.0;
+  options.yaw_rate  = 0.0;
+  options.use_gps       = true;
+  options.stress_gains  = false;
+  options.dropout       = 0.0;
+  options.gyro_bias     = 0.0;
+  options.rest          = 0.0;
+  options.p_trace       = nullptr;
+
+  int option = 0;
+  while (-1 != (option = getopt(argc, argv, "t:a:r:p:y:ngd:b:s:o:h")))
+  {
+    switch (option)
+    {
+    case 't': options.duration  = atof(optarg); break;
+    case 'a': options.altitude  = atof(optarg); break;
+    case 'r': options.roll      = atof(optarg); break;
+    case 'p': options.pitch     = atof(optarg); break;
+    case 'y': options.yaw_rate  = atof(optarg); break;
+    case 'n': options.use_gps   = false;        break;
+    case 'g': options.stress_gains = true;      break;
+    case 'd': options.dropout   = atof(optarg) / 1000.0; break;
+    case 'b': options.gyro_bias = atof(optarg); break;
+    case 's': options.rest      = atof(optarg); break;
+    case 'o': options.p_trace   = optarg;       break;
+    default:
+      return false;
+    }
+  }
+
+  return options.duration > 0.0
+      && options.dropout  >= 0.0
+      && options.rest     >= 0.0;
+}
+
+
+//  ****************************************************************************
+/// Commands the drone the way a pilot would over the radio link,
+/// holding the altitude with the throttle.
+///
+class Pilot
+{
+public:
+  //  **************************************************************************
+  /// @param hover  ESC command that holds the airframe at a constant altitude.
+  ///
+  Pilot(double hover)
+    : m_integral(0.0)
+  {
+    // The drone scales positive throttle commands to 80% of the motor range,
+    // and the ESCs run from 20% at idle.
+    m_hover = (hover - 0.2) / 0.8 / 0.8;
+  }
+
+  //  **************************************************************************
+  QCopter command(const Sim::Multirotor &model,
+                  double                 altitude,
+                  double                 roll,
+                  double                 pitch,
+                  double                 yaw_rate,
+                  double                 dt)
+  {
+    double error = altitude - model.position().z();
+
+    m_integral  += error * dt;
+    m_integral   = constrain(m_integral, -2.0, 2.0);
+
+    double thrust = m_hover
+                  + 0.10 * error
+                  + 0.02 * m_integral
+                  - 0.15 * model.velocity().z();
+
+    // Commands are normalized to the drone's 30 degree command limit.
+    QCopter cmd;
+    cmd.roll    = to_int16(float(constrain(roll  / 30.0, -1.0, 1.0)));
+    cmd.pitch   = to_int16(float(constrain(pitch / 30.0, -1.0, 1.0)));
+    cmd.yaw     = to_int16(float(constrain(yaw_rate, -1.0, 1.0)));
+    cmd.thrust  = to_int16(float(constrain(thrust, 0.0, 1.0)));
+
+    return cmd;
+  }
+
+private:
+  double    m_hover;
+  double    m_integral;
+};
+
+
+//  ****************************************************************************
+/// Stands in for the receiver thread, the only producer of commands for
+/// the drone. Forwards the pilot's most recent command, and alternates
+/// the gains of every PID between two sets as fast as they are accepted.
+///
+class GroundStation
+{
+public:
+  //  **************************************************************************
+  GroundStation(Drone &drone)
+    : m_drone(drone)
+    , m_is_exit(false)
+    , m_rounds(0)
+    , m_gain_updates(0)
+    , m_toggles(0)
+    , m_is_pending(false)
+    , m_commands(0)
+    , m_toggle(k_toggle_none)
+    , m_set(1)
+    , m_index(0)
+  {
+    const FlightConfig &config = default_flight_config();
+
+    const PIDConfig *p_pids[k_pid_count] =
+    {
+      &config.roll, &config.pitch, &config.roll_rate, &config.pitch_rate, &config.yaw
+    };
+
+    for (size_t index = 0; index < k_pid_count; ++index)
+    {
+      const PIDConfig &pid = *p_pids[index];
+
+      m_gains[0][index] = Gain{pid.Kp, pid.Ki, pid.Kd};
+      m_gains[1][index] = Gain{pid.Kp * 1.1f, pid.Ki * 0.9f, pid.Kd * 1.2f};
+    }
+  }
+
+  //  **************************************************************************
+  /// Sends the first set of gains, so every cycle observes one of the two
+  /// sets, then starts the thread.
+  ///
+  void start()
+  {
+    for (size_t index = 0; index < k_pid_count; ++index)
+    {
+      adjust(0, index);
+    }
+
+    m_thread = std::thread(thread_proc, this);
+  }
+
+  //  **************************************************************************
+  void stop()
+  {
+    m_is_exit = true;
+
+    if (m_thread.joinable())
+    {
+      m_thread.join();
+    }
+  }
+
+  //  **************************************************************************
+  /// Hands the pilot's command to the ground station,
+  /// and waits until the station has tried to queue it for the drone.
+  ///
+  void command(const QCopter &cmd)
+  {
+    m_pilot.write_buffer() = cmd;
+    m_pilot.publish();
+
+    // The round in progress may have already checked for a command.
+    uint64_t round = m_rounds + 2;
+    while (m_rounds < round)
+    {
+      std::this_thread::yield();
+    }
+  }
+
+  //  **************************************************************************
+  /// Indicates if each PID holds one complete set of gains.
+  ///
+  bool is_consistent(const DronePIDs &pids) const
+  {
+    for (size_t index = 0; index < k_pid_count; ++index)
+    {
+      const PIDDesc &desc = state(pids, index).desc;
+      if ( !matches(desc, m_gains[0][index])
+        && !matches(desc, m_gains[1][index]))
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  //  **************************************************************************
+  /// Indicates if each PID holds the last set of gains that was sent.
+  ///
+  bool is_current(const DronePIDs &pids) const
+  {
+    for (size_t index = 0; index < k_pid_count; ++index)
+    {
+      if (!matches(state(pids, index).desc, m_gains[m_last_set[index]][index]))
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  //  **************************************************************************
+  /// Indicates if the last command the station sent armed the drone.
+  /// Valid once the station is stopped.
+  ///
+  bool is_armed() const
+  {
+    return k_toggle_arm != m_toggle;
+  }
+
+  //  **************************************************************************
+  uint64_t gain_updates() const
+  {
+    return m_gain_updates;
+  }
+
+  //  **************************************************************************
+  uint64_t toggles() const
+  {
+    return m_toggles;
+  }
+
+private:
+  //  **************************************************************************
+  struct Gain
+  {
+    float   Kp;
+    float   Ki;
+    float   Kd;
+  };
+
+  static const size_t   k_pid_count       = 5;
+  static const uint64_t k_toggle_divider  = 20;   ///< Pilot commands between
+                                                  ///  the toggles, 1 Hz.
+
+  //  **************************************************************************
+  /// The arming command that waits for room in the queue.
+  ///
+  enum Toggle
+  {
+    k_toggle_none,
+    k_toggle_disarm,
+    k_toggle_arm
+  };
+
+  Drone                 &m_drone;
+  TripleBuffer<QCopter> m_pilot;
+  std::thread           m_thread;
+  std::atomic_bool      m_is_exit;
+  std::atomic<uint64_t> m_rounds;
+  std::atomic<uint64_t> m_gain_updates;
+  std::atomic<uint64_t> m_toggles;
+
+  // Owned by the ground station thread.
+  bool                  m_is_pending;     ///< A pilot command waits for room.
+  uint64_t              m_commands;       ///< From the pilot.
+  Toggle                m_toggle;
+  size_t                m_set;            ///< The set of gains being sent.
+  size_t                m_index;          ///< The PID to adjust next.
+
+  Gain                  m_gains[2][k_pid_count];
+  size_t                m_last_set[k_pid_count];
+
+  //  **************************************************************************
+  static PIDType pid_type(size_t index)
+  {
+    static const PIDType k_types[k_pid_count] =
+    {
+      k_roll, k_pitch, k_roll_rate, k_pitch_rate, k_rotate
+    };
+
+    return k_types[index];
+  }
+
+  //  **************************************************************************
+  static const PIDState& state(const DronePIDs &pids, size_t index)
+  {
+    const PIDState *p_states[k_pid_count] =
+    {
+      &pids.roll, &pids.pitch, &pids.roll_rate, &pids.pitch_rate, &pids.rotation
+    };
+
+    return *p_states[index];
+  }
+
+  //  **************************************************************************
+  static bool matches(const PIDDesc &desc, const Gain &gain)
+  {
+    return desc.Kp == uint64_t(encode_PID(gain.Kp))
+        && desc.Ki == uint64_t(encode_PID(gain.Ki))
+        && desc.Kd == uint64_t(encode_PID(gain.Kd));
+  }
+
+  //  **************************************************************************
+  bool adjust(size_t set, size_t index)
+  {
+    const Gain &gain = m_gains[set][index];
+    if (!m_drone.adjust_gain(pid_type(index), gain.Kp, gain.Ki, gain.Kd))
+    {
+      return false;
+    }
+
+    m_last_set[index] = set;
+    ++m_gain_updates;
+
+    return true;
+  }
+
+  //  **************************************************************************
+  //  Disarms and arms the drone each k_toggle_divider commands of the pilot,
+  //  then forwards the pilot's command, and sends the next gains until the
+  //  queue is full. Never waits for the control loop, which runs on the
+  //  thread that waits for the ground station.
+  //
+  void run_round()
+  {
+    if (m_pilot.acquire())
+    {
+      m_is_pending = true;
+
+      if (0 == ++m_commands % k_toggle_divider)
+      {
+        m_toggle = k_toggle_disarm;
+      }
+    }
+
+    // The arm command resets the thrust, so it precedes the pilot's command.
+    if ( k_toggle_disarm == m_toggle
+      && m_drone.halt())
+    {
+      m_toggle = k_toggle_arm;
+    }
+
+    if ( k_toggle_arm == m_toggle
+      && m_drone.activate())
+    {
+      m_toggle = k_toggle_none;
+      ++m_toggles;
+    }
+
+    if ( m_is_pending
+      && m_drone.command(m_pilot.read_buffer()))
+    {
+      m_is_pending = false;
+    }
+
+    for (size_t count = 0; count < k_pid_count; ++count)
+    {
+      if (!adjust(m_set, m_index))
+        break;
+
+      if (++m_index == k_pid_count)
+      {
+        m_index = 0;
+        m_set  ^= 1;
+      }
+    }
+
+    ++m_rounds;
+  }
+
+  //  **************************************************************************
+  static void thread_proc(GroundStation *p_this)
+  {
+    while (!p_this->m_is_exit)
+    {
+      p_this->run_round();
+    }
+  }
+};
+
+
+//  ****************************************************************************
+double degrees(double radians)
+{
+  return radians * 180.0 / M_PI;
+}
+
+}
+
+
+//  ****************************************************************************
+int main(int argc, char* argv[])
+{
+  Options options;
+  if (!parse_options(argc, argv, options))
+  {
+    usage();
+    return 1;
+  }
+
+  Sim::SimPlatform platform;
+  HAL::platform(&platform);
+
+  if ( options.use_gps
+    && !platform.sim_gps().open())
+  {
+    return 1;
+  }
+
+  Drone drone;
+  if (!drone.init())
+  {
+    cerr << "An error occurred during Drone::init()" << endl;
+    return 1;
+  }
+
+  Sim::Airframe frame = Sim::default_airframe();
+  for (size_t axis = 0; axis < 3; ++axis)
+  {
+    frame.gyro_bias[axis] = options.gyro_bias;
+  }
+
+  Sim::Multirotor model(drone.mixer(), frame);
+
+  Pilot pilot(model.hover_command());
+
+  std::ofstream trace;
+  if (options.p_trace)
+  {
+    trace.open(options.p_trace);
+    if (!trace)
+    {
+      cerr << "Could not open the trace file: " << options.p_trace << endl;
+      return 1;
+    }
+
+    trace << "time,roll,pitch,yaw,roll_cmd,pitch_cmd,east,north,up\n";
+  }
+
+  const double    dt          = to_seconds(k_physics_ns);
+  const uint64_t  imu_divider = platform.sim_imu().period_ns() / k_physics_ns;
+
+  HAL::IMUData    sample      = {{0}};
+
+  // The drone is disarmed on the ground, and only measures the IMU.
+  const uint64_t  rest_steps  = uint64_t(options.rest / dt);
+  for (uint64_t step = 0; step < rest_steps; ++step)
+  {
+    model.step(platform.sim_esc().levels(), dt);
+    platform.sim_clock().advance(k_physics_ns);
+
+    if (0 == step % imu_divider)
+    {
+      model.sample(sample);
+      platform.sim_imu().publish(sample);
+      drone.step();
+    }
+  }
+
+  // The base location is recorded when the drone is armed, so the pilot
+  // waits on the ground for the first fix. The reader of the GPS runs in
+  // wall time, and the simulation does not advance while it waits.
+  if (options.use_gps)
+  {
+    uint64_t wait_start = timestamp_ns();
+    while ( !drone.current_location().is_valid
+         && timestamp_ns() - wait_start < k_fix_timeout_ns)
+    {
+      platform.sim_gps().report(platform.sim_clock().now_ns(),
+                                k_base_latitude,
+                                k_base_longitude,
+                                0.0,
+                                0.0);
+      usleep(k_fix_poll_us);
+    }
+
+    if (!drone.current_location().is_valid)
+    {
+      cerr << "The GPS did not report a fix before the drone was armed." << endl;
+      return 1;
+    }
+  }
+
+  drone.activate();
+
+  GroundStation station(drone);
+  uint64_t      torn_cycles = 0;
+
+  if (options.stress_gains)
+  {
+    station.start();
+  }
+
+  const uint64_t  steps       = uint64_t(options.duration / dt);
+  const double    step_start  = options.duration / 3.0;
+  const double    step_end    = options.duration * 2.0 / 3.0;
+  const double    drop_start  = options.duration / 2.0;
+  const double    drop_end    = drop_start + options.dropout;
+
+  uint64_t        cycles      = 0;
+  double          roll_cmd    = 0.0;
+  double          pitch_cmd   = 0.0;
+  double          error_sqr   = 0.0;
+  double          max_error   = 0.0;
+
+  uint64_t        wall_start  = timestamp_ns();
+
+  for (uint64_t step = 0; step < steps; ++step)
+  {
+    double time = step * dt;
+
+    if (0 == step % k_command_divider)
+    {
+      bool is_step  = time >= step_start && time < step_end;
+      roll_cmd      = is_step ? options.roll  : 0.0;
+      pitch_cmd     = is_step ? options.pitch : 0.0;
+
+      QCopter cmd = pilot.command(model,
+                                  options.altitude,
+                                  roll_cmd,
+                                  pitch_cmd,
+                                  is_step ? options.yaw_rate : 0.0,
+                                  dt * k_command_divider);
+      if (options.stress_gains)
+      {
+        station.command(cmd);
+      }
+      else
+      {
+        drone.command(cmd);
+      }
+    }
+
+    model.step(platform.sim_esc().levels(), dt);
+    platform.sim_clock().advance(k_physics_ns);
+
+    // The motors hold their levels while the IMU is silent.
+    bool is_dropped = time >= drop_start && time < drop_end;
+
+    if (0 == step % imu_divider)
+    {
+      model.sample(sample);
+
+      if (!is_dropped)
+      {
+        platform.sim_imu().publish(sample);
+      }
+
+      if ( !is_dropped
+        && drone.step())
+      {
+        ++cycles;
+
+        if ( options.stress_gains
+          && !station.is_consistent(drone.PID_state()))
+        {
+          ++torn_cycles;
+        }
+      }
+
+      if (!model.is_landed())
+      {
+        double roll_error   = roll_cmd  - degrees(model.roll());
+        double pitch_error  = pitch_cmd - degrees(model.pitch());
+        double error        = std::sqrt(roll_error  * roll_error
+                                      + pitch_error * pitch_error);
+
+        error_sqr += error * error;
+        max_error  = std::max(max_error, error);
+      }
+
+      if (trace.is_open())
+      {
+        const imu::Vector<3> &position = model.position();
+
+        trace << time << ","
+              << degrees(model.roll())  << ","
+              << degrees(model.pitch()) << ","
+              << degrees(model.yaw())   << ","
+              << roll_cmd   << ","
+              << pitch_cmd  << ","
+              << position.x() << ","
+              << position.y() << ","
+              << position.z() << "\n";
+      }
+    }
+
+    if ( options.use_gps
+      && 0 == step % k_gps_divider)
+    {
+      const imu::Vector<3> &position = model.position();
+      const imu::Vector<3> &velocity = model.velocity();
+
+      double latitude   = k_base_latitude
+                        + degrees(position.y() / k_earth_radius);
+      double longitude  = k_base_longitude
+                        + degrees(position.x() / (k_earth_radius * std::cos(k_base_latitude * M_PI / 180.0)));
+      double speed      = std::sqrt(velocity.x() * velocity.x() + velocity.y() * velocity.y());
+      double course     = std::fmod(degrees(std::atan2(velocity.x(), velocity.y())) + 360.0, 360.0);
+
+      platform.sim_gps().report(platform.sim_clock().now_ns(),
+                                latitude,
+                                longitude,
+                                speed * k_knots_per_ms,
+                                course);
+    }
+  }
+
+  double wall_time = to_seconds(timestamp_ns() - wall_start);
+
+  bool is_current  = true;
+  bool is_armed     = true;
+  bool is_expected  = true;
+  if (options.stress_gains)
+  {
+    // Applies the updates that were still queued.
+    station.stop();
+
+    platform.sim_imu().publish(sample);
+    drone.step();
+
+    is_current  = station.is_current(drone.PID_state());
+    is_armed    = drone.state().is_armed;
+    is_expected = station.is_armed() == is_armed;
+  }
+
+  // The control loop does not run again, so the motors only stop if the
+  // halt sends them a zero pulse itself.
+  drone.halt();
+
+  bool is_stopped = true;
+  for (size_t index = 0; index < Drone::k_max_motor_count; ++index)
+  {
+    is_stopped = is_stopped && 0.0 == platform.sim_esc().levels()[index];
+  }
+
+  const imu::Vector<3> &position = model.position();
+
+  cout  << std::fixed << std::setprecision(3)
+        << "\nSimulated " << options.duration << "s in " << wall_time << "s, "
+        << std::setprecision(1) << (wall_time > 0.0 ? options.duration / wall_time : 0.0)
+        << "x real-time, " << cycles << " control cycles.\n"
+        << std::setprecision(3)
+        << "Attitude error (deg): rms " << (cycles ? std::sqrt(error_sqr / cycles) : 0.0)
+        << ", max " << max_error << "\n"
+        << "Final position (m):   east " << position.x()
+        << ", north " << position.y()
+        << ", up " << position.z() << "\n"
+        << "Final attitude (deg): roll " << degrees(model.roll())
+        << ", pitch " << degrees(model.pitch())
+        << ", yaw " << degrees(model.yaw()) << "\n"
+        << "Motors after the halt: " << (is_stopped ? "stopped" : "RUNNING") << "\n";
+
+  GyroBias bias;
+  drone.gyro_bias(bias);
+
+  cout  << "Gyro bias (deg/s):    roll " << degrees(bias.roll)
+        << ", pitch " << degrees(bias.pitch)
+        << ", yaw " << degrees(bias.yaw)
+        << ", from " << bias.samples << " samples\n\n";
+
+  if (options.stress_gains)
+  {
+    cout  << "Gain updates: " << station.gain_updates()
+          << " applied, " << drone.dropped_commands() << " rejected by a full queue.\n"
+          << "Arming toggles: " << station.toggles() << ", final state "
+          << (is_armed ? "armed" : "disarmed")
+          << (is_expected ? "" : ", NOT AS SENT") << "\n"
+          << "Cycles with inconsistent gains: " << torn_cycles << "\n"
+          << "Final gains: " << (is_current ? "current" : "STALE") << "\n\n";
+  }
+
+  drone.loop_profiler().report(cout);
+  cout << "\n";
+  drone.scheduler().report(cout);
+  cout << "\n";
+  drone.watchdog().report(cout);
+
+  return (0 == torn_cycles && is_current && is_expected && is_stopped) ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+/// @file sim_platform.cpp
+///
+/// Simulated devices for the software-in-the-loop simulator.
+///
+//  ****************************************************************************
+#include "sim_platform.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+
+using std::cout;
+using std::endl;
+
+
+namespace Sim
+{
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+/// Formats an angle as NMEA degrees and decimal minutes, i.e. DDMM.MMMM.
+///
+void format_angle(char *p_buffer, size_t size, double degrees, int width)
+{
+  double  value   = std::fabs(degrees);
+  int     whole   = int(value);
+  double  minutes = (value - whole) * 60.0;
+
+  snprintf(p_buffer, size, "%0*d%07.4f", width, whole, minutes);
+}
+
+}
+
+
+//  ****************************************************************************
+SimESC::SimESC()
+{
+  for (size_t index = 0; index < Drone::k_max_motor_count; ++index)
+  {
+    m_levels[index] = 0.0;
+  }
+}
+
+//  ****************************************************************************
+int SimESC::send(int channel, double level)
+{
+  if ( channel < 1
+    || channel > int(Drone::k_max_motor_count))
+  {
+    return -1;
+  }
+
+  m_levels[channel - 1] = level;
+  return 0;
+}
+
+
+//  ****************************************************************************
+SimGPSPort::SimGPSPort()
+  : m_master(-1)
+  , m_slave(-1)
+{ }
+
+//  ****************************************************************************
+SimGPSPort::~SimGPSPort()
+{
+  close();
+}
+
+//  ****************************************************************************
+bool SimGPSPort::open()
+{
+  m_master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if ( m_master < 0
+    || 0 != grantpt(m_master)
+    || 0 != unlockpt(m_master))
+  {
+    cout << "Could not create the simulated GPS port." << endl;
+    close();
+    return false;
+  }
+
+  m_device = ptsname(m_master);
+
+  // Hold the slave open so the port remains valid while the driver
+  // reopens it, and configure it as a raw serial line that does not echo.
+  m_slave = ::open(m_device.c_str(), O_RDWR | O_NOCTTY);
+  if (m_slave < 0)
+  {
+    cout << "Could not open the simulated GPS port " << m_device << "." << endl;
+    close();
+    return false;
+  }
+
+  termios options;
+  tcgetattr(m_slave, &options);
+  cfmakeraw(&options);
+  tcsetattr(m_slave, TCSANOW, &options);
+
+  return true;
+}
+
+//  ****************************************************************************
+void SimGPSPort::close()
+{
+  if (m_slave >= 0)
+  {
+    ::close(m_slave);
+    m_slave = -1;
+  }
+
+  if (m_master >= 0)
+  {
+    ::close(m_master);
+    m_master = -1;
+  }
+
+  m_device.clear();
+}
+
+//  ****************************************************************************
+void SimGPSPort::report(uint64_t  time_ns,
+                        double    latitude,
+                        double    longitude,
+                        double    speed,
+                        double    course)
+{
+  if (m_master < 0)
+  {
+    return;
+  }
+
+  // Discard the configuration commands sent by the driver.
+  char discard[256];
+  while (read(m_master, discard, sizeof(discard)) > 0)
+  { }
+
+  uint64_t  ms      = time_ns / 1000000ULL;
+  unsigned  seconds = unsigned((ms / 1000) % 86400);
+
+  char lat[32];
+  char lon[32];
+  format_angle(lat, sizeof(lat), latitude,  2);
+  format_angle(lon, sizeof(lon), longitude, 3);
+
+  char body[96];
+  int  len = snprintf(body, sizeof(body),
+                      "GPRMC,%02u%02u%02u.%03u,A,%s,%c,%s,%c,%.2f,%.2f,010118,,,A",
+                      seconds / 3600,
+                      (seconds / 60) % 60,
+                      seconds % 60,
+                      unsigned(ms % 1000),
+                      lat, latitude  < 0.0 ? 'S' : 'N',
+                      lon, longitude < 0.0 ? 'W' : 'E',
+                      speed,
+                      course);
+
+  uint8_t checksum = 0;
+  for (int index = 0; index < len; ++index)
+  {
+    checksum ^= uint8_t(body[index]);
+  }
+
+  char sentence[128];
+  len = snprintf(sentence, sizeof(sentence), "$%s*%02X\r\n", body, checksum);
+
+  // The driver may fall behind when the simulation runs faster
+  // than real-time, sentences are dropped rather than blocking.
+  if (write(m_master, sentence, len) < 0)
+  {
+    return;
+  }
+}
+
+
+} // namespace Sim
@@ -0,0 +1,303 @@
+/// @file sim_platform.h
+///
+/// Simulated devices for the software-in-the-loop simulator.
+///
+/// Time only advances when the simulator steps the clock, which allows
+/// the flight software to run as fast as the host allows.
+///
+//  ****************************************************************************
+#ifndef SIM_PLATFORM_H_INCLUDED
+#define SIM_PLATFORM_H_INCLUDED
+
+#include <atomic>
+#include <string>
+
+#include "attitude_filter.h"
+#include "drone.h"
+#include "hal.h"
+#include "utility/timebase.h"
+
+
+namespace Sim
+{
+
+//  ****************************************************************************
+/// Simulated time, in nanoseconds.
+///
+class SimClock
+  : public HAL::Clock
+{
+public:
+  //  **************************************************************************
+  /// The clock starts at one second, zero is not a valid sample time.
+  ///
+  SimClock()
+    : m_now_ns(1000000000ULL)
+  { }
+
+  //  **************************************************************************
+  uint64_t now_ns() const
+  {
+    return m_now_ns;
+  }
+
+  //  **************************************************************************
+  void advance(uint64_t duration_ns)
+  {
+    m_now_ns.store(m_now_ns.load(std::memory_order_relaxed) + duration_ns);
+  }
+
+private:
+  std::atomic<uint64_t>
+            m_now_ns;                 ///< The GPS thread stamps its fixes.
+};
+
+
+//  ****************************************************************************
+const uint64_t  k_dmp_period_ns = 5 * k_ns_per_ms;    ///< The DMP reports at 200 Hz.
+
+
+//  ****************************************************************************
+/// Reports the samples provided by the simulator to the drone.
+///
+/// The DMP reports the orientation of the airframe itself. In the raw mode,
+/// the orientation is estimated from the measurements by an AttitudeFilter.
+///
+class SimIMU
+  : public HAL::IMU
+{
+public:
+  //  **************************************************************************
+  SimIMU(const SimClock &clock)
+    : m_clock(clock)
+    , m_handler(nullptr)
+    , m_mode(HAL::k_imu_dmp)
+    , m_period_ns(k_dmp_period_ns)
+    , m_last_ns(0)
+  { }
+
+  //  **************************************************************************
+  bool init(HAL::IMUHandler handler, const HAL::IMUConfig &config)
+  {
+    m_handler   = handler;
+    m_mode      = config.mode;
+    m_period_ns = HAL::k_imu_raw == config.mode
+                ? k_ns_per_s / config.sample_rate
+                : k_dmp_period_ns;
+    m_last_ns   = 0;
+
+    m_filter.gains(config.filter_Kp, config.filter_Ki);
+    m_filter.reset();
+
+    return true;
+  }
+
+  //  **************************************************************************
+  /// Reports the time between the samples the simulator should publish.
+  ///
+  uint64_t period_ns() const
+  {
+    return m_period_ns;
+  }
+
+  //  **************************************************************************
+  void term()
+  {
+    m_handler = nullptr;
+  }
+
+  //  **************************************************************************
+  /// Reports a sample to the drone, stamped with the current simulated time.
+  ///
+  void publish(const HAL::IMUData &data)
+  {
+    if (!m_handler)
+    {
+      return;
+    }
+
+    uint64_t now = m_clock.now_ns();
+
+    if (HAL::k_imu_dmp == m_mode)
+    {
+      m_handler(data, now);
+      return;
+    }
+
+    HAL::IMUData sample = data;
+    m_filter.fuse(sample, m_last_ns ? to_seconds(now - m_last_ns) : to_seconds(m_period_ns));
+    m_last_ns = now;
+
+    m_handler(sample, now);
+  }
+
+private:
+  const SimClock   &m_clock;
+  HAL::IMUHandler   m_handler;
+  HAL::IMUMode      m_mode;
+  uint64_t          m_period_ns;
+  uint64_t          m_last_ns;          ///< Time of the previous raw sample.
+  AttitudeFilter    m_filter;
+};
+
+
+//  ****************************************************************************
+/// Holds the most recent command sent to each ESC.
+///
+class SimESC
+  : public HAL::ESC
+{
+public:
+  //  **************************************************************************
+  SimESC();
+
+  //  **************************************************************************
+  bool init()   { return true; }
+  void term()   { }
+  int  send(int channel, double level);
+
+  //  **************************************************************************
+  /// Commands for each motor, indexed from 0.
+  ///
+  const double* levels() const
+  {
+    return m_levels;
+  }
+
+private:
+  double    m_levels[Drone::k_max_motor_count];
+};
+
+
+//  ****************************************************************************
+/// Streams NMEA sentences to the drone's GPS driver through a pseudo-terminal.
+///
+class SimGPSPort
+  : public HAL::GPSPort
+{
+public:
+  //  **************************************************************************
+  SimGPSPort();
+  ~SimGPSPort();
+
+  //  **************************************************************************
+  /// Creates the pseudo-terminal the GPS driver opens.
+  ///
+  bool open();
+  void close();
+
+  //  **************************************************************************
+  const char* device() const
+  {
+    return m_device.c_str();
+  }
+
+  //  **************************************************************************
+  /// Sends an RMC sentence for the specified location.
+  ///
+  /// @param time_ns    Simulated time of the fix.
+  /// @param latitude   degrees
+  /// @param longitude  degrees
+  /// @param speed      knots
+  /// @param course     degrees from true north
+  ///
+  void report(uint64_t  time_ns,
+              double    latitude,
+              double    longitude,
+              double    speed,
+              double    course);
+
+private:
+  int           m_master;
+  int           m_slave;
+  std::string   m_device;
+};
+
+
+//  ****************************************************************************
+class SimADC
+  : public HAL::ADC
+{
+public:
+  bool  init()            { return true; }
+  void  term()            { }
+  float battery_voltage() { return 8.4f; }
+};
+
+
+//  ****************************************************************************
+class SimLEDs
+  : public HAL::LEDs
+{
+public:
+  //  **************************************************************************
+  SimLEDs()
+    : m_state{false, false}
+  { }
+
+  //  **************************************************************************
+  void set(LED led, bool is_on)
+  {
+    m_state[led] = is_on;
+  }
+
+  //  **************************************************************************
+  bool is_on(LED led) const
+  {
+    return m_state[led];
+  }
+
+private:
+  bool      m_state[2];
+};
+
+
+//  ****************************************************************************
+/// Devices for the simulator.
+/// The control loop is stepped by the simulator after each IMU sample.
+///
+class SimPlatform
+  : public HAL::Platform
+{
+public:
+  //  **************************************************************************
+  SimPlatform()
+    : m_imu(m_clock)
+  { }
+
+  //  **************************************************************************
+  HAL::IMU&     imu()   { return m_imu;   }
+  HAL::ESC&     esc()   { return m_esc;   }
+  HAL::GPSPort& gps()   { return m_gps;   }
+  HAL::ADC&     adc()   { return m_adc;   }
+  HAL::LEDs&    leds()  { return m_leds;  }
+  HAL::Clock&   clock() { return m_clock; }
+
+  //  **************************************************************************
+  bool is_realtime() const
+  {
+    return false;
+  }
+
+  //  **************************************************************************
+  SimClock&     sim_clock()     { return m_clock; }
+  SimIMU&       sim_imu()       { return m_imu;   }
+  SimESC&       sim_esc()       { return m_esc;   }
+  SimGPSPort&   sim_gps()       { return m_gps;   }
+  SimLEDs&      sim_leds()      { return m_leds;  }
+
+private:
+  //  **************************************************************************
+  SimClock      m_clock;
+  SimIMU        m_imu;
+  SimESC        m_esc;
+  SimGPSPort    m_gps;
+  SimADC        m_adc;
+  SimLEDs       m_leds;
+};
+
+
+} // namespace Sim
+
+
+#endif
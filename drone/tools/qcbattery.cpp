@@ -0,0 +1,356 @@
+/// @file qcbattery.cpp
+///
+/// Tests the battery monitor and the compensation of the throttle against a
+/// simulated pack.
+///
+/// The first test samples a noisy ADC, which now and then fails to convert,
+/// with the BatteryMonitor thread at 50 Hz. The control loop is played by
+/// the main thread, which checks the rate of the readings, their mean, and
+/// that the failed conversions are counted rather than averaged.
+///
+/// The second test flies a drone on a simulated clock, from a charged pack
+/// until it is nearly drained. The voltage of the pack sags with the
+/// throttle, and the drone climbs now and then, above the hover level. The
+/// thrust of the motors follows the square of the throttle times the voltage
+/// under load. The test passes while the thrust at the hover level holds to
+/// the thrust it had at the reference voltage, and the cells are counted
+/// and their voltage estimated.
+///
+/// With -u the throttle is not compensated, for comparison.
+///
+/// Usage: qcbattery [-t seconds] [-f seconds] [-c cells] [-s sag]
+///                  [-n noise] [-e errors] [-u]
+///
+//  ****************************************************************************
+#include "../battery.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include <unistd.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+const float     k_full_cell       = 4.2f;     ///< volts, resting, charged.
+const float     k_empty_cell      = 3.6f;     ///< volts, resting, at landing.
+
+const float     k_hover_level     = 0.3f;
+const float     k_climb_level     = 0.2f;     ///< Above the hover level.
+const double    k_climb_period    = 10.0;     ///< seconds, between the climbs.
+const double    k_climb_time      = 2.0;      ///< seconds, of each climb.
+
+const uint32_t  k_period_ms       = 20;       ///< 50 Hz
+const uint32_t  k_decimation      = 10;
+const double    k_control_dt      = 0.005;    ///< seconds, 200 Hz
+const uint32_t  k_battery_divider = 40;       ///< Cycles between the updates
+                                              ///  of the estimate, 5 Hz.
+const double    k_settle_time     = 10.0;     ///< seconds, before the thrust
+                                              ///  is checked.
+
+const double    k_min_rate_share  = 0.8;      ///< Of the expected readings.
+const double    k_max_thrust_error= 0.02;     ///< Of the thrust at the reference.
+const double    k_max_cell_error  = 0.03;     ///< volts
+
+
+//  ****************************************************************************
+void usage()
+{
+  cerr  << "Usage: qcbattery [-t seconds] [-f seconds] [-c cells] [-s sag]\n"
+        << "                 [-n noise] [-e errors] [-u]\n"
+        << "  -t  Seconds of the test of the sampler. Default: 2\n"
+        << "  -f  Seconds of simulated flight, from charged to drained. Default: 600\n"
+        << "  -c  Cells in the pack, 1 to 4. Default: 2\n"
+        << "  -s  volts, the sag of the pack at full throttle. Default: 0.6\n"
+        << "  -n  volts, the standard deviation of the samples. Default: 0.05\n"
+        << "  -e  The share of the samples the ADC fails to convert. Default: 0.02\n"
+        << "  -u  Flies without the compensation of the throttle.\n";
+}
+
+//  ****************************************************************************
+/// The settings of the tests.
+///
+struct Pack
+{
+  double    seconds;                  ///< Of the test of the sampler.
+  double    flight;                   ///< seconds, simulated.
+  uint32_t  cells;
+  float     sag;                      ///< volts, at full throttle.
+  float     noise;                    ///< volts
+  float     errors;                   ///< The share of the samples.
+  bool      is_compensated;
+};
+
+
+//  ****************************************************************************
+/// An ADC that reads the pack, with noise and failed conversions.
+///
+class PackADC
+  : public HAL::ADC
+{
+public:
+  //  **************************************************************************
+  PackADC(const Pack &pack)
+    : m_random(42)
+    , m_noise(0.0f, pack.noise)
+    , m_share(0.0f, 1.0f)
+    , m_error_share(pack.errors)
+    , m_voltage(0.0f)
+    , m_errors(0)
+  { }
+
+  //  **************************************************************************
+  bool  init()            { return true; }
+  void  term()            { }
+
+  //  **************************************************************************
+  float battery_voltage()
+  {
+    if (m_share(m_random) < m_error_share)
+    {
+      ++m_errors;
+      return -1.0f;
+    }
+
+    return m_voltage + m_noise(m_random);
+  }
+
+  //  **************************************************************************
+  /// Sets the voltage of the pack under load.
+  ///
+  void      voltage(float value)  { m_voltage = value; }
+  uint32_t  errors() const        { return m_errors; }
+
+private:
+  std::mt19937                          m_random;
+  std::normal_distribution<float>       m_noise;
+  std::uniform_real_distribution<float> m_share;
+  float                                 m_error_share;
+
+  std::atomic<float>  m_voltage;
+  uint32_t            m_errors;
+};
+
+
+//  ****************************************************************************
+/// Samples a steady pack with the thread of the monitor.
+///
+/// @return true if the readings arrive at their rate, with the mean voltage.
+///
+bool test_sampler(const Pack &pack)
+{
+  const float voltage = pack.cells * 3.9f;
+
+  PackADC adc(pack);
+  adc.voltage(voltage);
+
+  HAL::MonotonicClock clock;
+
+  BatteryMonitor monitor;
+  monitor.attach(&adc, k_decimation);
+
+  if (!monitor.start(k_period_ms, clock))
+  {
+    cout << "The battery monitor did not start.\n";
+    return false;
+  }
+
+  uint32_t  readings      = 0;
+  uint64_t  last_ns       = 0;
+  double    max_error     = 0.0;
+
+  uint64_t start_ns = timestamp_ns();
+  uint64_t end_ns   = start_ns + seconds_to_ns(pack.seconds);
+
+  for (uint64_t now_ns = start_ns; now_ns < end_ns; now_ns = timestamp_ns())
+  {
+    BatteryReading reading;
+    if ( monitor.latest(reading)
+      && reading.timestamp_ns != last_ns)
+    {
+      last_ns   = reading.timestamp_ns;
+      max_error = std::max(max_error, double(std::fabs(reading.voltage - voltage)));
+      ++readings;
+    }
+
+    std::this_thread::sleep_for(std::chrono::nanoseconds(uint64_t(k_control_dt * k_ns_per_s)));
+  }
+
+  monitor.stop();
+
+  double expected   = pack.seconds * 1000.0 / (k_period_ms * k_decimation);
+  double max_noise  = 4.0 * pack.noise / std::sqrt(double(k_decimation) * (1.0 - pack.errors));
+
+  cout  << "Sampler test:\n"
+        << "  samples " << monitor.samples()
+        << "  errors " << monitor.errors() << " of " << adc.errors()
+        << "  readings " << readings << " of " << expected << "\n"
+        << "  voltage error (V)  max " << max_error
+        << "  allowed " << max_noise << "\n";
+
+  return monitor.errors() == adc.errors()
+      && readings  >= k_min_rate_share * expected
+      && max_error <= max_noise;
+}
+
+//  ****************************************************************************
+/// Flies from a charged pack until it is nearly drained.
+///
+/// @return true if the thrust of the hover level held.
+///
+bool test_flight(const Pack &pack)
+{
+  PackADC adc(pack);
+
+  BatteryMonitor monitor;
+  monitor.attach(&adc, k_decimation);
+
+  // The pack is counted from the first reading, and the hover level was
+  // tuned on a charged pack.
+  const float reference = pack.cells * k_full_cell;
+
+  BatteryEstimator battery;
+  battery.configure(0, pack.sag, pack.is_compensated ? reference : 0.0f, k_hover_level);
+
+  const uint32_t sample_divider = uint32_t(k_period_ms / (1000.0 * k_control_dt) + 0.5);
+  const double   reference_thrust = k_hover_level * (reference - pack.sag * k_hover_level);
+
+  uint64_t  cycles      = uint64_t(pack.flight / k_control_dt);
+  float     voltage     = 0.0f;
+  double    max_error   = 0.0;
+  double    final_error = 0.0;
+  float     cell        = k_full_cell;
+
+  for (uint64_t cycle = 0; cycle < cycles; ++cycle)
+  {
+    double time     = cycle * k_control_dt;
+    bool   is_climb = std::fmod(time, k_climb_period) >= k_climb_period - k_climb_time;
+
+    float throttle  = battery.compensation()
+                    * (is_climb ? k_hover_level + k_climb_level : k_hover_level);
+
+    // The pack drains evenly over the flight, and sags with the throttle.
+    cell            = float(k_full_cell - (k_full_cell - k_empty_cell) * time / pack.flight);
+    float loaded    = pack.cells * cell - pack.sag * throttle;
+
+    adc.voltage(loaded);
+
+    if (0 == cycle % sample_divider)
+    {
+      monitor.poll(seconds_to_ns(time));
+    }
+
+    if (0 == cycle % k_battery_divider)
+    {
+      BatteryReading reading;
+      if (monitor.latest(reading))
+      {
+        voltage = reading.voltage;
+      }
+
+      battery.update(voltage, float(k_battery_divider * k_control_dt));
+    }
+
+    battery.load(throttle, float(k_control_dt));
+
+    // The thrust of the hover level, as a share of the thrust at the reference.
+    double error = throttle * loaded / reference_thrust;
+    error        = error * error - 1.0;
+
+    if (!is_climb)
+    {
+      final_error = error;
+      if (time >= k_settle_time)
+      {
+        max_error = std::max(max_error, std::fabs(error));
+      }
+    }
+  }
+
+  const BatteryEstimate &estimate = battery.estimate();
+
+  double cell_error = std::fabs(estimate.cell_voltage - cell);
+
+  cout  << "Flight test, " << (pack.is_compensated ? "with" : "without") << " compensation:\n"
+        << "  readings " << monitor.readings()
+        << "  cells " << estimate.cells << " of " << pack.cells << "\n"
+        << "  cell voltage (V)  estimate " << estimate.cell_voltage
+        << "  true " << cell
+        << "  error " << cell_error << "\n"
+        << "  compensation " << estimate.compensation << "\n"
+        << "  hover thrust error (%)  max " << 100.0 * max_error
+        << "  final " << 100.0 * final_error << "\n";
+
+  return estimate.cells == pack.cells
+      && cell_error <= k_max_cell_error
+      && max_error  <= k_max_thrust_error;
+}
+
+} // namespace unnamed
+
+
+//  ****************************************************************************
+int main(int argc, char* argv[])
+{
+  Pack pack = { 2.0, 600.0, 2, 0.6f, 0.05f, 0.02f, true };
+
+  int option = 0;
+  while ((option = getopt(argc, argv, "t:f:c:s:n:e:uh")) != -1)
+  {
+    switch (option)
+    {
+    case 't':
+      pack.seconds  = atof(optarg);
+      break;
+    case 'f':
+      pack.flight   = atof(optarg);
+      break;
+    case 'c':
+      pack.cells    = uint32_t(atoi(optarg));
+      break;
+    case 's':
+      pack.sag      = float(atof(optarg));
+      break;
+    case 'n':
+      pack.noise    = float(atof(optarg));
+      break;
+    case 'e':
+      pack.errors   = float(atof(optarg));
+      break;
+    case 'u':
+      pack.is_compensated = false;
+      break;
+    default:
+      usage();
+      return 1;
+    }
+  }
+
+  if ( pack.seconds <= 0.0
+    || pack.flight  <= 0.0
+    || pack.cells   <  1
+    || pack.cells   >  BatteryEstimator::k_max_cells)
+  {
+    usage();
+    return 1;
+  }
+
+  bool is_passed = test_sampler(pack);
+  is_passed      = test_flight(pack) && is_passed;
+
+  cout << (is_passed ? "PASSED" : "FAILED") << "\n";
+
+  return is_passed ? 0 : 1;
+}
@@ -0,0 +1,507 @@
+/// @file qcbus.cpp
+///
+/// Tests the I2CArbiter against a timing model of the I2C bus that the IMU
+/// shares with the barometer.
+///
+/// The model runs on a simulated clock. The IMU interrupts once each period,
+/// with jitter, and its FIFO is read right away; now and then the FIFO holds
+/// two samples. Each transaction takes up to a stretch longer than the
+/// arbiter estimates, as the devices hold the clock of the bus low. Besides
+/// the barometer, a second device reads a larger block at a lower rate, to
+/// load the bus.
+///
+/// A collision is a transaction of the barometer or of the load that still
+/// runs when the IMU interrupts, which delays the read of the IMU. The test
+/// passes without collisions, and with the barometer read at its rate.
+///
+/// With -u the transactions run as soon as they are due instead, as they
+/// would without the arbiter, for comparison.
+///
+/// The callback test then runs the arbiter on the monotonic clock, with a
+/// stub of the DMP that interrupts at the rate on its own thread, and a
+/// barometer whose reads sleep for the time of the transaction. In the
+/// inline path, as the DMP callback ran before, the callback runs the
+/// transactions. In the thread path, the callback notifies the arbiter and
+/// its bus thread runs them. The test reports the time the DMP thread spends
+/// in the callback, and passes when the thread path reads the barometer at
+/// its rate, and its callback returns in a small share of a read.
+///
+/// Usage: qcbus [-t seconds] [-r rate] [-j jitter] [-s stretch] [-g guard]
+///              [-b baro_rate] [-l load_bytes] [-c seconds] [-u]
+///
+//  ****************************************************************************
+#include "../i2c_arbiter.h"
+#include "../utility/histogram.h"
+#include "../utility/timebase.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+const uint32_t  k_clock_hz        = 400000;
+const uint32_t  k_fifo_bytes      = 32;       ///< A DMP packet and its count.
+const double    k_double_fifo     = 0.05;     ///< The share of the reads of two
+                                              ///  packets.
+const uint32_t  k_baro_bytes      = 6;
+const double    k_load_rate       = 10.0;     ///< Hz
+const double    k_min_baro_share  = 0.9;      ///< Of the requested reads.
+const double    k_max_callback_share = 0.25;  ///< Of a read of the barometer.
+
+
+//  ****************************************************************************
+void usage()
+{
+  cerr  << "Usage: qcbus [-t seconds] [-r rate] [-j jitter] [-s stretch] [-g guard]\n"
+        << "             [-b baro_rate] [-l load_bytes] [-u]\n"
+        << "  -t  Seconds of simulated time. Default: 60\n"
+        << "  -r  Hz, the rate of the IMU interrupts. Default: 200\n"
+        << "  -j  us, the jitter of the interrupts. Default: 50\n"
+        << "  -s  The most a transaction takes longer than estimated, in %. Default: 20\n"
+        << "  -g  The share of each period left idle before an interrupt, in %. Default: 10\n"
+        << "  -b  Hz, the rate of the barometer. Default: 25\n"
+        << "  -l  Bytes read by the load device at 10 Hz, 0 for none. Default: 64\n"
+        << "  -c  Seconds of each path of the callback test, 0 for none. Default: 2\n"
+        << "  -u  Runs the transactions when due, without the arbiter.\n";
+}
+
+//  ****************************************************************************
+/// The clock of the model, advanced by the transactions.
+///
+class ModelClock
+  : public HAL::Clock
+{
+public:
+  ModelClock() : m_now_ns(0) { }
+
+  uint64_t now_ns() const           { return m_now_ns; }
+  void     set(uint64_t now_ns)     { m_now_ns = now_ns; }
+  void     advance(uint64_t ns)     { m_now_ns += ns; }
+
+private:
+  uint64_t m_now_ns;
+};
+
+
+//  ****************************************************************************
+/// The timing of the transactions on the bus.
+///
+struct Bus
+{
+  ModelClock   &clock;
+  I2CArbiter   &arbiter;
+  std::mt19937  random;
+  std::uniform_real_distribution<double>
+                stretch;
+
+  //  **************************************************************************
+  /// Advances the clock by the time a transaction takes.
+  ///
+  void transfer(uint32_t bytes)
+  {
+    clock.advance(uint64_t(arbiter.duration_ns(bytes) * (1.0 + stretch(random))));
+  }
+};
+
+
+//  ****************************************************************************
+/// A device that is read periodically, in transactions of the arbiter.
+///
+struct Device
+{
+  const char   *name;
+  Bus          *p_bus;
+  uint32_t      bytes;
+  uint64_t      period_ns;
+  bool          is_arbitrated;
+
+  uint64_t      due_ns;               ///< Of the next read, without the arbiter.
+  uint64_t      reads;
+  uint64_t      last_ns;
+  uint64_t      max_interval_ns;
+
+  //  **************************************************************************
+  void start()
+  {
+    due_ns = p_bus->clock.now_ns();
+    submit();
+  }
+
+  //  **************************************************************************
+  void submit()
+  {
+    if (is_arbitrated)
+    {
+      p_bus->arbiter.submit(bytes, due_ns, read_proc, this);
+    }
+  }
+
+  //  **************************************************************************
+  static void read_proc(void *p_context)
+  {
+    Device *p_this = static_cast<Device*>(p_context);
+    Bus    &bus    = *p_this->p_bus;
+
+    bus.transfer(p_this->bytes);
+
+    uint64_t now_ns = bus.clock.now_ns();
+    if (p_this->reads > 0)
+    {
+      p_this->max_interval_ns = std::max(p_this->max_interval_ns, now_ns - p_this->last_ns);
+    }
+
+    p_this->last_ns = now_ns;
+    ++p_this->reads;
+
+    // The reads keep to their rate, unless a read is a whole period late.
+    p_this->due_ns += p_this->period_ns;
+    if (p_this->due_ns < now_ns)
+    {
+      p_this->due_ns = now_ns + p_this->period_ns;
+    }
+
+    p_this->submit();
+  }
+};
+
+
+//  ****************************************************************************
+/// Converts a duration in nanoseconds to microseconds.
+///
+double to_us(uint64_t duration_ns)
+{
+  return double(duration_ns) / k_ns_per_us;
+}
+
+//  ****************************************************************************
+/// Delivers the interrupts of a stub DMP to the arbiter on the monotonic
+/// clock, by one of the two paths.
+///
+class Callback
+{
+public:
+  //  **************************************************************************
+  Callback(double rate, double baro_rate, uint64_t guard_ns, bool is_threaded)
+    : m_arbiter(m_clock)
+    , m_is_threaded(is_threaded)
+    , m_period_ns(uint64_t(k_ns_per_s / rate))
+    , m_baro_period_ns(uint64_t(k_ns_per_s / baro_rate))
+    , m_due_ns(0)
+    , m_reads(0)
+  {
+    m_arbiter.configure(k_clock_hz, m_period_ns, guard_ns);
+  }
+
+  //  **************************************************************************
+  /// Runs the interrupts of the stub for a number of seconds.
+  ///
+  void run(double seconds)
+  {
+    m_due_ns = m_clock.now_ns();
+    m_arbiter.submit(k_baro_bytes, m_due_ns, read_proc, this);
+
+    if (m_is_threaded)
+    {
+      m_arbiter.start(HAL::k_bus_priority);
+    }
+
+    std::thread dmp(dmp_proc, this, uint32_t(seconds * k_ns_per_s / m_period_ns));
+
+    sched_param param = {0};
+    param.sched_priority = HAL::k_imu_priority;
+    pthread_setschedparam(dmp.native_handle(), SCHED_FIFO, &param);
+
+    dmp.join();
+
+    m_arbiter.stop();
+  }
+
+  //  **************************************************************************
+  void report(std::ostream &out) const
+  {
+    std::ios::fmtflags flags = out.flags();
+
+    out << std::fixed << std::setprecision(1)
+        << "  " << (m_is_threaded ? "thread" : "inline")
+        << ": " << m_reads << " reads, callback (us)"
+        << "  p50 " << to_us(m_callback.percentile(0.50))
+        << "  p99 " << to_us(m_callback.percentile(0.99))
+        << "  max " << to_us(m_callback.max()) << "\n";
+
+    out.flags(flags);
+  }
+
+  //  **************************************************************************
+  uint64_t                reads()     const { return m_reads;     }
+  const LatencyHistogram& callback()  const { return m_callback;  }
+
+private:
+  //  **************************************************************************
+  //  The stub of the DMP, which interrupts once each period.
+  //
+  static
+    void dmp_proc(Callback *p_this, uint32_t count)
+  {
+    uint64_t deadline = p_this->m_clock.now_ns();
+
+    for (uint32_t index = 0; index < count; ++index)
+    {
+      deadline += p_this->m_period_ns;
+
+      timespec next = { time_t(deadline / k_ns_per_s), long(deadline % k_ns_per_s) };
+      while (0 != clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr))
+      { }
+
+      // The callback runs once the FIFO was read, as RCIMU stamps it.
+      uint64_t timestamp = p_this->m_clock.now_ns();
+
+      if (p_this->m_is_threaded)
+      {
+        p_this->m_arbiter.notify(timestamp);
+      }
+      else
+      {
+        p_this->m_arbiter.interrupt(timestamp);
+      }
+
+      p_this->m_callback.record(p_this->m_clock.now_ns() - timestamp);
+    }
+  }
+
+  //  **************************************************************************
+  //  Reads the barometer, which blocks for the time of the transaction.
+  //
+  static
+    void read_proc(void *p_context)
+  {
+    Callback *p_this = static_cast<Callback*>(p_context);
+
+    uint64_t duration_ns = p_this->m_arbiter.duration_ns(k_baro_bytes);
+    std::this_thread::sleep_for(std::chrono::nanoseconds(duration_ns));
+
+    ++p_this->m_reads;
+
+    uint64_t now_ns = p_this->m_clock.now_ns();
+
+    p_this->m_due_ns += p_this->m_baro_period_ns;
+    if (p_this->m_due_ns < now_ns)
+    {
+      p_this->m_due_ns = now_ns + p_this->m_baro_period_ns;
+    }
+
+    p_this->m_arbiter.submit(k_baro_bytes, p_this->m_due_ns, read_proc, p_this);
+  }
+
+  //  **************************************************************************
+  HAL::MonotonicClock   m_clock;
+  I2CArbiter            m_arbiter;
+  bool                  m_is_threaded;
+  uint64_t              m_period_ns;
+  uint64_t              m_baro_period_ns;
+  uint64_t              m_due_ns;             ///< Of the next read.
+  uint64_t              m_reads;              ///< Written by the thread of
+                                              ///  the transactions.
+  LatencyHistogram      m_callback;
+};
+
+} // namespace unnamed
+
+
+//  ****************************************************************************
+int main(int argc, char* argv[])
+{
+  double    seconds     = 60.0;
+  double    rate        = 200.0;
+  double    jitter_us   = 50.0;
+  double    stretch     = 20.0;
+  double    guard       = 10.0;
+  double    baro_rate   = 25.0;
+  uint32_t  load_bytes  = 64;
+  double    callback_seconds = 2.0;
+  bool      is_arbitrated = true;
+
+  int option = 0;
+  while ((option = getopt(argc, argv, "t:r:j:s:g:b:l:c:uh")) != -1)
+  {
+    switch (option)
+    {
+    case 't':
+      seconds     = atof(optarg);
+      break;
+    case 'r':
+      rate        = atof(optarg);
+      break;
+    case 'j':
+      jitter_us   = atof(optarg);
+      break;
+    case 's':
+      stretch     = atof(optarg);
+      break;
+    case 'g':
+      guard       = atof(optarg);
+      break;
+    case 'b':
+      baro_rate   = atof(optarg);
+      break;
+    case 'l':
+      load_bytes  = uint32_t(atoi(optarg));
+      break;
+    case 'c':
+      callback_seconds = atof(optarg);
+      break;
+    case 'u':
+      is_arbitrated = false;
+      break;
+    default:
+      usage();
+      return 1;
+    }
+  }
+
+  if ( seconds   <= 0.0
+    || rate      <= 0.0
+    || baro_rate <= 0.0)
+  {
+    usage();
+    return 1;
+  }
+
+  uint64_t period_ns = uint64_t(k_ns_per_s / rate);
+
+  ModelClock clock;
+  I2CArbiter arbiter(clock);
+  arbiter.configure(k_clock_hz, period_ns, uint64_t(period_ns * guard / 100.0));
+
+  Bus bus = { clock, arbiter, std::mt19937(42),
+              std::uniform_real_distribution<double>(0.0, stretch / 100.0) };
+
+  Device devices[] =
+  {
+    { "baro", &bus, k_baro_bytes, uint64_t(k_ns_per_s / baro_rate),  is_arbitrated, 0, 0, 0, 0 },
+    { "load", &bus, load_bytes,   uint64_t(k_ns_per_s / k_load_rate), is_arbitrated, 0, 0, 0, 0 }
+  };
+  const size_t device_count = load_bytes > 0 ? 2 : 1;
+
+  for (size_t index = 0; index < device_count; ++index)
+  {
+    devices[index].start();
+  }
+
+  std::mt19937                            random(7);
+  std::uniform_real_distribution<double>  jitter(-jitter_us, jitter_us);
+  std::uniform_real_distribution<double>  share(0.0, 1.0);
+
+  uint64_t periods        = uint64_t(seconds * rate);
+  uint64_t collisions     = 0;
+  uint64_t max_delay_ns   = 0;
+
+  for (uint64_t period = 1; period <= periods; ++period)
+  {
+    uint64_t interrupt_ns = period * period_ns + int64_t(jitter(random) * k_ns_per_us);
+
+    // Without the arbiter, each device is read when due, even if that runs
+    // into the next interrupt.
+    for (bool is_due = !is_arbitrated; is_due; )
+    {
+      Device *p_next = nullptr;
+      for (size_t index = 0; index < device_count; ++index)
+      {
+        if ( devices[index].due_ns < interrupt_ns
+          && (!p_next || devices[index].due_ns < p_next->due_ns))
+        {
+          p_next = &devices[index];
+        }
+      }
+
+      is_due = nullptr != p_next;
+      if (is_due)
+      {
+        clock.set(std::max(clock.now_ns(), p_next->due_ns));
+        Device::read_proc(p_next);
+      }
+    }
+
+    if (clock.now_ns() > interrupt_ns)
+    {
+      ++collisions;
+      max_delay_ns = std::max(max_delay_ns, clock.now_ns() - interrupt_ns);
+    }
+
+    clock.set(std::max(clock.now_ns(), interrupt_ns));
+    bus.transfer(share(random) < k_double_fifo ? 2 * k_fifo_bytes : k_fifo_bytes);
+
+    if (is_arbitrated)
+    {
+      arbiter.interrupt(interrupt_ns);
+    }
+  }
+
+  cout  << "Simulated " << seconds << " s of a " << k_clock_hz / 1000 << " kHz bus, "
+        << periods << " interrupts of the IMU, "
+        << (is_arbitrated ? "with" : "without") << " the arbiter.\n";
+
+  if (is_arbitrated)
+  {
+    arbiter.report(cout);
+  }
+
+  for (size_t index = 0; index < device_count; ++index)
+  {
+    const Device &device = devices[index];
+
+    cout  << "  " << device.name << ": " << device.reads << " reads, "
+          << device.reads / seconds << " Hz, at most "
+          << device.max_interval_ns / double(k_ns_per_ms) << " ms apart.\n";
+  }
+
+  cout  << "Collisions with the IMU: " << collisions
+        << ", delayed its read at most " << max_delay_ns / double(k_ns_per_us) << " us.\n";
+
+  bool is_passed = 0 == collisions
+                && devices[0].reads >= k_min_baro_share * baro_rate * seconds;
+
+  if (callback_seconds > 0.0)
+  {
+    Callback inline_path(rate, baro_rate, uint64_t(period_ns * guard / 100.0), false);
+    Callback thread_path(rate, baro_rate, uint64_t(period_ns * guard / 100.0), true);
+
+    inline_path.run(callback_seconds);
+    thread_path.run(callback_seconds);
+
+    cout << "Callback of the DMP, " << callback_seconds << " s of each path:\n";
+    inline_path.report(cout);
+    thread_path.report(cout);
+
+    uint64_t callback_ns  = thread_path.callback().percentile(0.99);
+    uint64_t allowed_ns   = uint64_t(k_max_callback_share * arbiter.duration_ns(k_baro_bytes));
+
+    cout  << std::fixed << std::setprecision(1)
+          << "Thread path callback p99 " << to_us(callback_ns)
+          << " us, allowed " << to_us(allowed_ns) << " us\n";
+
+    is_passed = is_passed
+             && thread_path.reads() >= k_min_baro_share * baro_rate * callback_seconds
+             && callback_ns         <= allowed_ns;
+  }
+
+  cout << (is_passed ? "PASSED" : "FAILED") << "\n";
+
+  return is_passed ? 0 : 1;
+}
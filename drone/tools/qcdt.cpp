@@ -0,0 +1,359 @@
+/// @file qcdt.cpp
+///
+/// Measures the noise that the timebase of the control loop adds to the
+/// derivative term of a PID.
+///
+/// The same stream of IMU samples runs through three PIDs, which differ only
+/// in the timestamps they are given:
+///   ms          the time the callback ran, truncated to whole milliseconds
+///               by timestamp_ms(), as the PIDs were driven before;
+///   ns          the nanosecond timestamp of the DMP interrupt of the sample,
+///               as the PIDs are driven now;
+///   reference   the time the DMP took the sample, which is evenly spaced.
+/// The noise of each path is the RMS of the difference between its
+/// derivative term and the derivative term of the reference.
+///
+/// Without a log, the stream is simulated: a roll angle that moves as a
+/// pilot flies, sampled at 200 Hz by the clock of the DMP, which runs a
+/// little off the clock of the processor. The interrupt of each sample is
+/// stamped with jitter, and the old callback read the clock later still,
+/// after the work of the cycle that preceded the PIDs.
+///
+/// With a flight log, the roll angle and the timestamp of each IMU record
+/// are replayed. The reference spaces the samples evenly over the log, and
+/// the ms path truncates the timestamp of the interrupt.
+///
+/// The simulated stream passes when the ns path has a small share of the
+/// noise of the ms path. A log passes when the ns path is not noisier.
+///
+/// Usage: qcdt [-t seconds] [-r rate] [-d drift] [-j jitter_us]
+///             [-l latency_us] [-c cutoff_hz] [log.qcl]
+///
+//  ****************************************************************************
+#include "../PID.h"
+#include "../flight_log.h"
+#include "../hal.h"
+#include "../utility/timebase.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <unistd.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+const uint64_t  k_start_ns        = k_ns_per_s;   ///< PIDs treat zero as unset.
+const double    k_settle_time     = 0.5;          ///< seconds, before the noise
+                                                  ///  is measured.
+const double    k_max_noise_share = 0.25;         ///< Of the ms path, simulated.
+
+
+//  ****************************************************************************
+void usage()
+{
+  cerr  << "Usage: qcdt [-t seconds] [-r rate] [-d drift] [-j jitter_us]\n"
+        << "            [-l latency_us] [-c cutoff_hz] [log.qcl]\n"
+        << "  -t  Seconds of the simulated stream. Default: 60\n"
+        << "  -r  Hz, the rate of the samples. Default: 200\n"
+        << "  -d  The error of the clock of the DMP, in %. Default: 0.5\n"
+        << "  -j  us, the standard deviation of the interrupt stamps. Default: 30\n"
+        << "  -l  us, the most the old callback read the clock after the\n"
+        << "      interrupt. Default: 500\n"
+        << "  -c  Hz, the cutoff of the derivative filters. Default: 20\n";
+}
+
+//  ****************************************************************************
+struct Options
+{
+  double    seconds;
+  double    rate;
+  double    drift;
+  double    jitter_us;
+  double    latency_us;
+  float     cutoff_hz;
+};
+
+//  ****************************************************************************
+/// A sample of the stream, and the time of each path.
+///
+struct Sample
+{
+  float     roll;                 ///< radians
+  uint64_t  reference_ns;
+  uint64_t  interrupt_ns;
+  uint64_t  callback_ns;
+};
+
+//  ****************************************************************************
+/// Simulates the samples of a pilot's flight.
+///
+std::vector<Sample> simulate(const Options &options)
+{
+  std::mt19937                            random(42);
+  std::normal_distribution<double>        jitter(0.0, options.jitter_us * k_ns_per_us);
+  std::uniform_real_distribution<double>  latency(0.0, options.latency_us * k_ns_per_us);
+  std::uniform_real_distribution<double>  phase(0.0, double(k_ns_per_ms));
+
+  size_t    count   = size_t(options.seconds * options.rate);
+  double    period  = k_ns_per_s / (options.rate * (1.0 + options.drift / 100.0));
+  uint64_t  start   = k_start_ns + uint64_t(phase(random));
+
+  std::vector<Sample> samples(count);
+
+  for (size_t index = 0; index < count; ++index)
+  {
+    double time = index / options.rate;
+
+    Sample &sample      = samples[index];
+    sample.roll         = float(0.3 * sin(2.0 * k_pi * 0.5 * time)
+                              + 0.05 * sin(2.0 * k_pi * 3.0 * time));
+    sample.reference_ns = start + uint64_t(index * period);
+    sample.interrupt_ns = sample.reference_ns + uint64_t(std::fabs(jitter(random)));
+    sample.callback_ns  = sample.interrupt_ns + uint64_t(latency(random));
+  }
+
+  return samples;
+}
+
+//  ****************************************************************************
+/// Reads the IMU samples of a flight log.
+///
+bool read_log(const char *p_path, std::vector<Sample> &samples)
+{
+  FILE *p_file = fopen(p_path, "rb");
+  if (!p_file)
+  {
+    cerr << "Could not open the flight log: " << p_path << "\n";
+    return false;
+  }
+
+  FlightLogHeader header;
+  if ( 1 != fread(&header, sizeof(header), 1, p_file)
+    || header.magic       != k_flight_log_magic
+    || header.byte_order  != k_flight_log_byte_order
+    || header.version     != k_flight_log_version
+    || header.record_size != sizeof(FlightRecord))
+  {
+    cerr << "The file is not a flight log of this version.\n";
+    fclose(p_file);
+    return false;
+  }
+
+  FlightRecord record;
+  while (1 == fread(&record, sizeof(record), 1, p_file))
+  {
+    if (record.type == k_record_imu)
+    {
+      Sample sample       = { };
+      sample.roll         = record.imu.fused_TaitBryan[HAL::k_tb_roll_y];
+      sample.interrupt_ns = record.timestamp_ns;
+      sample.callback_ns  = record.timestamp_ns;
+
+      samples.push_back(sample);
+    }
+  }
+
+  fclose(p_file);
+
+  if (samples.size() < 2)
+  {
+    cerr << "The flight log has too few IMU samples.\n";
+    return false;
+  }
+
+  // The DMP samples at a steady rate, so the reference spaces the samples
+  // evenly between the first and the last.
+  uint64_t first  = samples.front().interrupt_ns;
+  double   period = double(samples.back().interrupt_ns - first) / (samples.size() - 1);
+
+  for (size_t index = 0; index < samples.size(); ++index)
+  {
+    samples[index].reference_ns = first + uint64_t(index * period + 0.5);
+  }
+
+  return true;
+}
+
+//  ****************************************************************************
+/// The derivative term of a PID, driven by the timestamps of one path.
+///
+class DerivativePath
+{
+public:
+  //  **************************************************************************
+  DerivativePath(float cutoff_hz)
+    : m_pid(0.0f, 0.0f, 1.0f)
+    , m_min_dt(1.0f)
+    , m_max_dt(0.0f)
+  {
+    m_pid.lowpass_freq(cutoff_hz);
+  }
+
+  //  **************************************************************************
+  /// @return The derivative term, which holds when the PID skips a sample.
+  ///
+  float update(float roll, uint64_t timestamp)
+  {
+    m_pid.update(roll, timestamp);
+
+    if (m_pid.dt() > 0.0f)
+    {
+      m_min_dt  = std::min(m_min_dt, m_pid.dt());
+      m_max_dt  = std::max(m_max_dt, m_pid.dt());
+    }
+
+    return m_pid.derivative();
+  }
+
+  //  **************************************************************************
+  float min_dt() const  { return m_min_dt; }
+  float max_dt() const  { return m_max_dt; }
+
+private:
+  PID       m_pid;
+  float     m_min_dt;
+  float     m_max_dt;
+};
+
+//  ****************************************************************************
+/// Accumulates the RMS of a difference.
+///
+class RMS
+{
+public:
+  RMS() : m_sum(0.0), m_count(0) { }
+
+  void    add(double value)   { m_sum += value * value; ++m_count; }
+  double  value() const       { return m_count ? sqrt(m_sum / m_count) : 0.0; }
+
+private:
+  double    m_sum;
+  uint64_t  m_count;
+};
+
+} // namespace unnamed
+
+
+//  ****************************************************************************
+int main(int argc, char* argv[])
+{
+  Options options = { 60.0, 200.0, 0.5, 30.0, 500.0, 20.0f };
+
+  int option = 0;
+  while ((option = getopt(argc, argv, "t:r:d:j:l:c:h")) != -1)
+  {
+    switch (option)
+    {
+    case 't':
+      options.seconds     = atof(optarg);
+      break;
+    case 'r':
+      options.rate        = atof(optarg);
+      break;
+    case 'd':
+      options.drift       = atof(optarg);
+      break;
+    case 'j':
+      options.jitter_us   = atof(optarg);
+      break;
+    case 'l':
+      options.latency_us  = atof(optarg);
+      break;
+    case 'c':
+      options.cutoff_hz   = float(atof(optarg));
+      break;
+    default:
+      usage();
+      return 1;
+    }
+  }
+
+  if ( options.seconds   <= 0.0
+    || options.rate      <= 0.0
+    || options.cutoff_hz <= 0.0f)
+  {
+    usage();
+    return 1;
+  }
+
+  bool                is_log = optind < argc;
+  std::vector<Sample> samples;
+
+  if (is_log)
+  {
+    if (!read_log(argv[optind], samples))
+    {
+      return 1;
+    }
+  }
+  else
+  {
+    samples = simulate(options);
+  }
+
+  DerivativePath  reference(options.cutoff_hz);
+  DerivativePath  ms_path(options.cutoff_hz);
+  DerivativePath  ns_path(options.cutoff_hz);
+
+  RMS   signal;
+  RMS   ms_noise;
+  RMS   ns_noise;
+
+  uint64_t settle_ns = samples.front().reference_ns + seconds_to_ns(k_settle_time);
+
+  for (size_t index = 0; index < samples.size(); ++index)
+  {
+    const Sample &sample = samples[index];
+
+    // timestamp_ms() truncated the clock, and the PIDs took the
+    // milliseconds as their time.
+    uint64_t ms_time = sample.callback_ns / k_ns_per_ms * k_ns_per_ms;
+
+    float expected  = reference.update(sample.roll, sample.reference_ns);
+    float ms_term   = ms_path.update(sample.roll, ms_time);
+    float ns_term   = ns_path.update(sample.roll, sample.interrupt_ns);
+
+    if (sample.reference_ns >= settle_ns)
+    {
+      signal.add(expected);
+      ms_noise.add(ms_term - expected);
+      ns_noise.add(ns_term - expected);
+    }
+  }
+
+  cout  << std::fixed << std::setprecision(4)
+        << (is_log ? "Replayed " : "Simulated ") << samples.size() << " samples.\n"
+        << "Derivative term RMS (rad/s): " << signal.value() << "\n"
+        << std::setw(10) << "path"
+        << std::setw(12) << "noise"
+        << std::setw(12) << "dt min ms"
+        << std::setw(12) << "dt max ms" << "\n"
+        << std::setw(10) << "ms"
+        << std::setw(12) << ms_noise.value()
+        << std::setw(12) << 1000.0f * ms_path.min_dt()
+        << std::setw(12) << 1000.0f * ms_path.max_dt() << "\n"
+        << std::setw(10) << "ns"
+        << std::setw(12) << ns_noise.value()
+        << std::setw(12) << 1000.0f * ns_path.min_dt()
+        << std::setw(12) << 1000.0f * ns_path.max_dt() << "\n";
+
+  double allowed    = (is_log ? 1.0 : k_max_noise_share) * ms_noise.value();
+  bool   is_passed  = ns_noise.value() <= allowed;
+
+  cout << (is_passed ? "PASSED" : "FAILED") << "\n";
+
+  return is_passed ? 0 : 1;
+}
@@ -0,0 +1,421 @@
+/// @file qcfilter.cpp
+///
+/// Replays the IMU samples of the flight logs written by the FlightRecorder
+/// through the AttitudeFilter, to measure its throughput and its accuracy.
+///
+/// Each recorded sample is fused with the recorded timestamps, and the
+/// estimate is compared to the orientation the sample was recorded with.
+/// For a log recorded with the DMP, this compares the filter to the DMP
+/// with the same measurements.
+///
+/// The DMP reports the yaw from the heading it started with, and the filter
+/// from magnetic north, so the yaw is compared after the difference of the
+/// first sample is removed.
+///
+/// The time to fuse the samples is measured on the host, which gives an
+/// idea of the cost of the filter in the time slice of the control loop.
+///
+/// Before the logs, the orientation check feeds known rotations, measured in
+/// the axes of the chip as the raw mode reads them, through orient_x_back()
+/// and the filter: tilts about the x and y axes of the IMU, a heading from
+/// the magnetic field, and a rotation at a constant rate about each axis.
+/// Each must give the same angle, with the same sign, about the same axis.
+/// Without logs, only the check runs.
+///
+/// Usage: qcfilter [-p Kp] [-i Ki] [-v] [log.qcl]...
+///
+//  ****************************************************************************
+#include "../attitude_filter.h"
+#include "../flight_log.h"
+#include "../utility/timebase.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <unistd.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+const double  k_pi                  = 3.14159265358979323846;
+const double  k_degrees_per_radian  = 180.0 / k_pi;
+
+const size_t  k_axis_count          = 3;
+
+const double  k_check_angle         = 20.0;   ///< degrees, of each rotation.
+const double  k_check_error         = 1.0;    ///< degrees
+const double  k_check_dip           = 60.0;   ///< degrees, of the magnetic field.
+const float   k_check_period        = 0.005f; ///< seconds, of the samples.
+const size_t  k_check_samples       = 200;    ///< Of each rotation at a rate.
+
+const char* k_axis_names[k_axis_count] =
+{
+  "pitch_x",
+  "roll_y",
+  "yaw_z"
+};
+
+
+//  ****************************************************************************
+void usage()
+{
+  cerr  << "Usage: qcfilter [-p Kp] [-i Ki] [-v] [log.qcl]...\n"
+        << "  -p  The proportional gain of the filter. Default: 0.1\n"
+        << "  -i  The integral gain of the filter. Default: 0\n"
+        << "  -v  Reports the error of each sample, in degrees.\n";
+}
+
+//  ****************************************************************************
+/// The comparisons over all of the fused samples.
+///
+struct Report
+{
+  uint64_t  samples;
+  uint64_t  fuse_ns;                          ///< Host time to fuse the samples.
+
+  double    square_error[k_axis_count];       ///< degrees^2
+  double    max_error[k_axis_count];          ///< degrees
+
+  Report()
+    : samples(0)
+    , fuse_ns(0)
+    , square_error{0.0, 0.0, 0.0}
+    , max_error{0.0, 0.0, 0.0}
+  { }
+};
+
+//  ****************************************************************************
+bool read_header(FILE* p_file, FlightLogHeader &header)
+{
+  if (1 != fread(&header, sizeof(header), 1, p_file))
+  {
+    cerr << "The file is too short to be a flight log.\n";
+    return false;
+  }
+
+  if (header.magic != k_flight_log_magic)
+  {
+    cerr << "The file is not a flight log.\n";
+    return false;
+  }
+
+  if (header.byte_order != k_flight_log_byte_order)
+  {
+    cerr << "The flight log was recorded with a different byte order.\n";
+    return false;
+  }
+
+  if ( header.version     != k_flight_log_version
+    || header.record_size != sizeof(FlightRecord)
+    || header.header_size != sizeof(FlightLogHeader))
+  {
+    cerr << "Unsupported flight log version: " << header.version << "\n";
+    return false;
+  }
+
+  return true;
+}
+
+//  ****************************************************************************
+/// Returns the difference of two angles, within +/- 180 degrees.
+///
+double angle_error(float estimate, float reference)
+{
+  double error = std::remainder(double(estimate) - reference, 2.0 * k_pi);
+
+  return std::fabs(error) * k_degrees_per_radian;
+}
+
+//  ****************************************************************************
+bool replay(const char *p_path, AttitudeFilter &filter, bool is_verbose, Report &report)
+{
+  FILE* p_file = fopen(p_path, "rb");
+  if (!p_file)
+  {
+    cerr << "Could not open: " << p_path << "\n";
+    return false;
+  }
+
+  FlightLogHeader header;
+  if (!read_header(p_file, header))
+  {
+    fclose(p_file);
+    return false;
+  }
+
+  // The samples are read first, so only the filter is timed.
+  std::vector<HAL::IMUData> samples;
+  std::vector<uint64_t>     timestamps;
+
+  FlightRecord record;
+  while (1 == fread(&record, sizeof(record), 1, p_file))
+  {
+    if (record.type != k_record_imu)
+    {
+      continue;
+    }
+
+    const IMURecord &imu = record.imu;
+
+    HAL::IMUData sample;
+    std::copy(imu.accel,           imu.accel + 3,           sample.accel);
+    std::copy(imu.gyro,            imu.gyro + 3,            sample.gyro);
+    std::copy(imu.mag,             imu.mag + 3,             sample.mag);
+    std::copy(imu.fused_TaitBryan, imu.fused_TaitBryan + 3, sample.fused_TaitBryan);
+    std::copy(imu.fused_quat,      imu.fused_quat + 4,      sample.fused_quat);
+
+    samples.push_back(sample);
+    timestamps.push_back(record.timestamp_ns);
+  }
+
+  fclose(p_file);
+
+  if (samples.empty())
+  {
+    cerr << p_path << ": the log has no IMU samples.\n";
+    return true;
+  }
+
+  std::vector<HAL::IMUData> estimates(samples);
+
+  // Each log is a separate flight, the filter aligns with its first sample.
+  filter.reset();
+
+  uint64_t start_ns = timestamp_ns();
+
+  for (size_t index = 0; index < estimates.size(); ++index)
+  {
+    float dt = index > 0
+             ? to_seconds(timestamps[index] - timestamps[index - 1])
+             : 0.0f;
+
+    filter.fuse(estimates[index], dt);
+  }
+
+  report.fuse_ns += timestamp_ns() - start_ns;
+
+  float heading = estimates[0].fused_TaitBryan[HAL::k_tb_yaw_z]
+                - samples[0].fused_TaitBryan[HAL::k_tb_yaw_z];
+
+  for (size_t index = 0; index < samples.size(); ++index)
+  {
+    float estimate[k_axis_count];
+    std::copy(estimates[index].fused_TaitBryan,
+              estimates[index].fused_TaitBryan + k_axis_count,
+              estimate);
+    estimate[HAL::k_tb_yaw_z] -= heading;
+
+    const float *p_reference = samples[index].fused_TaitBryan;
+
+    if (is_verbose)
+    {
+      cout << timestamps[index];
+    }
+
+    for (size_t axis = 0; axis < k_axis_count; ++axis)
+    {
+      double error = angle_error(estimate[axis], p_reference[axis]);
+
+      report.square_error[axis] += error * error;
+      report.max_error[axis]     = std::max(report.max_error[axis], error);
+
+      if (is_verbose)
+      {
+        cout << " " << error;
+      }
+    }
+
+    if (is_verbose)
+    {
+      cout << "\n";
+    }
+  }
+
+  report.samples += samples.size();
+  return true;
+}
+
+//  ****************************************************************************
+/// Sets a vector of a sample, as the chip measures a vector of the IMU axes.
+///
+void to_chip(const double *p_imu, float *p_chip)
+{
+  // The inverse of orient_x_back(), the x axis of the chip points back.
+  p_chip[0] = float(-p_imu[1]);
+  p_chip[1] = float( p_imu[0]);
+  p_chip[2] = float( p_imu[2]);
+}
+
+//  ****************************************************************************
+/// Fuses the samples of a rotation, and compares the orientation.
+///
+/// @param accel      measured gravity, in the IMU axes.
+/// @param mag        measured field, in the IMU axes, or zero.
+/// @param rate       degrees / second, measured in the IMU axes.
+/// @param expected   degrees, the Tait-Bryan angles of the rotation.
+///
+/// @return true if each angle is within the allowed error.
+///
+bool check(const char    *p_name,
+           const double  *accel,
+           const double  *mag,
+           const double  *rate,
+           const double  *expected)
+{
+  HAL::IMUData sample = { };
+  to_chip(accel, sample.accel);
+  to_chip(mag,   sample.mag);
+  to_chip(rate,  sample.gyro);
+
+  orient_x_back(sample);
+
+  // Only the gyro moves the estimate after the alignment.
+  AttitudeFilter filter(0.0f, 0.0f);
+  filter.fuse(sample, 0.0f);
+
+  bool has_rate = rate[0] != 0.0 || rate[1] != 0.0 || rate[2] != 0.0;
+  for (size_t index = 0; has_rate && index < k_check_samples; ++index)
+  {
+    filter.fuse(sample, k_check_period);
+  }
+
+  bool is_passed = true;
+
+  cout << "  " << p_name << ":";
+
+  for (size_t axis = 0; axis < k_axis_count; ++axis)
+  {
+    double angle = sample.fused_TaitBryan[axis] * k_degrees_per_radian;
+
+    is_passed = is_passed && std::fabs(angle - expected[axis]) <= k_check_error;
+
+    cout << "  " << k_axis_names[axis] << " " << angle;
+  }
+
+  cout << (is_passed ? "" : "  WRONG") << "\n";
+
+  return is_passed;
+}
+
+//  ****************************************************************************
+/// Checks the orientation of the raw samples against known rotations.
+///
+bool check_orientation()
+{
+  double s      = std::sin(k_check_angle / k_degrees_per_radian);
+  double c      = std::cos(k_check_angle / k_degrees_per_radian);
+  double north  = std::cos(k_check_dip / k_degrees_per_radian);
+  double down   = -std::sin(k_check_dip / k_degrees_per_radian);
+  double rate   = k_check_angle / (k_check_samples * k_check_period);
+
+  const double level[]      = { 0.0, 0.0, 1.0 };
+  const double none[]       = { 0.0, 0.0, 0.0 };
+
+  // Gravity of a positive rotation about x and about y, and the field of a
+  // positive rotation about z, as the rotated IMU measures them.
+  const double tilt_x[]     = { 0.0, s, c };
+  const double tilt_y[]     = { -s, 0.0, c };
+  const double heading[]    = { s * north, c * north, down };
+
+  const double rate_x[]     = { rate, 0.0, 0.0 };
+  const double rate_y[]     = { 0.0, rate, 0.0 };
+  const double rate_z[]     = { 0.0, 0.0, rate };
+
+  const double pitch[]      = { k_check_angle, 0.0, 0.0 };
+  const double roll[]       = { 0.0, k_check_angle, 0.0 };
+  const double yaw[]        = { 0.0, 0.0, k_check_angle };
+
+  cout << "Orientation of the raw samples, in degrees:\n";
+
+  bool is_passed = check("tilt x",  tilt_x, none,    none,   pitch);
+  is_passed      = check("tilt y",  tilt_y, none,    none,   roll)  && is_passed;
+  is_passed      = check("heading", level,  heading, none,   yaw)   && is_passed;
+  is_passed      = check("rate x",  level,  none,    rate_x, pitch) && is_passed;
+  is_passed      = check("rate y",  level,  none,    rate_y, roll)  && is_passed;
+  is_passed      = check("rate z",  level,  none,    rate_z, yaw)   && is_passed;
+
+  cout << (is_passed ? "PASSED" : "FAILED") << "\n";
+
+  return is_passed;
+}
+
+} // namespace unnamed
+
+
+//  ****************************************************************************
+int main(int argc, char* argv[])
+{
+  float Kp      = 0.1f;
+  float Ki      = 0.0f;
+  bool  verbose = false;
+
+  int option = 0;
+  while ((option = getopt(argc, argv, "p:i:vh")) != -1)
+  {
+    switch (option)
+    {
+    case 'p':
+      Kp = float(atof(optarg));
+      break;
+    case 'i':
+      Ki = float(atof(optarg));
+      break;
+    case 'v':
+      verbose = true;
+      break;
+    default:
+      usage();
+      return 1;
+    }
+  }
+
+  if (!check_orientation())
+  {
+    return 1;
+  }
+
+  if (optind >= argc)
+  {
+    return 0;
+  }
+
+  AttitudeFilter filter(Kp, Ki);
+
+  Report report;
+  for (int index = optind; index < argc; ++index)
+  {
+    if (!replay(argv[index], filter, verbose, report))
+    {
+      return 1;
+    }
+  }
+
+  if (0 == report.samples)
+  {
+    cout << "No IMU samples to fuse.\n";
+    return 1;
+  }
+
+  cout << report.samples << " samples fused in " << report.fuse_ns / k_ns_per_us
+       << " us, " << double(report.fuse_ns) / report.samples << " ns per sample.\n"
+       << "Error to the recorded orientation, in degrees:\n";
+
+  for (size_t axis = 0; axis < k_axis_count; ++axis)
+  {
+    cout << "  " << k_axis_names[axis]
+         << "  rms " << std::sqrt(report.square_error[axis] / report.samples)
+         << "  max " << report.max_error[axis] << "\n";
+  }
+
+  return 0;
+}
@@ -0,0 +1,558 @@
+/// @file qcfixed.cpp
+///
+/// Replays the flight logs written by the FlightRecorder through the control
+/// path, in float and in fixed point.
+///
+/// Each cycle of the log is replayed with the recorded timestamps, setpoints,
+/// orientation and throttle, and with the gains of the configuration file.
+///
+///   - The float path must reproduce the PID outputs and the motor levels
+///     of the log bit for bit, which verifies the replay itself.
+///   - The fixed-point path is compared to the float path. Fixed point
+///     cannot be bit-exact to float, so its largest error must be within
+///     the tolerance. The orientation telemetry of both paths is counted
+///     where it matches exactly.
+///
+/// The replay is only exact for logs recorded with the same configuration,
+/// and without a change of the gains during the flight. The angle loop is
+/// replayed in every cycle, so the logs must be recorded with an
+/// angle_divider of 1.
+///
+/// Usage: qcfixed [-c flight.conf] [-e tolerance] [-v] <log.qcl>...
+///
+//  ****************************************************************************
+#include "../control_arithmetic.h"
+#include "../flight_config.h"
+#include "../flight_log.h"
+#include "../mixer.h"
+#include "../pid_bank.h"
+#include "../qc_msg.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+//  The period of the DMP and the command limits of the flight software,
+//  see Drone::init.
+const float   k_dmp_period        = 0.005f;
+const float   k_rp_command_limit  = k_pi_6;
+const float   k_yaw_command_limit = k_pi_3;
+const float   k_critical_limit    = k_pi_3;
+
+const size_t  k_pid_count         = 5;
+const size_t  k_encoding_count    = 5;
+
+const char* k_pid_names[k_pid_count] =
+{
+  "roll_stab",
+  "pitch_stab",
+  "roll_rate_pid",
+  "pitch_rate_pid",
+  "rotation"
+};
+
+
+//  ****************************************************************************
+void usage()
+{
+  cerr  << "Usage: qcfixed [-c flight.conf] [-e tolerance] [-v] <log.qcl>...\n"
+        << "  -c  The configuration the logs were recorded with. Default: the defaults.\n"
+        << "  -e  Largest error of the fixed-point path. Default: 0.001\n"
+        << "  -v  Reports each cycle where the float path does not match the log.\n";
+}
+
+//  ****************************************************************************
+const PIDRecord& pid_at(const CycleRecord &cycle, size_t index)
+{
+  const PIDRecord* pids[] =
+  {
+    &cycle.roll_stabilize,
+    &cycle.pitch_stabilize,
+    &cycle.roll_rate_pid,
+    &cycle.pitch_rate_pid,
+    &cycle.rotation
+  };
+
+  return *pids[index];
+}
+
+//  ****************************************************************************
+//  As constrain in drone.h, which is not included with the flight code.
+//
+float constrain(float value, float lower, float upper)
+{
+  float result = value;
+  if (result < lower)
+  {
+    result = lower;
+  }
+  else if (result > upper)
+  {
+    result = upper;
+  }
+
+  return result;
+}
+
+//  ****************************************************************************
+bool same_bits(float lhs, float rhs)
+{
+  return 0 == memcmp(&lhs, &rhs, sizeof(lhs));
+}
+
+//  ****************************************************************************
+FrameType frame_for(size_t motor_count)
+{
+  switch (motor_count)
+  {
+  case 4:   return k_frame_quad;
+  case 8:   return k_frame_octo;
+  case 6:
+  default:  return k_frame_hex;
+  }
+}
+
+
+//  ****************************************************************************
+/// The results of one cycle of the control path.
+///
+struct CycleOutput
+{
+  float     pid[k_pid_count];
+  float     motor[8];
+  int16_t   encoding[k_encoding_count];
+  bool      is_mixed;
+};
+
+
+//  ****************************************************************************
+/// Returns the period of the control loop, which runs for each IMU sample.
+///
+float period(const FlightConfig &config)
+{
+  return HAL::k_imu_raw == config.imu.mode
+       ? 1.0f / config.imu.sample_rate
+       : k_dmp_period;
+}
+
+
+//  ****************************************************************************
+/// The control path of Drone::update, in the arithmetic.
+///
+template <typename Arithmetic>
+class ControlPath
+{
+public:
+  //  **************************************************************************
+  ControlPath(const FlightConfig &config, FrameType frame)
+    : m_config(config)
+    , m_stabilize(period(config) * config.angle_divider)
+    , m_rates(period(config))
+    , mp_mixer(&mixer_table<Arithmetic>(frame))
+  {
+    limit(m_stabilize.lane(0), k_rp_command_limit);
+    limit(m_stabilize.lane(1), k_rp_command_limit);
+    limit(m_rates.lane(0),     k_critical_limit);
+    limit(m_rates.lane(1),     k_critical_limit);
+    limit(m_rates.lane(2),     k_yaw_command_limit);
+
+    apply(m_stabilize.lane(0), config.roll);
+    apply(m_stabilize.lane(1), config.pitch);
+    apply(m_rates.lane(0),     config.roll_rate);
+    apply(m_rates.lane(1),     config.pitch_rate);
+    apply(m_rates.lane(2),     config.yaw);
+  }
+
+  //  **************************************************************************
+  void update(const FlightRecord &record, CycleOutput &output)
+  {
+    typedef OrientationEncoder<Arithmetic> Encoder;
+
+    const CycleRecord &cycle = record.cycle;
+
+    if (cycle.throttle < m_config.hover_level)
+    {
+      m_stabilize.lane(0).reset_integral();
+      m_stabilize.lane(1).reset_integral();
+    }
+
+    if (m_config.is_scheduled)
+    {
+      SchedulePoint point = m_config.schedule.locate(cycle.throttle, cycle.battery_voltage);
+
+      schedule(m_stabilize.lane(0), m_config.roll,       point);
+      schedule(m_stabilize.lane(1), m_config.pitch,      point);
+      schedule(m_rates.lane(0),     m_config.roll_rate,  point);
+      schedule(m_rates.lane(1),     m_config.pitch_rate, point);
+      schedule(m_rates.lane(2),     m_config.yaw,        point);
+    }
+
+    m_stabilize.lane(0).setpoint(cycle.roll_stabilize.setpoint);
+    m_stabilize.lane(1).setpoint(cycle.pitch_stabilize.setpoint);
+
+    if (angle_control == cycle.control_mode)
+    {
+      // The attitude the angle loop ran with, which is measured from the
+      // quaternion for the quaternion error.
+      float attitude[2] = { cycle.roll_stabilize.measured, cycle.pitch_stabilize.measured };
+      m_stabilize.update(attitude, record.timestamp_ns, &output.pid[0]);
+    }
+    else
+    {
+      output.pid[0] = m_stabilize.lane(0).target();
+      output.pid[1] = m_stabilize.lane(1).target();
+    }
+
+    // The rate setpoints are calculated from the stabilization outputs
+    // and the rates of the log, so the recorded setpoints are replayed.
+    m_rates.lane(0).setpoint(cycle.roll_rate_pid.setpoint);
+    m_rates.lane(1).setpoint(cycle.pitch_rate_pid.setpoint);
+    m_rates.lane(2).setpoint(cycle.rotation.setpoint);
+
+    float rates[3] = { cycle.roll_rate, cycle.pitch_rate, cycle.yaw_rate };
+    m_rates.update(rates, record.timestamp_ns, &output.pid[2]);
+
+    output.pid[2] = constrain(output.pid[2], -k_critical_limit, k_critical_limit);
+    output.pid[3] = constrain(output.pid[3], -k_critical_limit, k_critical_limit);
+
+    output.encoding[0] = Encoder::roll(cycle.roll_rate);
+    output.encoding[1] = Encoder::roll(cycle.roll);
+    output.encoding[2] = Encoder::pitch(cycle.pitch_rate);
+    output.encoding[3] = Encoder::pitch(cycle.pitch);
+    output.encoding[4] = Encoder::yaw(cycle.yaw);
+
+    output.is_mixed = !cycle.is_critical;
+    if (output.is_mixed)
+    {
+      float levels[k_mixer_max_table];
+      mp_mixer->mix(cycle.throttle, output.pid[2], output.pid[3], output.pid[4], levels);
+
+      // As Drone::set_motor_level, then as the PWM limits the duty cycle.
+      for (size_t index = 0; index < 8; ++index)
+      {
+        float level = index < mp_mixer->motor_count
+                    ? constrain(levels[index], m_config.motor_min, m_config.motor_max)
+                    : 0.0f;
+
+        output.motor[index] = constrain(level, 0.0f, 1.0f);
+      }
+    }
+    else
+    {
+      for (size_t index = 0; index < 2; ++index)
+      {
+        m_stabilize.lane(index).clear();
+      }
+
+      for (size_t index = 0; index < 3; ++index)
+      {
+        m_rates.lane(index).clear();
+      }
+    }
+  }
+
+private:
+  typedef PIDBank<2, Arithmetic>  StabilizeBank;
+  typedef PIDBank<3, Arithmetic>  RateBank;
+
+  FlightConfig        m_config;
+  StabilizeBank       m_stabilize;
+  RateBank            m_rates;
+  const MixerTable*   mp_mixer;
+
+  //  **************************************************************************
+  template <typename Lane>
+  static void limit(Lane lane, float range)
+  {
+    lane.min(-range);
+    lane.max( range);
+  }
+
+  //  **************************************************************************
+  template <typename Lane>
+  static void apply(Lane lane, const PIDConfig &config)
+  {
+    lane.Kp          (config.Kp);
+    lane.Ki          (config.Ki);
+    lane.Kd          (config.Kd);
+    lane.scalar      (config.scalar);
+    lane.windup_limit(config.windup_limit);
+    lane.filter      (config.filter);
+  }
+
+  //  **************************************************************************
+  template <typename Lane>
+  static void schedule(Lane lane, const PIDConfig &config, const SchedulePoint &point)
+  {
+    lane.scale_gains(config.Kp_table.lookup(point),
+                     config.Ki_table.lookup(point),
+                     config.Kd_table.lookup(point));
+  }
+};
+
+
+//  ****************************************************************************
+/// The comparisons over all of the replayed cycles.
+///
+struct Report
+{
+  uint64_t  cycles;
+  uint64_t  mixed;
+
+  uint64_t  float_pid_exact;          ///< Cycles with every PID output exact.
+  uint64_t  float_motor_exact;        ///< Mixed cycles with every motor exact.
+
+  double    fixed_pid_error[k_pid_count];
+  double    fixed_motor_error;
+  uint64_t  encoding_exact;           ///< Encoded values that match the float path.
+
+  Report()
+  {
+    memset(this, 0, sizeof(*this));
+  }
+};
+
+//  ****************************************************************************
+bool read_header(FILE* p_file, FlightLogHeader &header)
+{
+  if (1 != fread(&header, sizeof(header), 1, p_file))
+  {
+    cerr << "The file is too short to be a flight log.\n";
+    return false;
+  }
+
+  if (header.magic != k_flight_log_magic)
+  {
+    cerr << "The file is not a flight log.\n";
+    return false;
+  }
+
+  if (header.byte_order != k_flight_log_byte_order)
+  {
+    cerr << "The flight log was recorded with a different byte order.\n";
+    return false;
+  }
+
+  if ( header.version     != k_flight_log_version
+    || header.record_size != sizeof(FlightRecord)
+    || header.header_size != sizeof(FlightLogHeader))
+  {
+    cerr << "Unsupported flight log version: " << header.version << "\n";
+    return false;
+  }
+
+  return true;
+}
+
+//  ****************************************************************************
+bool replay(const char *p_path, const FlightConfig &config, bool is_verbose, Report &report)
+{
+  FILE* p_file = fopen(p_path, "rb");
+  if (!p_file)
+  {
+    cerr << "Could not open: " << p_path << "\n";
+    return false;
+  }
+
+  FlightLogHeader header;
+  if (!read_header(p_file, header))
+  {
+    fclose(p_file);
+    return false;
+  }
+
+  ControlPath<FloatArithmetic>* p_float = nullptr;
+  ControlPath<FixedArithmetic>* p_fixed = nullptr;
+
+  FlightRecord  record;
+  uint64_t      count    = 0;
+  uint32_t      expected = 0;
+
+  while (1 == fread(&record, sizeof(record), 1, p_file))
+  {
+    // The controllers advance in each cycle, so the cycles after
+    // a record that was dropped cannot be replayed.
+    if (count > 0 && record.sequence != expected)
+    {
+      cerr << p_path << ": " << uint32_t(record.sequence - expected)
+           << " records were dropped at sequence " << expected
+           << ", the replay ends there.\n";
+      break;
+    }
+
+    expected = record.sequence + 1;
+    ++count;
+
+    if (record.type != k_record_cycle)
+    {
+      continue;
+    }
+
+    const CycleRecord &cycle = record.cycle;
+
+    // The frame is known from the first cycle.
+    if (!p_float)
+    {
+      FrameType frame = frame_for(cycle.motor_count);
+
+      p_float = new ControlPath<FloatArithmetic>(config, frame);
+      p_fixed = new ControlPath<FixedArithmetic>(config, frame);
+    }
+
+    CycleOutput reference;
+    CycleOutput fixed;
+
+    p_float->update(record, reference);
+    p_fixed->update(record, fixed);
+
+    ++report.cycles;
+
+    bool is_exact = true;
+    for (size_t index = 0; index < k_pid_count; ++index)
+    {
+      if (!same_bits(reference.pid[index], pid_at(cycle, index).output))
+      {
+        is_exact = false;
+
+        if (is_verbose)
+        {
+          cout << "Sequence " << record.sequence << ": "
+               << k_pid_names[index] << " is " << reference.pid[index]
+               << ", logged " << pid_at(cycle, index).output << "\n";
+        }
+      }
+
+      double error = std::fabs(double(fixed.pid[index]) - reference.pid[index]);
+      report.fixed_pid_error[index] = std::max(report.fixed_pid_error[index], error);
+    }
+
+    report.float_pid_exact += is_exact ? 1 : 0;
+
+    if (reference.is_mixed)
+    {
+      ++report.mixed;
+
+      is_exact = true;
+      for (size_t index = 0; index < 8; ++index)
+      {
+        is_exact = is_exact && same_bits(reference.motor[index], cycle.motor[index]);
+
+        double error = std::fabs(double(fixed.motor[index]) - reference.motor[index]);
+        report.fixed_motor_error = std::max(report.fixed_motor_error, error);
+      }
+
+      report.float_motor_exact += is_exact ? 1 : 0;
+    }
+
+    for (size_t index = 0; index < k_encoding_count; ++index)
+    {
+      report.encoding_exact += (reference.encoding[index] == fixed.encoding[index]) ? 1 : 0;
+    }
+  }
+
+  delete p_float;
+  delete p_fixed;
+
+  fclose(p_file);
+  return true;
+}
+
+} // namespace unnamed
+
+
+//  ****************************************************************************
+int main(int argc, char* argv[])
+{
+  FlightConfig  config    = default_flight_config();
+  double        tolerance = 0.001;
+  bool          verbose   = false;
+
+  int option = 0;
+  while ((option = getopt(argc, argv, "c:e:vh")) != -1)
+  {
+    switch (option)
+    {
+    case 'c':
+      if (!load_flight_config(optarg, config))
+      {
+        return 1;
+      }
+      break;
+    case 'e':
+      tolerance = atof(optarg);
+      break;
+    case 'v':
+      verbose = true;
+      break;
+    default:
+      usage();
+      return 1;
+    }
+  }
+
+  if (optind >= argc)
+  {
+    usage();
+    return 1;
+  }
+
+  Report report;
+  for (int index = optind; index < argc; ++index)
+  {
+    if (!replay(argv[index], config, verbose, report))
+    {
+      return 1;
+    }
+  }
+
+  bool is_float_exact = report.float_pid_exact   == report.cycles
+                     && report.float_motor_exact == report.mixed;
+
+  double fixed_error = report.fixed_motor_error;
+
+  cout << report.cycles << " cycles replayed, " << report.mixed << " mixed.\n"
+       << "Float:  " << report.float_pid_exact << " cycles with the logged PID outputs, "
+       << report.float_motor_exact << " with the logged motor levels.\n"
+       << "Fixed:  largest error of each PID output:";
+
+  for (size_t index = 0; index < k_pid_count; ++index)
+  {
+    cout << " " << k_pid_names[index] << " " << report.fixed_pid_error[index];
+    fixed_error = std::max(fixed_error, report.fixed_pid_error[index]);
+  }
+
+  cout << "\n"
+       << "        largest error of the motor levels: " << report.fixed_motor_error << "\n"
+       << "        " << report.encoding_exact << " of " << report.cycles * k_encoding_count
+       << " orientation encodings match the float path.\n";
+
+  if (!is_float_exact)
+  {
+    cout << "FAILED: the float path does not reproduce the log.\n";
+    return 1;
+  }
+
+  if (fixed_error > tolerance)
+  {
+    cout << "FAILED: the error of the fixed-point path exceeds " << tolerance << ".\n";
+    return 1;
+  }
+
+  cout << "PASSED\n";
+  return 0;
+}
@@ -0,0 +1,310 @@
+/// @file qcgeofence.cpp
+///
+/// Tests the geofence, and the tangent plane it is tested in.
+///
+/// Points inside and outside a cylinder, a concave polygon and a ceiling are
+/// tested against the area, and configurations that do not describe an area
+/// must be rejected. Then, at latitudes from the equator to the arctic,
+/// locations around an origin are converted to the plane and compared to
+/// their east and north through the earth-centered frame, and a location
+/// just outside a cylinder must be outside it.
+///
+/// The test passes when each point is where it is expected, and each
+/// location is within its limit of the earth-centered position.
+///
+/// Usage: qcgeofence [-d distance]
+///
+//  ****************************************************************************
+#include "../geofence.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include <unistd.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+const double  k_a           = 6378137.0;          ///< m, the semi-major axis.
+const double  k_e2          = 6.69437999014e-3;   ///< The first eccentricity squared.
+const double  k_radians     = 3.14159265358979323846 / 180.0;
+
+const double  k_max_error   = 0.002;              ///< Relative to the distance.
+const double  k_latitudes[] = { 0.0, 30.0, 47.6205, 60.0, 70.0, 80.0 };
+
+
+//  ****************************************************************************
+void usage()
+{
+  cerr  << "Usage: qcgeofence [-d distance]\n"
+        << "  -d  m, of the locations from the origin. Default: 200\n";
+}
+
+//  ****************************************************************************
+/// A point and the side of the area it is expected on.
+///
+struct Point
+{
+  const char   *p_name;
+  float         east;
+  float         north;
+  float         up;
+  bool          is_inside;
+};
+
+//  ****************************************************************************
+/// Tests points against an area.
+///
+bool test_points(const char *p_area, const Geofence &fence,
+                 const Point *p_points, size_t count)
+{
+  bool is_passed = true;
+
+  cout << p_area << ":\n";
+
+  for (size_t index = 0; index < count; ++index)
+  {
+    const Point  &point     = p_points[index];
+    LocalPosition position  = { point.east, point.north, point.up };
+    bool          is_inside = fence.contains(position);
+
+    cout  << "  " << std::setw(24) << std::left << point.p_name << std::right
+          << (is_inside ? "inside" : "outside")
+          << (is_inside == point.is_inside ? "" : "  WRONG") << "\n";
+
+    is_passed = is_inside == point.is_inside && is_passed;
+  }
+
+  return is_passed;
+}
+
+//  ****************************************************************************
+/// Tests the cylinder, a concave polygon and the ceiling.
+///
+bool test_areas()
+{
+  bool is_passed = true;
+
+  // A cylinder of 20 m, without a ceiling.
+  Geofence cylinder(20.0f);
+
+  const Point k_cylinder[] =
+  {
+    { "base",                  0.0f,   0.0f,    0.0f, true  },
+    { "north of the base",     0.0f,  19.9f,    0.0f, true  },
+    { "past the north",        0.0f,  20.1f,    0.0f, false },
+    { "diagonal inside",      14.0f, -14.0f,    0.0f, true  },
+    { "diagonal outside",    -15.0f,  15.0f,    0.0f, false },
+    { "high above the base",   0.0f,   0.0f, 1000.0f, true  },
+  };
+
+  is_passed = test_points("Cylinder of 20 m", cylinder,
+                          k_cylinder, sizeof(k_cylinder) / sizeof(k_cylinder[0]))
+           && is_passed;
+
+  // An L of 40 m with a notch of 30 m, and a ceiling of 30 m.
+  NumberList corner   = { 12, { 0, 0,  40, 0,  40, 10,  10, 10,  10, 40,  0, 40 } };
+  Geofence   polygon;
+  bool       is_valid = polygon.configure(0.0f, 30.0f, corner);
+
+  const Point k_polygon[] =
+  {
+    { "corner of the L",       5.0f,   5.0f,    0.0f, true  },
+    { "end of the east arm",  35.0f,   5.0f,    0.0f, true  },
+    { "end of the north arm",  5.0f,  35.0f,    0.0f, true  },
+    { "in the notch",         20.0f,  20.0f,    0.0f, false },
+    { "west of the L",        -1.0f,   5.0f,    0.0f, false },
+    { "east of the L",        45.0f,   5.0f,    0.0f, false },
+    { "north of the L",        5.0f,  41.0f,    0.0f, false },
+    { "south of the L",       20.0f,  -1.0f,    0.0f, false },
+    { "below the ceiling",     5.0f,   5.0f,   29.0f, true  },
+    { "above the ceiling",     5.0f,   5.0f,   31.0f, false },
+  };
+
+  cout  << "Polygon: " << (is_valid ? "accepted" : "REJECTED")
+        << (polygon.is_polygon() ? "" : ", NOT A POLYGON") << "\n";
+
+  is_passed = is_valid && polygon.is_polygon() && is_passed;
+  is_passed = test_points("L of 40 m, ceiling of 30 m", polygon,
+                          k_polygon, sizeof(k_polygon) / sizeof(k_polygon[0]))
+           && is_passed;
+
+  // Configurations that do not describe an area.
+  NumberList none     = { 0, { } };
+  NumberList line     = { 4, { 0, 0,  10, 10 } };
+  NumberList odd      = { 7, { 0, 0,  10, 0,  0, 10,  5 } };
+
+  Geofence   rejected;
+  bool       is_rejected = !rejected.configure(-1.0f,  0.0f, none)
+                        && !rejected.configure( 0.0f,  0.0f, none)
+                        && !rejected.configure(20.0f, -1.0f, none)
+                        && !rejected.configure( 0.0f,  0.0f, line)
+                        && !rejected.configure( 0.0f,  0.0f, odd);
+
+  cout  << "Areas without a size or with too few vertices: "
+        << (is_rejected ? "rejected" : "ACCEPTED") << "\n";
+
+  return is_rejected && is_passed;
+}
+
+//  ****************************************************************************
+/// A location in the earth-centered, earth-fixed frame.
+///
+void to_ecef(double latitude, double longitude, double altitude, double *p_ecef)
+{
+  double sin_lat  = std::sin(latitude  * k_radians);
+  double cos_lat  = std::cos(latitude  * k_radians);
+  double sin_lon  = std::sin(longitude * k_radians);
+  double cos_lon  = std::cos(longitude * k_radians);
+  double normal   = k_a / std::sqrt(1.0 - k_e2 * sin_lat * sin_lat);
+
+  p_ecef[0] = (normal + altitude) * cos_lat * cos_lon;
+  p_ecef[1] = (normal + altitude) * cos_lat * sin_lon;
+  p_ecef[2] = (normal * (1.0 - k_e2) + altitude) * sin_lat;
+}
+
+//  ****************************************************************************
+/// The east, north and up of a location from an origin, through the
+/// earth-centered frame.
+///
+void to_enu(double latitude, double longitude, double altitude,
+            double origin_latitude, double origin_longitude, double origin_altitude,
+            double *p_enu)
+{
+  double point[3];
+  double origin[3];
+  to_ecef(latitude, longitude, altitude, point);
+  to_ecef(origin_latitude, origin_longitude, origin_altitude, origin);
+
+  double dx = point[0] - origin[0];
+  double dy = point[1] - origin[1];
+  double dz = point[2] - origin[2];
+
+  double sin_lat  = std::sin(origin_latitude  * k_radians);
+  double cos_lat  = std::cos(origin_latitude  * k_radians);
+  double sin_lon  = std::sin(origin_longitude * k_radians);
+  double cos_lon  = std::cos(origin_longitude * k_radians);
+
+  p_enu[0] = -sin_lon * dx + cos_lon * dy;
+  p_enu[1] = -sin_lat * cos_lon * dx - sin_lat * sin_lon * dy + cos_lat * dz;
+  p_enu[2] =  cos_lat * cos_lon * dx + cos_lat * sin_lon * dy + sin_lat * dz;
+}
+
+//  ****************************************************************************
+/// Compares the plane to the earth-centered frame at each latitude.
+///
+bool test_frames(double distance)
+{
+  const double  k_longitude = -122.3493;
+  const double  k_altitude  = 56.0;
+  const size_t  k_bearings  = 16;
+
+  bool is_passed = true;
+
+  cout  << "Locations " << distance << " m from the origin, largest error:\n";
+
+  for (size_t index = 0; index < sizeof(k_latitudes) / sizeof(k_latitudes[0]); ++index)
+  {
+    double latitude = k_latitudes[index];
+
+    LocalFrame frame;
+    frame.origin(latitude, k_longitude, k_altitude);
+
+    // The degrees of a meter at the origin, from the earth-centered frame.
+    double east_step[3];
+    double north_step[3];
+    to_enu(latitude, k_longitude + 1e-4, k_altitude, latitude, k_longitude, k_altitude, east_step);
+    to_enu(latitude + 1e-4, k_longitude, k_altitude, latitude, k_longitude, k_altitude, north_step);
+
+    double lon_per_m = 1e-4 / east_step[0];
+    double lat_per_m = 1e-4 / north_step[1];
+
+    double worst = 0.0;
+    for (size_t bearing = 0; bearing < k_bearings; ++bearing)
+    {
+      double angle  = 2.0 * 3.14159265358979323846 * bearing / k_bearings;
+      double lat    = latitude    + distance * std::cos(angle) * lat_per_m;
+      double lon    = k_longitude + distance * std::sin(angle) * lon_per_m;
+      double alt    = k_altitude  + 10.0;
+
+      double        expected[3];
+      LocalPosition position = frame.to_local(lat, lon, alt);
+      to_enu(lat, lon, alt, latitude, k_longitude, k_altitude, expected);
+
+      // The plane does not follow the curvature, so its up differs by
+      // d^2 / 2R, and only the east and the north are compared.
+      double error = std::max(std::fabs(position.east  - expected[0]),
+                              std::fabs(position.north - expected[1]));
+      worst = std::max(worst, error);
+    }
+
+    // A location due east, just outside a cylinder of the distance.
+    Geofence  cylinder(static_cast<float>(distance));
+    double    outside   = frame.to_local(latitude,
+                                         k_longitude + 1.01 * distance * lon_per_m,
+                                         k_altitude).east;
+    double    inside    = frame.to_local(latitude,
+                                         k_longitude + 0.99 * distance * lon_per_m,
+                                         k_altitude).east;
+
+    LocalPosition beyond = { float(outside), 0.0f, 0.0f };
+    LocalPosition within = { float(inside),  0.0f, 0.0f };
+
+    bool is_accurate = worst <= k_max_error * distance;
+    bool is_fenced   = !cylinder.contains(beyond) && cylinder.contains(within);
+
+    cout  << "  " << std::setw(8) << latitude << " deg: "
+          << std::setw(8) << worst << " m"
+          << (is_accurate ? "" : "  WRONG")
+          << (is_fenced ? "" : ", FENCE WRONG") << "\n";
+
+    is_passed = is_accurate && is_fenced && is_passed;
+  }
+
+  return is_passed;
+}
+
+} // namespace unnamed
+
+
+//  ****************************************************************************
+int main(int argc, char* argv[])
+{
+  double distance = 200.0;
+
+  int option = 0;
+  while ((option = getopt(argc, argv, "d:h")) != -1)
+  {
+    switch (option)
+    {
+    case 'd':
+      distance = atof(optarg);
+      break;
+    default:
+      usage();
+      return 1;
+    }
+  }
+
+  if (distance <= 0.0)
+  {
+    usage();
+    return 1;
+  }
+
+  bool is_passed = test_areas();
+  is_passed      = test_frames(distance) && is_passed;
+
+  cout << (is_passed ? "PASSED" : "FAILED") << "\n";
+
+  return is_passed ? 0 : 1;
+}
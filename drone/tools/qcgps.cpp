@@ -0,0 +1,392 @@
+/// @file qcgps.cpp
+///
+/// Tests the reader of the GPS driver against a simulated receiver, which
+/// writes NMEA sentences to a pseudo-terminal the driver opens.
+///
+/// Each fix is a GGA and an RMC sentence, written in chunks the size of the
+/// FIFO of a UART, a chunk each millisecond, as they arrive from the
+/// receiver. After the last chunk of a fix, the test waits for the driver
+/// to parse it, and measures the time from the write of its new line to the
+/// fix, and the system calls the read thread made for it. A line of noise
+/// longer than any sentence is written first, which the driver must discard.
+///
+/// The test passes when every fix is parsed with its location, with no more
+/// than a poll and a read for each chunk, and promptly.
+///
+/// Usage: qcgps [-n fixes] [-r rate] [-c chunk] [-l latency_ms]
+///
+//  ****************************************************************************
+#include "../GPS.h"
+#include "../utility/timebase.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+const double    k_latitude        = 47.6205;  ///< degrees, of the first fix.
+const double    k_longitude       = -122.3493;
+const double    k_step            = 0.0001;   ///< degrees, between the fixes.
+const double    k_max_error       = 0.00001;  ///< degrees
+
+const uint64_t  k_chunk_ns        = 1 * k_ns_per_ms;
+const uint64_t  k_timeout_ns      = 100 * k_ns_per_ms;
+const size_t    k_noise_bytes     = 300;
+
+
+//  ****************************************************************************
+void usage()
+{
+  cerr  << "Usage: qcgps [-n fixes] [-r rate] [-c chunk] [-l latency_ms]\n"
+        << "  -n  Fixes to send. Default: 50\n"
+        << "  -r  Hz, the rate of the fixes. Default: 10\n"
+        << "  -c  Bytes written at once, 0 for a whole fix. Default: 16\n"
+        << "  -l  Milliseconds allowed from a new line to its fix. Default: 20\n";
+}
+
+//  ****************************************************************************
+/// The simulated receiver, the master side of a pseudo-terminal.
+///
+class Receiver
+{
+public:
+  //  **************************************************************************
+  Receiver()
+    : m_master(-1)
+    , m_slave(-1)
+  { }
+
+  //  **************************************************************************
+  ~Receiver()
+  {
+    if (m_slave >= 0)
+    {
+      ::close(m_slave);
+    }
+
+    if (m_master >= 0)
+    {
+      ::close(m_master);
+    }
+  }
+
+  //  **************************************************************************
+  /// Creates the pseudo-terminal, as a raw serial line that does not echo.
+  ///
+  bool open()
+  {
+    m_master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if ( m_master < 0
+      || 0 != grantpt(m_master)
+      || 0 != unlockpt(m_master))
+    {
+      return false;
+    }
+
+    m_device = ptsname(m_master);
+
+    // The slave is held open while the driver opens its own.
+    m_slave = ::open(m_device.c_str(), O_RDWR | O_NOCTTY);
+    if (m_slave < 0)
+    {
+      return false;
+    }
+
+    termios options;
+    tcgetattr(m_slave, &options);
+    cfmakeraw(&options);
+    tcsetattr(m_slave, TCSANOW, &options);
+
+    return true;
+  }
+
+  //  **************************************************************************
+  const char* device() const
+  {
+    return m_device.c_str();
+  }
+
+  //  **************************************************************************
+  /// Discards the commands the driver sent to the receiver.
+  ///
+  void discard()
+  {
+    char buffer[256];
+    while (::read(m_master, buffer, sizeof(buffer)) > 0)
+    { }
+  }
+
+  //  **************************************************************************
+  /// Writes the text in chunks, a chunk each millisecond.
+  ///
+  /// @param mark   the offset of a byte in the text.
+  ///
+  /// @return The monotonic time the chunk with the mark was written.
+  ///
+  uint64_t write(const std::string &text, size_t chunk, size_t mark, uint32_t &writes)
+  {
+    size_t    size      = chunk > 0 ? chunk : text.size();
+    uint64_t  mark_ns   = 0;
+
+    for (size_t offset = 0; offset < text.size(); offset += size)
+    {
+      if (offset > 0)
+      {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(k_chunk_ns));
+      }
+
+      size_t count = std::min(size, text.size() - offset);
+
+      uint64_t write_ns = timestamp_ns();
+      if (::write(m_master, text.data() + offset, count) != ssize_t(count))
+      {
+        cout << "The receiver could not write to the port.\n";
+      }
+
+      if ( mark >= offset
+        && mark <  offset + count)
+      {
+        mark_ns = write_ns;
+      }
+
+      ++writes;
+    }
+
+    return mark_ns;
+  }
+
+private:
+  int           m_master;
+  int           m_slave;
+  std::string   m_device;
+};
+
+//  ****************************************************************************
+/// Returns a sentence with its checksum, and the new line of the receiver.
+///
+std::string sentence(const char *p_body)
+{
+  uint8_t checksum = 0;
+  for (const char *p_cur = p_body; *p_cur; ++p_cur)
+  {
+    checksum ^= uint8_t(*p_cur);
+  }
+
+  char text[128];
+  snprintf(text, sizeof(text), "$%s*%02X\r\n", p_body, checksum);
+
+  return text;
+}
+
+//  ****************************************************************************
+/// Formats an angle as the degrees and minutes of NMEA.
+///
+std::string angle(double value, int degree_digits)
+{
+  value = std::fabs(value);
+
+  int     degrees = int(value);
+  double  minutes = (value - degrees) * 60.0;
+
+  char text[32];
+  snprintf(text, sizeof(text), "%0*d%07.4f", degree_digits, degrees, minutes);
+
+  return text;
+}
+
+//  ****************************************************************************
+/// Returns the GGA and RMC sentences of a fix.
+///
+std::string fix(uint32_t index, double latitude, double longitude)
+{
+  unsigned  seconds = 43200 + index / 5;
+  unsigned  ms      = (index % 5) * 200;
+
+  char time[16];
+  snprintf(time, sizeof(time), "%02u%02u%02u.%03u",
+           seconds / 3600, (seconds / 60) % 60, seconds % 60, ms);
+
+  std::string lat = angle(latitude,  2);
+  std::string lon = angle(longitude, 3);
+  char        ns  = latitude  < 0.0 ? 'S' : 'N';
+  char        ew  = longitude < 0.0 ? 'W' : 'E';
+
+  char body[96];
+  snprintf(body, sizeof(body), "GPGGA,%s,%s,%c,%s,%c,1,08,0.9,45.0,M,-17.0,M,,",
+           time, lat.c_str(), ns, lon.c_str(), ew);
+
+  std::string text = sentence(body);
+
+  snprintf(body, sizeof(body), "GPRMC,%s,A,%s,%c,%s,%c,0.50,90.00,010118,,,A",
+           time, lat.c_str(), ns, lon.c_str(), ew);
+
+  return text + sentence(body);
+}
+
+} // namespace unnamed
+
+
+//  ****************************************************************************
+int main(int argc, char* argv[])
+{
+  uint32_t  fixes       = 50;
+  double    rate        = 10.0;
+  size_t    chunk       = 16;
+  double    latency_ms  = 20.0;
+
+  int option = 0;
+  while ((option = getopt(argc, argv, "n:r:c:l:h")) != -1)
+  {
+    switch (option)
+    {
+    case 'n':
+      fixes       = uint32_t(atoi(optarg));
+      break;
+    case 'r':
+      rate        = atof(optarg);
+      break;
+    case 'c':
+      chunk       = size_t(atoi(optarg));
+      break;
+    case 'l':
+      latency_ms  = atof(optarg);
+      break;
+    default:
+      usage();
+      return 1;
+    }
+  }
+
+  if ( fixes == 0
+    || rate  <= 0.0)
+  {
+    usage();
+    return 1;
+  }
+
+  Receiver receiver;
+  if (!receiver.open())
+  {
+    cout << "Could not create the port of the receiver.\n";
+    return 1;
+  }
+
+  HAL::MonotonicClock clock;
+
+  GPS::UltimateGPS gps;
+  if (!gps.init(receiver.device(), clock))
+  {
+    cout << "The GPS driver did not start.\n";
+    return 1;
+  }
+
+  receiver.discard();
+
+  // Noise longer than any sentence, read before the end of its line.
+  uint32_t writes = 0;
+  receiver.write(std::string(k_noise_bytes, 'x'), chunk, 0, writes);
+  std::this_thread::sleep_for(std::chrono::nanoseconds(10 * k_chunk_ns));
+  receiver.write("\r\n", chunk, 0, writes);
+
+  auto period = std::chrono::nanoseconds(uint64_t(k_ns_per_s / rate));
+  auto next   = std::chrono::steady_clock::now();
+
+  writes = 0;
+
+  uint64_t  start_polls     = gps.polls();
+  uint64_t  start_reads     = gps.reads();
+  uint32_t  parsed          = 0;
+  uint32_t  misplaced       = 0;
+  uint64_t  bytes           = 0;
+  double    total_latency   = 0.0;
+  uint64_t  max_latency_ns  = 0;
+
+  for (uint32_t index = 0; index < fixes; ++index)
+  {
+    double      latitude  = k_latitude  + index * k_step;
+    double      longitude = k_longitude - index * k_step;
+    std::string text      = fix(index, latitude, longitude);
+
+    uint64_t  expected  = gps.fixes() + 1;
+    // The port turns the carriage return that ends the RMC sentence
+    // into the new line of the sentence.
+    uint64_t  write_ns  = receiver.write(text, chunk, text.size() - 2, writes);
+    bytes              += text.size();
+
+    while ( gps.fixes() < expected
+         && timestamp_ns() - write_ns < k_timeout_ns)
+    {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    if (gps.fixes() >= expected)
+    {
+      uint64_t latency_ns = gps.fix_ns() > write_ns ? gps.fix_ns() - write_ns : 0;
+
+      total_latency  += to_seconds(latency_ns);
+      max_latency_ns  = std::max(max_latency_ns, latency_ns);
+      ++parsed;
+
+      const GPS::location_t &location = gps.location();
+      if ( !location.is_valid
+        || std::fabs(location.latitude  - latitude)  > k_max_error
+        || std::fabs(location.longitude - longitude) > k_max_error)
+      {
+        ++misplaced;
+      }
+    }
+
+    next += period;
+    std::this_thread::sleep_until(next);
+  }
+
+  uint64_t polls = gps.polls() - start_polls;
+  uint64_t reads = gps.reads() - start_reads;
+
+  gps.term();
+
+  double per_fix        = double(polls + reads) / fixes;
+  double writes_per_fix = double(writes) / fixes;
+  double mean_ms        = parsed ? 1000.0 * total_latency / parsed : 0.0;
+  double max_ms         = double(max_latency_ns) / k_ns_per_ms;
+
+  cout  << "Sent " << fixes << " fixes of " << double(bytes) / fixes << " bytes, in "
+        << writes_per_fix << " writes each.\n"
+        << "  parsed " << parsed
+        << "  misplaced " << misplaced
+        << "  sentences " << gps.sentences()
+        << "  overruns " << gps.overruns() << "\n"
+        << "  system calls per fix " << per_fix
+        << "  (" << double(polls) / fixes << " polls, "
+        << double(reads) / fixes << " reads)\n"
+        << "  latency (ms)  mean " << mean_ms
+        << "  max " << max_ms << "\n";
+
+  bool is_passed = parsed == fixes
+                && 0 == misplaced
+                && gps.overruns() > 0
+                && per_fix <= 2.0 * writes_per_fix
+                && max_ms  <= latency_ms;
+
+  cout << (is_passed ? "PASSED" : "FAILED") << "\n";
+
+  return is_passed ? 0 : 1;
+}
@@ -0,0 +1,385 @@
+/// @file qchandoff.cpp
+///
+/// Compares the two ways the samples of the IMU reach the control loop,
+/// against a stub of the DMP that interrupts at 200 Hz on its own thread.
+///
+/// In the callback path, as the drone flew before, the DMP thread runs the
+/// control cycle inside its callback. In the thread path, as the drone flies
+/// now, the callback publishes the sample to a TripleBuffer and notifies an
+/// EventSignal, and an update thread one priority below the DMP thread runs
+/// the cycle. The control cycle is simulated by a fixed amount of work.
+///
+/// For each path the test reports, in microseconds:
+///   interrupt   from the deadline of the stub to its interrupt,
+///   callback    the time the DMP thread spends in the callback,
+///   wake        from the interrupt to the start of the control cycle,
+///   jitter      the deviation of the period between the control cycles
+///               from the period of the interrupts.
+///
+/// The test passes when the thread path runs a cycle for each sample, and
+/// its callback returns in a small share of the work of a cycle.
+///
+/// Run as root, the threads run at the SCHED_FIFO priorities of the flight
+/// software. Otherwise they run with the default policy, and the jitter is
+/// the scheduler's.
+///
+/// Usage: qchandoff [-t seconds] [-r rate] [-w work_us]
+///
+//  ****************************************************************************
+#include "../hal.h"
+#include "../utility/event_signal.h"
+#include "../utility/histogram.h"
+#include "../utility/timebase.h"
+#include "../utility/triple_buffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+const int       k_control_priority    = HAL::k_imu_priority - 1;
+
+const int       k_wait_timeout_ms     = 100;
+const double    k_min_cycle_share     = 0.99; ///< Of the interrupts.
+const double    k_max_callback_share  = 0.1;  ///< Of the work of a cycle.
+
+
+//  ****************************************************************************
+void usage()
+{
+  cerr  << "Usage: qchandoff [-t seconds] [-r rate] [-w work_us]\n"
+        << "  -t  Seconds of each path. Default: 5\n"
+        << "  -r  Hz, the rate of the interrupts. Default: 200\n"
+        << "  -w  us, the work of a control cycle. Default: 1000\n";
+}
+
+//  ****************************************************************************
+struct Options
+{
+  double    seconds;
+  double    rate;
+  uint64_t  work_ns;
+};
+
+//  ****************************************************************************
+/// A sample of the IMU, as the callback receives it.
+///
+struct Sample
+{
+  HAL::IMUData  data;
+  uint64_t      timestamp_ns;             ///< Of the interrupt.
+};
+
+//  ****************************************************************************
+/// Converts a duration in nanoseconds to microseconds.
+///
+double to_us(uint64_t duration_ns)
+{
+  return double(duration_ns) / k_ns_per_us;
+}
+
+//  ****************************************************************************
+/// Sets the real-time priority of a thread.
+///
+/// @return false if the process may not use SCHED_FIFO.
+///
+bool set_priority(std::thread &thread, int priority)
+{
+  sched_param param = {0};
+  param.sched_priority = priority;
+
+  return 0 == pthread_setschedparam(thread.native_handle(), SCHED_FIFO, &param);
+}
+
+
+//  ****************************************************************************
+/// Delivers the interrupts of the stub DMP to a simulated control loop, by
+/// one of the two paths.
+///
+class Handoff
+{
+public:
+  //  **************************************************************************
+  Handoff(const Options &options, bool is_threaded)
+    : m_options(options)
+    , m_is_threaded(is_threaded)
+    , m_period_ns(uint64_t(k_ns_per_s / options.rate))
+    , m_is_exit(false)
+    , m_sample()
+    , m_last_cycle_ns(0)
+    , m_interrupts(0)
+    , m_cycles(0)
+  { }
+
+  //  **************************************************************************
+  /// Runs the interrupts of the stub for the time of the options.
+  ///
+  /// @return true if the threads run at their real-time priorities.
+  ///
+  bool run()
+  {
+    bool is_realtime = true;
+
+    std::thread update;
+    if (m_is_threaded)
+    {
+      update      = std::thread(update_proc, this);
+      is_realtime = set_priority(update, k_control_priority);
+    }
+
+    std::thread dmp(dmp_proc, this);
+    is_realtime = set_priority(dmp, HAL::k_imu_priority) && is_realtime;
+
+    dmp.join();
+
+    if (m_is_threaded)
+    {
+      // The last sample is processed before the update thread exits.
+      std::this_thread::sleep_for(std::chrono::nanoseconds(m_period_ns));
+
+      m_is_exit = true;
+      m_event.notify();
+      update.join();
+    }
+
+    return is_realtime;
+  }
+
+  //  **************************************************************************
+  void report(std::ostream &out) const
+  {
+    std::ios::fmtflags flags = out.flags();
+
+    out << (m_is_threaded ? "Thread" : "Callback") << " path: "
+        << m_interrupts << " interrupts, " << m_cycles << " cycles\n"
+        << std::setw(10) << "(us)"
+        << std::setw(10) << "count"
+        << std::setw(10) << "min"
+        << std::setw(10) << "p50"
+        << std::setw(10) << "p99"
+        << std::setw(10) << "p99.9"
+        << std::setw(10) << "max" << "\n";
+
+    out << std::fixed << std::setprecision(1);
+
+    report(out, "interrupt",  m_interrupt);
+    report(out, "callback",   m_callback);
+    report(out, "wake",       m_wake);
+    report(out, "jitter",     m_jitter);
+
+    out.flags(flags);
+  }
+
+  //  **************************************************************************
+  uint32_t                interrupts() const  { return m_interrupts;  }
+  uint32_t                cycles()     const  { return m_cycles;      }
+  const LatencyHistogram& callback()   const  { return m_callback;    }
+
+private:
+  //  **************************************************************************
+  static
+    void report(std::ostream &out, const char *p_name, const LatencyHistogram &hist)
+  {
+    out << std::setw(10) << p_name
+        << std::setw(10) << hist.count()
+        << std::setw(10) << to_us(hist.min())
+        << std::setw(10) << to_us(hist.percentile(0.50))
+        << std::setw(10) << to_us(hist.percentile(0.99))
+        << std::setw(10) << to_us(hist.percentile(0.999))
+        << std::setw(10) << to_us(hist.max()) << "\n";
+  }
+
+  //  **************************************************************************
+  //  The stub of the DMP, which interrupts once each period.
+  //
+  static
+    void dmp_proc(Handoff *p_this)
+  {
+    uint32_t  count     = uint32_t(p_this->m_options.seconds * p_this->m_options.rate);
+    uint64_t  deadline  = timestamp_ns();
+
+    for (uint32_t index = 0; index < count; ++index)
+    {
+      deadline += p_this->m_period_ns;
+
+      timespec next = { time_t(deadline / k_ns_per_s), long(deadline % k_ns_per_s) };
+      while (0 != clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr))
+      { }
+
+      // The interrupt is stamped as RCIMU stamps it, on entry to the callback.
+      uint64_t timestamp = timestamp_ns();
+      p_this->m_interrupt.record(timestamp - deadline);
+
+      p_this->interrupt(index, timestamp);
+
+      p_this->m_callback.record(timestamp_ns() - timestamp);
+    }
+  }
+
+  //  **************************************************************************
+  //  The callback of the DMP.
+  //
+  void interrupt(uint32_t index, uint64_t timestamp)
+  {
+    ++m_interrupts;
+
+    Sample &sample = m_is_threaded ? m_samples.write_buffer() : m_sample;
+
+    sample.data.gyro[HAL::k_tb_roll_y]  = float(index);
+    sample.timestamp_ns                 = timestamp;
+
+    if (m_is_threaded)
+    {
+      m_samples.publish();
+      m_event.notify();
+    }
+    else
+    {
+      cycle(sample);
+    }
+  }
+
+  //  **************************************************************************
+  //  The update thread, as Drone::thread_proc.
+  //
+  static
+    void update_proc(Handoff *p_this)
+  {
+    while (!p_this->m_is_exit)
+    {
+      uint64_t signals = p_this->m_event.wait_for(k_wait_timeout_ms);
+      if (p_this->m_is_exit)
+      {
+        break;
+      }
+
+      if ( signals > 0
+        && p_this->m_samples.acquire())
+      {
+        p_this->cycle(p_this->m_samples.read_buffer());
+      }
+    }
+  }
+
+  //  **************************************************************************
+  //  A control cycle, which works for the time of the options.
+  //
+  void cycle(const Sample &sample)
+  {
+    uint64_t start = timestamp_ns();
+
+    m_wake.record(start - sample.timestamp_ns);
+
+    if (m_last_cycle_ns)
+    {
+      int64_t deviation = int64_t(start - m_last_cycle_ns) - int64_t(m_period_ns);
+      m_jitter.record(uint64_t(deviation < 0 ? -deviation : deviation));
+    }
+
+    m_last_cycle_ns = start;
+    ++m_cycles;
+
+    while (timestamp_ns() - start < m_options.work_ns)
+    { }
+  }
+
+  //  **************************************************************************
+  const Options        &m_options;
+  bool                  m_is_threaded;
+  uint64_t              m_period_ns;
+
+  TripleBuffer<Sample>  m_samples;        ///< The thread path.
+  EventSignal           m_event;
+  std::atomic<bool>     m_is_exit;
+
+  Sample                m_sample;         ///< The callback path.
+  uint64_t              m_last_cycle_ns;
+
+  uint32_t              m_interrupts;     ///< Written by the DMP thread.
+  std::atomic<uint32_t> m_cycles;         ///< Written by the control cycle.
+
+  LatencyHistogram      m_interrupt;
+  LatencyHistogram      m_callback;
+  LatencyHistogram      m_wake;
+  LatencyHistogram      m_jitter;
+};
+
+} // namespace unnamed
+
+
+//  ****************************************************************************
+int main(int argc, char* argv[])
+{
+  Options options = { 5.0, 200.0, 1000 * k_ns_per_us };
+
+  int option = 0;
+  while ((option = getopt(argc, argv, "t:r:w:h")) != -1)
+  {
+    switch (option)
+    {
+    case 't':
+      options.seconds = atof(optarg);
+      break;
+    case 'r':
+      options.rate    = atof(optarg);
+      break;
+    case 'w':
+      options.work_ns = uint64_t(atof(optarg) * k_ns_per_us);
+      break;
+    default:
+      usage();
+      return 1;
+    }
+  }
+
+  if ( options.seconds <= 0.0
+    || options.rate    <= 0.0
+    || options.work_ns >= uint64_t(k_ns_per_s / options.rate))
+  {
+    usage();
+    return 1;
+  }
+
+  Handoff callback(options, false);
+  Handoff threaded(options, true);
+
+  bool is_realtime = callback.run();
+  is_realtime      = threaded.run() && is_realtime;
+
+  if (!is_realtime)
+  {
+    cout << "Warning: Could not set the real-time priorities, run as root to use them.\n";
+  }
+
+  callback.report(cout);
+  threaded.report(cout);
+
+  uint64_t callback_ns  = threaded.callback().percentile(0.99);
+  uint64_t allowed_ns   = uint64_t(k_max_callback_share * options.work_ns);
+
+  cout  << std::fixed << std::setprecision(1)
+        << "Thread path callback p99 " << to_us(callback_ns)
+        << " us, allowed " << to_us(allowed_ns) << " us\n";
+
+  bool is_passed = threaded.cycles() >= k_min_cycle_share * threaded.interrupts()
+                && callback_ns       <= allowed_ns;
+
+  cout << (is_passed ? "PASSED" : "FAILED") << "\n";
+
+  return is_passed ? 0 : 1;
+}
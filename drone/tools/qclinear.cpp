@@ -0,0 +1,527 @@
+/// @file qclinear.cpp
+///
+/// Tests the results of the float linear algebra of the estimators, and its
+/// conversions to and from imumaths.
+///
+/// The solves of the Cholesky and the LDLT factorizations are checked by the
+/// residual of random symmetric positive-definite systems, and a matrix that
+/// is not positive definite must be rejected. The expressions that read
+/// their destination, such as A = A * f, A = A * B, T = T.transpose() and
+/// P = F * P * F' + Q, are compared to the same arithmetic in double, on
+/// separate matrices. Vectors, matrices and quaternions are converted to
+/// imumaths and back, and from imumaths and back.
+///
+/// The test passes when each residual and difference is within its limit.
+///
+/// Usage: qclinear [-n trials] [-s seed]
+///
+//  ****************************************************************************
+#include "../utility/imumaths_adapter.h"
+#include "../utility/linear_algebra.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+#include <unistd.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+const size_t  k_states          = 6;        ///< Of the Kalman filter.
+const size_t  k_columns         = 2;        ///< Of the right-hand sides.
+
+const double  k_max_residual    = 1e-5;     ///< Relative to the norms.
+const double  k_max_difference  = 1e-5;     ///< Relative to the largest element.
+const double  k_max_conversion  = 1e-6;     ///< Relative, of a round trip
+                                            ///  through float.
+
+typedef Matrix<k_states, k_states>    StateMatrix;
+typedef Matrix<k_states, k_columns>   RightHand;
+
+
+//  ****************************************************************************
+void usage()
+{
+  cerr  << "Usage: qclinear [-n trials] [-s seed]\n"
+        << "  -n  Random trials of each check. Default: 1000\n"
+        << "  -s  Seed of the random matrices. Default: 42\n";
+}
+
+//  ****************************************************************************
+/// The largest difference of the checks of a kind, and the pass of each.
+///
+struct Check
+{
+  const char   *p_name;
+  double        limit;
+  double        worst;
+  uint64_t      failed;
+
+  //  **************************************************************************
+  void add(double value)
+  {
+    worst = std::max(worst, value);
+    if (!(value <= limit))
+    {
+      ++failed;
+    }
+  }
+
+  //  **************************************************************************
+  bool report() const
+  {
+    cout  << "  " << p_name << ": largest " << worst
+          << ", allowed " << limit
+          << (failed ? ", FAILED " : "");
+
+    if (failed)
+    {
+      cout << failed << " times";
+    }
+
+    cout << "\n";
+
+    return 0 == failed;
+  }
+};
+
+//  ****************************************************************************
+/// Fills a matrix with random elements.
+///
+template <size_t Rows, size_t Cols>
+void randomize(Matrix<Rows, Cols> &matrix, std::mt19937 &random)
+{
+  std::uniform_real_distribution<float> element(-1.0f, 1.0f);
+
+  for (size_t index = 0; index < Matrix<Rows, Cols>::k_size; ++index)
+  {
+    matrix[index] = element(random);
+  }
+}
+
+//  ****************************************************************************
+/// Returns a random symmetric positive-definite matrix, as a covariance.
+///
+StateMatrix covariance(std::mt19937 &random)
+{
+  StateMatrix m;
+  randomize(m, random);
+
+  StateMatrix a = m * m.transpose();
+  for (size_t index = 0; index < k_states; ++index)
+  {
+    a(index, index) += 0.1f;
+  }
+
+  return a;
+}
+
+//  ****************************************************************************
+/// The largest absolute element of a matrix.
+///
+template <size_t Rows, size_t Cols>
+double max_norm(const Matrix<Rows, Cols> &matrix)
+{
+  double norm = 0.0;
+  for (size_t index = 0; index < Matrix<Rows, Cols>::k_size; ++index)
+  {
+    norm = std::max(norm, std::fabs(double(matrix[index])));
+  }
+
+  return norm;
+}
+
+//  ****************************************************************************
+/// The largest difference of a matrix from the same matrix in double,
+/// relative to its largest element.
+///
+template <size_t Rows, size_t Cols>
+double difference(const Matrix<Rows, Cols> &actual, const double *p_expected)
+{
+  double norm = 0.0;
+  double diff = 0.0;
+
+  for (size_t index = 0; index < Matrix<Rows, Cols>::k_size; ++index)
+  {
+    norm = std::max(norm, std::fabs(p_expected[index]));
+    diff = std::max(diff, std::fabs(actual[index] - p_expected[index]));
+  }
+
+  return norm > 0.0 ? diff / norm : diff;
+}
+
+//  ****************************************************************************
+/// Multiplies two matrices in double.
+///
+template <size_t Rows, size_t Inner, size_t Cols>
+void multiply(const double *p_lhs, const double *p_rhs, double *p_result)
+{
+  for (size_t row = 0; row < Rows; ++row)
+  {
+    for (size_t col = 0; col < Cols; ++col)
+    {
+      double sum = 0.0;
+      for (size_t inner = 0; inner < Inner; ++inner)
+      {
+        sum += p_lhs[row * Inner + inner] * p_rhs[inner * Cols + col];
+      }
+
+      p_result[row * Cols + col] = sum;
+    }
+  }
+}
+
+//  ****************************************************************************
+/// Copies a matrix to double.
+///
+template <size_t Rows, size_t Cols>
+void to_double(const Matrix<Rows, Cols> &matrix, double *p_result)
+{
+  std::copy(matrix.data(), matrix.data() + Matrix<Rows, Cols>::k_size, p_result);
+}
+
+//  ****************************************************************************
+/// The residual of a solve, |A X - B| / (|A| |X| + |B|).
+///
+double residual(const StateMatrix &a, const RightHand &x, const RightHand &b)
+{
+  RightHand error = a * x - b;
+
+  return max_norm(error) / (max_norm(a) * max_norm(x) + max_norm(b));
+}
+
+//  ****************************************************************************
+/// Solves random systems with both factorizations.
+///
+bool test_solves(uint64_t trials, std::mt19937 &random)
+{
+  Check cholesky  = { "Cholesky residual", k_max_residual, 0.0, 0 };
+  Check ldlt      = { "LDLT residual",     k_max_residual, 0.0, 0 };
+  Check failed    = { "Factorizations failed", 0.0, 0.0, 0 };
+
+  for (uint64_t trial = 0; trial < trials; ++trial)
+  {
+    StateMatrix a = covariance(random);
+
+    RightHand b;
+    randomize(b, random);
+
+    Cholesky<k_states> llt;
+    RightHand          x = b;
+    if (llt.compute(a))
+    {
+      llt.solve(x);
+      cholesky.add(residual(a, x, b));
+    }
+    else
+    {
+      failed.add(1.0);
+    }
+
+    LDLT<k_states>  ldl;
+    RightHand       y = b;
+    if (ldl.compute(a))
+    {
+      ldl.solve(y);
+      ldlt.add(residual(a, y, b));
+    }
+    else
+    {
+      failed.add(1.0);
+    }
+  }
+
+  // A matrix with a negative eigenvalue has no Cholesky factor.
+  StateMatrix indefinite = StateMatrix::identity();
+  indefinite(k_states - 1, k_states - 1) = -1.0f;
+
+  Cholesky<k_states> llt;
+  bool is_rejected = !llt.compute(indefinite);
+
+  cout << "Solves of " << trials << " systems of " << k_states << " states:\n";
+
+  bool is_passed = cholesky.report();
+  is_passed      = ldlt.report()   && is_passed;
+  is_passed      = failed.report() && is_passed;
+
+  cout  << "  Indefinite matrix: "
+        << (is_rejected ? "rejected" : "FACTORED") << "\n";
+
+  return is_rejected && is_passed;
+}
+
+//  ****************************************************************************
+/// Evaluates the expressions that read their destination.
+///
+bool test_aliasing(uint64_t trials, std::mt19937 &random)
+{
+  std::uniform_real_distribution<float> factor(-2.0f, 2.0f);
+
+  Check scaled      = { "A = A * f",            k_max_difference, 0.0, 0 };
+  Check product     = { "A = A * B",            k_max_difference, 0.0, 0 };
+  Check right       = { "B = A * B",            k_max_difference, 0.0, 0 };
+  Check transpose   = { "T = T.transpose()",    k_max_difference, 0.0, 0 };
+  Check symmetric   = { "A += A.transpose()",   k_max_difference, 0.0, 0 };
+  Check propagate   = { "P = F * P * F' + Q",   k_max_difference, 0.0, 0 };
+
+  const size_t k_size = StateMatrix::k_size;
+
+  for (uint64_t trial = 0; trial < trials; ++trial)
+  {
+    StateMatrix a, b, f, p, q;
+    randomize(a, random);
+    randomize(b, random);
+    randomize(f, random);
+    p = covariance(random);
+    q = covariance(random);
+
+    double da[k_size], db[k_size], df[k_size], dp[k_size], dq[k_size];
+    to_double(a, da);
+    to_double(b, db);
+    to_double(f, df);
+    to_double(p, dp);
+    to_double(q, dq);
+
+    double expected[k_size];
+    double temp[k_size];
+
+    // A = A * f
+    float       scale = factor(random);
+    StateMatrix work  = a;
+    work = work * scale;
+    for (size_t index = 0; index < k_size; ++index)
+    {
+      expected[index] = da[index] * scale;
+    }
+    scaled.add(difference(work, expected));
+
+    // A = A * B
+    work = a;
+    work = work * b;
+    multiply<k_states, k_states, k_states>(da, db, expected);
+    product.add(difference(work, expected));
+
+    // B = A * B
+    work = b;
+    work = a * work;
+    right.add(difference(work, expected));
+
+    // T = T.transpose()
+    work = a;
+    work = work.transpose();
+    for (size_t row = 0; row < k_states; ++row)
+    {
+      for (size_t col = 0; col < k_states; ++col)
+      {
+        expected[row * k_states + col] = da[col * k_states + row];
+      }
+    }
+    transpose.add(difference(work, expected));
+
+    // A += A.transpose()
+    work  = a;
+    work += work.transpose();
+    for (size_t row = 0; row < k_states; ++row)
+    {
+      for (size_t col = 0; col < k_states; ++col)
+      {
+        expected[row * k_states + col] = da[row * k_states + col] + da[col * k_states + row];
+      }
+    }
+    symmetric.add(difference(work, expected));
+
+    // P = F * P * F' + Q
+    double dft[k_size];
+    for (size_t row = 0; row < k_states; ++row)
+    {
+      for (size_t col = 0; col < k_states; ++col)
+      {
+        dft[row * k_states + col] = df[col * k_states + row];
+      }
+    }
+
+    multiply<k_states, k_states, k_states>(df, dp, temp);
+    multiply<k_states, k_states, k_states>(temp, dft, expected);
+    for (size_t index = 0; index < k_size; ++index)
+    {
+      expected[index] += dq[index];
+    }
+
+    p = f * p * f.transpose() + q;
+    propagate.add(difference(p, expected));
+  }
+
+  cout << "Expressions that read their destination, " << trials << " trials:\n";
+
+  bool is_passed = scaled.report();
+  is_passed      = product.report()   && is_passed;
+  is_passed      = right.report()     && is_passed;
+  is_passed      = transpose.report() && is_passed;
+  is_passed      = symmetric.report() && is_passed;
+  is_passed      = propagate.report() && is_passed;
+
+  return is_passed;
+}
+
+//  ****************************************************************************
+/// The relative difference of two values.
+///
+double relative(double actual, double expected)
+{
+  double scale = std::max(std::fabs(expected), 1.0);
+
+  return std::fabs(actual - expected) / scale;
+}
+
+//  ****************************************************************************
+/// Converts values to imumaths and back, and from imumaths and back.
+///
+bool test_adapter(uint64_t trials, std::mt19937 &random)
+{
+  std::uniform_real_distribution<double> element(-100.0, 100.0);
+
+  Check to_imu_trip   = { "float to imumaths and back", 0.0,              0.0, 0 };
+  Check to_float_trip = { "imumaths to float and back", k_max_conversion, 0.0, 0 };
+
+  for (uint64_t trial = 0; trial < trials; ++trial)
+  {
+    // float to imumaths and back is exact.
+    Vector<3>     vector;
+    Matrix<3, 3>  matrix;
+    randomize(vector, random);
+    randomize(matrix, random);
+
+    Quat quat = { float(element(random)), float(element(random)),
+                  float(element(random)), float(element(random)) };
+
+    Vector<3>     vector_back = to_float(to_imu(vector));
+    Matrix<3, 3>  matrix_back = to_float(to_imu(matrix));
+    Quat          quat_back   = to_float(to_imu(quat));
+
+    double diff = 0.0;
+    for (size_t index = 0; index < 3; ++index)
+    {
+      diff = std::max(diff, std::fabs(double(vector_back[index]) - vector[index]));
+    }
+
+    for (size_t index = 0; index < 9; ++index)
+    {
+      diff = std::max(diff, std::fabs(double(matrix_back[index]) - matrix[index]));
+    }
+
+    diff = std::max(diff, std::fabs(double(quat_back.w) - quat.w));
+    diff = std::max(diff, std::fabs(double(quat_back.x) - quat.x));
+    diff = std::max(diff, std::fabs(double(quat_back.y) - quat.y));
+    diff = std::max(diff, std::fabs(double(quat_back.z) - quat.z));
+
+    to_imu_trip.add(diff);
+
+    // imumaths to float and back loses the precision of a float.
+    imu::Vector<3>  imu_vector(element(random), element(random), element(random));
+    imu::Matrix<3>  imu_matrix;
+    for (int row = 0; row < 3; ++row)
+    {
+      for (int col = 0; col < 3; ++col)
+      {
+        imu_matrix(row, col) = element(random);
+      }
+    }
+
+    imu::Quaternion imu_quat(element(random), element(random),
+                             element(random), element(random));
+
+    imu::Vector<3>  imu_vector_back = to_imu(to_float(imu_vector));
+    imu::Matrix<3>  imu_matrix_back = to_imu(to_float(imu_matrix));
+    imu::Quaternion imu_quat_back   = to_imu(to_float(imu_quat));
+
+    diff = 0.0;
+    for (int index = 0; index < 3; ++index)
+    {
+      diff = std::max(diff, relative(imu_vector_back[index], imu_vector[index]));
+    }
+
+    for (int row = 0; row < 3; ++row)
+    {
+      for (int col = 0; col < 3; ++col)
+      {
+        diff = std::max(diff, relative(imu_matrix_back(row, col), imu_matrix(row, col)));
+      }
+    }
+
+    diff = std::max(diff, relative(imu_quat_back.w(), imu_quat.w()));
+    diff = std::max(diff, relative(imu_quat_back.x(), imu_quat.x()));
+    diff = std::max(diff, relative(imu_quat_back.y(), imu_quat.y()));
+    diff = std::max(diff, relative(imu_quat_back.z(), imu_quat.z()));
+
+    to_float_trip.add(diff);
+  }
+
+  // An expression converts as the matrix it evaluates to.
+  Matrix<3, 3>    matrix = Matrix<3, 3>::identity() * 2.0f;
+  imu::Matrix<3>  doubled = to_imu(matrix + matrix);
+
+  bool is_expression = 4.0 == doubled(0, 0)
+                    && 0.0 == doubled(0, 1);
+
+  cout << "Conversions with imumaths, " << trials << " trials:\n";
+
+  bool is_passed = to_imu_trip.report();
+  is_passed      = to_float_trip.report() && is_passed;
+
+  cout  << "  Expression to imumaths: "
+        << (is_expression ? "converted" : "WRONG") << "\n";
+
+  return is_expression && is_passed;
+}
+
+} // namespace unnamed
+
+
+//  ****************************************************************************
+int main(int argc, char* argv[])
+{
+  uint64_t  trials  = 1000;
+  uint32_t  seed    = 42;
+
+  int option = 0;
+  while ((option = getopt(argc, argv, "n:s:h")) != -1)
+  {
+    switch (option)
+    {
+    case 'n':
+      trials  = uint64_t(atoll(optarg));
+      break;
+    case 's':
+      seed    = uint32_t(atoi(optarg));
+      break;
+    default:
+      usage();
+      return 1;
+    }
+  }
+
+  if (0 == trials)
+  {
+    usage();
+    return 1;
+  }
+
+  std::mt19937 random(seed);
+
+  bool is_passed = test_solves(trials, random);
+  is_passed      = test_aliasing(trials, random) && is_passed;
+  is_passed      = test_adapter(trials, random)  && is_passed;
+
+  cout << (is_passed ? "PASSED" : "FAILED") << "\n";
+
+  return is_passed ? 0 : 1;
+}
@@ -0,0 +1,311 @@
+/// @file qclog.cpp
+///
+/// Offline decoder for the binary flight logs written by the FlightRecorder.
+///
+/// Usage: qclog [-f csv|tsv|legacy] [-o output] <log.qcl>
+///
+///   csv     All recorded channels, comma separated, with a header row (default).
+///   tsv     All recorded channels, tab separated, with a header row.
+///   legacy  The 16 columns of the original data.csv log, without a header.
+///
+//  ****************************************************************************
+#include "../flight_log.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::ostream;
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+enum Format
+{
+  k_csv,
+  k_tsv,
+  k_legacy
+};
+
+const char* k_pid_names[] =
+{
+  "roll_stab",
+  "pitch_stab",
+  "roll_rate_pid",
+  "pitch_rate_pid",
+  "rotation"
+};
+
+const char* k_pid_fields[] =
+{
+  "setpoint",
+  "measured",
+  "error",
+  "integral",
+  "derivative",
+  "output"
+};
+
+
+//  ****************************************************************************
+void usage()
+{
+  cerr  << "Usage: qclog [-f csv|tsv|legacy] [-o output] <log.qcl>\n";
+}
+
+//  ****************************************************************************
+const PIDRecord& pid_at(const CycleRecord &cycle, size_t index)
+{
+  const PIDRecord* pids[] =
+  {
+    &cycle.roll_stabilize,
+    &cycle.pitch_stabilize,
+    &cycle.roll_rate_pid,
+    &cycle.pitch_rate_pid,
+    &cycle.rotation
+  };
+
+  return *pids[index];
+}
+
+//  ****************************************************************************
+void write_header(ostream &out, char sep)
+{
+  out << "timestamp_ns" << sep << "sequence" << sep
+      << "is_armed" << sep << "control_mode" << sep << "is_critical" << sep
+      << "throttle" << sep
+      << "roll" << sep << "pitch" << sep << "yaw" << sep
+      << "roll_rate" << sep << "pitch_rate" << sep << "yaw_rate";
+
+  for (size_t pid = 0; pid < 5; ++pid)
+  {
+    for (size_t field = 0; field < 6; ++field)
+    {
+      out << sep << k_pid_names[pid] << "_" << k_pid_fields[field];
+    }
+  }
+
+  for (char motor = 'A'; motor <= 'H'; ++motor)
+  {
+    out << sep << "motor_" << motor;
+  }
+
+  out << sep << "battery_voltage";
+  out << "\n";
+}
+
+//  ****************************************************************************
+void write_cycle(ostream &out, const FlightRecord &record, char sep)
+{
+  const CycleRecord &cycle = record.cycle;
+
+  out << record.timestamp_ns << sep << record.sequence << sep
+      << int(cycle.is_armed) << sep << int(cycle.control_mode) << sep
+      << int(cycle.is_critical) << sep
+      << cycle.throttle << sep
+      << cycle.roll << sep << cycle.pitch << sep << cycle.yaw << sep
+      << cycle.roll_rate << sep << cycle.pitch_rate << sep << cycle.yaw_rate;
+
+  for (size_t index = 0; index < 5; ++index)
+  {
+    const PIDRecord &pid = pid_at(cycle, index);
+
+    out << sep << pid.setpoint
+        << sep << pid.measured
+        << sep << pid.error
+        << sep << pid.integral
+        << sep << pid.derivative
+        << sep << pid.output;
+  }
+
+  for (size_t index = 0; index < 8; ++index)
+  {
+    out << sep << cycle.motor[index];
+  }
+
+  out << sep << cycle.battery_voltage;
+  out << "\n";
+}
+
+//  ****************************************************************************
+//  Matches the column order of the data.csv file previously written
+//  directly by the control loop.
+//
+void write_legacy(ostream &out, const FlightRecord &record)
+{
+  const CycleRecord &cycle = record.cycle;
+
+  out << cycle.roll_stabilize.setpoint  << ","    // 1
+      << cycle.roll                     << ","    // 2
+      << cycle.roll_stabilize.output    << ","    // 3
+      << cycle.roll_rate_pid.setpoint   << ","    // 4
+      << cycle.roll_rate                << ","    // 5
+      << cycle.roll_rate_pid.output     << ","    // 6
+      << cycle.pitch_stabilize.setpoint << ","    // 7
+      << cycle.pitch                    << ","    // 8
+      << cycle.pitch_stabilize.output   << ","    // 9
+      << cycle.pitch_rate_pid.setpoint  << ","    // 10
+      << cycle.pitch_rate               << ","    // 11
+      << cycle.pitch_rate_pid.output    << ","    // 12
+      << cycle.rotation.setpoint        << ","    // 13
+      << cycle.yaw_rate                 << ","    // 14
+      << cycle.rotation.output          << ","    // 15
+      << cycle.yaw                      << "\n";  // 16
+}
+
+//  ****************************************************************************
+bool read_header(FILE* p_file, FlightLogHeader &header)
+{
+  if (1 != fread(&header, sizeof(header), 1, p_file))
+  {
+    cerr << "The file is too short to be a flight log.\n";
+    return false;
+  }
+
+  if (header.magic != k_flight_log_magic)
+  {
+    cerr << "The file is not a flight log.\n";
+    return false;
+  }
+
+  if (header.byte_order != k_flight_log_byte_order)
+  {
+    cerr << "The flight log was recorded with a different byte order.\n";
+    return false;
+  }
+
+  if ( header.version     != k_flight_log_version
+    || header.record_size != sizeof(FlightRecord)
+    || header.header_size != sizeof(FlightLogHeader))
+  {
+    cerr << "Unsupported flight log version: " << header.version << "\n";
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace unnamed
+
+
+//  ****************************************************************************
+int main(int argc, char* argv[])
+{
+  Format      format = k_csv;
+  std::string output;
+
+  int option = 0;
+  while ((option = getopt(argc, argv, "f:o:h")) != -1)
+  {
+    switch (option)
+    {
+    case 'f':
+      if (0 == strcmp(optarg, "csv"))
+        format = k_csv;
+      else if (0 == strcmp(optarg, "tsv"))
+        format = k_tsv;
+      else if (0 == strcmp(optarg, "legacy"))
+        format = k_legacy;
+      else
+      {
+        usage();
+        return 1;
+      }
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    default:
+      usage();
+      return 1;
+    }
+  }
+
+  if (optind >= argc)
+  {
+    usage();
+    return 1;
+  }
+
+  FILE* p_file = fopen(argv[optind], "rb");
+  if (!p_file)
+  {
+    cerr << "Could not open: " << argv[optind] << "\n";
+    return 1;
+  }
+
+  FlightLogHeader header;
+  if (!read_header(p_file, header))
+  {
+    fclose(p_file);
+    return 1;
+  }
+
+  std::ofstream file_out;
+  if (!output.empty())
+  {
+    file_out.open(output.c_str());
+    if (!file_out.is_open())
+    {
+      cerr << "Could not create: " << output << "\n";
+      fclose(p_file);
+      return 1;
+    }
+  }
+
+  ostream &out = output.empty() ? cout : file_out;
+  out.precision(9);
+
+  char sep = (format == k_tsv) ? '\t' : ',';
+  if (format != k_legacy)
+  {
+    write_header(out, sep);
+  }
+
+  FlightRecord  record;
+  uint64_t      count    = 0;
+  uint64_t      dropped  = 0;
+  uint32_t      expected = 0;
+
+  while (1 == fread(&record, sizeof(record), 1, p_file))
+  {
+    // Gaps in the sequence are records the recorder could not keep up with.
+    if (count > 0 && record.sequence != expected)
+    {
+      dropped += uint32_t(record.sequence - expected);
+    }
+
+    expected = record.sequence + 1;
+    ++count;
+
+    if (record.type != k_record_cycle)
+    {
+      continue;
+    }
+
+    if (format == k_legacy)
+    {
+      write_legacy(out, record);
+    }
+    else
+    {
+      write_cycle(out, record, sep);
+    }
+  }
+
+  fclose(p_file);
+
+  cerr  << count << " records decoded, "
+        << dropped << " records were dropped during recording.\n";
+
+  return 0;
+}
@@ -0,0 +1,384 @@
+/// @file qcrange.cpp
+///
+/// Tests the reader of the range finder against a simulated PRU, which
+/// writes the ring of range_ring.h in ordinary memory from its own thread.
+///
+/// The first test writes the ring as fast as the host allows, far faster
+/// than it is read, and checks that every sample the reader keeps is the
+/// one the PRU wrote with its sequence, and that the samples it loses are
+/// counted as dropped or torn.
+///
+/// The second test writes the echoes of a drone that rises and sinks at the
+/// rate of the HY-SRF05, with noise, spurious long echoes and missing echoes,
+/// and reads them with the RangeSensor thread. The control loop is played
+/// by the main thread, which compares each altitude it takes to the true
+/// altitude at the time of the echo, and checks its age.
+///
+/// Usage: qcrange [-t seconds] [-r rate] [-p poll_ms] [-n noise]
+///                [-o outliers] [-m misses] [-a altitude]
+///
+//  ****************************************************************************
+#include "../range.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include <unistd.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+const double    k_pi              = 3.14159265358979323846;
+
+const double    k_swing           = 0.3;      ///< meters, of the simulated climb.
+const double    k_swing_rate      = 0.25;     ///< Hz
+
+const uint64_t  k_control_ns      = 5 * k_ns_per_ms;
+const uint64_t  k_max_age_ns      = 100 * k_ns_per_ms;
+const double    k_max_rms_error   = 0.05;     ///< meters
+
+
+//  ****************************************************************************
+void usage()
+{
+  cerr  << "Usage: qcrange [-t seconds] [-r rate] [-p poll_ms] [-n noise]\n"
+        << "               [-o outliers] [-m misses] [-a altitude]\n"
+        << "  -t  Seconds of each test. Default: 2\n"
+        << "  -r  Hz, the rate of the simulated echoes. Default: 50\n"
+        << "  -p  Milliseconds between the reads of the ring. Default: 5\n"
+        << "  -n  meters, the standard deviation of the echoes. Default: 0.01\n"
+        << "  -o  The share of the echoes that are spurious. Default: 0.05\n"
+        << "  -m  The share of the samples without an echo. Default: 0.05\n"
+        << "  -a  meters, the altitude the drone climbs around. Default: 1\n";
+}
+
+//  ****************************************************************************
+/// Writes a sample to the ring, the way the PRU program does.
+///
+void write_sample(volatile RangeShared &shared, uint32_t timestamp, uint32_t echo)
+{
+  uint32_t            head = shared.head;
+  volatile RangeSlot &slot = shared.slots[head % RANGE_RING_SLOTS];
+
+  slot.sequence   = 0;
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.timestamp  = timestamp;
+  slot.echo       = echo;
+
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.sequence   = head + 1;
+  shared.echo     = echo;
+
+  std::atomic_thread_fence(std::memory_order_release);
+  shared.head     = head + 1;
+}
+
+//  ****************************************************************************
+/// The echo written with a sequence by the first test.
+///
+uint32_t stress_echo(uint32_t sequence)
+{
+  return (sequence * 2654435761u) | 1;
+}
+
+//  ****************************************************************************
+/// The IEP ticks between the samples of the first test.
+///
+const uint32_t k_stress_ticks = 1000;
+
+//  ****************************************************************************
+/// Writes the ring far faster than it is read.
+///
+/// @return true if no sample was kept that the PRU did not write.
+///
+bool test_overrun(double seconds)
+{
+  RangeShared shared = { };
+
+  RangeRing   ring;
+  ring.attach(&shared);
+
+  std::atomic_bool  is_exit(false);
+  uint32_t          written = 0;
+
+  std::thread writer([&]()
+  {
+    while (!is_exit)
+    {
+      uint32_t sequence = shared.head + 1;
+      write_sample(shared, sequence * k_stress_ticks, stress_echo(sequence));
+    }
+
+    written = shared.head;
+  });
+
+  RangeSample samples[RANGE_RING_SLOTS];
+  uint32_t    last      = 0;
+  uint32_t    corrupt   = 0;
+  uint64_t    end_ns    = timestamp_ns() + seconds_to_ns(seconds);
+
+  while (true)
+  {
+    uint64_t now_ns = timestamp_ns();
+    bool     is_end = now_ns >= end_ns;
+
+    if (is_end)
+    {
+      is_exit = true;
+      writer.join();
+    }
+
+    size_t count = ring.read(samples, RANGE_RING_SLOTS, now_ns);
+
+    for (size_t index = 0; index < count; ++index)
+    {
+      const RangeSample &sample = samples[index];
+
+      bool is_valid = sample.sequence > last
+                   && sample.distance == stress_echo(sample.sequence) / float(RANGE_ECHO_PER_M);
+
+      // The intervals between the samples of a read come from the PRU.
+      if ( is_valid
+        && index > 0)
+      {
+        uint64_t ticks = uint64_t(sample.sequence - samples[index - 1].sequence) * k_stress_ticks;
+        is_valid = sample.timestamp_ns - samples[index - 1].timestamp_ns
+                == ticks * k_ns_per_us / RANGE_TICKS_PER_US;
+      }
+
+      if (!is_valid)
+      {
+        ++corrupt;
+      }
+
+      last = sample.sequence;
+    }
+
+    if (is_end)
+    {
+      break;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  uint32_t counted = ring.samples() + ring.dropped() + ring.torn();
+
+  cout  << "Overrun test:\n"
+        << "  written " << written
+        << "  read " << ring.samples()
+        << "  dropped " << ring.dropped()
+        << "  torn " << ring.torn()
+        << "  corrupt " << corrupt << "\n";
+
+  return 0 == corrupt
+      && ring.samples() > 0
+      && counted == written;
+}
+
+//  ****************************************************************************
+/// The settings of the second test.
+///
+struct Flight
+{
+  double    seconds;
+  double    rate;                     ///< Hz
+  uint32_t  poll_ms;
+  double    noise;                    ///< meters
+  double    outliers;                 ///< The share of the echoes.
+  double    misses;                   ///< The share of the samples.
+  double    altitude;                 ///< meters
+};
+
+//  ****************************************************************************
+/// Returns the true altitude, at a time since the start of the test.
+///
+double true_altitude(const Flight &flight, double time)
+{
+  return flight.altitude + k_swing * std::sin(2.0 * k_pi * k_swing_rate * time);
+}
+
+//  ****************************************************************************
+/// Reads echoes of a climbing drone with the RangeSensor.
+///
+/// @return true if the altitude is accurate, and never older than allowed.
+///
+bool test_flight(const Flight &flight)
+{
+  RangeShared         shared = { };
+  RangeSensor         sensor;
+  HAL::MonotonicClock clock;
+
+  std::atomic_bool  is_exit(false);
+  uint32_t          written   = 0;
+  uint32_t          no_echo   = 0;
+
+  uint64_t start_ns = timestamp_ns();
+
+  if (!sensor.start(&shared, flight.poll_ms, clock))
+  {
+    cout << "The range sensor did not start.\n";
+    return false;
+  }
+
+  std::thread writer([&]()
+  {
+    std::mt19937                            random(42);
+    std::normal_distribution<double>        noise(0.0, flight.noise);
+    std::uniform_real_distribution<double>  share(0.0, 1.0);
+    std::uniform_real_distribution<double>  spurious(0.5, 2.0);
+
+    auto period = std::chrono::nanoseconds(uint64_t(k_ns_per_s / flight.rate));
+    auto next   = std::chrono::steady_clock::now();
+
+    while (!is_exit)
+    {
+      uint64_t  now_ns    = timestamp_ns();
+      double    distance  = true_altitude(flight, to_seconds(now_ns - start_ns))
+                          + noise(random);
+
+      if (share(random) < flight.misses)
+      {
+        distance = 0.0;
+        ++no_echo;
+      }
+      else if (share(random) < flight.outliers)
+      {
+        distance += spurious(random);
+      }
+
+      uint32_t ticks = uint32_t((now_ns - start_ns) * RANGE_TICKS_PER_US / k_ns_per_us);
+      write_sample(shared, ticks, uint32_t(distance * RANGE_ECHO_PER_M));
+
+      next += period;
+      std::this_thread::sleep_until(next);
+    }
+
+    written = shared.head;
+  });
+
+  uint32_t  readings    = 0;
+  double    square_error= 0.0;
+  double    max_error   = 0.0;
+  double    total_age   = 0.0;
+  uint64_t  max_age_ns  = 0;
+
+  uint64_t end_ns = start_ns + seconds_to_ns(flight.seconds);
+
+  for (uint64_t now_ns = timestamp_ns(); now_ns < end_ns; now_ns = timestamp_ns())
+  {
+    float     altitude  = 0.0f;
+    uint64_t  age_ns    = 0;
+
+    if (sensor.latest(altitude, age_ns, now_ns))
+    {
+      double error = std::fabs(altitude - true_altitude(flight, to_seconds(now_ns - age_ns - start_ns)));
+
+      square_error += error * error;
+      max_error     = std::max(max_error, error);
+      total_age    += to_seconds(age_ns);
+      max_age_ns    = std::max(max_age_ns, age_ns);
+      ++readings;
+    }
+
+    std::this_thread::sleep_for(std::chrono::nanoseconds(k_control_ns));
+  }
+
+  is_exit = true;
+  writer.join();
+
+  // The samples written after the last read of the thread.
+  sensor.stop();
+  sensor.poll(timestamp_ns());
+
+  const RangeRing &ring = sensor.ring();
+
+  double rms_error = readings ? std::sqrt(square_error / readings) : 0.0;
+
+  cout  << "Flight test:\n"
+        << "  written " << written
+        << "  read " << ring.samples()
+        << "  dropped " << ring.dropped()
+        << "  torn " << ring.torn() << "\n"
+        << "  echoes " << sensor.echoes()
+        << "  misses " << sensor.misses() << " of " << no_echo
+        << "  outliers " << sensor.outliers() << "\n"
+        << "  altitude error (m)  rms " << rms_error
+        << "  max " << max_error << "\n"
+        << "  age (ms)  mean " << (readings ? 1000.0 * total_age / readings : 0.0)
+        << "  max " << double(max_age_ns) / k_ns_per_ms << "\n";
+
+  return readings > 0
+      && ring.samples() == written
+      && sensor.misses() == no_echo
+      && rms_error  <= k_max_rms_error
+      && max_age_ns <= k_max_age_ns;
+}
+
+} // namespace unnamed
+
+
+//  ****************************************************************************
+int main(int argc, char* argv[])
+{
+  Flight flight = { 2.0, 50.0, 5, 0.01, 0.05, 0.05, 1.0 };
+
+  int option = 0;
+  while ((option = getopt(argc, argv, "t:r:p:n:o:m:a:h")) != -1)
+  {
+    switch (option)
+    {
+    case 't':
+      flight.seconds  = atof(optarg);
+      break;
+    case 'r':
+      flight.rate     = atof(optarg);
+      break;
+    case 'p':
+      flight.poll_ms  = uint32_t(atoi(optarg));
+      break;
+    case 'n':
+      flight.noise    = atof(optarg);
+      break;
+    case 'o':
+      flight.outliers = atof(optarg);
+      break;
+    case 'm':
+      flight.misses   = atof(optarg);
+      break;
+    case 'a':
+      flight.altitude = atof(optarg);
+      break;
+    default:
+      usage();
+      return 1;
+    }
+  }
+
+  if ( flight.seconds <= 0.0
+    || flight.rate    <= 0.0)
+  {
+    usage();
+    return 1;
+  }
+
+  bool is_passed = test_overrun(flight.seconds);
+  is_passed      = test_flight(flight) && is_passed;
+
+  cout << (is_passed ? "PASSED" : "FAILED") << "\n";
+
+  return is_passed ? 0 : 1;
+}
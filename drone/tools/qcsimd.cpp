@@ -0,0 +1,381 @@
+/// @file qcsimd.cpp
+///
+/// Compares the vector paths of the PID banks and the mixer, as they are
+/// built for this processor, with the PID class and the scalar mixer.
+///
+/// The vector test updates a bank of five controllers and the same bank on
+/// its scalar path with the same samples, at a jittered 200 Hz with stalls
+/// and repeated samples, and changes their setpoints, gains and state now
+/// and then. The mixer test mixes random commands for each frame with the
+/// vectors and the scalar mixer. Some of the samples and commands are tiny,
+/// so the arithmetic meets denormals. The paths of SSE2 and AArch64 must be
+/// bit-identical. The NEON unit of ARMv7 flushes denormals to zero, so its
+/// results must be within the tolerance of pid_bank.h and mixer.h.
+///
+/// The PID test updates the bank and five PIDs at the nominal period of the
+/// bank, where the outputs must be within k_pid_tolerance.
+///
+/// Usage: qcsimd [-n cycles] [-s seed]
+///
+//  ****************************************************************************
+#include "../mixer.h"
+#include "../pid_bank.h"
+#include "../PID.h"
+#include "../utility/timebase.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+#include <unistd.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+const size_t    k_pid_count     = 5;
+const float     k_period        = 0.005f;   ///< seconds, of the DMP.
+const float     k_cutoff        = 41.0f;    ///< Hz, of the derivative filter.
+const float     k_tiny          = 1e-38f;   ///< Scales the denormal samples.
+
+// The bank multiplies by the reciprocal of the time slice where the PID
+// divides by it, and designs its derivative filter for the nominal period,
+// so at that period its outputs differ from the PID's in the lowest bits.
+const float     k_pid_tolerance = 1e-5f;
+
+
+//  ****************************************************************************
+void usage()
+{
+  cerr  << "Usage: qcsimd [-n cycles] [-s seed]\n"
+        << "  -n  Cycles of each test. Default: 1000000\n"
+        << "  -s  Seed of the random samples. Default: 42\n";
+}
+
+//  ****************************************************************************
+/// Names the vector path that was built.
+///
+const char* path_name()
+{
+#if defined(PID_BANK_USE_SSE)
+  return "SSE2";
+#elif defined(PID_BANK_USE_NEON) && defined(__aarch64__)
+  return "AArch64 NEON";
+#elif defined(PID_BANK_USE_NEON)
+  return "ARMv7 NEON";
+#else
+  return "scalar";
+#endif
+}
+
+//  ****************************************************************************
+/// The largest difference between two floats, where NaN only matches NaN.
+///
+void compare(float expected, float actual, float &difference, uint64_t &inexact)
+{
+  if (0 == memcmp(&expected, &actual, sizeof(float)))
+  {
+    return;
+  }
+
+  ++inexact;
+
+  if (std::isnan(expected) || std::isnan(actual))
+  {
+    difference = INFINITY;
+    return;
+  }
+
+  difference = std::max(difference, std::fabs(expected - actual));
+}
+
+//  ****************************************************************************
+/// FloatArithmetic, with which a bank only takes its scalar path.
+///
+struct ScalarArithmetic
+  : public FloatArithmetic
+{
+  typedef std::false_type IsFloat;
+};
+
+typedef PIDBank<k_pid_count>                    VectorBank;
+typedef PIDBank<k_pid_count, ScalarArithmetic>  ScalarBank;
+
+//  ****************************************************************************
+/// Applies the same configuration to two controllers.
+///
+template <typename First, typename Second>
+void configure(First first, Second second, float Kp, float Ki, float Kd)
+{
+  first.Kp(Kp);                 second.Kp(Kp);
+  first.Ki(Ki);                 second.Ki(Ki);
+  first.Kd(Kd);                 second.Kd(Kd);
+  first.windup_limit(0.2f);     second.windup_limit(0.2f);
+  first.lowpass_freq(k_cutoff); second.lowpass_freq(k_cutoff);
+  first.min(-0.5f);             second.min(-0.5f);
+  first.max(0.5f);              second.max(0.5f);
+}
+
+//  ****************************************************************************
+/// Compares the state of two controllers.
+///
+template <typename First, typename Second>
+void compare(First first, Second second, float &difference, uint64_t &inexact)
+{
+  compare(first.error(),      second.error(),       difference, inexact);
+  compare(first.dError(),     second.dError(),      difference, inexact);
+  compare(first.integrator(), second.integrator(),  difference, inexact);
+}
+
+//  ****************************************************************************
+/// Runs the vectors and the scalar path of a bank with the same samples,
+/// with the events that take the scalar path in between.
+///
+/// @return true if the vectors are within the tolerance of the bank.
+///
+bool test_vectors(uint64_t cycles, std::mt19937 &random)
+{
+  std::uniform_real_distribution<float> signal(-1.0f, 1.0f);
+
+  VectorBank  vectors(k_period);
+  ScalarBank  scalar(k_period);
+
+  for (size_t index = 0; index < k_pid_count; ++index)
+  {
+    configure(vectors.lane(index),
+              scalar.lane(index),
+              1.0f  + signal(random),
+              0.5f  + 0.4f  * signal(random),
+              0.1f  + 0.05f * signal(random));
+  }
+
+  uint64_t  timestamp   = k_ns_per_s;
+  float     difference  = 0.0f;
+  uint64_t  inexact     = 0;
+
+  for (uint64_t cycle = 0; cycle < cycles; ++cycle)
+  {
+    // Mostly a jittered period, with stalls and repeated samples.
+    uint32_t event = random() % 1000;
+    if (0 == event)
+    {
+      timestamp += 2 * k_ns_per_s;
+    }
+    else if (1 != event)
+    {
+      timestamp += 4 * k_ns_per_ms + random() % (2 * k_ns_per_ms);
+    }
+
+    size_t              index   = random() % k_pid_count;
+    VectorBank::Lane    vector  = vectors.lane(index);
+    ScalarBank::Lane    lane    = scalar.lane(index);
+
+    switch (random() % 1000)
+    {
+    case 0:
+      vector.clear();
+      lane.clear();
+      break;
+    case 1:
+      vector.reset_integral();
+      lane.reset_integral();
+      break;
+    case 2:
+    {
+      float Kp = 1.0f + signal(random);
+      vector.Kp(Kp);
+      lane.Kp(Kp);
+      break;
+    }
+    default:
+      if (random() % 50 == 0)
+      {
+        float setpoint = signal(random);
+        vector.setpoint(setpoint);
+        lane.setpoint(setpoint);
+      }
+      break;
+    }
+
+    // Every hundredth cycle the samples are denormal.
+    float scale = (0 == random() % 100) ? k_tiny : 1.0f;
+
+    float actual[k_pid_count];
+    float expected[k_pid_count];
+    float output[k_pid_count];
+    for (size_t pid = 0; pid < k_pid_count; ++pid)
+    {
+      actual[pid] = scale * signal(random);
+    }
+
+    scalar.update(actual, timestamp, expected);
+    vectors.update(actual, timestamp, output);
+
+    for (size_t pid = 0; pid < k_pid_count; ++pid)
+    {
+      compare(expected[pid], output[pid], difference, inexact);
+      compare(scalar.lane(pid), vectors.lane(pid), difference, inexact);
+    }
+  }
+
+  cout  << "PID bank vectors: " << inexact << " inexact values, largest difference "
+        << difference << ", allowed " << k_pid_bank_tolerance << "\n";
+
+  return difference <= k_pid_bank_tolerance;
+}
+
+//  ****************************************************************************
+/// Runs a bank and the PIDs with the same samples, at the nominal period.
+///
+/// @return true if the bank is within the tolerance of the PIDs.
+///
+bool test_PIDs(uint64_t cycles, std::mt19937 &random)
+{
+  std::uniform_real_distribution<float> signal(-1.0f, 1.0f);
+
+  PID         pids[k_pid_count];
+  VectorBank  bank(k_period);
+
+  for (size_t index = 0; index < k_pid_count; ++index)
+  {
+    configure<PID&>(pids[index],
+                    bank.lane(index),
+                    1.0f  + signal(random),
+                    0.5f  + 0.4f  * signal(random),
+                    0.1f  + 0.05f * signal(random));
+  }
+
+  uint64_t  timestamp   = k_ns_per_s;
+  uint64_t  period_ns   = seconds_to_ns(k_period);
+  float     difference  = 0.0f;
+  uint64_t  inexact     = 0;
+
+  for (uint64_t cycle = 0; cycle < cycles; ++cycle)
+  {
+    timestamp += period_ns;
+
+    if (random() % 50 == 0)
+    {
+      size_t index    = random() % k_pid_count;
+      float  setpoint = signal(random);
+
+      pids[index].setpoint(setpoint);
+      bank.lane(index).setpoint(setpoint);
+    }
+
+    float actual[k_pid_count];
+    float output[k_pid_count];
+    for (size_t pid = 0; pid < k_pid_count; ++pid)
+    {
+      actual[pid] = 0.3f * signal(random);
+    }
+
+    bank.update(actual, timestamp, output);
+
+    for (size_t pid = 0; pid < k_pid_count; ++pid)
+    {
+      compare(pids[pid].update(actual[pid], timestamp), output[pid], difference, inexact);
+    }
+  }
+
+  cout  << "PID bank and PID: " << inexact << " inexact outputs, largest difference "
+        << difference << ", allowed " << k_pid_tolerance << "\n";
+
+  return difference <= k_pid_tolerance;
+}
+
+//  ****************************************************************************
+/// Mixes the same commands with the vectors and with the scalar mixer.
+///
+template <typename Frame>
+bool test_mixer(const char *p_name, uint64_t cycles, std::mt19937 &random)
+{
+  typedef Mixer<Frame> FrameMixer;
+
+  std::uniform_real_distribution<float> command(-1.5f, 1.5f);
+  std::uniform_real_distribution<float> throttle(-0.2f, 1.2f);
+
+  float     difference  = 0.0f;
+  uint64_t  inexact     = 0;
+
+  for (uint64_t cycle = 0; cycle < cycles; ++cycle)
+  {
+    float scale = (0 == random() % 100) ? k_tiny : 1.0f;
+
+    float level = throttle(random);
+    float roll  = scale * command(random);
+    float pitch = scale * command(random);
+    float yaw   = command(random);
+
+    float expected[k_mixer_max_table];
+    float actual[k_mixer_max_table];
+
+    FrameMixer::mix_scalar(level, roll, pitch, yaw, expected);
+    FrameMixer::mix(level, roll, pitch, yaw, actual);
+
+    for (size_t motor = 0; motor < FrameMixer::k_motor_count; ++motor)
+    {
+      compare(expected[motor], actual[motor], difference, inexact);
+    }
+  }
+
+  cout  << "Mixer " << p_name << ": " << inexact << " inexact levels, largest difference "
+        << difference << ", allowed " << k_mixer_tolerance << "\n";
+
+  return difference <= k_mixer_tolerance;
+}
+
+} // namespace unnamed
+
+
+//  ****************************************************************************
+int main(int argc, char* argv[])
+{
+  uint64_t  cycles  = 1000000;
+  uint32_t  seed    = 42;
+
+  int option = 0;
+  while ((option = getopt(argc, argv, "n:s:h")) != -1)
+  {
+    switch (option)
+    {
+    case 'n':
+      cycles  = uint64_t(atoll(optarg));
+      break;
+    case 's':
+      seed    = uint32_t(atoi(optarg));
+      break;
+    default:
+      usage();
+      return 1;
+    }
+  }
+
+  if (0 == cycles)
+  {
+    usage();
+    return 1;
+  }
+
+  std::mt19937 random(seed);
+
+  cout << "Vector path: " << path_name() << "\n";
+
+  bool is_passed = test_vectors(cycles, random);
+  is_passed      = test_PIDs(cycles, random) && is_passed;
+  is_passed      = test_mixer<QuadFrame>("quad", cycles, random) && is_passed;
+  is_passed      = test_mixer<HexFrame>("hex",   cycles, random) && is_passed;
+  is_passed      = test_mixer<OctoFrame>("octo", cycles, random) && is_passed;
+
+  cout << (is_passed ? "PASSED" : "FAILED") << "\n";
+
+  return is_passed ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+/// @file qcwatchdog.cpp
+///
+/// Tests that the watchdog degrades the drone after the same time of faults
+/// at any sample rate.
+///
+/// For each rate, a watchdog is fed cycles that overrun their time slice,
+/// and the time of faults that enters each mode is compared to the limits.
+/// Then a stall of the control loop is reported, long enough to hold the
+/// drone level and too short to descend, and the mode after it is checked.
+/// Last, the time of cycles without a fault that steps the mode down is
+/// compared to the recovery.
+///
+/// The test passes when each time is within a time slice of its limit.
+///
+/// Usage: qcwatchdog [-r rate]...
+///
+//  ****************************************************************************
+#include "../watchdog.h"
+#include "../utility/timebase.h"
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <unistd.h>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+/// Seconds of consecutive faults that enter each mode.
+///
+const double  k_fault_times[k_degrade_count] = { 0.0, 0.015, 0.025, 0.05, 0.2 };
+
+const double  k_recovery_time   = 1.0;      ///< seconds, to step down a mode.
+const double  k_stall_time      = 0.1;      ///< seconds, held level without
+                                            ///  a descent.
+const double  k_max_time        = 5.0;      ///< seconds, of each part.
+
+
+//  ****************************************************************************
+void usage()
+{
+  cerr  << "Usage: qcwatchdog [-r rate]...\n"
+        << "  -r  Hz, a sample rate to test. Default: 200 and 1000\n";
+}
+
+//  ****************************************************************************
+/// Checks that a time is within a slice of the expected time.
+///
+bool check(const char *p_name, double seconds, double expected, double slice)
+{
+  bool is_passed = seconds >= expected - slice
+                && seconds <= expected + slice;
+
+  cout  << "  " << std::setw(14) << p_name
+        << std::setw(10) << 1000.0 * seconds << " ms, expected "
+        << 1000.0 * expected << " ms" << (is_passed ? "" : "  WRONG") << "\n";
+
+  return is_passed;
+}
+
+//  ****************************************************************************
+/// Runs the watchdog at a sample rate.
+///
+bool test(double rate)
+{
+  uint64_t  slice_ns  = uint64_t(k_ns_per_s / rate);
+  double    slice     = 1.0 / rate;
+  uint64_t  cycles    = uint64_t(k_max_time * rate);
+  bool      is_passed = true;
+
+  cout << "At " << rate << " Hz, a slice of " << 1000.0 * slice << " ms:\n";
+
+  // Each cycle overruns its slice, a fault each.
+  Watchdog  watchdog(slice_ns);
+  double    entered[k_degrade_count] = { 0.0 };
+
+  for (uint64_t cycle = 1; cycle <= cycles; ++cycle)
+  {
+    DegradeMode mode = watchdog.mode();
+    watchdog.cycle(slice_ns, 2 * slice_ns);
+
+    if (watchdog.mode() != mode)
+    {
+      entered[watchdog.mode()] = cycle * slice;
+    }
+  }
+
+  for (int mode = k_degrade_none + 1; mode < k_degrade_count; ++mode)
+  {
+    is_passed = check(to_string(DegradeMode(mode)), entered[mode],
+                      k_fault_times[mode], slice) && is_passed;
+  }
+
+  // A stall of the control loop holds the drone level, and does not descend.
+  Watchdog stalled(slice_ns);
+
+  stalled.cycle(slice_ns, 0);
+  stalled.stall(seconds_to_ns(k_stall_time));
+  stalled.cycle(seconds_to_ns(k_stall_time) + slice_ns, 0);
+
+  bool is_held = k_degrade_hold == stalled.mode();
+
+  cout  << "  " << std::setw(14) << "stall" << std::setw(10) << 1000.0 * k_stall_time
+        << " ms, mode " << to_string(stalled.mode())
+        << (is_held ? "" : "  WRONG") << "\n";
+
+  is_passed = is_held && is_passed;
+
+  // The held mode steps down after the recovery.
+  double recovered = 0.0;
+  for (uint64_t cycle = 1; cycle <= cycles && 0.0 == recovered; ++cycle)
+  {
+    stalled.cycle(slice_ns, 0);
+
+    if (k_degrade_hold != stalled.mode())
+    {
+      recovered = cycle * slice;
+    }
+  }
+
+  is_passed = check("recovery", recovered, k_recovery_time, slice) && is_passed;
+
+  return is_passed;
+}
+
+} // namespace unnamed
+
+
+//  ****************************************************************************
+int main(int argc, char* argv[])
+{
+  std::vector<double> rates;
+
+  int option = 0;
+  while ((option = getopt(argc, argv, "r:h")) != -1)
+  {
+    switch (option)
+    {
+    case 'r':
+      rates.push_back(atof(optarg));
+      break;
+    default:
+      usage();
+      return 1;
+    }
+  }
+
+  if (rates.empty())
+  {
+    rates.push_back(200.0);
+    rates.push_back(1000.0);
+  }
+
+  bool is_passed = true;
+  for (size_t index = 0; index < rates.size(); ++index)
+  {
+    if (rates[index] <= 0.0)
+    {
+      usage();
+      return 1;
+    }
+
+    is_passed = test(rates[index]) && is_passed;
+  }
+
+  cout << (is_passed ? "PASSED" : "FAILED") << "\n";
+
+  return is_passed ? 0 : 1;
+}
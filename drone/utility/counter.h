@@ -0,0 +1,29 @@
+/// @file counter.h
+///
+/// Statistics counters that one thread writes and any thread may read.
+///
+/// A counter has a single writer, so a relaxed load and store increments it
+/// without the locked read-modify-write of fetch_add. A reader sees each
+/// count whole, though not in any order with the other counters.
+///
+//  ****************************************************************************
+#ifndef COUNTER_H_INCLUDED
+#define COUNTER_H_INCLUDED
+
+#include <atomic>
+#include <type_traits>
+
+
+//  ****************************************************************************
+/// Adds to a counter that has only one writer.
+///
+template <typename T>
+inline
+void increment(std::atomic<T>                       &counter,
+               typename std::common_type<T>::type    count = 1)
+{
+  counter.store(counter.load(std::memory_order_relaxed) + count,
+                std::memory_order_relaxed);
+}
+
+#endif
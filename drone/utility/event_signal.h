@@ -0,0 +1,107 @@
+/// @file event_signal.h
+///
+/// Wakes a blocked thread from another thread, or from an interrupt callback,
+/// without spinning. Implemented with a Linux eventfd.
+///
+//  ****************************************************************************
+#ifndef EVENT_SIGNAL_H_INCLUDED
+#define EVENT_SIGNAL_H_INCLUDED
+
+#include <cstdint>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+
+//  ****************************************************************************
+/// A counting event that one thread waits on and others signal.
+///
+class EventSignal
+{
+public:
+  //  **************************************************************************
+  EventSignal()
+    : m_fd(::eventfd(0, EFD_CLOEXEC))
+  { }
+
+  //  **************************************************************************
+  ~EventSignal()
+  {
+    if (m_fd >= 0)
+    {
+      ::close(m_fd);
+    }
+  }
+
+  EventSignal(const EventSignal&)             = delete;
+  EventSignal& operator=(const EventSignal&)  = delete;
+
+  //  **************************************************************************
+  /// Indicates if the underlying event descriptor was created.
+  ///
+  bool is_valid() const
+  {
+    return m_fd >= 0;
+  }
+
+  //  **************************************************************************
+  /// Returns the descriptor, to wait for the event along with other
+  /// descriptors with poll(). The event is signaled when it is readable.
+  ///
+  int fd() const
+  {
+    return m_fd;
+  }
+
+  //  **************************************************************************
+  /// Signals the event, waking the waiting thread.
+  ///
+  void notify()
+  {
+    uint64_t count = 1;
+    ssize_t  result = ::write(m_fd, &count, sizeof(count));
+    (void)result;
+  }
+
+  //  **************************************************************************
+  /// Blocks until the event is signaled.
+  ///
+  /// @return   The number of times the event was signaled since the last wait.
+  ///           Zero indicates the wait was interrupted.
+  ///
+  uint64_t wait()
+  {
+    uint64_t count = 0;
+    if (::read(m_fd, &count, sizeof(count)) != sizeof(count))
+    {
+      return 0;
+    }
+
+    return count;
+  }
+
+  //  **************************************************************************
+  /// Blocks until the event is signaled or the timeout expires.
+  ///
+  /// @return   The number of times the event was signaled since the last wait.
+  ///           Zero indicates the timeout expired.
+  ///
+  uint64_t wait_for(int timeout_ms)
+  {
+    pollfd desc = { m_fd, POLLIN, 0 };
+    if (::poll(&desc, 1, timeout_ms) <= 0)
+    {
+      return 0;
+    }
+
+    return wait();
+  }
+
+private:
+  //  **************************************************************************
+  int     m_fd;               ///< The eventfd descriptor.
+};
+
+
+#endif
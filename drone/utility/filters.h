@@ -0,0 +1,462 @@
+/// @file filters.h
+///
+/// Signal filters for the control loop.
+///
+/// Each filter holds its history in fixed-capacity storage, and calculates
+/// its coefficients when it is configured for a cutoff and a sample period.
+/// Filtering a sample does not allocate memory or divide.
+///
+//  ****************************************************************************
+#ifndef FILTERS_H_INCLUDED
+#define FILTERS_H_INCLUDED
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+//  ****************************************************************************
+/// The filters that may be selected for a signal.
+///
+enum FilterType
+{
+  k_filter_none,                      ///< Passes the signal through.
+  k_filter_lowpass,                   ///< First-order low-pass.
+  k_filter_biquad,                    ///< Second-order low-pass.
+  k_filter_notch,                     ///< Second-order band-stop.
+  k_filter_average,                   ///< Moving average.
+  k_filter_median                     ///< Moving median.
+};
+
+//  ****************************************************************************
+const size_t  k_filter_max_window = 15;   ///< Longest moving average or median.
+
+
+//  ****************************************************************************
+/// Selects and tunes a filter.
+///
+struct FilterConfig
+{
+  FilterType  type;
+  float       cutoff;                 ///< Hz, the cutoff, or the center of a notch.
+  float       q;                      ///< Quality factor of a biquad or notch.
+  uint32_t    window;                 ///< Samples in a moving average or median.
+};
+
+//  ****************************************************************************
+inline
+bool operator==(const FilterConfig &lhs, const FilterConfig &rhs)
+{
+  return lhs.type   == rhs.type
+      && lhs.cutoff == rhs.cutoff
+      && lhs.q      == rhs.q
+      && lhs.window == rhs.window;
+}
+
+//  ****************************************************************************
+inline
+bool operator!=(const FilterConfig &lhs, const FilterConfig &rhs)
+{
+  return !(lhs == rhs);
+}
+
+
+//  ****************************************************************************
+/// First-order low-pass filter.
+///
+/// The output starts from zero after a reset.
+///
+class LowPassFilter
+{
+public:
+  //  **************************************************************************
+  LowPassFilter()
+    : m_alpha(1.0f)
+    , m_value(0.0f)
+  { }
+
+  //  **************************************************************************
+  /// Returns the smoothing factor of an RC low-pass for the sample period.
+  ///
+  static float coefficient(float cutoff, float period)
+  {
+    float RC = 1.0 / (float(2.0 * M_PI) * cutoff);
+
+    return period / (RC + period);
+  }
+
+  //  **************************************************************************
+  void configure(float cutoff, float period)
+  {
+    m_alpha = coefficient(cutoff, period);
+    reset();
+  }
+
+  //  **************************************************************************
+  void reset()
+  {
+    m_value = 0.0f;
+  }
+
+  //  **************************************************************************
+  float apply(float sample)
+  {
+    m_value = m_value + (sample - m_value) * m_alpha;
+
+    return m_value;
+  }
+
+private:
+  float   m_alpha;                    ///< Share of each new sample in the output.
+  float   m_value;                    ///< The last output.
+};
+
+
+//  ****************************************************************************
+/// Second-order IIR filter, in transposed direct form II.
+///
+/// The coefficients are from the Audio EQ Cookbook (R. Bristow-Johnson).
+/// Frequencies are limited to below the Nyquist frequency of the period.
+///
+class BiquadFilter
+{
+public:
+  //  **************************************************************************
+  BiquadFilter()
+    : m_b0(1.0f)
+    , m_b1(0.0f)
+    , m_b2(0.0f)
+    , m_a1(0.0f)
+    , m_a2(0.0f)
+    , m_z1(0.0f)
+    , m_z2(0.0f)
+  { }
+
+  //  **************************************************************************
+  /// A low-pass filter, Butterworth when q is 1/sqrt(2).
+  ///
+  void low_pass(float cutoff, float period, float q)
+  {
+    double cos_w  = 0.0;
+    double alpha  = prewarp(cutoff, period, q, cos_w);
+
+    set(0.5 * (1.0 - cos_w),
+        1.0 - cos_w,
+        0.5 * (1.0 - cos_w),
+        1.0 + alpha,
+        -2.0 * cos_w,
+        1.0 - alpha);
+  }
+
+  //  **************************************************************************
+  /// A notch at the center frequency, with a width of center / q.
+  ///
+  void notch(float center, float period, float q)
+  {
+    double cos_w  = 0.0;
+    double alpha  = prewarp(center, period, q, cos_w);
+
+    set(1.0,
+        -2.0 * cos_w,
+        1.0,
+        1.0 + alpha,
+        -2.0 * cos_w,
+        1.0 - alpha);
+  }
+
+  //  **************************************************************************
+  void reset()
+  {
+    m_z1 = 0.0f;
+    m_z2 = 0.0f;
+  }
+
+  //  **************************************************************************
+  float apply(float sample)
+  {
+    float output = m_b0 * sample + m_z1;
+
+    m_z1 = m_b1 * sample - m_a1 * output + m_z2;
+    m_z2 = m_b2 * sample - m_a2 * output;
+
+    return output;
+  }
+
+private:
+  float   m_b0;                       ///< Feed-forward coefficients,
+  float   m_b1;                       ///  normalized by a0.
+  float   m_b2;
+  float   m_a1;                       ///< Feedback coefficients,
+  float   m_a2;                       ///  normalized by a0.
+
+  float   m_z1;                       ///< The delayed state.
+  float   m_z2;
+
+  //  **************************************************************************
+  static double prewarp(float frequency, float period, float q, double &cos_w)
+  {
+    // Stay below the Nyquist frequency, where the filter is unstable.
+    double nyquist  = 0.5 / period;
+    double f        = frequency < 0.45 * nyquist ? frequency : 0.45 * nyquist;
+    double w        = 2.0 * M_PI * f * period;
+
+    cos_w = std::cos(w);
+
+    return std::sin(w) / (2.0 * q);
+  }
+
+  //  **************************************************************************
+  void set(double b0, double b1, double b2, double a0, double a1, double a2)
+  {
+    m_b0 = float(b0 / a0);
+    m_b1 = float(b1 / a0);
+    m_b2 = float(b2 / a0);
+    m_a1 = float(a1 / a0);
+    m_a2 = float(a2 / a0);
+
+    reset();
+  }
+};
+
+
+//  ****************************************************************************
+/// Average of the most recent samples.
+///
+/// Until the window fills, the missing samples count as zero.
+///
+template <size_t Capacity>
+class MovingAverage
+{
+public:
+  //  **************************************************************************
+  MovingAverage()
+  {
+    configure(Capacity);
+  }
+
+  //  **************************************************************************
+  void configure(size_t window)
+  {
+    m_window  = window < 1 ? 1 : (window > Capacity ? Capacity : window);
+    m_scale   = 1.0f / m_window;
+
+    reset();
+  }
+
+  //  **************************************************************************
+  void reset()
+  {
+    for (size_t index = 0; index < Capacity; ++index)
+    {
+      m_samples[index] = 0.0f;
+    }
+
+    m_next  = 0;
+    m_sum   = 0.0f;
+  }
+
+  //  **************************************************************************
+  float apply(float sample)
+  {
+    m_sum += sample - m_samples[m_next];
+    m_samples[m_next] = sample;
+
+    if (++m_next == m_window)
+    {
+      m_next = 0;
+
+      // Sum the window once per pass, so the rounding errors
+      // of the running sum do not accumulate.
+      m_sum = 0.0f;
+      for (size_t index = 0; index < m_window; ++index)
+      {
+        m_sum += m_samples[index];
+      }
+    }
+
+    return m_sum * m_scale;
+  }
+
+private:
+  float   m_samples[Capacity];        ///< The window, oldest at m_next.
+  size_t  m_window;                   ///< Samples in the window.
+  size_t  m_next;                     ///< Position of the next sample.
+  float   m_sum;                      ///< Sum of the window.
+  float   m_scale;                    ///< The reciprocal of the window.
+};
+
+
+//  ****************************************************************************
+/// Median of the most recent samples, which rejects isolated spikes.
+///
+/// Until the window fills, the median of the samples received is reported.
+///
+template <size_t Capacity>
+class MedianFilter
+{
+public:
+  //  **************************************************************************
+  MedianFilter()
+  {
+    configure(Capacity);
+  }
+
+  //  **************************************************************************
+  void configure(size_t window)
+  {
+    m_window = window < 1 ? 1 : (window > Capacity ? Capacity : window);
+
+    reset();
+  }
+
+  //  **************************************************************************
+  void reset()
+  {
+    m_count = 0;
+    m_next  = 0;
+  }
+
+  //  **************************************************************************
+  float apply(float sample)
+  {
+    size_t position = m_count;
+
+    if (m_count == m_window)
+    {
+      // Remove the oldest sample from the sorted window.
+      position = find(m_samples[m_next]);
+    }
+    else
+    {
+      ++m_count;
+    }
+
+    m_samples[m_next] = sample;
+    m_next            = (m_next + 1 == m_window) ? 0 : m_next + 1;
+
+    // Move the sample into order, from where the old sample was removed.
+    while ( position > 0
+         && m_sorted[position - 1] > sample)
+    {
+      m_sorted[position] = m_sorted[position - 1];
+      --position;
+    }
+
+    while ( position + 1 < m_count
+         && m_sorted[position + 1] < sample)
+    {
+      m_sorted[position] = m_sorted[position + 1];
+      ++position;
+    }
+
+    m_sorted[position] = sample;
+
+    return m_sorted[m_count / 2];
+  }
+
+private:
+  float   m_samples[Capacity];        ///< The window in the order received.
+  float   m_sorted[Capacity];         ///< The window in ascending order.
+  size_t  m_window;                   ///< Samples in the window.
+  size_t  m_count;                    ///< Samples received, up to the window.
+  size_t  m_next;                     ///< Position of the next sample.
+
+  //  **************************************************************************
+  size_t find(float value) const
+  {
+    for (size_t index = 0; index < m_count; ++index)
+    {
+      // Bitwise, so a NaN sample is still found.
+      if (0 == std::memcmp(&m_sorted[index], &value, sizeof(value)))
+      {
+        return index;
+      }
+    }
+
+    return m_count - 1;
+  }
+};
+
+
+//  ****************************************************************************
+/// A filter that is selected when it is configured.
+///
+class SignalFilter
+{
+public:
+  //  **************************************************************************
+  SignalFilter()
+    : m_type(k_filter_none)
+  { }
+
+  //  **************************************************************************
+  /// Selects the filter and calculates its coefficients.
+  ///
+  /// @param period   The sample period, in seconds.
+  ///
+  void configure(const FilterConfig &config, float period)
+  {
+    m_type = config.type;
+
+    switch (m_type)
+    {
+    case k_filter_lowpass:  m_lowpass.configure(config.cutoff, period);       break;
+    case k_filter_biquad:   m_biquad.low_pass(config.cutoff, period, config.q); break;
+    case k_filter_notch:    m_biquad.notch(config.cutoff, period, config.q);    break;
+    case k_filter_average:  m_average.configure(config.window);               break;
+    case k_filter_median:   m_median.configure(config.window);                break;
+    case k_filter_none:
+    default:                                                                  break;
+    }
+  }
+
+  //  **************************************************************************
+  FilterType type() const
+  {
+    return m_type;
+  }
+
+  //  **************************************************************************
+  void reset()
+  {
+    switch (m_type)
+    {
+    case k_filter_lowpass:  m_lowpass.reset();  break;
+    case k_filter_biquad:
+    case k_filter_notch:    m_biquad.reset();   break;
+    case k_filter_average:  m_average.reset();  break;
+    case k_filter_median:   m_median.reset();   break;
+    case k_filter_none:
+    default:                                    break;
+    }
+  }
+
+  //  **************************************************************************
+  float apply(float sample)
+  {
+    switch (m_type)
+    {
+    case k_filter_lowpass:  return m_lowpass.apply(sample);
+    case k_filter_biquad:
+    case k_filter_notch:    return m_biquad.apply(sample);
+    case k_filter_average:  return m_average.apply(sample);
+    case k_filter_median:   return m_median.apply(sample);
+    case k_filter_none:
+    default:                return sample;
+    }
+  }
+
+private:
+  FilterType      m_type;
+
+  LowPassFilter   m_lowpass;
+  BiquadFilter    m_biquad;
+  MovingAverage<k_filter_max_window>
+                  m_average;
+  MedianFilter<k_filter_max_window>
+                  m_median;
+};
+
+
+#endif
@@ -0,0 +1,193 @@
+/// @file fixed_point.h
+///
+/// Saturating fixed-point numbers in the Q format.
+///
+/// A Fixed value holds a signed integer with Fraction fractional bits.
+/// Every operation saturates rather than wrapping. The most negative raw
+/// value is never produced, so the range is symmetric and negation is
+/// always exact. Products are calculated in the wide type and rounded to
+/// nearest, which costs a single long multiply on ARMv7.
+///
+//  ****************************************************************************
+#ifndef FIXED_POINT_H_INCLUDED
+#define FIXED_POINT_H_INCLUDED
+
+#include <cstdint>
+#include <limits>
+
+
+//  ****************************************************************************
+/// A saturating fixed-point number.
+///
+/// @tparam Raw       The integer that holds the value.
+/// @tparam Wide      An integer with room for the product of two Raw values.
+/// @tparam Fraction  The number of fractional bits.
+///
+template <typename Raw, typename Wide, int Fraction>
+class Fixed
+{
+public:
+  typedef Raw   raw_type;
+  typedef Wide  wide_type;
+
+  static const int  k_fraction  = Fraction;
+  static const Raw  k_raw_max   = std::numeric_limits<Raw>::max();
+  static const Raw  k_raw_min   = -k_raw_max;
+
+  //  **************************************************************************
+  Fixed()
+    : m_raw(0)
+  { }
+
+  //  **************************************************************************
+  static Fixed from_raw(Raw raw)
+  {
+    Fixed value;
+    value.m_raw = raw;
+
+    return value;
+  }
+
+  //  **************************************************************************
+  /// Returns the nearest value, rounding halves away from zero.
+  /// Values out of range saturate, and NaN converts to zero.
+  ///
+  static Fixed from_float(float number)
+  {
+    float scaled = number * scale();
+
+    if (scaled >= float(k_raw_max))
+    {
+      return max();
+    }
+
+    if (scaled <= float(k_raw_min))
+    {
+      return min();
+    }
+
+    if (!(scaled == scaled))
+    {
+      return Fixed();
+    }
+
+    // Values above 2^23 are already whole, the remainder of the others
+    // is exact, so a float that is representable converts exactly.
+    Wide  whole = Wide(scaled);
+    float rest  = scaled - float(whole);
+
+    // Without branches, as the sign of a signal is not predictable.
+    whole += Wide(rest >= 0.5f) - Wide(rest <= -0.5f);
+
+    return from_wide(whole);
+  }
+
+  //  **************************************************************************
+  static Fixed max()
+  {
+    return from_raw(k_raw_max);
+  }
+
+  //  **************************************************************************
+  static Fixed min()
+  {
+    return from_raw(k_raw_min);
+  }
+
+  //  **************************************************************************
+  /// Saturates a wide value with the same number of fractional bits.
+  ///
+  static Fixed from_wide(Wide wide)
+  {
+    if (wide > Wide(k_raw_max))
+    {
+      return max();
+    }
+
+    if (wide < Wide(k_raw_min))
+    {
+      return min();
+    }
+
+    return from_raw(Raw(wide));
+  }
+
+  //  **************************************************************************
+  Raw raw() const
+  {
+    return m_raw;
+  }
+
+  //  **************************************************************************
+  float to_float() const
+  {
+    return float(m_raw) * (1.0f / scale());
+  }
+
+  //  **************************************************************************
+  /// Multiplies by a value in any Q format, the result is in this format.
+  ///
+  template <typename OtherRaw, typename OtherWide, int OtherFraction>
+  Fixed operator*(Fixed<OtherRaw, OtherWide, OtherFraction> rhs) const
+  {
+    const Wide k_half = Wide(1) << (OtherFraction - 1);
+
+    // The shift of a negative product rounds towards negative infinity,
+    // with the half added first it rounds to nearest.
+    Wide product = Wide(m_raw) * Wide(rhs.raw());
+
+    return from_wide((product + k_half) >> OtherFraction);
+  }
+
+  //  **************************************************************************
+  Fixed operator+(Fixed rhs) const
+  {
+    return from_wide(Wide(m_raw) + Wide(rhs.m_raw));
+  }
+
+  //  **************************************************************************
+  Fixed operator-(Fixed rhs) const
+  {
+    return from_wide(Wide(m_raw) - Wide(rhs.m_raw));
+  }
+
+  //  **************************************************************************
+  Fixed operator-() const
+  {
+    return from_raw(-m_raw);
+  }
+
+  //  **************************************************************************
+  Fixed& operator+=(Fixed rhs)
+  {
+    return *this = *this + rhs;
+  }
+
+  //  **************************************************************************
+  bool operator<(Fixed rhs) const   { return m_raw <  rhs.m_raw; }
+  bool operator>(Fixed rhs) const   { return m_raw >  rhs.m_raw; }
+  bool operator<=(Fixed rhs) const  { return m_raw <= rhs.m_raw; }
+  bool operator>=(Fixed rhs) const  { return m_raw >= rhs.m_raw; }
+  bool operator==(Fixed rhs) const  { return m_raw == rhs.m_raw; }
+  bool operator!=(Fixed rhs) const  { return m_raw != rhs.m_raw; }
+
+private:
+  Raw     m_raw;
+
+  //  **************************************************************************
+  static float scale()
+  {
+    return float(Wide(1) << Fraction);
+  }
+};
+
+
+//  ****************************************************************************
+typedef Fixed<int16_t, int32_t, 15>   Q15;    ///< -1.0 to 1.0, for 16-bit telemetry.
+typedef Fixed<int32_t, int64_t, 31>   Q31;    ///< -1.0 to 1.0, for coefficients.
+typedef Fixed<int32_t, int64_t, 24>   Q7_24;  ///< -128.0 to 128.0, for angles.
+typedef Fixed<int32_t, int64_t, 20>   Q11_20; ///< -2048.0 to 2048.0, for control signals.
+typedef Fixed<int32_t, int64_t, 16>   Q15_16; ///< -32768.0 to 32768.0, for rates.
+
+
+#endif
@@ -0,0 +1,215 @@
+/// @file histogram.h
+///
+/// Log-linear latency histogram, in the style of HDR histograms.
+///
+/// Each power of two is split into a fixed number of linear sub-buckets,
+/// which bounds the relative error of every recorded value to about 6%
+/// over a range from nanoseconds to seconds with a fixed amount of storage.
+///
+//  ****************************************************************************
+#ifndef HISTOGRAM_H_INCLUDED
+#define HISTOGRAM_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "counter.h"
+
+
+//  ****************************************************************************
+/// Latency histogram with a single writer and any number of readers.
+///
+/// Recording does not lock or allocate. Only one thread may record values,
+/// which allows the counters to be updated without atomic read-modify-write
+/// instructions. Other threads may read the counters at any time.
+///
+class LatencyHistogram
+{
+public:
+  //  **************************************************************************
+  static const unsigned k_sub_bits      = 4;
+  static const unsigned k_sub_count     = 1 << k_sub_bits;
+  static const unsigned k_max_bits      = 32;           ///< Values up to ~4.29s
+  static const size_t   k_bucket_count  = (k_max_bits - k_sub_bits + 1) * k_sub_count;
+
+  //  **************************************************************************
+  LatencyHistogram()
+    : m_budget(0)
+  {
+    clear();
+  }
+
+  //  **************************************************************************
+  /// Values larger than the budget are counted as overruns.
+  /// A budget of zero disables overrun accounting.
+  ///
+  void budget(uint64_t value)
+  {
+    m_budget = value;
+  }
+
+  //  **************************************************************************
+  uint64_t budget() const
+  {
+    return m_budget;
+  }
+
+  //  **************************************************************************
+  /// Records a single value. Only one thread may call this function.
+  ///
+  void record(uint64_t value)
+  {
+    increment(m_buckets[bucket_index(value)]);
+    increment(m_count);
+
+    if (m_budget && value > m_budget)
+    {
+      increment(m_overruns);
+    }
+
+    if (value < m_min.load(std::memory_order_relaxed))
+    {
+      m_min.store(value, std::memory_order_relaxed);
+    }
+
+    if (value > m_max.load(std::memory_order_relaxed))
+    {
+      m_max.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  //  **************************************************************************
+  /// Resets all of the recorded values.
+  /// Only the thread that records values may call this function.
+  ///
+  void clear()
+  {
+    for (size_t index = 0; index < k_bucket_count; ++index)
+    {
+      m_buckets[index].store(0, std::memory_order_relaxed);
+    }
+
+    m_count.store(0, std::memory_order_relaxed);
+    m_overruns.store(0, std::memory_order_relaxed);
+    m_min.store(UINT64_MAX, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+  }
+
+  //  **************************************************************************
+  uint32_t count() const
+  {
+    return m_count.load(std::memory_order_relaxed);
+  }
+
+  //  **************************************************************************
+  uint32_t overruns() const
+  {
+    return m_overruns.load(std::memory_order_relaxed);
+  }
+
+  //  **************************************************************************
+  uint64_t min() const
+  {
+    return count() ? m_min.load(std::memory_order_relaxed) : 0;
+  }
+
+  //  **************************************************************************
+  uint64_t max() const
+  {
+    return m_max.load(std::memory_order_relaxed);
+  }
+
+  //  **************************************************************************
+  /// Reports the value below which the specified fraction of the
+  /// recorded values fall, with the resolution of a bucket.
+  ///
+  /// @param fraction   Between 0.0 and 1.0, i.e. 0.99 for the 99th percentile.
+  ///
+  uint64_t percentile(double fraction) const
+  {
+    uint64_t total = 0;
+    for (size_t index = 0; index < k_bucket_count; ++index)
+    {
+      total += m_buckets[index].load(std::memory_order_relaxed);
+    }
+
+    if (0 == total)
+    {
+      return 0;
+    }
+
+    uint64_t target = uint64_t(fraction * total + 0.5);
+    if (target < 1)
+    {
+      target = 1;
+    }
+
+    uint64_t seen = 0;
+    for (size_t index = 0; index < k_bucket_count; ++index)
+    {
+      seen += m_buckets[index].load(std::memory_order_relaxed);
+      if (seen >= target)
+      {
+        // Never report beyond the largest recorded value.
+        uint64_t value = bucket_upper(index);
+        return value < max() ? value : max();
+      }
+    }
+
+    return max();
+  }
+
+  //  **************************************************************************
+  /// Maps a value to the index of the bucket that counts it.
+  ///
+  static size_t bucket_index(uint64_t value)
+  {
+    if (value < k_sub_count)
+    {
+      return size_t(value);
+    }
+
+    if (value >> k_max_bits)
+    {
+      return k_bucket_count - 1;
+    }
+
+    unsigned exponent = 63 - __builtin_clzll(value);
+    unsigned shift    = exponent - k_sub_bits;
+
+    return size_t(exponent - k_sub_bits + 1) * k_sub_count
+         + size_t(value >> shift) - k_sub_count;
+  }
+
+  //  **************************************************************************
+  /// Reports the largest value counted by the bucket.
+  ///
+  static uint64_t bucket_upper(size_t index)
+  {
+    if (index < k_sub_count)
+    {
+      return index;
+    }
+
+    unsigned shift = unsigned(index / k_sub_count) - 1;
+    uint64_t sub   = index % k_sub_count;
+
+    return ((k_sub_count + sub + 1) << shift) - 1;
+  }
+
+private:
+  //  **************************************************************************
+  typedef std::atomic<uint32_t>   counter_t;
+
+  //  **************************************************************************
+  counter_t             m_buckets[k_bucket_count];
+  counter_t             m_count;
+  counter_t             m_overruns;
+  std::atomic<uint64_t> m_min;
+  std::atomic<uint64_t> m_max;
+  uint64_t              m_budget;
+};
+
+
+#endif
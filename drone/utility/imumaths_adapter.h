@@ -0,0 +1,99 @@
+/// @file imumaths_adapter.h
+///
+/// Conversions between the double types of imumaths and the float types of
+/// the control loop, for the code that hands values from one to the other.
+/// The simulator keeps its own state in double, and does not use them yet.
+///
+//  ****************************************************************************
+#ifndef IMUMATHS_ADAPTER_H_INCLUDED
+#define IMUMATHS_ADAPTER_H_INCLUDED
+
+#include "imumaths.h"
+#include "linear_algebra.h"
+#include "quat.h"
+
+
+//  ****************************************************************************
+template <uint8_t N>
+inline
+Vector<N> to_float(const imu::Vector<N> &vector)
+{
+  Vector<N> result;
+  for (size_t index = 0; index < N; ++index)
+  {
+    result[index] = float(vector[index]);
+  }
+
+  return result;
+}
+
+//  ****************************************************************************
+template <uint8_t N>
+inline
+Matrix<N, N> to_float(const imu::Matrix<N> &matrix)
+{
+  Matrix<N, N> result;
+  for (size_t row = 0; row < N; ++row)
+  {
+    for (size_t col = 0; col < N; ++col)
+    {
+      result(row, col) = float(matrix(row, col));
+    }
+  }
+
+  return result;
+}
+
+//  ****************************************************************************
+inline
+Quat to_float(const imu::Quaternion &q)
+{
+  Quat result = { float(q.w()), float(q.x()), float(q.y()), float(q.z()) };
+
+  return result;
+}
+
+//  ****************************************************************************
+/// Converts a vector, or a matrix expression of one column.
+///
+template <typename E, size_t N>
+inline
+imu::Vector<N> to_imu(const MatrixExpr<E, N, 1> &vector)
+{
+  imu::Vector<N> result;
+  for (size_t index = 0; index < N; ++index)
+  {
+    result[index] = vector(index, 0);
+  }
+
+  return result;
+}
+
+//  ****************************************************************************
+/// Converts a square matrix, or a square matrix expression.
+///
+template <typename E, size_t N>
+inline
+imu::Matrix<N> to_imu(const MatrixExpr<E, N, N> &matrix)
+{
+  imu::Matrix<N> result;
+  for (size_t row = 0; row < N; ++row)
+  {
+    for (size_t col = 0; col < N; ++col)
+    {
+      result(row, col) = matrix(row, col);
+    }
+  }
+
+  return result;
+}
+
+//  ****************************************************************************
+inline
+imu::Quaternion to_imu(const Quat &q)
+{
+  return imu::Quaternion(q.w, q.x, q.y, q.z);
+}
+
+
+#endif
@@ -0,0 +1,716 @@
+/// @file linear_algebra.h
+///
+/// Fixed-size float matrices and vectors for the estimators of the control
+/// loop.
+///
+/// The dimensions are template parameters, so the storage is a plain array
+/// in the owner, never allocated, and every loop has a constant trip count.
+/// The kernels are unrolled at compile time rather than left to the loop
+/// optimizer.
+///
+/// The arithmetic operators build expression templates instead of results.
+/// An expression such as P = F * P * F.transpose() + Q is evaluated once,
+/// element by element, into its destination. The exception is an operand
+/// of a product that is itself a sum or a product: each of its elements
+/// would be read once for each column of the result, so it is evaluated
+/// into a matrix once when the product is formed. Expressions refer to
+/// their operands, so they must be evaluated within the statement that
+/// forms them.
+///
+/// An expression that reads its destination through a product or a
+/// transpose, such as A = A * B, is evaluated into a temporary before it
+/// is stored, so assignments are always correct.
+///
+/// Symmetric positive-definite systems, such as the innovation covariance
+/// of a Kalman filter, are solved by the Cholesky or the LDLT factorization
+/// rather than with an inverse.
+///
+/// Building with QC_NEON multiplies the matrices that are not expressions
+/// with the NEON unit, when the columns of the result are a multiple of four.
+///
+/// imu::Vector and imu::Matrix remain for the code in double precision, and
+/// imumaths_adapter.h converts to and from them. tools/qclinear tests both.
+///
+//  ****************************************************************************
+#ifndef LINEAR_ALGEBRA_H_INCLUDED
+#define LINEAR_ALGEBRA_H_INCLUDED
+
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <type_traits>
+
+#include "unroll.h"
+
+#if defined(QC_NEON) && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#include <arm_neon.h>
+#define LINEAR_ALGEBRA_NEON
+#endif
+
+
+template <size_t Rows, size_t Cols> class Matrix;
+template <typename E> class Transpose;
+
+template <size_t N>
+using Vector = Matrix<N, 1>;
+
+
+//  ****************************************************************************
+/// The base of every matrix expression.
+///
+/// Each expression provides:
+///   - at(row, col), the value of an element.
+///   - refers_to(p), if the matrix at p is read by the expression.
+///   - reads_across(p), if an element of the matrix at p is read for an
+///     element of the result other than the same element.
+///
+template <typename Derived, size_t Rows, size_t Cols>
+struct MatrixExpr
+{
+  static const size_t k_rows = Rows;
+  static const size_t k_cols = Cols;
+
+  //  **************************************************************************
+  const Derived& derived() const
+  {
+    return static_cast<const Derived&>(*this);
+  }
+
+  //  **************************************************************************
+  float operator()(size_t row, size_t col) const
+  {
+    return derived().at(row, col);
+  }
+
+  //  **************************************************************************
+  Transpose<Derived> transpose() const
+  {
+    return Transpose<Derived>(derived());
+  }
+};
+
+
+//  ****************************************************************************
+/// How an expression holds an operand. Matrices are held by reference, and
+/// the other expressions by value, as they only hold references themselves.
+///
+template <typename E>
+struct Nested
+{
+  typedef const E type;
+};
+
+template <size_t Rows, size_t Cols>
+struct Nested<Matrix<Rows, Cols> >
+{
+  typedef const Matrix<Rows, Cols>& type;
+};
+
+
+//  ****************************************************************************
+template <typename L, typename R>
+class Sum
+  : public MatrixExpr<Sum<L, R>, L::k_rows, L::k_cols>
+{
+public:
+  Sum(const L &lhs, const R &rhs)
+    : m_lhs(lhs)
+    , m_rhs(rhs)
+  { }
+
+  float at(size_t row, size_t col) const          { return m_lhs.at(row, col) + m_rhs.at(row, col); }
+  bool  refers_to(const void *p) const            { return m_lhs.refers_to(p)    || m_rhs.refers_to(p); }
+  bool  reads_across(const void *p) const         { return m_lhs.reads_across(p) || m_rhs.reads_across(p); }
+
+private:
+  typename Nested<L>::type  m_lhs;
+  typename Nested<R>::type  m_rhs;
+};
+
+//  ****************************************************************************
+template <typename L, typename R>
+class Difference
+  : public MatrixExpr<Difference<L, R>, L::k_rows, L::k_cols>
+{
+public:
+  Difference(const L &lhs, const R &rhs)
+    : m_lhs(lhs)
+    , m_rhs(rhs)
+  { }
+
+  float at(size_t row, size_t col) const          { return m_lhs.at(row, col) - m_rhs.at(row, col); }
+  bool  refers_to(const void *p) const            { return m_lhs.refers_to(p)    || m_rhs.refers_to(p); }
+  bool  reads_across(const void *p) const         { return m_lhs.reads_across(p) || m_rhs.reads_across(p); }
+
+private:
+  typename Nested<L>::type  m_lhs;
+  typename Nested<R>::type  m_rhs;
+};
+
+//  ****************************************************************************
+template <typename E>
+class Scaled
+  : public MatrixExpr<Scaled<E>, E::k_rows, E::k_cols>
+{
+public:
+  Scaled(const E &operand, float scale)
+    : m_operand(operand)
+    , m_scale(scale)
+  { }
+
+  float at(size_t row, size_t col) const          { return m_operand.at(row, col) * m_scale; }
+  bool  refers_to(const void *p) const            { return m_operand.refers_to(p); }
+  bool  reads_across(const void *p) const         { return m_operand.reads_across(p); }
+
+private:
+  typename Nested<E>::type  m_operand;
+  float                     m_scale;
+};
+
+//  ****************************************************************************
+template <typename E>
+class Transpose
+  : public MatrixExpr<Transpose<E>, E::k_cols, E::k_rows>
+{
+public:
+  explicit
+  Transpose(const E &operand)
+    : m_operand(operand)
+  { }
+
+  float at(size_t row, size_t col) const          { return m_operand.at(col, row); }
+  bool  refers_to(const void *p) const            { return m_operand.refers_to(p); }
+  bool  reads_across(const void *p) const         { return m_operand.refers_to(p); }
+
+private:
+  typename Nested<E>::type  m_operand;
+};
+
+
+//  ****************************************************************************
+/// How a product holds an operand. Matrices, and their transposes, are read
+/// in place. Any other expression is evaluated once.
+///
+template <typename E>
+struct ProductOperand
+{
+  typedef const Matrix<E::k_rows, E::k_cols> type;
+};
+
+template <size_t Rows, size_t Cols>
+struct ProductOperand<Matrix<Rows, Cols> >
+{
+  typedef const Matrix<Rows, Cols>& type;
+};
+
+template <size_t Rows, size_t Cols>
+struct ProductOperand<Transpose<Matrix<Rows, Cols> > >
+{
+  typedef const Transpose<Matrix<Rows, Cols> > type;
+};
+
+//  ****************************************************************************
+template <typename L, typename R>
+class Product
+  : public MatrixExpr<Product<L, R>, L::k_rows, R::k_cols>
+{
+public:
+  static const size_t k_inner = L::k_cols;
+
+  Product(const L &lhs, const R &rhs)
+    : m_lhs(lhs)
+    , m_rhs(rhs)
+  { }
+
+  //  **************************************************************************
+  float at(size_t row, size_t col) const
+  {
+    float sum = 0.0f;
+    Unroll<k_inner>::apply([&](size_t inner)
+    {
+      sum += m_lhs.at(row, inner) * m_rhs.at(inner, col);
+    });
+
+    return sum;
+  }
+
+  bool  refers_to(const void *p) const            { return m_lhs.refers_to(p) || m_rhs.refers_to(p); }
+  bool  reads_across(const void *p) const         { return refers_to(p); }
+
+  //  **************************************************************************
+  const typename std::remove_reference<typename ProductOperand<L>::type>::type&
+  lhs() const
+  {
+    return m_lhs;
+  }
+
+  const typename std::remove_reference<typename ProductOperand<R>::type>::type&
+  rhs() const
+  {
+    return m_rhs;
+  }
+
+private:
+  typename ProductOperand<L>::type  m_lhs;
+  typename ProductOperand<R>::type  m_rhs;
+};
+
+
+//  ****************************************************************************
+/// Stores each element of an expression in the matrix.
+/// The expression must not read the matrix across elements.
+///
+template <size_t Rows, size_t Cols, typename E>
+inline
+void evaluate(Matrix<Rows, Cols> &result, const E &expr)
+{
+  Unroll<Rows * Cols>::apply([&](size_t index)
+  {
+    result[index] = expr.at(index / Cols, index % Cols);
+  });
+}
+
+#ifdef LINEAR_ALGEBRA_NEON
+//  ****************************************************************************
+/// Multiplies two matrices four columns of the result at a time.
+///
+template <size_t Rows, size_t Inner, size_t Cols>
+inline
+typename std::enable_if<0 == Cols % 4>::type
+evaluate(Matrix<Rows, Cols> &result, const Product<Matrix<Rows, Inner>, Matrix<Inner, Cols> > &expr)
+{
+  const Matrix<Rows, Inner>  &lhs = expr.lhs();
+  const Matrix<Inner, Cols>  &rhs = expr.rhs();
+
+  for (size_t row = 0; row < Rows; ++row)
+  {
+    for (size_t col = 0; col < Cols; col += 4)
+    {
+      float32x4_t sum = vmulq_n_f32(vld1q_f32(&rhs(0, col)), lhs(row, 0));
+      for (size_t inner = 1; inner < Inner; ++inner)
+      {
+        sum = vmlaq_n_f32(sum, vld1q_f32(&rhs(inner, col)), lhs(row, inner));
+      }
+
+      vst1q_f32(&result(row, col), sum);
+    }
+  }
+}
+#endif
+
+
+//  ****************************************************************************
+/// A matrix of floats, stored by rows. A Vector is a matrix of one column.
+///
+template <size_t Rows, size_t Cols>
+class Matrix
+  : public MatrixExpr<Matrix<Rows, Cols>, Rows, Cols>
+{
+public:
+  static const size_t k_size = Rows * Cols;
+
+  //  **************************************************************************
+  /// The elements are zero.
+  ///
+  Matrix()
+    : m_cells()
+  { }
+
+  //  **************************************************************************
+  /// The elements by rows. Any that are not listed are zero.
+  ///
+  Matrix(std::initializer_list<float> values)
+    : m_cells()
+  {
+    size_t index = 0;
+    for (float value : values)
+    {
+      if (index < k_size)
+      {
+        m_cells[index++] = value;
+      }
+    }
+  }
+
+  //  **************************************************************************
+  template <typename E>
+  Matrix(const MatrixExpr<E, Rows, Cols> &expr)
+  {
+    evaluate(*this, expr.derived());
+  }
+
+  //  **************************************************************************
+  template <typename E>
+  Matrix& operator=(const MatrixExpr<E, Rows, Cols> &expr)
+  {
+    if (expr.derived().reads_across(this))
+    {
+      Matrix result(expr);
+      *this = result;
+    }
+    else
+    {
+      evaluate(*this, expr.derived());
+    }
+
+    return *this;
+  }
+
+  //  **************************************************************************
+  template <typename E>
+  Matrix& operator+=(const MatrixExpr<E, Rows, Cols> &expr)
+  {
+    return *this = *this + expr;
+  }
+
+  template <typename E>
+  Matrix& operator-=(const MatrixExpr<E, Rows, Cols> &expr)
+  {
+    return *this = *this - expr;
+  }
+
+  Matrix& operator*=(float scale)
+  {
+    Unroll<k_size>::apply([&](size_t index)
+    {
+      m_cells[index] *= scale;
+    });
+
+    return *this;
+  }
+
+  //  **************************************************************************
+  static Matrix identity()
+  {
+    Matrix result;
+    Unroll<(Rows < Cols ? Rows : Cols)>::apply([&](size_t index)
+    {
+      result(index, index) = 1.0f;
+    });
+
+    return result;
+  }
+
+  //  **************************************************************************
+  float  at(size_t row, size_t col) const         { return m_cells[row * Cols + col]; }
+  float& operator()(size_t row, size_t col)       { return m_cells[row * Cols + col]; }
+  const float&
+         operator()(size_t row, size_t col) const { return m_cells[row * Cols + col]; }
+
+  //  **************************************************************************
+  /// The elements by rows, the elements of a vector.
+  ///
+  float& operator[](size_t index)                 { return m_cells[index]; }
+  float  operator[](size_t index) const           { return m_cells[index]; }
+
+  float& x()                                      { return m_cells[0]; }
+  float& y()                                      { return m_cells[1]; }
+  float& z()                                      { return m_cells[2]; }
+  float  x() const                                { return m_cells[0]; }
+  float  y() const                                { return m_cells[1]; }
+  float  z() const                                { return m_cells[2]; }
+
+  //  **************************************************************************
+  const float* data() const                       { return m_cells; }
+  float*       data()                             { return m_cells; }
+
+  //  **************************************************************************
+  bool refers_to(const void *p) const             { return this == p; }
+  bool reads_across(const void *) const           { return false; }
+
+private:
+  float   m_cells[k_size];
+};
+
+
+//  ****************************************************************************
+template <typename L, typename R, size_t Rows, size_t Cols>
+inline
+Sum<L, R> operator+(const MatrixExpr<L, Rows, Cols> &lhs, const MatrixExpr<R, Rows, Cols> &rhs)
+{
+  return Sum<L, R>(lhs.derived(), rhs.derived());
+}
+
+//  ****************************************************************************
+template <typename L, typename R, size_t Rows, size_t Cols>
+inline
+Difference<L, R> operator-(const MatrixExpr<L, Rows, Cols> &lhs, const MatrixExpr<R, Rows, Cols> &rhs)
+{
+  return Difference<L, R>(lhs.derived(), rhs.derived());
+}
+
+//  ****************************************************************************
+template <typename E, size_t Rows, size_t Cols>
+inline
+Scaled<E> operator-(const MatrixExpr<E, Rows, Cols> &operand)
+{
+  return Scaled<E>(operand.derived(), -1.0f);
+}
+
+//  ****************************************************************************
+template <typename E, size_t Rows, size_t Cols>
+inline
+Scaled<E> operator*(const MatrixExpr<E, Rows, Cols> &operand, float scale)
+{
+  return Scaled<E>(operand.derived(), scale);
+}
+
+template <typename E, size_t Rows, size_t Cols>
+inline
+Scaled<E> operator*(float scale, const MatrixExpr<E, Rows, Cols> &operand)
+{
+  return Scaled<E>(operand.derived(), scale);
+}
+
+template <typename E, size_t Rows, size_t Cols>
+inline
+Scaled<E> operator/(const MatrixExpr<E, Rows, Cols> &operand, float divisor)
+{
+  return Scaled<E>(operand.derived(), 1.0f / divisor);
+}
+
+//  ****************************************************************************
+template <typename L, typename R, size_t Rows, size_t Inner, size_t Cols>
+inline
+Product<L, R> operator*(const MatrixExpr<L, Rows, Inner> &lhs, const MatrixExpr<R, Inner, Cols> &rhs)
+{
+  return Product<L, R>(lhs.derived(), rhs.derived());
+}
+
+//  ****************************************************************************
+template <typename L, typename R, size_t N>
+inline
+float dot(const MatrixExpr<L, N, 1> &lhs, const MatrixExpr<R, N, 1> &rhs)
+{
+  float sum = 0.0f;
+  Unroll<N>::apply([&](size_t index)
+  {
+    sum += lhs(index, 0) * rhs(index, 0);
+  });
+
+  return sum;
+}
+
+//  ****************************************************************************
+template <typename L, typename R>
+inline
+Vector<3> cross(const MatrixExpr<L, 3, 1> &lhs, const MatrixExpr<R, 3, 1> &rhs)
+{
+  float lx = lhs(0, 0), ly = lhs(1, 0), lz = lhs(2, 0);
+  float rx = rhs(0, 0), ry = rhs(1, 0), rz = rhs(2, 0);
+
+  return Vector<3>({ ly * rz - lz * ry, lz * rx - lx * rz, lx * ry - ly * rx });
+}
+
+//  ****************************************************************************
+template <typename E, size_t N>
+inline
+float squared_norm(const MatrixExpr<E, N, 1> &operand)
+{
+  return dot(operand, operand);
+}
+
+
+//  ****************************************************************************
+/// Factors a symmetric positive-definite matrix as L L', to solve A X = B.
+///
+/// The reciprocals of the diagonal are kept, so a solve only multiplies.
+///
+template <size_t N>
+class Cholesky
+{
+public:
+  //  **************************************************************************
+  /// @return   false if the matrix is not positive definite.
+  ///           Nothing may be solved until a matrix is factored.
+  ///
+  bool compute(const Matrix<N, N> &a)
+  {
+    for (size_t col = 0; col < N; ++col)
+    {
+      float diagonal = a(col, col);
+      for (size_t k = 0; k < col; ++k)
+      {
+        diagonal -= m_lower(col, k) * m_lower(col, k);
+      }
+
+      if (!(diagonal > 0.0f))
+      {
+        return false;
+      }
+
+      float root        = std::sqrt(diagonal);
+      m_lower(col, col) = root;
+      m_inverse[col]    = 1.0f / root;
+
+      for (size_t row = col + 1; row < N; ++row)
+      {
+        float value = a(row, col);
+        for (size_t k = 0; k < col; ++k)
+        {
+          value -= m_lower(row, k) * m_lower(col, k);
+        }
+
+        m_lower(row, col) = value * m_inverse[col];
+        m_lower(col, row) = 0.0f;
+      }
+    }
+
+    return true;
+  }
+
+  //  **************************************************************************
+  /// Replaces B with the solution X of A X = B.
+  ///
+  template <size_t K>
+  void solve(Matrix<N, K> &b) const
+  {
+    for (size_t col = 0; col < K; ++col)
+    {
+      // L y = b
+      for (size_t row = 0; row < N; ++row)
+      {
+        float value = b(row, col);
+        for (size_t k = 0; k < row; ++k)
+        {
+          value -= m_lower(row, k) * b(k, col);
+        }
+
+        b(row, col) = value * m_inverse[row];
+      }
+
+      // L' x = y
+      for (size_t row = N; row-- > 0; )
+      {
+        float value = b(row, col);
+        for (size_t k = row + 1; k < N; ++k)
+        {
+          value -= m_lower(k, row) * b(k, col);
+        }
+
+        b(row, col) = value * m_inverse[row];
+      }
+    }
+  }
+
+  //  **************************************************************************
+  const Matrix<N, N>& lower() const
+  {
+    return m_lower;
+  }
+
+private:
+  Matrix<N, N>  m_lower;
+  Vector<N>     m_inverse;                  ///< Reciprocals of the diagonal.
+};
+
+
+//  ****************************************************************************
+/// Factors a symmetric matrix as L D L', with a unit diagonal in L, to solve
+/// A X = B without a square root.
+///
+/// The matrix is not pivoted, so it should be positive definite, or close
+/// to it, as a covariance is.
+///
+template <size_t N>
+class LDLT
+{
+public:
+  //  **************************************************************************
+  /// @return   false if an element of D is zero.
+  ///           Nothing may be solved until a matrix is factored.
+  ///
+  bool compute(const Matrix<N, N> &a)
+  {
+    for (size_t col = 0; col < N; ++col)
+    {
+      float diagonal = a(col, col);
+      for (size_t k = 0; k < col; ++k)
+      {
+        diagonal -= m_lower(col, k) * m_lower(col, k) * m_diagonal[k];
+      }
+
+      if (!(std::fabs(diagonal) > 0.0f))
+      {
+        return false;
+      }
+
+      m_diagonal[col]   = diagonal;
+      m_inverse[col]    = 1.0f / diagonal;
+      m_lower(col, col) = 1.0f;
+
+      for (size_t row = col + 1; row < N; ++row)
+      {
+        float value = a(row, col);
+        for (size_t k = 0; k < col; ++k)
+        {
+          value -= m_lower(row, k) * m_lower(col, k) * m_diagonal[k];
+        }
+
+        m_lower(row, col) = value * m_inverse[col];
+        m_lower(col, row) = 0.0f;
+      }
+    }
+
+    return true;
+  }
+
+  //  **************************************************************************
+  /// Replaces B with the solution X of A X = B.
+  ///
+  template <size_t K>
+  void solve(Matrix<N, K> &b) const
+  {
+    for (size_t col = 0; col < K; ++col)
+    {
+      // L z = b
+      for (size_t row = 0; row < N; ++row)
+      {
+        float value = b(row, col);
+        for (size_t k = 0; k < row; ++k)
+        {
+          value -= m_lower(row, k) * b(k, col);
+        }
+
+        b(row, col) = value;
+      }
+
+      // D y = z
+      for (size_t row = 0; row < N; ++row)
+      {
+        b(row, col) *= m_inverse[row];
+      }
+
+      // L' x = y
+      for (size_t row = N; row-- > 0; )
+      {
+        float value = b(row, col);
+        for (size_t k = row + 1; k < N; ++k)
+        {
+          value -= m_lower(k, row) * b(k, col);
+        }
+
+        b(row, col) = value;
+      }
+    }
+  }
+
+  //  **************************************************************************
+  const Matrix<N, N>& lower() const
+  {
+    return m_lower;
+  }
+
+  const Vector<N>& diagonal() const
+  {
+    return m_diagonal;
+  }
+
+private:
+  Matrix<N, N>  m_lower;
+  Vector<N>     m_diagonal;
+  Vector<N>     m_inverse;                  ///< Reciprocals of the diagonal.
+};
+
+
+#endif
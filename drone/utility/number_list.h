@@ -0,0 +1,30 @@
+/// @file number_list.h
+///
+/// A short list of numbers from the configuration file, such as the factors
+/// of a gain schedule or the vertices of a geofence.
+///
+/// The list has a fixed capacity, so a configuration is copied and handed
+/// to the control loop without allocating.
+///
+//  ****************************************************************************
+#ifndef NUMBER_LIST_H_INCLUDED
+#define NUMBER_LIST_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+
+
+//  ****************************************************************************
+const size_t  k_number_list_max   = 32;     ///< Most numbers in a list.
+
+
+//  ****************************************************************************
+/// The numbers listed for a setting in the configuration file.
+///
+struct NumberList
+{
+  uint32_t  count;
+  float     values[k_number_list_max];
+};
+
+#endif
@@ -0,0 +1,199 @@
+/// @file quat.h
+///
+/// Float quaternion kernels for the control loop.
+///
+/// The orientation of the IMU is reported as a quaternion, and these kernels
+/// operate on it directly, without a conversion to Euler angles or to a
+/// rotation matrix. They only multiply and add, apart from a reciprocal
+/// square root to normalize, which is estimated from the bits of the float
+/// and refined with Newton's method rather than with a division.
+///
+/// imu::Quaternion remains for the tools and the simulator, which need its
+/// double precision and its conversions.
+///
+//  ****************************************************************************
+#ifndef QUAT_H_INCLUDED
+#define QUAT_H_INCLUDED
+
+#include <cstdint>
+#include <cstring>
+
+
+//  ****************************************************************************
+/// A quaternion (w, x, y, z), laid out as HAL::IMUData::fused_quat.
+///
+struct Quat
+{
+  float w;
+  float x;
+  float y;
+  float z;
+};
+
+
+//  ****************************************************************************
+/// Returns 1 / sqrt(value) for a positive value, with a relative error
+/// below 5e-6.
+///
+inline
+float inv_sqrt(float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+
+  bits = 0x5F375A86u - (bits >> 1);
+
+  float estimate;
+  memcpy(&estimate, &bits, sizeof(estimate));
+
+  // Each step squares the relative error of the estimate.
+  float half = 0.5f * value;
+  estimate   = estimate * (1.5f - half * estimate * estimate);
+  estimate   = estimate * (1.5f - half * estimate * estimate);
+
+  return estimate;
+}
+
+//  ****************************************************************************
+inline
+Quat to_quat(const float *p_quat)
+{
+  Quat result = { p_quat[0], p_quat[1], p_quat[2], p_quat[3] };
+
+  return result;
+}
+
+//  ****************************************************************************
+/// Returns the rotation b followed by the rotation a, a * b.
+///
+inline
+Quat multiply(const Quat &a, const Quat &b)
+{
+  Quat result =
+  {
+    a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+    a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+    a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+    a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w
+  };
+
+  return result;
+}
+
+//  ****************************************************************************
+/// Returns the inverse of a unit quaternion.
+///
+inline
+Quat conjugate(const Quat &q)
+{
+  Quat result = { q.w, -q.x, -q.y, -q.z };
+
+  return result;
+}
+
+//  ****************************************************************************
+/// Scales a quaternion to unit length. The quaternion must not be zero.
+///
+inline
+Quat normalize(const Quat &q)
+{
+  float scale = inv_sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+
+  Quat result = { q.w * scale, q.x * scale, q.y * scale, q.z * scale };
+
+  return result;
+}
+
+//  ****************************************************************************
+/// Returns the rotation about the z axis with the heading of a unit
+/// quaternion, the yaw of the Tait-Bryan angles the DMP reports.
+///
+inline
+Quat heading(const Quat &q)
+{
+  // The cosine and the sine of the yaw, scaled by the same length.
+  float c = 1.0f - 2.0f * (q.y * q.y + q.z * q.z);
+  float s = 2.0f * (q.w * q.z + q.x * q.y);
+
+  float length_sq = c * c + s * s;
+  if (length_sq <= 0.0f)
+  {
+    Quat level = { 1.0f, 0.0f, 0.0f, 0.0f };
+    return level;
+  }
+
+  // (1 + cos, sin) points at half the angle, except when turned around.
+  float length = length_sq * inv_sqrt(length_sq);
+  if (c + length <= 1.0e-6f * length)
+  {
+    Quat around = { 0.0f, 0.0f, 0.0f, 1.0f };
+    return around;
+  }
+
+  Quat result = { c + length, 0.0f, 0.0f, s };
+
+  return normalize(result);
+}
+
+//  ****************************************************************************
+/// Returns the rotation of a pitch about the x axis followed by a roll
+/// about the y axis, in radians, with the sign conventions of the DMP.
+///
+/// The sines are approximated for the half angles, which are within the
+/// command limits of the control loop.
+///
+inline
+Quat from_tilt(float roll_y, float pitch_x)
+{
+  // sin and cos to the fourth power, within 3e-4 up to 45 degrees.
+  float half_roll   = 0.5f * roll_y;
+  float half_pitch  = 0.5f * pitch_x;
+
+  float roll_sq     = half_roll  * half_roll;
+  float pitch_sq    = half_pitch * half_pitch;
+
+  float sin_roll    = half_roll  * (1.0f - roll_sq  * (1.0f / 6.0f));
+  float cos_roll    = 1.0f - roll_sq  * (0.5f - roll_sq  * (1.0f / 24.0f));
+  float sin_pitch   = half_pitch * (1.0f - pitch_sq * (1.0f / 6.0f));
+  float cos_pitch   = 1.0f - pitch_sq * (0.5f - pitch_sq * (1.0f / 24.0f));
+
+  Quat result =
+  {
+    cos_roll * cos_pitch,
+    cos_roll * sin_pitch,
+    sin_roll * cos_pitch,
+   -sin_roll * sin_pitch
+  };
+
+  return normalize(result);
+}
+
+//  ****************************************************************************
+/// Converts a rotation to the vector of its axis scaled by the angle, the
+/// error to be corrected about each axis.
+///
+/// The length is 2 sin(angle / 2) rather than the angle, within 1.2% up to
+/// 30 degrees, and the shorter of the two rotations is always reported.
+///
+inline
+void to_rotation_vector(const Quat &q, float *p_vector)
+{
+  float scale = q.w < 0.0f ? -2.0f : 2.0f;
+
+  p_vector[0] = scale * q.x;
+  p_vector[1] = scale * q.y;
+  p_vector[2] = scale * q.z;
+}
+
+//  ****************************************************************************
+/// Returns the rotation from the orientation to the target orientation,
+/// in the axes of the orientation.
+///
+inline
+Quat attitude_error(const Quat &orientation, const Quat &target)
+{
+  return multiply(conjugate(orientation), target);
+}
+
+
+#endif
@@ -0,0 +1,154 @@
+/// @file spsc_ring.h
+///
+/// Lock-free, fixed-capacity ring buffer for a single producer thread
+/// and a single consumer thread.
+///
+//  ****************************************************************************
+#ifndef SPSC_RING_H_INCLUDED
+#define SPSC_RING_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+
+
+//  ****************************************************************************
+/// Single-producer / single-consumer ring buffer.
+///
+/// The storage is embedded in the object, no allocations are performed.
+/// The capacity must be a power of two.
+///
+template <typename T, size_t N>
+class SPSCRing
+{
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SPSCRing capacity must be a power of two.");
+
+public:
+  //  **************************************************************************
+  SPSCRing()
+    : m_head(0)
+    , m_tail(0)
+  { }
+
+  //  **************************************************************************
+  /// Returns the maximum number of elements the ring can hold.
+  ///
+  static constexpr size_t capacity()
+  {
+    return N;
+  }
+
+  //  **************************************************************************
+  /// Producer: Reserves the next free slot to be populated in place.
+  ///
+  /// @return   A pointer to the slot, which becomes visible to the
+  ///           consumer after commit(). nullptr if the ring is full.
+  ///
+  T* claim()
+  {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) >= N)
+    {
+      return nullptr;
+    }
+
+    return &m_items[head & k_mask];
+  }
+
+  //  **************************************************************************
+  /// Producer: Publishes the slot returned by the last call to claim().
+  ///
+  void commit()
+  {
+    m_head.store(m_head.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+  }
+
+  //  **************************************************************************
+  /// Producer: Copies an element into the ring.
+  ///
+  /// @return   false if the ring is full and the element was not added.
+  ///
+  bool push(const T &item)
+  {
+    T* p_slot = claim();
+    if (!p_slot)
+    {
+      return false;
+    }
+
+    *p_slot = item;
+    commit();
+
+    return true;
+  }
+
+  //  **************************************************************************
+  /// Consumer: Returns the oldest element in the ring.
+  ///
+  /// @return   nullptr if the ring is empty.
+  ///
+  T* front()
+  {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail == m_head.load(std::memory_order_acquire))
+    {
+      return nullptr;
+    }
+
+    return &m_items[tail & k_mask];
+  }
+
+  //  **************************************************************************
+  /// Consumer: Releases the element returned by front().
+  ///
+  void pop()
+  {
+    m_tail.store(m_tail.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+  }
+
+  //  **************************************************************************
+  /// Consumer: Copies the oldest element out of the ring.
+  ///
+  /// @return   false if the ring is empty.
+  ///
+  bool pop(T &item)
+  {
+    T* p_item = front();
+    if (!p_item)
+    {
+      return false;
+    }
+
+    item = *p_item;
+    pop();
+
+    return true;
+  }
+
+  //  **************************************************************************
+  /// Reports the number of elements waiting in the ring.
+  /// The value is only a snapshot when called concurrently.
+  ///
+  size_t size() const
+  {
+    return m_head.load(std::memory_order_acquire)
+         - m_tail.load(std::memory_order_acquire);
+  }
+
+private:
+  //  **************************************************************************
+  static const size_t k_mask = N - 1;
+
+  alignas(64)
+  std::atomic<size_t> m_head;         ///< Next slot to be written by the producer.
+
+  alignas(64)
+  std::atomic<size_t> m_tail;         ///< Next slot to be read by the consumer.
+
+  alignas(64)
+  T                   m_items[N];     ///< Element storage.
+};
+
+
+#endif
@@ -0,0 +1,65 @@
+/// @file timebase.h
+///
+/// High-resolution monotonic timebase for the control loop.
+///
+/// All control-loop timestamps are unsigned nanosecond counts of
+/// CLOCK_MONOTONIC. Differences between timestamps are converted to
+/// seconds only at the point they are used in a calculation.
+///
+//  ****************************************************************************
+#ifndef TIMEBASE_H_INCLUDED
+#define TIMEBASE_H_INCLUDED
+
+#include <cstdint>
+#include <time.h>
+
+
+//  ****************************************************************************
+const uint64_t k_ns_per_us  = 1000ULL;
+const uint64_t k_ns_per_ms  = 1000000ULL;
+const uint64_t k_ns_per_s   = 1000000000ULL;
+
+
+//  ****************************************************************************
+/// Returns the current monotonic time in nanoseconds.
+///
+inline
+uint64_t timestamp_ns()
+{
+  timespec timestamp = {0, 0};
+
+  clock_gettime(CLOCK_MONOTONIC, &timestamp);
+
+  return uint64_t(timestamp.tv_sec) * k_ns_per_s
+       + uint64_t(timestamp.tv_nsec);
+}
+
+//  ****************************************************************************
+/// Converts a duration in nanoseconds to seconds.
+///
+inline
+float to_seconds(uint64_t duration_ns)
+{
+  return float(duration_ns) * 1.0e-9f;
+}
+
+//  ****************************************************************************
+/// Converts a duration in seconds to nanoseconds.
+///
+inline
+uint64_t seconds_to_ns(double duration_s)
+{
+  return uint64_t(duration_s * k_ns_per_s + 0.5);
+}
+
+//  ****************************************************************************
+/// Reports the elapsed seconds between two timestamps.
+///
+inline
+float elapsed_seconds(uint64_t start_ns, uint64_t end_ns)
+{
+  return to_seconds(end_ns - start_ns);
+}
+
+
+#endif
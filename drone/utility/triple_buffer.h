@@ -0,0 +1,100 @@
+/// @file triple_buffer.h
+///
+/// Lock-free hand-off of the most recent value from a single producer
+/// to a single consumer.
+///
+/// The producer always has a private buffer to fill, and the consumer always
+/// has a private buffer to read. A third buffer is exchanged between them
+/// with a single atomic operation. Neither side ever waits on the other,
+/// which makes this suitable for publishing sensor samples from an
+/// interrupt context.
+///
+//  ****************************************************************************
+#ifndef TRIPLE_BUFFER_H_INCLUDED
+#define TRIPLE_BUFFER_H_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+
+
+//  ****************************************************************************
+/// Single-producer / single-consumer triple buffer.
+///
+template <typename T>
+class TripleBuffer
+{
+public:
+  //  **************************************************************************
+  TripleBuffer()
+    : m_buffers{}
+    , m_write(0)
+    , m_shared(1)
+    , m_read(2)
+  { }
+
+  //  **************************************************************************
+  /// Producer: Returns the buffer to populate with the next value.
+  ///
+  T& write_buffer()
+  {
+    return m_buffers[m_write];
+  }
+
+  //  **************************************************************************
+  /// Producer: Publishes the contents of the write buffer.
+  /// An unread value that was previously published is discarded.
+  ///
+  void publish()
+  {
+    uint8_t prev = m_shared.exchange(m_write | k_fresh,
+                                     std::memory_order_acq_rel);
+    m_write = prev & k_index_mask;
+  }
+
+  //  **************************************************************************
+  /// Consumer: Takes ownership of the most recently published value.
+  ///
+  /// @return   true  if a new value is now available from read_buffer().
+  ///           false if nothing was published since the last call.
+  ///
+  bool acquire()
+  {
+    if (!(m_shared.load(std::memory_order_relaxed) & k_fresh))
+    {
+      return false;
+    }
+
+    uint8_t prev = m_shared.exchange(m_read,
+                                     std::memory_order_acq_rel);
+    m_read = prev & k_index_mask;
+
+    return true;
+  }
+
+  //  **************************************************************************
+  /// Consumer: Returns the value most recently taken with acquire().
+  ///
+  const T& read_buffer() const
+  {
+    return m_buffers[m_read];
+  }
+
+private:
+  //  **************************************************************************
+  static const uint8_t k_index_mask = 0x03;
+  static const uint8_t k_fresh      = 0x04;
+
+  T                     m_buffers[3];   ///< Storage for each of the buffers.
+
+  alignas(64)
+  uint8_t               m_write;        ///< Index owned by the producer.
+
+  alignas(64)
+  std::atomic<uint8_t>  m_shared;       ///< Index exchanged between both sides,
+                                        ///  flagged when it holds a new value.
+  alignas(64)
+  uint8_t               m_read;         ///< Index owned by the consumer.
+};
+
+
+#endif
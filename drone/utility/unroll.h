@@ -0,0 +1,36 @@
+/// @file unroll.h
+///
+/// Repeats an operation a number of times known at compile time, without
+/// a loop, for the kernels of the control loop.
+///
+//  ****************************************************************************
+#ifndef UNROLL_H_INCLUDED
+#define UNROLL_H_INCLUDED
+
+#include <cstddef>
+
+
+//  ****************************************************************************
+/// Calls op(index) for each index from 0 to Count - 1, unrolled.
+///
+template <size_t Count>
+struct Unroll
+{
+  template <typename Op>
+  static void apply(const Op &op)
+  {
+    Unroll<Count - 1>::apply(op);
+    op(Count - 1);
+  }
+};
+
+template <>
+struct Unroll<0>
+{
+  template <typename Op>
+  static void apply(const Op &)
+  { }
+};
+
+
+#endif
@@ -26,6 +26,8 @@
 #include <algorithm>
 #include <cmath>
 
+#include "timebase.h"
+
 void change_mode(int dir);
 int kbhit (void);
 
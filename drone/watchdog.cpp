@@ -0,0 +1,169 @@
+/// @file watchdog.cpp
+///
+/// Detects when the control loop falls behind its IMU samples, and degrades
+/// the work of the drone until it recovers.
+///
+//  ****************************************************************************
+#include "watchdog.h"
+#include "utility/timebase.h"
+
+#include <iomanip>
+#include <ostream>
+
+
+namespace // unnamed
+{
+
+//  ****************************************************************************
+/// The time of consecutive faults that enters each mode, in seconds. The
+/// drone holds its attitude after 50ms of faults, and descends after 200ms.
+///
+const float k_fault_times[k_degrade_count] =
+{
+  0.0f,                         // none
+  0.015f,                       // no_logging
+  0.025f,                       // no_telemetry
+  0.05f,                        // hold
+  0.2f                          // descend
+};
+
+const float k_recovery_time = 1.0f;   ///< seconds without a fault before
+                                      ///  the mode steps down.
+
+//  ****************************************************************************
+/// Converts a time to the whole samples of a time slice, at least one.
+///
+uint32_t to_samples(float seconds, uint64_t slice_ns)
+{
+  uint64_t samples = (seconds_to_ns(seconds) + slice_ns / 2) / slice_ns;
+
+  return samples > 0 ? uint32_t(samples) : 1;
+}
+
+}
+
+
+//  ****************************************************************************
+const char* to_string(DegradeMode mode)
+{
+  switch (mode)
+  {
+  case k_degrade_none:          return "none";
+  case k_degrade_no_logging:    return "no_logging";
+  case k_degrade_no_telemetry:  return "no_telemetry";
+  case k_degrade_hold:          return "hold";
+  case k_degrade_descend:       return "descend";
+  default:                      return "unknown";
+  }
+}
+
+
+//  ****************************************************************************
+Watchdog::Watchdog(uint64_t slice_ns)
+  : m_slice_ns(0)
+  , m_late_ns(0)
+  , m_recovery(0)
+  , m_faults(0)
+  , m_clean(0)
+  , m_stalled(0)
+  , m_mode(k_degrade_none)
+  , m_overruns(0)
+  , m_missed(0)
+  , m_max_faults(0)
+{
+  configure(slice_ns);
+
+  for (int index = 0; index < k_degrade_count; ++index)
+  {
+    m_entered[index].store(0, std::memory_order_relaxed);
+    m_cycles[index].store(0, std::memory_order_relaxed);
+  }
+}
+
+//  ****************************************************************************
+void Watchdog::configure(uint64_t slice_ns)
+{
+  m_slice_ns  = slice_ns;
+  m_late_ns   = slice_ns + slice_ns / 2;
+  m_recovery  = to_samples(k_recovery_time, slice_ns);
+
+  m_limits[k_degrade_none] = 0;
+
+  for (int index = k_degrade_none + 1; index < k_degrade_count; ++index)
+  {
+    m_limits[index] = to_samples(k_fault_times[index], slice_ns);
+  }
+}
+
+//  ****************************************************************************
+void Watchdog::fault(uint32_t count)
+{
+  m_clean   = 0;
+  m_faults += count;
+
+  if (m_faults > m_max_faults.load(std::memory_order_relaxed))
+  {
+    m_max_faults.store(m_faults, std::memory_order_relaxed);
+  }
+
+  uint8_t mode = m_mode.load(std::memory_order_relaxed);
+  while ( mode + 1 < k_degrade_count
+       && m_faults >= m_limits[mode + 1])
+  {
+    ++mode;
+  }
+
+  if (mode != m_mode.load(std::memory_order_relaxed))
+  {
+    enter(DegradeMode(mode));
+  }
+}
+
+//  ****************************************************************************
+void Watchdog::enter(DegradeMode mode)
+{
+  if (mode != m_mode.load(std::memory_order_relaxed))
+  {
+    increment(m_entered[mode]);
+    m_mode.store(uint8_t(mode), std::memory_order_relaxed);
+  }
+}
+
+//  ****************************************************************************
+void Watchdog::snapshot(WatchdogStats &stats) const
+{
+  stats.mode            = m_mode.load(std::memory_order_relaxed);
+  stats.overruns        = m_overruns.load(std::memory_order_relaxed);
+  stats.missed_samples  = m_missed.load(std::memory_order_relaxed);
+  stats.max_faults      = m_max_faults.load(std::memory_order_relaxed);
+  stats.count           = k_degrade_count;
+
+  for (int index = 0; index < k_degrade_count; ++index)
+  {
+    DegradeModeStats &mode = stats.modes[index];
+
+    mode.mode     = uint8_t(index);
+    mode.entered  = m_entered[index].load(std::memory_order_relaxed);
+    mode.cycles   = m_cycles[index].load(std::memory_order_relaxed);
+  }
+}
+
+//  ****************************************************************************
+void Watchdog::report(std::ostream &out) const
+{
+  out << "Watchdog: mode " << to_string(mode())
+      << ", " << m_overruns.load(std::memory_order_relaxed) << " overruns"
+      << ", " << m_missed.load(std::memory_order_relaxed) << " missed samples"
+      << ", at most " << m_max_faults.load(std::memory_order_relaxed)
+      << " consecutive faults.\n"
+      << std::setw(14) << "mode"
+      << std::setw(10) << "entered"
+      << std::setw(10) << "cycles" << "\n";
+
+  for (int index = 0; index < k_degrade_count; ++index)
+  {
+    out << std::setw(14) << to_string(DegradeMode(index))
+        << std::setw(10) << m_entered[index].load(std::memory_order_relaxed)
+        << std::setw(10) << m_cycles[index].load(std::memory_order_relaxed) << "\n";
+  }
+}
@@ -0,0 +1,196 @@
+/// @file watchdog.h
+///
+/// Detects when the control loop falls behind its IMU samples, and degrades
+/// the work of the drone until it recovers.
+///
+/// A fault is a cycle that does not complete within its time slice, or an IMU
+/// sample that does not arrive. As consecutive faults accumulate, the drone
+/// sheds work in steps: it stops the flight log, then the telemetry, then it
+/// ignores the sticks and holds a level attitude, and finally it descends.
+/// Each step is left after a second of cycles without faults, except the
+/// descent, which continues until the drone is disarmed.
+///
+/// The limits of the steps are times, which are converted to samples for
+/// the time slice, so the drone degrades after the same time at any rate.
+///
+//  ****************************************************************************
+#ifndef WATCHDOG_H_INCLUDED
+#define WATCHDOG_H_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+
+#include "qc_msg.h"
+#include "utility/counter.h"
+
+
+//  ****************************************************************************
+/// Tracks the faults of the control loop, and selects the DegradeMode.
+///
+/// Only the control thread may check cycles and report stalls.
+/// Snapshots and reports may be generated from any thread.
+///
+class Watchdog
+{
+public:
+  //  **************************************************************************
+  /// @param slice_ns       The time slice of each cycle.
+  ///
+  explicit
+  Watchdog(uint64_t slice_ns);
+
+  //  **************************************************************************
+  /// Changes the time slice, for a new sample rate, and converts the times
+  /// of the limits and of the recovery to samples of the slice.
+  ///
+  void configure(uint64_t slice_ns);
+
+  //  **************************************************************************
+  /// Checks a completed cycle.
+  ///
+  /// @param period_ns    The time since the previous sample was taken,
+  ///                     or zero for the first sample.
+  /// @param duration_ns  The time the cycle took to complete, from when
+  ///                     its sample was published.
+  ///
+  void cycle(uint64_t period_ns, uint64_t duration_ns)
+  {
+    uint32_t missed = 0;
+
+    // A sample is missed once the period is half a slice late.
+    if (period_ns > m_late_ns)
+    {
+      missed = uint32_t((period_ns + m_slice_ns / 2) / m_slice_ns) - 1;
+      missed = missed > m_stalled ? missed - m_stalled : 0;
+
+      increment(m_missed, missed);
+    }
+
+    m_stalled = 0;
+
+    bool is_overrun = duration_ns > m_slice_ns;
+    if (is_overrun)
+    {
+      increment(m_overruns);
+    }
+
+    if (is_overrun || missed)
+    {
+      fault(uint32_t(is_overrun) + missed);
+    }
+    else
+    {
+      recover();
+    }
+
+    increment(m_cycles[m_mode.load(std::memory_order_relaxed)]);
+  }
+
+  //  **************************************************************************
+  /// Counts the samples missed while the control loop waited for a sample.
+  /// The samples are not counted again by the cycle that ends the stall.
+  ///
+  /// @param duration_ns  The time waited without a sample.
+  ///
+  void stall(uint64_t duration_ns)
+  {
+    uint32_t missed = uint32_t(duration_ns / m_slice_ns);
+    if (0 == missed)
+    {
+      return;
+    }
+
+    m_stalled += missed;
+    increment(m_missed, missed);
+    fault(missed);
+  }
+
+  //  **************************************************************************
+  /// Returns to normal operation, when the drone is armed.
+  /// The counters are kept.
+  ///
+  void reset()
+  {
+    m_faults  = 0;
+    m_clean   = 0;
+    m_stalled = 0;
+    enter(k_degrade_none);
+  }
+
+  //  **************************************************************************
+  DegradeMode mode() const
+  {
+    return DegradeMode(m_mode.load(std::memory_order_relaxed));
+  }
+
+  //  **************************************************************************
+  /// Summarizes the faults and the modes for the watchdog telemetry message.
+  ///
+  void snapshot(WatchdogStats &stats) const;
+
+  //  **************************************************************************
+  /// Writes a human readable summary of the faults and the modes.
+  ///
+  void report(std::ostream &out) const;
+
+private:
+  //  **************************************************************************
+  typedef std::atomic<uint32_t>   counter_t;
+
+  //  **************************************************************************
+  //  Counts consecutive faults, and escalates through the modes
+  //  as they pass the threshold of each mode.
+  //
+  void fault(uint32_t count);
+
+  //  **************************************************************************
+  //  Steps down a mode after enough cycles without a fault.
+  //
+  void recover()
+  {
+    m_faults = 0;
+
+    if (++m_clean >= m_recovery)
+    {
+      m_clean = 0;
+
+      uint8_t mode = m_mode.load(std::memory_order_relaxed);
+      if ( mode > k_degrade_none
+        && mode < k_degrade_descend)
+      {
+        enter(DegradeMode(mode - 1));
+      }
+    }
+  }
+
+  //  **************************************************************************
+  void enter(DegradeMode mode);
+
+  //  **************************************************************************
+  uint64_t              m_slice_ns;
+  uint64_t              m_late_ns;        ///< A period beyond this missed a sample.
+  uint32_t              m_recovery;       ///< Cycles without a fault.
+  uint32_t              m_limits[k_degrade_count];
+                                          ///< Consecutive faults that enter each mode.
+
+  uint32_t              m_faults;         ///< Consecutive faults.
+  uint32_t              m_clean;          ///< Consecutive cycles without a fault.
+  uint32_t              m_stalled;        ///< Samples already counted by stall().
+
+  std::atomic<uint8_t>  m_mode;
+  counter_t             m_overruns;
+  counter_t             m_missed;
+  counter_t             m_max_faults;
+  counter_t             m_entered[k_degrade_count];
+  counter_t             m_cycles[k_degrade_count];
+};
+
+
+//  ****************************************************************************
+/// Returns a short display name for the mode.
+///
+const char* to_string(DegradeMode mode);
+
+
+#endif